@@ -0,0 +1,16 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout (location = 0) in vec3 fragPosition;
+layout (location = 1) flat in vec3 fragColor;
+
+layout (location = 0) out vec4 outColor;
+
+const vec3 LIGHT_DIRECTION = vec3(0.36, 0.48, 0.8);
+
+void main()
+{
+    vec3 normal = normalize(cross(dFdx(fragPosition), dFdy(fragPosition)));
+    float lighting = 0.3 + 0.7 * abs(dot(normal, LIGHT_DIRECTION));
+    outColor = vec4(fragColor * lighting, 1.0);
+}
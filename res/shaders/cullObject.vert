@@ -0,0 +1,55 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+struct CullObject
+{
+    vec4 center;
+    vec4 extent;
+};
+
+layout (std430, set = 0, binding = 0) readonly buffer Objects
+{
+    CullObject objects[];
+};
+
+layout (push_constant) uniform CullConstants
+{
+    mat4 viewProjection;
+    ivec2 depthSize;
+    uint objectCount;
+    uint level;
+    uint levelCount;
+    uint flags;
+} constants;
+
+layout (location = 0) out vec3 fragPosition;
+layout (location = 1) flat out vec3 fragColor;
+
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// The indirect draws put the object index into firstInstance. The box has
+// eight vertices, the vertex index bits select the corner.
+void main()
+{
+    CullObject object = objects[gl_InstanceIndex];
+    vec3 corner = vec3(gl_VertexIndex & 1, (gl_VertexIndex >> 1) & 1, (gl_VertexIndex >> 2) & 1) * 2.0 - 1.0;
+    vec3 position = object.center.xyz + corner * object.extent.xyz;
+
+    gl_Position = constants.viewProjection * vec4(position, 1.0);
+    fragPosition = position;
+
+    uint colorHash = hash(uint(gl_InstanceIndex));
+    fragColor = vec3(colorHash & 0xff, (colorHash >> 8) & 0xff, (colorHash >> 16) & 0xff) / 255.0 * 0.6 + 0.2;
+}
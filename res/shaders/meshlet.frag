@@ -0,0 +1,15 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout (location = 0) in vec3 fragNormal;
+layout (location = 1) flat in vec3 fragColor;
+
+layout (location = 0) out vec4 outColor;
+
+const vec3 LIGHT_DIRECTION = vec3(0.36, 0.48, 0.8);
+
+void main()
+{
+    float lighting = 0.3 + 0.7 * max(dot(normalize(fragNormal), LIGHT_DIRECTION), 0.0);
+    outColor = vec4(fragColor * lighting, 1.0);
+}
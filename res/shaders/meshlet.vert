@@ -0,0 +1,52 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+struct MeshletVertex
+{
+    vec4 position;
+    vec4 normal;
+};
+
+layout (std430, set = 0, binding = 0) readonly buffer Vertices
+{
+    MeshletVertex vertices[];
+};
+
+layout (push_constant) uniform MeshletConstants
+{
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    ivec2 depthSize;
+    uint meshletCount;
+    uint levelCount;
+    uint flags;
+} constants;
+
+layout (location = 0) out vec3 fragNormal;
+layout (location = 1) flat out vec3 fragColor;
+
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// The flattened index buffer holds mesh vertex indices and the indirect draws
+// put the meshlet index into firstInstance.
+void main()
+{
+    MeshletVertex vertex = vertices[gl_VertexIndex];
+    gl_Position = constants.viewProjection * vec4(vertex.position.xyz, 1.0);
+    fragNormal = vertex.normal.xyz;
+
+    uint colorHash = hash(uint(gl_InstanceIndex));
+    fragColor = vec3(colorHash & 0xff, (colorHash >> 8) & 0xff, (colorHash >> 16) & 0xff) / 255.0 * 0.6 + 0.2;
+}
@@ -0,0 +1,46 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+struct Particle
+{
+    vec4 positionLife;
+    vec4 velocityLifetime;
+};
+
+layout (std430, set = 0, binding = 0) readonly buffer Particles
+{
+    Particle particles[];
+};
+
+layout (push_constant) uniform ParticleDrawConstants
+{
+    mat4 viewProjection;
+    vec4 cameraRight;
+    vec4 cameraUp;
+} constants;
+
+layout (location = 0) out vec3 fragColor;
+layout (location = 1) out vec2 fragCorner;
+
+const vec2 corners[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+// One camera facing quad per instance, pulled straight from the particle
+// buffer. The quad size is in cameraRight.w.
+void main()
+{
+    Particle particle = particles[gl_InstanceIndex];
+    vec2 corner = corners[gl_VertexIndex];
+
+    vec3 offset = (constants.cameraRight.xyz * corner.x + constants.cameraUp.xyz * corner.y) * constants.cameraRight.w;
+    gl_Position = constants.viewProjection * vec4(particle.positionLife.xyz + offset, 1.0);
+
+    float age = 1.0 - particle.positionLife.w / particle.velocityLifetime.w;
+    fragColor = mix(vec3(4.0, 2.0, 0.6), vec3(0.6, 0.1, 0.02), age) * (1.0 - age);
+    fragCorner = corner;
+}
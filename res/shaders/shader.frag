@@ -1,11 +1,105 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+layout (constant_id = 0) const uint TEXTURE_CAPACITY = 1;
+layout (constant_id = 1) const uint BUFFER_CAPACITY = 1;
+layout (constant_id = 3) const bool TEXTURED = true;
+layout (constant_id = 7) const bool LIT = false;
+
+// Match clusteredLighting.h.
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 64
+
+struct Material
+{
+    vec4 color;
+};
+
+struct Light
+{
+    vec4 positionRadius;
+    vec4 colorIntensity;
+};
+
 layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec2 fragTexCoord;
+layout (location = 2) in vec3 fragWorldPosition;
+layout (location = 3) in vec3 fragNormal;
+layout (location = 4) in float fragViewDepth;
 
 layout (location = 0) out vec4 outColor;
 
+layout (set = 1, binding = 0) uniform sampler2D textures[TEXTURE_CAPACITY];
+layout (set = 1, binding = 1) readonly buffer MaterialBuffer
+{
+    Material materials[];
+} materialBuffers[BUFFER_CAPACITY];
+
+layout (set = 2, binding = 0) uniform LightingUniforms
+{
+    mat4 view;
+    mat4 inverseProjection;
+    vec2 screenSize;
+    float zNear;
+    float zFar;
+    uint lightCount;
+    float ambient;
+} lighting;
+
+layout (std430, set = 2, binding = 1) readonly buffer Lights
+{
+    Light lights[];
+};
+
+layout (std430, set = 2, binding = 2) readonly buffer Clusters
+{
+    uint clusterLights[];
+};
+
+layout (push_constant) uniform DrawConstants
+{
+    uint textureIndex;
+    uint materialBufferIndex;
+    uint materialIndex;
+} draw;
+
+// Only the lights binned into this fragment's cluster are looked at. The
+// slices are spaced exponentially in depth, like in lightBinning.comp.
+vec3 getLighting()
+{
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / lighting.screenSize * vec2(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y)), uvec2(LIGHT_CLUSTERS_X - 1, LIGHT_CLUSTERS_Y - 1));
+    float slice = log(fragViewDepth / lighting.zNear) / log(lighting.zFar / lighting.zNear) * LIGHT_CLUSTERS_Z;
+    uint cluster = (uint(clamp(slice, 0.0, LIGHT_CLUSTERS_Z - 1)) * LIGHT_CLUSTERS_Y + tile.y) * LIGHT_CLUSTERS_X + tile.x;
+
+    uint base = cluster * (MAX_LIGHTS_PER_CLUSTER + 1);
+    uint count = clusterLights[base];
+    vec3 normal = normalize(fragNormal);
+    vec3 result = vec3(lighting.ambient);
+    for (uint i = 0; i < count; i++)
+    {
+        Light light = lights[clusterLights[base + 1 + i]];
+        vec3 toLight = light.positionRadius.xyz - fragWorldPosition;
+        float distance = length(toLight);
+        float radius = light.positionRadius.w;
+        if (distance >= radius)
+            continue;
+
+        // Smooth falloff to zero at the radius. Both sides of the flat
+        // geometry are lit.
+        float falloff = 1.0 - (distance * distance) / (radius * radius);
+        float diffuse = abs(dot(normal, toLight / max(distance, 1e-4)));
+        result += light.colorIntensity.rgb * light.colorIntensity.a * diffuse * falloff * falloff;
+    }
+    return result;
+}
+
 void main()
 {
-    outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+    Material material = materialBuffers[draw.materialBufferIndex].materials[draw.materialIndex];
+    vec4 albedo = TEXTURED ? texture(textures[draw.textureIndex], fragTexCoord) : vec4(1.0);
+    outColor = albedo * material.color * vec4(fragColor, 1.0);
+    if (LIT)
+        outColor.rgb *= getLighting();
+}
@@ -5,18 +5,41 @@ out gl_PerVertex {
     vec4 gl_Position;
 };
 
+layout (constant_id = 2) const bool VERTEX_COLOR = true;
+layout (constant_id = 4) const bool INSTANCED = false;
+layout (constant_id = 5) const bool QUANTIZED_POSITIONS = false;
+layout (constant_id = 6) const float POSITION_SCALE = 1.0;
+
 layout (location = 0) in vec2 pos;
 layout (location = 1) in vec3 color;
+layout (location = 2) in vec2 texCoord;
+// INSTANCE_ATTRIBUTE_LOCATION in engine.cpp, right after the vertex attributes.
+layout (location = 3) in vec2 instanceOffset;
 
 layout (location = 0) out vec3 fragColor;
+layout (location = 1) out vec2 fragTexCoord;
+layout (location = 2) out vec3 fragWorldPosition;
+layout (location = 3) out vec3 fragNormal;
+layout (location = 4) out float fragViewDepth;
 
 layout (binding = 0) uniform UBO
 {
     mat4 MVP;
+    mat4 model;
 } ubo;
 
 void main()
 {
-    gl_Position = ubo.MVP * vec4(pos, 0.0, 1.0);
-    fragColor = color;
-}
\ No newline at end of file
+    vec2 position = QUANTIZED_POSITIONS ? pos * POSITION_SCALE : pos;
+    if (INSTANCED)
+        position += instanceOffset;
+
+    gl_Position = ubo.MVP * vec4(position, 0.0, 1.0);
+    fragColor = VERTEX_COLOR ? color : vec3(1.0);
+    fragTexCoord = texCoord;
+    // The geometry is flat in the z = 0 plane of its model space.
+    fragWorldPosition = (ubo.model * vec4(position, 0.0, 1.0)).xyz;
+    fragNormal = mat3(ubo.model) * vec3(0.0, 0.0, 1.0);
+    // w is the view space depth with a perspective projection.
+    fragViewDepth = gl_Position.w;
+}
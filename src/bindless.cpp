@@ -0,0 +1,316 @@
+#include "bindless.h"
+#include "deletionQueue.h"
+#include "descriptorAllocator.h"
+#include "frameStats.h"
+#include "memoryBudget.h"
+
+#include <algorithm>
+
+VkDescriptorSetLayout bindlessSetLayout = VK_NULL_HANDLE;
+uint32_t bindlessTextureCapacity = 0;
+uint32_t bindlessBufferCapacity = 0;
+
+static VkDescriptorPool bindlessDescriptorPool;
+static VkDescriptorSet bindlessDescriptorSets[MAX_FRAMES_IN_FLIGHT];
+
+// With descriptor indexing a single set is shared by all frames and free slots
+// are written while it is bound. Without it every frame in flight gets its own
+// copy and writes are replayed into each copy once that frame is idle again.
+static bool sharedDescriptorSet = false;
+
+struct BindlessWrite
+{
+    uint32_t binding;
+    uint32_t index;
+    VkDescriptorImageInfo imageInfo;
+    VkDescriptorBufferInfo bufferInfo;
+    uint32_t frameMask;
+};
+
+static std::vector<BindlessWrite> pendingWrites;
+static std::vector<uint32_t> freeTextureSlots;
+static std::vector<uint32_t> freeBufferSlots;
+
+static VkImage defaultImage;
+static VkDeviceMemory defaultImageMemory;
+static VkImageView defaultImageView;
+static VkSampler defaultImageSampler;
+static VkBuffer defaultBuffer;
+static VkDeviceMemory defaultBufferMemory;
+
+static const uint32_t maxBindlessTextures = 4096;
+static const uint32_t maxBindlessBuffers = 1024;
+static const VkDeviceSize defaultBufferSize = 256;
+
+static void writeDescriptor(VkDescriptorSet descriptorSet, const BindlessWrite &write)
+{
+    VkWriteDescriptorSet descriptorWrite;
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.pNext = nullptr;
+    descriptorWrite.dstSet = descriptorSet;
+    descriptorWrite.dstBinding = write.binding;
+    descriptorWrite.dstArrayElement = write.index;
+    descriptorWrite.descriptorCount = 1;
+    if (write.binding == BINDLESS_TEXTURE_BINDING)
+    {
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.pImageInfo = &write.imageInfo;
+        descriptorWrite.pBufferInfo = nullptr;
+    }
+    else
+    {
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite.pImageInfo = nullptr;
+        descriptorWrite.pBufferInfo = &write.bufferInfo;
+    }
+    descriptorWrite.pTexelBufferView = nullptr;
+
+    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+static void queueWrite(BindlessWrite &write)
+{
+    if (sharedDescriptorSet)
+    {
+        writeDescriptor(bindlessDescriptorSets[0], write);
+        return;
+    }
+
+    write.frameMask = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+    pendingWrites.push_back(write);
+}
+
+static void queueTextureWrite(uint32_t index, VkImageView imageView, VkSampler sampler)
+{
+    BindlessWrite write = {};
+    write.binding = BINDLESS_TEXTURE_BINDING;
+    write.index = index;
+    write.imageInfo.sampler = sampler;
+    write.imageInfo.imageView = imageView;
+    write.imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    queueWrite(write);
+}
+
+static void queueBufferWrite(uint32_t index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    BindlessWrite write = {};
+    write.binding = BINDLESS_BUFFER_BINDING;
+    write.index = index;
+    write.bufferInfo.buffer = buffer;
+    write.bufferInfo.offset = offset;
+    write.bufferInfo.range = range;
+    queueWrite(write);
+}
+
+static void createDefaultResources()
+{
+    createImage(1, 1, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, defaultImage, defaultImageMemory);
+    createImageView(defaultImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, 1, defaultImageView);
+
+    VkCommandBuffer commandBuffer = beginOneTimeCommands();
+    cmdImageBarrier(commandBuffer, defaultImage, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkClearColorValue white = {{1.0f, 1.0f, 1.0f, 1.0f}};
+    VkImageSubresourceRange subresourceRange;
+    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresourceRange.baseMipLevel = 0;
+    subresourceRange.levelCount = 1;
+    subresourceRange.baseArrayLayer = 0;
+    subresourceRange.layerCount = 1;
+    vkCmdClearColorImage(commandBuffer, defaultImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &white, 1, &subresourceRange);
+
+    cmdImageBarrier(commandBuffer, defaultImage, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    endOneTimeCommands(commandBuffer);
+
+    createBuffer(defaultBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, defaultBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, defaultBufferMemory);
+
+    void *memory;
+    COUNT_FRAME_STAT(MemoryMaps, 1);
+    vkMapMemory(device, defaultBufferMemory, 0, defaultBufferSize, 0, &memory);
+    memset(memory, 0, defaultBufferSize);
+    vkUnmapMemory(device, defaultBufferMemory);
+}
+
+void initBindless(VkSampler defaultSampler)
+{
+    sharedDescriptorSet = deviceCapabilities.descriptorIndexing;
+    bindlessTextureCapacity = std::min(maxBindlessTextures, deviceCapabilities.maxPerStageSampledImages);
+    bindlessBufferCapacity = std::min(maxBindlessBuffers, deviceCapabilities.maxPerStageStorageBuffers);
+    defaultImageSampler = defaultSampler;
+
+    VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[2];
+    descriptorSetLayoutBindings[0].binding = BINDLESS_TEXTURE_BINDING;
+    descriptorSetLayoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorSetLayoutBindings[0].descriptorCount = bindlessTextureCapacity;
+    descriptorSetLayoutBindings[0].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+    descriptorSetLayoutBindings[0].pImmutableSamplers = nullptr;
+
+    descriptorSetLayoutBindings[1].binding = BINDLESS_BUFFER_BINDING;
+    descriptorSetLayoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorSetLayoutBindings[1].descriptorCount = bindlessBufferCapacity;
+    descriptorSetLayoutBindings[1].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+    descriptorSetLayoutBindings[1].pImmutableSamplers = nullptr;
+
+    VkDescriptorBindingFlags bindingFlags[2] = {
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT};
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo;
+    bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsCreateInfo.pNext = nullptr;
+    bindingFlagsCreateInfo.bindingCount = 2;
+    bindingFlagsCreateInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutCreateInfo.pNext = sharedDescriptorSet ? &bindingFlagsCreateInfo : nullptr;
+    descriptorSetLayoutCreateInfo.flags = 0;
+    descriptorSetLayoutCreateInfo.bindingCount = 2;
+    descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindings;
+
+    bindlessSetLayout = descriptorLayoutCache.createLayout(descriptorSetLayoutCreateInfo);
+
+    uint32_t setCount = sharedDescriptorSet ? 1 : MAX_FRAMES_IN_FLIGHT;
+
+    VkDescriptorPoolSize descriptorPoolSizes[2];
+    descriptorPoolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorPoolSizes[0].descriptorCount = bindlessTextureCapacity * setCount;
+    descriptorPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorPoolSizes[1].descriptorCount = bindlessBufferCapacity * setCount;
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
+    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolCreateInfo.pNext = nullptr;
+    descriptorPoolCreateInfo.flags = 0;
+    descriptorPoolCreateInfo.maxSets = setCount;
+    descriptorPoolCreateInfo.poolSizeCount = 2;
+    descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizes;
+
+    VkResult result = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &bindlessDescriptorPool);
+    ASSERT_VULKAN(result);
+
+    VkDescriptorSetLayout setLayouts[MAX_FRAMES_IN_FLIGHT];
+    std::fill(setLayouts, setLayouts + MAX_FRAMES_IN_FLIGHT, bindlessSetLayout);
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.pNext = nullptr;
+    descriptorSetAllocateInfo.descriptorPool = bindlessDescriptorPool;
+    descriptorSetAllocateInfo.descriptorSetCount = setCount;
+    descriptorSetAllocateInfo.pSetLayouts = setLayouts;
+
+    result = vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, bindlessDescriptorSets);
+    ASSERT_VULKAN(result);
+
+    createDefaultResources();
+
+    // Without partially bound descriptors every slot the shader can reach has
+    // to be valid, so unused slots point at the defaults.
+    uint32_t textureSlots = sharedDescriptorSet ? 1 : bindlessTextureCapacity;
+    uint32_t bufferSlots = sharedDescriptorSet ? 1 : bindlessBufferCapacity;
+    for (uint32_t i = 0; i < textureSlots; i++)
+    {
+        queueTextureWrite(i, defaultImageView, defaultImageSampler);
+    }
+    for (uint32_t i = 0; i < bufferSlots; i++)
+    {
+        queueBufferWrite(i, defaultBuffer, 0, defaultBufferSize);
+    }
+
+    for (uint32_t i = bindlessTextureCapacity - 1; i > 0; i--)
+    {
+        freeTextureSlots.push_back(i);
+    }
+    for (uint32_t i = bindlessBufferCapacity - 1; i > 0; i--)
+    {
+        freeBufferSlots.push_back(i);
+    }
+
+    std::cout << "Bindless: " << bindlessTextureCapacity << " textures, " << bindlessBufferCapacity << " buffers, " << (sharedDescriptorSet ? "descriptor indexing" : "per-frame sets") << std::endl;
+}
+
+void shutDownBindless()
+{
+    vkDestroyDescriptorPool(device, bindlessDescriptorPool, nullptr);
+
+    vkDestroyImageView(device, defaultImageView, nullptr);
+    vkDestroyImage(device, defaultImage, nullptr);
+    freeDeviceMemory(defaultImageMemory);
+    vkDestroyBuffer(device, defaultBuffer, nullptr);
+    freeDeviceMemory(defaultBufferMemory);
+
+    pendingWrites.clear();
+    freeTextureSlots.clear();
+    freeBufferSlots.clear();
+}
+
+uint32_t allocateBindlessTexture(VkImageView imageView, VkSampler sampler)
+{
+    if (freeTextureSlots.empty())
+        throw std::runtime_error("Out of bindless texture slots!");
+
+    uint32_t index = freeTextureSlots.back();
+    freeTextureSlots.pop_back();
+    queueTextureWrite(index, imageView, sampler);
+    return index;
+}
+
+uint32_t allocateBindlessBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    if (freeBufferSlots.empty())
+        throw std::runtime_error("Out of bindless buffer slots!");
+
+    uint32_t index = freeBufferSlots.back();
+    freeBufferSlots.pop_back();
+    queueBufferWrite(index, buffer, offset, range);
+    return index;
+}
+
+// A released slot can still be read by frames in flight, so it only becomes
+// reusable once the work submitted so far has completed.
+void releaseBindlessTexture(uint32_t index)
+{
+    if (index == 0)
+        return;
+
+    if (!sharedDescriptorSet)
+        queueTextureWrite(index, defaultImageView, defaultImageSampler);
+    deletionQueue.push([=]() { freeTextureSlots.push_back(index); });
+}
+
+void releaseBindlessBuffer(uint32_t index)
+{
+    if (index == 0)
+        return;
+
+    if (!sharedDescriptorSet)
+        queueBufferWrite(index, defaultBuffer, 0, defaultBufferSize);
+    deletionQueue.push([=]() { freeBufferSlots.push_back(index); });
+}
+
+// Must be called after the frame's previous submission has completed and
+// after all allocations the frame's draws depend on.
+VkDescriptorSet beginBindlessFrame(uint32_t frame)
+{
+    if (sharedDescriptorSet)
+        return bindlessDescriptorSets[0];
+
+    uint32_t frameBit = 1u << frame;
+    for (BindlessWrite &write : pendingWrites)
+    {
+        if ((write.frameMask & frameBit) != 0)
+        {
+            writeDescriptor(bindlessDescriptorSets[frame], write);
+            write.frameMask &= ~frameBit;
+        }
+    }
+    pendingWrites.erase(std::remove_if(pendingWrites.begin(), pendingWrites.end(), [](const BindlessWrite &write) { return write.frameMask == 0; }), pendingWrites.end());
+
+    return bindlessDescriptorSets[frame];
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "engine.h"
+
+// One descriptor set holding large arrays of textures (binding 0) and storage
+// buffers (binding 1). Draws pick their resources by index through push
+// constants, so the set is bound once per frame instead of once per draw.
+// Slot 0 of each array always holds a default resource.
+const uint32_t BINDLESS_TEXTURE_BINDING = 0;
+const uint32_t BINDLESS_BUFFER_BINDING = 1;
+
+extern VkDescriptorSetLayout bindlessSetLayout;
+extern uint32_t bindlessTextureCapacity;
+extern uint32_t bindlessBufferCapacity;
+
+void initBindless(VkSampler defaultSampler);
+void shutDownBindless();
+
+uint32_t allocateBindlessTexture(VkImageView imageView, VkSampler sampler);
+uint32_t allocateBindlessBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+void releaseBindlessTexture(uint32_t index);
+void releaseBindlessBuffer(uint32_t index);
+
+VkDescriptorSet beginBindlessFrame(uint32_t frame);
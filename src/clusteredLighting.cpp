@@ -0,0 +1,259 @@
+#include "clusteredLighting.h"
+#include "descriptorAllocator.h"
+#include "deletionQueue.h"
+#include "frameStats.h"
+#include "memoryBudget.h"
+#include "pipelineCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+LightingSettings lightingSettings;
+
+static const uint32_t LIGHT_BINNING_GROUP_SIZE = 64;
+static const uint32_t LIGHT_CLUSTER_COUNT = LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z;
+
+// Match the structs and uniform block of lightBinning.comp and shader.frag.
+struct Light
+{
+    float positionRadius[4];
+    float colorIntensity[4];
+};
+
+struct LightingUniforms
+{
+    glm::mat4 view;
+    glm::mat4 inverseProjection;
+    float screenSize[2];
+    float zNear;
+    float zFar;
+    uint32_t lightCount;
+    float ambient;
+    uint32_t padding[2];
+};
+
+// Each cluster is its light count followed by up to MAX_LIGHTS_PER_CLUSTER
+// light indices.
+static const VkDeviceSize CLUSTER_BUFFER_SIZE = (VkDeviceSize)LIGHT_CLUSTER_COUNT * (MAX_LIGHTS_PER_CLUSTER + 1) * sizeof(uint32_t);
+
+// Written by the host once per frame, so every frame slot has its own. All of
+// them are shared with the async compute queue the binning may run on.
+static VkBuffer uniformBuffers[MAX_FRAMES_IN_FLIGHT];
+static VkDeviceMemory uniformBufferMemories[MAX_FRAMES_IN_FLIGHT];
+static LightingUniforms *uniformData[MAX_FRAMES_IN_FLIGHT];
+static VkBuffer lightBuffers[MAX_FRAMES_IN_FLIGHT];
+static VkDeviceMemory lightBufferMemories[MAX_FRAMES_IN_FLIGHT];
+static Light *lightData[MAX_FRAMES_IN_FLIGHT];
+static VkBuffer clusterBuffers[MAX_FRAMES_IN_FLIGHT];
+static VkDeviceMemory clusterBufferMemories[MAX_FRAMES_IN_FLIGHT];
+
+static VkDescriptorSetLayout lightingSetLayout;
+static VkPipelineLayout binningPipelineLayout;
+static VkPipeline binningPipeline = VK_NULL_HANDLE;
+static VkDescriptorSet frameLightingSet = VK_NULL_HANDLE;
+
+static void createBinningPipeline()
+{
+    binningPipeline = createComputePipeline("lightBinning.comp", binningPipelineLayout);
+}
+
+void initClusteredLighting()
+{
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        createBuffer(sizeof(LightingUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, uniformBuffers[i],
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBufferMemories[i], true);
+        COUNT_FRAME_STAT(MemoryMaps, 1);
+        VkResult result = vkMapMemory(device, uniformBufferMemories[i], 0, sizeof(LightingUniforms), 0, (void **)&uniformData[i]);
+        ASSERT_VULKAN(result);
+
+        createBuffer(MAX_LIGHTS * sizeof(Light), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, lightBuffers[i],
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, lightBufferMemories[i], true);
+        COUNT_FRAME_STAT(MemoryMaps, 1);
+        result = vkMapMemory(device, lightBufferMemories[i], 0, MAX_LIGHTS * sizeof(Light), 0, (void **)&lightData[i]);
+        ASSERT_VULKAN(result);
+
+        createBuffer(CLUSTER_BUFFER_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, clusterBuffers[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, clusterBufferMemories[i], true);
+    }
+
+    // binding 0: uniforms, binding 1: lights, binding 2: clusters
+    VkDescriptorSetLayoutBinding bindings[3];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutCreateInfo.pNext = nullptr;
+    descriptorSetLayoutCreateInfo.flags = 0;
+    descriptorSetLayoutCreateInfo.bindingCount = 3;
+    descriptorSetLayoutCreateInfo.pBindings = bindings;
+
+    lightingSetLayout = descriptorLayoutCache.createLayout(descriptorSetLayoutCreateInfo);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.pNext = nullptr;
+    pipelineLayoutCreateInfo.flags = 0;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &lightingSetLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+    pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+
+    VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &binningPipelineLayout);
+    ASSERT_VULKAN(result);
+
+    createBinningPipeline();
+}
+
+void shutDownClusteredLighting()
+{
+    vkDestroyPipeline(device, binningPipeline, nullptr);
+    vkDestroyPipelineLayout(device, binningPipelineLayout, nullptr);
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        freeDeviceMemory(clusterBufferMemories[i]);
+        vkDestroyBuffer(device, clusterBuffers[i], nullptr);
+        freeDeviceMemory(lightBufferMemories[i]);
+        vkDestroyBuffer(device, lightBuffers[i], nullptr);
+        freeDeviceMemory(uniformBufferMemories[i]);
+        vkDestroyBuffer(device, uniformBuffers[i], nullptr);
+    }
+}
+
+void recreateClusteredLightingPipelines()
+{
+    deletionQueue.destroyPipeline(binningPipeline);
+    createBinningPipeline();
+}
+
+VkDescriptorSetLayout getLightingSetLayout()
+{
+    return lightingSetLayout;
+}
+
+static float hashToUnit(uint32_t value)
+{
+    value ^= value >> 16;
+    value *= 0x7feb352du;
+    value ^= value >> 15;
+    value *= 0x846ca68bu;
+    value ^= value >> 16;
+    return (value & 0xffffff) / (float)0x1000000;
+}
+
+// Each light circles its own point above the ground plane, so the lights
+// sweep through the clusters every frame.
+static void updateLights(Light *lights, uint32_t lightCount, double time)
+{
+    for (uint32_t i = 0; i < lightCount; i++)
+    {
+        float centerX = hashToUnit(i * 8 + 0) * 2.0f - 1.0f;
+        float centerY = hashToUnit(i * 8 + 1) * 2.0f - 1.0f;
+        float orbitRadius = 0.05f + hashToUnit(i * 8 + 2) * 0.2f;
+        float speed = 0.5f + hashToUnit(i * 8 + 3) * 1.5f;
+        float phase = hashToUnit(i * 8 + 4) * glm::radians(360.0f);
+        float angle = (float)time * speed + phase;
+
+        Light &light = lights[i];
+        light.positionRadius[0] = centerX + std::cos(angle) * orbitRadius;
+        light.positionRadius[1] = centerY + std::sin(angle) * orbitRadius;
+        light.positionRadius[2] = 0.05f + hashToUnit(i * 8 + 5) * 0.1f;
+        light.positionRadius[3] = lightingSettings.lightRadius;
+
+        // A saturated hue each, from the hash of the index.
+        float hue = hashToUnit(i * 8 + 6) * 6.0f;
+        light.colorIntensity[0] = glm::clamp(std::abs(hue - 3.0f) - 1.0f, 0.0f, 1.0f);
+        light.colorIntensity[1] = glm::clamp(2.0f - std::abs(hue - 2.0f), 0.0f, 1.0f);
+        light.colorIntensity[2] = glm::clamp(2.0f - std::abs(hue - 4.0f), 0.0f, 1.0f);
+        light.colorIntensity[3] = 1.0f;
+    }
+}
+
+static VkDescriptorSet allocateLightingSet()
+{
+    VkDescriptorSet descriptorSet = frameDescriptorAllocators[currentFrame].allocate(lightingSetLayout);
+
+    VkDescriptorBufferInfo bufferInfos[3];
+    bufferInfos[0].buffer = uniformBuffers[currentFrame];
+    bufferInfos[1].buffer = lightBuffers[currentFrame];
+    bufferInfos[2].buffer = clusterBuffers[currentFrame];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+    }
+
+    VkWriteDescriptorSet descriptorWrites[3];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].pNext = nullptr;
+        descriptorWrites[i].dstSet = descriptorSet;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[i].pImageInfo = nullptr;
+        descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+        descriptorWrites[i].pTexelBufferView = nullptr;
+    }
+
+    vkUpdateDescriptorSets(device, 3, descriptorWrites, 0, nullptr);
+
+    return descriptorSet;
+}
+
+void updateClusteredLighting(double time, const glm::mat4 &view, const glm::mat4 &projection, float zNear, float zFar, uint32_t width, uint32_t height)
+{
+    uint32_t lightCount = std::min(lightingSettings.lightCount, (uint32_t)MAX_LIGHTS);
+    updateLights(lightData[currentFrame], lightCount, time);
+    COUNT_FRAME_STAT(UploadBytes, lightCount * sizeof(Light));
+
+    LightingUniforms &uniforms = *uniformData[currentFrame];
+    uniforms.view = view;
+    uniforms.inverseProjection = glm::inverse(projection);
+    uniforms.screenSize[0] = (float)width;
+    uniforms.screenSize[1] = (float)height;
+    uniforms.zNear = zNear;
+    uniforms.zFar = zFar;
+    uniforms.lightCount = lightCount;
+    uniforms.ambient = lightingSettings.ambient;
+    COUNT_FRAME_STAT(UploadBytes, sizeof(LightingUniforms));
+
+    frameLightingSet = allocateLightingSet();
+}
+
+VkDescriptorSet getLightingDescriptorSet()
+{
+    return frameLightingSet;
+}
+
+RenderGraphResource addLightBinningPass(RenderGraph &graph)
+{
+    RenderGraphResource clusters = graph.importBuffer("lightClusters", clusterBuffers[0], true);
+
+    graph.addPass("lightBinning", RenderGraphQueue::Compute)
+        .write(clusters, RenderGraphAccess::StorageWriteCompute)
+        .execute([](VkCommandBuffer commandBuffer) {
+            COUNT_FRAME_STAT(PipelineBinds, 1);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, binningPipeline);
+            COUNT_FRAME_STAT(DescriptorSetBinds, 1);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, binningPipelineLayout, 0, 1, &frameLightingSet, 0, nullptr);
+            COUNT_FRAME_STAT(Dispatches, 1);
+            vkCmdDispatch(commandBuffer, (LIGHT_CLUSTER_COUNT + LIGHT_BINNING_GROUP_SIZE - 1) / LIGHT_BINNING_GROUP_SIZE, 1, 1);
+        });
+
+    return clusters;
+}
+
+VkBuffer getLightClusterBuffer()
+{
+    return clusterBuffers[currentFrame];
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "engine.h"
+#include "renderGraph.h"
+
+#include <glm/glm.hpp>
+
+// Match the defines in lightBinning.comp and shader.frag.
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 64
+#define MAX_LIGHTS 1024
+
+// Clustered forward lighting. The view frustum is cut into a grid of froxels,
+// tiles on screen times exponential depth slices. A compute pass lists the
+// lights overlapping each froxel, and the scene's fragment shader only loops
+// over the list of the froxel it falls into.
+struct LightingSettings
+{
+    uint32_t lightCount = 64;
+    float lightRadius = 0.3f;
+    float ambient = 0.15f;
+};
+
+extern LightingSettings lightingSettings;
+
+// Before the scene pipeline layout is created, it uses the lighting set.
+void initClusteredLighting();
+void shutDownClusteredLighting();
+void recreateClusteredLightingPipelines();
+
+VkDescriptorSetLayout getLightingSetLayout();
+
+// Moves the lights and derives the froxel grid from the camera. Called once
+// per frame, after the frame slot was waited on.
+void updateClusteredLighting(double time, const glm::mat4 &view, const glm::mat4 &projection, float zNear, float zFar, uint32_t width, uint32_t height);
+// The lighting set of the current frame, for the scene pass.
+VkDescriptorSet getLightingDescriptorSet();
+
+// Adds the light binning pass and returns the cluster buffer it writes, for
+// the scene pass to read. Every frame slot has its own cluster buffer, set it
+// on the graph with getLightClusterBuffer before executing it.
+RenderGraphResource addLightBinningPass(RenderGraph &graph);
+VkBuffer getLightClusterBuffer();
@@ -0,0 +1,125 @@
+#include "deletionQueue.h"
+#include "memoryBudget.h"
+
+DeletionQueue deletionQueue(graphicsTimeline);
+
+DeletionQueue::DeletionQueue(TimelineQueue &timeline)
+    : timeline(timeline)
+{
+}
+
+void DeletionQueue::destroyBuffer(VkBuffer buffer)
+{
+    push([=]() { vkDestroyBuffer(device, buffer, nullptr); });
+}
+
+void DeletionQueue::freeMemory(VkDeviceMemory deviceMemory)
+{
+    push([=]() { freeDeviceMemory(deviceMemory); });
+}
+
+void DeletionQueue::destroyImage(VkImage image)
+{
+    push([=]() { vkDestroyImage(device, image, nullptr); });
+}
+
+void DeletionQueue::destroyImageView(VkImageView imageView)
+{
+    push([=]() { vkDestroyImageView(device, imageView, nullptr); });
+}
+
+void DeletionQueue::destroySampler(VkSampler sampler)
+{
+    push([=]() { vkDestroySampler(device, sampler, nullptr); });
+}
+
+void DeletionQueue::destroyFramebuffer(VkFramebuffer framebuffer)
+{
+    push([=]() { vkDestroyFramebuffer(device, framebuffer, nullptr); });
+}
+
+void DeletionQueue::destroyRenderPass(VkRenderPass renderPass)
+{
+    push([=]() { vkDestroyRenderPass(device, renderPass, nullptr); });
+}
+
+void DeletionQueue::destroyPipeline(VkPipeline pipeline)
+{
+    push([=]() { vkDestroyPipeline(device, pipeline, nullptr); });
+}
+
+void DeletionQueue::destroyPipelineLayout(VkPipelineLayout pipelineLayout)
+{
+    push([=]() { vkDestroyPipelineLayout(device, pipelineLayout, nullptr); });
+}
+
+void DeletionQueue::destroyShaderModule(VkShaderModule shaderModule)
+{
+    push([=]() { vkDestroyShaderModule(device, shaderModule, nullptr); });
+}
+
+void DeletionQueue::destroyCommandPool(VkCommandPool commandPool)
+{
+    push([=]() { vkDestroyCommandPool(device, commandPool, nullptr); });
+}
+
+void DeletionQueue::destroySwapchain(VkSwapchainKHR swapchain)
+{
+    push([=]() { vkDestroySwapchainKHR(device, swapchain, nullptr); });
+}
+
+// Objects referenced by work that is still being batched are released with
+// that batch, everything else with the last flushed submit.
+void DeletionQueue::push(std::function<void()> destroyFunction)
+{
+    push(timeline.getPendingValue(), std::move(destroyFunction));
+}
+
+void DeletionQueue::push(uint64_t lastUsedValue, std::function<void()> destroyFunction)
+{
+    entries.push_back({lastUsedValue, std::move(destroyFunction)});
+}
+
+void DeletionQueue::pushSubmitted(std::function<void()> destroyFunction)
+{
+    push(timeline.getSubmittedValue(), std::move(destroyFunction));
+}
+
+void DeletionQueue::collect()
+{
+    timeline.collect();
+
+    // Entries are in order except for those added by pushSubmitted, which may
+    // sit behind entries waiting for the batch being recorded.
+    uint64_t completedValue = timeline.getCompletedValue();
+    std::vector<std::function<void()>> destroyFunctions;
+    for (auto entry = entries.begin(); entry != entries.end();)
+    {
+        if (entry->value <= completedValue)
+        {
+            destroyFunctions.push_back(std::move(entry->destroyFunction));
+            entry = entries.erase(entry);
+        }
+        else
+        {
+            entry++;
+        }
+    }
+
+    for (std::function<void()> &destroyFunction : destroyFunctions)
+    {
+        destroyFunction();
+    }
+}
+
+void DeletionQueue::flush()
+{
+    timeline.waitForValue(timeline.getSubmittedValue());
+    timeline.collect();
+
+    for (Entry &entry : entries)
+    {
+        entry.destroyFunction();
+    }
+    entries.clear();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "submission.h"
+
+#include <functional>
+
+// Defers destruction of Vulkan objects until the timeline value they were
+// last used in has completed, so nothing needs a device or queue wide idle.
+class DeletionQueue
+{
+  public:
+    DeletionQueue(TimelineQueue &timeline);
+
+    void destroyBuffer(VkBuffer buffer);
+    void freeMemory(VkDeviceMemory deviceMemory);
+    void destroyImage(VkImage image);
+    void destroyImageView(VkImageView imageView);
+    void destroySampler(VkSampler sampler);
+    void destroyFramebuffer(VkFramebuffer framebuffer);
+    void destroyRenderPass(VkRenderPass renderPass);
+    void destroyPipeline(VkPipeline pipeline);
+    void destroyPipelineLayout(VkPipelineLayout pipelineLayout);
+    void destroyShaderModule(VkShaderModule shaderModule);
+    void destroyCommandPool(VkCommandPool commandPool);
+    void destroySwapchain(VkSwapchainKHR swapchain);
+
+    void push(std::function<void()> destroyFunction);
+    void push(uint64_t lastUsedValue, std::function<void()> destroyFunction);
+    // For objects the batch still being recorded doesn't use, released with
+    // the last flushed submit.
+    void pushSubmitted(std::function<void()> destroyFunction);
+
+    void collect();
+    void flush();
+
+  private:
+    struct Entry
+    {
+        uint64_t value;
+        std::function<void()> destroyFunction;
+    };
+
+    TimelineQueue &timeline;
+    std::deque<Entry> entries;
+};
+
+extern DeletionQueue deletionQueue;
@@ -0,0 +1,192 @@
+#include "descriptorAllocator.h"
+
+#include <algorithm>
+
+DescriptorLayoutCache descriptorLayoutCache;
+DescriptorAllocator frameDescriptorAllocators[MAX_FRAMES_IN_FLIGHT];
+
+struct PoolSizeRatio
+{
+    VkDescriptorType type;
+    float ratio;
+};
+
+// Descriptors per set, tuned to what the engine's layouts actually contain.
+static const PoolSizeRatio poolSizeRatios[] = {
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+    {VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f},
+};
+
+static const uint32_t maxSetsPerPool = 4096;
+
+void DescriptorAllocator::init(uint32_t initialSetsPerPool)
+{
+    setsPerPool = initialSetsPerPool;
+}
+
+void DescriptorAllocator::destroy()
+{
+    for (VkDescriptorPool pool : usedPools)
+    {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    for (VkDescriptorPool pool : freePools)
+    {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    usedPools.clear();
+    freePools.clear();
+    currentPool = VK_NULL_HANDLE;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool()
+{
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const PoolSizeRatio &poolSizeRatio : poolSizeRatios)
+    {
+        VkDescriptorPoolSize poolSize;
+        poolSize.type = poolSizeRatio.type;
+        poolSize.descriptorCount = std::max(1u, (uint32_t)(poolSizeRatio.ratio * setsPerPool));
+        poolSizes.push_back(poolSize);
+    }
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
+    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolCreateInfo.pNext = nullptr;
+    descriptorPoolCreateInfo.flags = 0;
+    descriptorPoolCreateInfo.maxSets = setsPerPool;
+    descriptorPoolCreateInfo.poolSizeCount = poolSizes.size();
+    descriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
+
+    VkDescriptorPool pool;
+    VkResult result = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &pool);
+    ASSERT_VULKAN(result);
+
+    // Every new pool is larger than the last, so a busy allocator settles on a
+    // few big pools.
+    setsPerPool = std::min(setsPerPool * 2, maxSetsPerPool);
+
+    return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::grabPool()
+{
+    VkDescriptorPool pool;
+    if (!freePools.empty())
+    {
+        pool = freePools.back();
+        freePools.pop_back();
+    }
+    else
+    {
+        pool = createPool();
+    }
+
+    usedPools.push_back(pool);
+    return pool;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+    if (currentPool == VK_NULL_HANDLE)
+        currentPool = grabPool();
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.pNext = nullptr;
+    descriptorSetAllocateInfo.descriptorPool = currentPool;
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &layout;
+
+    VkDescriptorSet descriptorSet;
+    VkResult result = vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet);
+
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+    {
+        currentPool = grabPool();
+        descriptorSetAllocateInfo.descriptorPool = currentPool;
+        result = vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet);
+    }
+    ASSERT_VULKAN(result);
+
+    return descriptorSet;
+}
+
+// Only valid once the GPU has finished with every set handed out since the
+// last reset.
+void DescriptorAllocator::reset()
+{
+    for (VkDescriptorPool pool : usedPools)
+    {
+        vkResetDescriptorPool(device, pool, 0);
+        freePools.push_back(pool);
+    }
+    usedPools.clear();
+    currentPool = VK_NULL_HANDLE;
+}
+
+bool DescriptorLayoutCache::LayoutBinding::operator==(const LayoutBinding &other) const
+{
+    return binding == other.binding && descriptorType == other.descriptorType && descriptorCount == other.descriptorCount &&
+           stageFlags == other.stageFlags && bindingFlags == other.bindingFlags;
+}
+
+bool DescriptorLayoutCache::LayoutKey::operator==(const LayoutKey &other) const
+{
+    return flags == other.flags && bindings == other.bindings;
+}
+
+size_t DescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey &key) const
+{
+    size_t hash = std::hash<uint32_t>()(key.flags);
+    for (const LayoutBinding &binding : key.bindings)
+    {
+        size_t bindingHash = binding.binding | binding.descriptorType << 8 | (size_t)binding.descriptorCount << 16 | (size_t)binding.stageFlags << 40 | (size_t)binding.bindingFlags << 56;
+        hash ^= std::hash<size_t>()(bindingHash) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::createLayout(const VkDescriptorSetLayoutCreateInfo &createInfo)
+{
+    const VkDescriptorBindingFlags *bindingFlags = nullptr;
+    for (const VkBaseInStructure *next = (const VkBaseInStructure *)createInfo.pNext; next != nullptr; next = next->pNext)
+    {
+        if (next->sType == VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO)
+            bindingFlags = ((const VkDescriptorSetLayoutBindingFlagsCreateInfo *)next)->pBindingFlags;
+    }
+
+    LayoutKey key;
+    key.flags = createInfo.flags;
+    for (uint32_t i = 0; i < createInfo.bindingCount; i++)
+    {
+        const VkDescriptorSetLayoutBinding &binding = createInfo.pBindings[i];
+        key.bindings.push_back({binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags, bindingFlags != nullptr ? bindingFlags[i] : 0});
+    }
+    std::sort(key.bindings.begin(), key.bindings.end(), [](const LayoutBinding &a, const LayoutBinding &b) { return a.binding < b.binding; });
+
+    auto it = layouts.find(key);
+    if (it != layouts.end())
+        return it->second;
+
+    VkDescriptorSetLayout layout;
+    VkResult result = vkCreateDescriptorSetLayout(device, &createInfo, nullptr, &layout);
+    ASSERT_VULKAN(result);
+
+    layouts[key] = layout;
+    return layout;
+}
+
+void DescriptorLayoutCache::destroy()
+{
+    for (auto &entry : layouts)
+    {
+        vkDestroyDescriptorSetLayout(device, entry.second, nullptr);
+    }
+    layouts.clear();
+}
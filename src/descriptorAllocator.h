@@ -0,0 +1,66 @@
+#pragma once
+
+#include "engine.h"
+
+#include <unordered_map>
+
+// Hands out descriptor sets from a list of pools that grows on demand. Sets are
+// never freed individually; reset() recycles every pool at once, which keeps
+// allocation a pointer bump and avoids pool fragmentation.
+class DescriptorAllocator
+{
+  public:
+    void init(uint32_t initialSetsPerPool = 64);
+    void destroy();
+
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+    void reset();
+
+  private:
+    VkDescriptorPool createPool();
+    VkDescriptorPool grabPool();
+
+    uint32_t setsPerPool;
+    VkDescriptorPool currentPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPool> usedPools;
+    std::vector<VkDescriptorPool> freePools;
+};
+
+// Deduplicates descriptor set layouts by their bindings, so identical layouts
+// requested from different places share one handle.
+class DescriptorLayoutCache
+{
+  public:
+    VkDescriptorSetLayout createLayout(const VkDescriptorSetLayoutCreateInfo &createInfo);
+    void destroy();
+
+  private:
+    struct LayoutBinding
+    {
+        uint32_t binding;
+        VkDescriptorType descriptorType;
+        uint32_t descriptorCount;
+        VkShaderStageFlags stageFlags;
+        VkDescriptorBindingFlags bindingFlags;
+
+        bool operator==(const LayoutBinding &other) const;
+    };
+
+    struct LayoutKey
+    {
+        VkDescriptorSetLayoutCreateFlags flags;
+        std::vector<LayoutBinding> bindings;
+
+        bool operator==(const LayoutKey &other) const;
+    };
+
+    struct LayoutKeyHash
+    {
+        size_t operator()(const LayoutKey &key) const;
+    };
+
+    std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> layouts;
+};
+
+extern DescriptorLayoutCache descriptorLayoutCache;
+extern DescriptorAllocator frameDescriptorAllocators[MAX_FRAMES_IN_FLIGHT];
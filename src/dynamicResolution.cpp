@@ -0,0 +1,70 @@
+#include "dynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+DynamicResolutionSettings dynamicResolutionSettings;
+
+static float renderScale = 1.0f;
+static double smoothedMilliseconds = 0.0;
+static uint32_t framesSinceChange = 0;
+
+// From the first pass starting to the last one ending, so work overlapping on
+// the async compute queue is not counted twice.
+static double getGpuFrameMilliseconds(const std::vector<RenderGraphPassTiming> &timings)
+{
+    double start = timings[0].startMilliseconds;
+    double end = 0.0;
+    for (const RenderGraphPassTiming &timing : timings)
+    {
+        start = std::min(start, timing.startMilliseconds);
+        end = std::max(end, timing.startMilliseconds + timing.milliseconds);
+    }
+    return end - start;
+}
+
+bool updateDynamicResolution(const std::vector<RenderGraphPassTiming> &timings)
+{
+    if (!dynamicResolutionSettings.enabled || timings.empty())
+        return false;
+
+    double frameMilliseconds = getGpuFrameMilliseconds(timings);
+    smoothedMilliseconds = smoothedMilliseconds == 0.0 ? frameMilliseconds : smoothedMilliseconds * 0.9 + frameMilliseconds * 0.1;
+
+    if (++framesSinceChange < dynamicResolutionSettings.cooldownFrames || smoothedMilliseconds <= 0.0)
+        return false;
+
+    // GPU time grows with the pixel count, the square of the scale. Rounding
+    // down leaves headroom before the next step up, which keeps the scale
+    // from bouncing between two steps.
+    const DynamicResolutionSettings &settings = dynamicResolutionSettings;
+    float idealScale = renderScale * std::sqrt(settings.targetMilliseconds / smoothedMilliseconds);
+    float scale = std::floor(idealScale / settings.scaleStep + 1e-3f) * settings.scaleStep;
+    scale = std::min(std::max(scale, settings.minScale), settings.maxScale);
+    if (std::abs(scale - renderScale) < settings.scaleStep * 0.5f)
+        return false;
+
+    // Predicts the time at the new scale until frames rendered at it arrive.
+    smoothedMilliseconds *= (scale * scale) / (renderScale * renderScale);
+    renderScale = scale;
+    framesSinceChange = 0;
+    return true;
+}
+
+void setRenderScale(float scale)
+{
+    renderScale = std::min(std::max(scale, 0.1f), 1.0f);
+    dynamicResolutionSettings.enabled = false;
+}
+
+float getRenderScale()
+{
+    return renderScale;
+}
+
+VkExtent2D getRenderExtent(uint32_t width, uint32_t height)
+{
+    if (renderScale >= 1.0f)
+        return {width, height};
+    return {std::max((uint32_t)std::lround(width * renderScale), 1u), std::max((uint32_t)std::lround(height * renderScale), 1u)};
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "engine.h"
+#include "renderGraph.h"
+
+// Scales the internal render resolution to keep the GPU frame time under a
+// target. The scale snaps to steps, and the render graph is only rebuilt when
+// it moves to another step, at most once per cooldown.
+struct DynamicResolutionSettings
+{
+    bool enabled = true;
+    float targetMilliseconds = 1000.0f / 60.0f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float scaleStep = 0.05f;
+    // Also covers the frames still in flight at the old scale.
+    uint32_t cooldownFrames = 30;
+};
+
+extern DynamicResolutionSettings dynamicResolutionSettings;
+
+// Takes the pass timings of a finished frame. Returns true when the render
+// scale changed and the graph needs to be rebuilt.
+bool updateDynamicResolution(const std::vector<RenderGraphPassTiming> &timings);
+// Locks the scale, e.g. for captures that have to be reproducible.
+void setRenderScale(float scale);
+float getRenderScale();
+VkExtent2D getRenderExtent(uint32_t width, uint32_t height);
@@ -0,0 +1,2286 @@
+#include "engine.h"
+#include "submission.h"
+#include "deletionQueue.h"
+#include "texture.h"
+#include "vertexLayout.h"
+#include "bindless.h"
+#include "clusteredLighting.h"
+#include "descriptorAllocator.h"
+#include "dynamicResolution.h"
+#include "shaderManager.h"
+#include "pipelineCache.h"
+#include "renderGraph.h"
+#include "postProcess.h"
+#include "frameCapture.h"
+#include "frameStats.h"
+#include "geometryPool.h"
+#include "memoryBudget.h"
+#include "meshlets.h"
+#include "occlusionCulling.h"
+#include "particles.h"
+#include "sceneFormat.h"
+#include "sceneLoader.h"
+#include "simulation.h"
+#include "stressScene.h"
+
+#include <fstream>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+VkInstance instance;
+std::vector<VkPhysicalDevice> physicalDevices;
+VkSurfaceKHR surface;
+VkDevice device;
+VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+VkImage *swapchainImages;
+VkImageView *imageViews;
+VkShaderModule shaderModuleVert;
+VkShaderModule shaderModuleFrag;
+VkPipelineLayout pipelineLayout;
+RenderGraph renderGraph;
+RenderGraphResource backbuffer;
+RenderGraphResource lightClusters;
+// Sets the scene pass binds, updated every frame before the graph executes.
+VkDescriptorSet frameDescriptorSet;
+VkDescriptorSet bindlessDescriptorSet;
+VkCommandPool commandPool;
+VkQueue queue;
+VkQueue computeQueue = VK_NULL_HANDLE;
+
+VkSemaphore semaphoresImageAvailable[MAX_FRAMES_IN_FLIGHT];
+VkSemaphore semaphoresRenderingDone[MAX_FRAMES_IN_FLIGHT];
+uint64_t frameTimelineValues[MAX_FRAMES_IN_FLIGHT] = {};
+uint32_t currentFrame = 0;
+
+uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+DeviceCapabilities deviceCapabilities;
+std::vector<VkExtensionProperties> deviceExtensionProperties;
+PFN_vkGetPhysicalDeviceFeatures2 getPhysicalDeviceFeatures2 = nullptr;
+PFN_vkGetPhysicalDeviceMemoryProperties2 getPhysicalDeviceMemoryProperties2 = nullptr;
+
+// Quantized vertices have a different stride, so they get a pool of their own.
+GeometryPool sceneGeometry;
+GeometryPool quantizedSceneGeometry;
+GeometryHandle quadMesh;
+GeometryHandle quantizedQuadMesh;
+VkBuffer instanceBuffer;
+VkDeviceMemory instanceBufferDeviceMemory;
+VkBuffer uniformBuffers[MAX_FRAMES_IN_FLIGHT];
+VkDeviceMemory uniformBufferDeviceMemories[MAX_FRAMES_IN_FLIGHT];
+
+GLFWwindow *window;
+const char *windowTitle = "Vulkan";
+
+uint32_t swapchainImageCount = 0;
+
+uint32_t width = 800;
+uint32_t height = 600;
+// The size the scene is rendered at before the upscale to the swapchain.
+uint32_t renderWidth = 800;
+uint32_t renderHeight = 600;
+const VkFormat format = VK_FORMAT_B8G8R8A8_UNORM;
+// Clamped to what the device supports for both color and depth.
+uint32_t requestedMsaaSamples = 4;
+VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+
+// Matches the UBO block of shader.vert.
+struct SceneUniforms
+{
+    glm::mat4 MVP;
+    glm::mat4 model;
+};
+
+SceneUniforms sceneUniforms;
+glm::mat4 viewMatrix;
+glm::mat4 projectionMatrix;
+const float Z_NEAR = 0.01f;
+const float Z_FAR = 10.0f;
+VkDescriptorSetLayout descriptorSetLayout;
+
+Texture *texture;
+
+class Material
+{
+  public:
+    glm::vec4 color;
+};
+
+std::vector<Material> materials = {
+    {glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)}};
+
+VkBuffer materialBuffer;
+VkDeviceMemory materialBufferDeviceMemory;
+uint32_t materialBufferIndex;
+
+// Per-draw indices into the bindless arrays, see bindless.h.
+struct DrawConstants
+{
+    uint32_t textureIndex;
+    uint32_t materialBufferIndex;
+    uint32_t materialIndex;
+};
+
+class Vertex
+{
+  public:
+    glm::vec2 pos;
+    glm::vec3 color;
+    glm::vec2 texCoord;
+
+    Vertex(glm::vec2 pos, glm::vec3 color, glm::vec2 texCoord)
+        : pos(pos), color(color), texCoord(texCoord)
+    {
+    }
+
+    static constexpr auto getLayout()
+    {
+        return makeVertexLayout<Vertex>(VK_VERTEX_INPUT_RATE_VERTEX, VERTEX_ATTRIBUTE(Vertex, pos), VERTEX_ATTRIBUTE(Vertex, color), VERTEX_ATTRIBUTE(Vertex, texCoord));
+    }
+};
+
+// Same layout as Vertex, but with positions stored as 16 bit snorm. The
+// shader scales them back by the POSITION_SCALE specialization constant.
+class QuantizedVertex
+{
+  public:
+    Snorm16x2 pos;
+    glm::vec3 color;
+    glm::vec2 texCoord;
+
+    static constexpr auto getLayout()
+    {
+        return makeVertexLayout<QuantizedVertex>(VK_VERTEX_INPUT_RATE_VERTEX, VERTEX_ATTRIBUTE(QuantizedVertex, pos), VERTEX_ATTRIBUTE(QuantizedVertex, color),
+                                                 VERTEX_ATTRIBUTE(QuantizedVertex, texCoord));
+    }
+};
+
+// Per-instance data, read from binding 1. Every pipeline declares it so the
+// vertex shader interface stays the same across permutations.
+class InstanceData
+{
+  public:
+    glm::vec2 offset;
+
+    static constexpr auto getLayout()
+    {
+        return makeVertexLayout<InstanceData>(VK_VERTEX_INPUT_RATE_INSTANCE, VERTEX_ATTRIBUTE(InstanceData, offset));
+    }
+};
+
+static_assert(isVertexLayoutValid(Vertex::getLayout()) && isVertexLayoutValid(QuantizedVertex::getLayout()) && isVertexLayoutValid(InstanceData::getLayout()),
+              "vertex attribute outside of its stride");
+
+// Instance attributes follow the vertex attributes. Both vertex types feed
+// the same vertex shader, so they need the same number of locations.
+constexpr uint32_t INSTANCE_ATTRIBUTE_LOCATION = (uint32_t)Vertex::getLayout().attributes.size();
+static_assert(QuantizedVertex::getLayout().attributes.size() == INSTANCE_ATTRIBUTE_LOCATION, "vertex types disagree on the instance attribute location");
+
+// Feature flags selecting a shader permutation. Each flag maps to a boolean
+// specialization constant, see shader.vert and shader.frag.
+enum ShaderFeatureFlagBits : uint32_t
+{
+    SHADER_FEATURE_VERTEX_COLOR_BIT = 0x00000001,
+    SHADER_FEATURE_TEXTURED_BIT = 0x00000002,
+    SHADER_FEATURE_INSTANCED_BIT = 0x00000004,
+    SHADER_FEATURE_QUANTIZED_POSITIONS_BIT = 0x00000008,
+    SHADER_FEATURE_LIT_BIT = 0x00000010,
+};
+
+enum ShaderConstantId : uint32_t
+{
+    SHADER_CONSTANT_TEXTURE_CAPACITY = 0,
+    SHADER_CONSTANT_BUFFER_CAPACITY = 1,
+    SHADER_CONSTANT_VERTEX_COLOR = 2,
+    SHADER_CONSTANT_TEXTURED = 3,
+    SHADER_CONSTANT_INSTANCED = 4,
+    SHADER_CONSTANT_QUANTIZED_POSITIONS = 5,
+    SHADER_CONSTANT_POSITION_SCALE = 6,
+    SHADER_CONSTANT_LIT = 7,
+};
+
+VkPipeline createScenePipeline(uint32_t features);
+
+PipelinePermutations scenePipelines(createScenePipeline);
+uint32_t sceneFeatures = SHADER_FEATURE_VERTEX_COLOR_BIT | SHADER_FEATURE_TEXTURED_BIT | SHADER_FEATURE_LIT_BIT;
+
+std::vector<Vertex> vertices =
+    {
+        Vertex({-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}),
+        Vertex({0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}),
+        Vertex({-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}),
+        Vertex({0.5f, -0.5f}, {1.0f, 1.0f, 1.0f}, {1.0f, 0.0f})};
+
+std::vector<uint32_t> indices = {
+    0, 1, 2,
+    0, 3, 1};
+
+std::vector<InstanceData> instances = {
+    {glm::vec2(0.0f, 0.0f)}};
+
+std::vector<QuantizedVertex> quantizedVertices;
+float positionScale = 1.0f;
+
+static_assert(sizeof(QuantizedVertex) == sizeof(SceneVertex), "scene files are uploaded without conversion");
+std::string sceneFileName;
+
+void printStats(VkPhysicalDevice &device)
+{
+    VkPhysicalDeviceProperties deviceProps;
+    vkGetPhysicalDeviceProperties(device, &deviceProps);
+
+    uint32_t apiVer = deviceProps.apiVersion;
+
+    std::cout << std::endl;
+    std::cout << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Name:                      " << deviceProps.deviceName << std::endl;
+    std::cout << "API Version:               " << VK_VERSION_MAJOR(apiVer) << "." << VK_VERSION_MINOR(apiVer) << "." << VK_VERSION_PATCH(apiVer) << std::endl;
+    std::cout << "Driver Version:            " << deviceProps.driverVersion << std::endl;
+    std::cout << "Vendor ID:                 " << deviceProps.vendorID << std::endl;
+    std::cout << "Device ID:                 " << deviceProps.deviceID << std::endl;
+    std::cout << "Device Type:               " << deviceProps.deviceType << std::endl;
+    std::cout << "Discrete Queue Priorities: " << deviceProps.limits.discreteQueuePriorities << std::endl;
+
+    VkPhysicalDeviceFeatures deviceFeatures;
+    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+    std::cout << "Geometry Shader:    " << deviceFeatures.geometryShader << std::endl;
+
+    std::cout << std::endl;
+
+    VkPhysicalDeviceMemoryProperties deviceMemProps;
+    vkGetPhysicalDeviceMemoryProperties(device, &deviceMemProps);
+    std::cout << "Memory Heap Count:  " << deviceMemProps.memoryHeapCount << std::endl;
+    for (uint32_t i = 0; i < deviceMemProps.memoryHeapCount; i++)
+    {
+        bool deviceLocal = (deviceMemProps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        std::cout << "  Heap # " << i << ": " << deviceMemProps.memoryHeaps[i].size / (1024 * 1024) << " MiB" << (deviceLocal ? ", device local" : "") << std::endl;
+    }
+    std::cout << "Memory Type Count:  " << deviceMemProps.memoryTypeCount << std::endl;
+    for (uint32_t i = 0; i < deviceMemProps.memoryTypeCount; i++)
+    {
+        std::cout << "  Type # " << i << ": heap " << deviceMemProps.memoryTypes[i].heapIndex << ", flags " << deviceMemProps.memoryTypes[i].propertyFlags << std::endl;
+    }
+
+    std::cout << std::endl;
+
+    uint32_t familyQueueCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &familyQueueCount, nullptr);
+    VkQueueFamilyProperties *familyProperties = new VkQueueFamilyProperties[familyQueueCount];
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &familyQueueCount, familyProperties);
+
+    std::cout << "Queue Family Count: " << familyQueueCount << std::endl;
+
+    for (int i = 0; i < familyQueueCount; i++)
+    {
+        std::cout << std::endl;
+        std::cout << "Queue Family # " << i << std::endl;
+        std::cout << "VK_QUEUE_GRAPHICS_BIT       " << ((familyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0) << std::endl;
+        std::cout << "VK_QUEUE_COMPUTE_BIT        " << ((familyProperties[i].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0) << std::endl;
+        std::cout << "VK_QUEUE_TRANSFER_BIT       " << ((familyProperties[i].queueFlags & VK_QUEUE_TRANSFER_BIT) != 0) << std::endl;
+        std::cout << "VK_QUEUE_SPARSE_BINDING_BIT " << ((familyProperties[i].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT) != 0) << std::endl;
+        std::cout << "Queue Count:          " << familyProperties[i].queueCount << std::endl;
+        std::cout << "Timestamp Valid Bits: " << familyProperties[i].timestampValidBits << std::endl;
+        uint32_t width = familyProperties[i].minImageTransferGranularity.width;
+        uint32_t height = familyProperties[i].minImageTransferGranularity.height;
+        uint32_t depth = familyProperties[i].minImageTransferGranularity.depth;
+        std::cout << "Min Image Timestamp Granularity : " << width << ", " << height << ", " << depth << std::endl;
+    }
+
+    VkSurfaceCapabilitiesKHR surfaceCapabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &surfaceCapabilities);
+    std::cout << std::endl;
+    std::cout << std::endl;
+    std::cout << std::endl;
+    std::cout << "Surface capabilities: " << std::endl;
+    std::cout << "      minImageCount: " << surfaceCapabilities.minImageCount << std::endl;
+    std::cout << "      maxImageCount: " << surfaceCapabilities.maxImageCount << std::endl;
+    std::cout << "      currentExtent: " << surfaceCapabilities.currentExtent.width << "/" << surfaceCapabilities.currentExtent.height << std::endl;
+    std::cout << "      minImageExtent: " << surfaceCapabilities.currentExtent.width << "/" << surfaceCapabilities.currentExtent.height << std::endl;
+    std::cout << "      maxImageExtent: " << surfaceCapabilities.currentExtent.width << "/" << surfaceCapabilities.currentExtent.height << std::endl;
+    std::cout << "      maxImageArrayLayers: " << surfaceCapabilities.maxImageArrayLayers << std::endl;
+    std::cout << "      supportedTransforms: " << surfaceCapabilities.supportedTransforms << std::endl;
+    std::cout << "      currentTransform: " << surfaceCapabilities.currentTransform << std::endl;
+    std::cout << "      supportedCompositeA: " << surfaceCapabilities.supportedCompositeAlpha << std::endl;
+    std::cout << "      supportedUsageFlags: " << surfaceCapabilities.supportedUsageFlags << std::endl;
+
+    uint32_t formateCount = 0;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formateCount, nullptr);
+    VkSurfaceFormatKHR *surfaceFormats = new VkSurfaceFormatKHR[formateCount];
+    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formateCount, surfaceFormats);
+
+    std::cout << std::endl;
+    std::cout << "Amount of Formats: " << formateCount << std::endl;
+
+    for (int i = 0; i < formateCount; i++)
+    {
+        std::cout << "Format: " << surfaceFormats[i].format << std::endl;
+    }
+
+    uint32_t presentationModeCount = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentationModeCount, nullptr);
+    VkPresentModeKHR *presentModes = new VkPresentModeKHR[presentationModeCount];
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentationModeCount, presentModes);
+
+    std::cout << std::endl;
+    std::cout << "Amount of Presentation Modes: " << presentationModeCount << std::endl;
+
+    for (int i = 0; i < presentationModeCount; i++)
+    {
+        std::cout << "Supported presentation mod: " << presentModes[i] << std::endl;
+    }
+
+    std::cout << std::endl;
+    delete[] familyProperties;
+    delete[] surfaceFormats;
+    delete[] presentModes;
+}
+
+std::vector<char> readFile(const std::string &fileName)
+{
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+
+    if (file)
+    {
+        size_t fileSize = (size_t)file.tellg();
+        std::vector<char> fileBuffer(fileSize);
+        file.seekg(0);
+        file.read(fileBuffer.data(), fileSize);
+        file.close();
+        return fileBuffer;
+    }
+    else
+    {
+        throw std::runtime_error("Failed to open file!");
+    }
+}
+
+void recreateSwapchain();
+
+// Input arrives on the main thread while everything it affects belongs to the
+// render thread, so callbacks only queue it up for processInput.
+std::mutex inputMutex;
+std::vector<int> pendingKeys;
+bool resizePending = false;
+int pendingWidth = 0;
+int pendingHeight = 0;
+
+void windowResizeCallback(GLFWwindow *window, int w, int h)
+{
+    std::lock_guard<std::mutex> lock(inputMutex);
+    resizePending = true;
+    pendingWidth = w;
+    pendingHeight = h;
+}
+
+void resizeWindow(int w, int h)
+{
+    VkSurfaceCapabilitiesKHR surfaceCapabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevices[0], surface, &surfaceCapabilities);
+    if (w > surfaceCapabilities.maxImageExtent.width)
+        w = surfaceCapabilities.maxImageExtent.width;
+    if (h > surfaceCapabilities.maxImageExtent.height)
+        h = surfaceCapabilities.maxImageExtent.height;
+
+    if (w == 0 || h == 0)
+        return;
+
+    width = w;
+    height = h;
+
+    recreateSwapchain();
+}
+
+bool renderGraphDirty = false;
+bool printPassTimingsRequested = false;
+bool particleBenchmark = false;
+bool lightBenchmark = false;
+bool vsync = true;
+
+void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS)
+        return;
+
+    std::lock_guard<std::mutex> lock(inputMutex);
+    pendingKeys.push_back(key);
+}
+
+void handleKey(int key)
+{
+    switch (key)
+    {
+    case GLFW_KEY_B:
+        postProcessSettings.bloom = !postProcessSettings.bloom;
+        renderGraphDirty = true;
+        break;
+    case GLFW_KEY_M:
+        postProcessSettings.tonemap = !postProcessSettings.tonemap;
+        renderGraphDirty = true;
+        break;
+    case GLFW_KEY_F:
+        postProcessSettings.fxaa = !postProcessSettings.fxaa;
+        renderGraphDirty = true;
+        break;
+    case GLFW_KEY_P:
+        particleSettings.enabled = !particleSettings.enabled;
+        renderGraphDirty = true;
+        break;
+    case GLFW_KEY_K:
+        meshletSettings.meshShading = !meshletSettings.meshShading;
+        renderGraphDirty = true;
+        break;
+    case GLFW_KEY_O:
+        occlusionCullingSettings.occlusion = !occlusionCullingSettings.occlusion;
+        std::cout << "Occlusion culling " << occlusionCullingSettings.occlusion << std::endl;
+        break;
+    case GLFW_KEY_T:
+        printPassTimingsRequested = true;
+        break;
+    case GLFW_KEY_V:
+        printMemoryBudget();
+        break;
+    case GLFW_KEY_C:
+        printFrameStats();
+        break;
+    case GLFW_KEY_L:
+        sceneFeatures ^= SHADER_FEATURE_LIT_BIT;
+        renderGraphDirty = true;
+        std::cout << "Clustered lighting " << ((sceneFeatures & SHADER_FEATURE_LIT_BIT) != 0) << ", " << lightingSettings.lightCount << " lights" << std::endl;
+        break;
+    case GLFW_KEY_G:
+        frameStatsSettings.overlay = !frameStatsSettings.overlay;
+        renderGraphDirty = true;
+        break;
+    case GLFW_KEY_R:
+        dynamicResolutionSettings.enabled = !dynamicResolutionSettings.enabled;
+        std::cout << "Dynamic resolution " << dynamicResolutionSettings.enabled << ", render scale " << getRenderScale() << std::endl;
+        break;
+    }
+}
+
+void processInput()
+{
+    std::vector<int> keys;
+    bool resize;
+    int w;
+    int h;
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        keys.swap(pendingKeys);
+        resize = resizePending;
+        resizePending = false;
+        w = pendingWidth;
+        h = pendingHeight;
+    }
+
+    for (int key : keys)
+    {
+        handleKey(key);
+    }
+    if (resize)
+        resizeWindow(w, h);
+}
+
+// Safe to call from the render thread, the main thread is blocked waiting
+// for events and has to be woken up to notice.
+void requestClose()
+{
+    glfwSetWindowShouldClose(window, GLFW_TRUE);
+    glfwPostEmptyEvent();
+}
+
+void initWindow()
+{
+    glfwInit();
+
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+
+    window = glfwCreateWindow(width, height, windowTitle, nullptr, nullptr);
+    glfwSetWindowSizeCallback(window, windowResizeCallback);
+    glfwSetKeyCallback(window, keyCallback);
+}
+
+void createShaderModule(const std::vector<char> &code, VkShaderModule *shaderModule)
+{
+    VkShaderModuleCreateInfo shaderCreateInfo;
+    shaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderCreateInfo.pNext = nullptr;
+    shaderCreateInfo.flags = 0;
+    shaderCreateInfo.codeSize = code.size();
+    shaderCreateInfo.pCode = (uint32_t *)code.data();
+
+    VkResult result = vkCreateShaderModule(device, &shaderCreateInfo, nullptr, shaderModule);
+    ASSERT_VULKAN(result);
+}
+
+bool isInstanceExtensionSupported(const char *extensionName)
+{
+    uint32_t extensionCount = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+
+    for (const VkExtensionProperties &extension : extensions)
+    {
+        if (strcmp(extension.extensionName, extensionName) == 0)
+            return true;
+    }
+    return false;
+}
+
+void createInstance()
+{
+    auto enumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+    if (enumerateInstanceVersion != nullptr)
+        enumerateInstanceVersion(&instanceApiVersion);
+    instanceApiVersion = std::min(instanceApiVersion, (uint32_t)VK_API_VERSION_1_2);
+
+    VkApplicationInfo appInfo;
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pNext = nullptr;
+    appInfo.pApplicationName = "Vulkan";
+    appInfo.applicationVersion = VK_MAKE_VERSION(0, 0, 0);
+    appInfo.pEngineName = "Vulkan Engine";
+    appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.apiVersion = instanceApiVersion;
+
+    const std::vector<const char *> validationLayers = {
+        "VK_LAYER_LUNARG_standard_validation"};
+
+    uint32_t glfwExtensionCount = 0;
+    auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    std::vector<const char *> instanceExtensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+
+    if (instanceApiVersion < VK_API_VERSION_1_1 && isInstanceExtensionSupported(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+        instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
+    VkInstanceCreateInfo instanceInfo;
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.pNext = nullptr;
+    instanceInfo.flags = 0;
+    instanceInfo.pApplicationInfo = &appInfo;
+    instanceInfo.enabledLayerCount = validationLayers.size();
+    instanceInfo.ppEnabledLayerNames = validationLayers.data();
+    instanceInfo.enabledExtensionCount = instanceExtensions.size();
+    instanceInfo.ppEnabledExtensionNames = instanceExtensions.data();
+
+    VkResult result = vkCreateInstance(&instanceInfo, nullptr, &instance);
+    ASSERT_VULKAN(result);
+
+    if (instanceApiVersion >= VK_API_VERSION_1_1)
+    {
+        getPhysicalDeviceFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2");
+        getPhysicalDeviceMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2");
+    }
+    else
+    {
+        getPhysicalDeviceFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+        getPhysicalDeviceMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+    }
+}
+
+void printInstanceLayers()
+{
+    uint32_t layerCount = 0;
+    vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+    VkLayerProperties *layers = new VkLayerProperties[layerCount];
+    vkEnumerateInstanceLayerProperties(&layerCount, layers);
+
+    std::cout << std::endl;
+
+    std::cout << "Amount of Instance layers: " << layerCount << std::endl;
+
+    for (int i = 0; i < layerCount; i++)
+    {
+        std::cout << std::endl;
+        std::cout << "Name:         " << layers[i].layerName << std::endl;
+        std::cout << "Spec Version: " << layers[i].specVersion << std::endl;
+        std::cout << "Impl Version: " << layers[i].implementationVersion << std::endl;
+        std::cout << "Description:  " << layers[i].description << std::endl;
+    }
+
+    delete[] layers;
+}
+
+void printInstanceExtensions()
+{
+    uint32_t extensionCount = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+    VkExtensionProperties *extensions = new VkExtensionProperties[extensionCount];
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions);
+
+    std::cout << std::endl;
+    std::cout << "Amount of Extensions: " << extensionCount << std::endl;
+
+    for (int i = 0; i < extensionCount; i++)
+    {
+        std::cout << std::endl;
+        std::cout << "Name:         " << extensions[i].extensionName << std::endl;
+        std::cout << "Spec Version: " << extensions[i].specVersion << std::endl;
+    }
+
+    delete[] extensions;
+}
+
+void createGlfwWindowSurface()
+{
+    VkResult result = glfwCreateWindowSurface(instance, window, nullptr, &surface);
+    ASSERT_VULKAN(result);
+}
+
+std::vector<VkPhysicalDevice> getAllPhysicalDevices()
+{
+    uint32_t deviceCount = 0;
+    VkResult result = vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+    ASSERT_VULKAN(result);
+
+    std::vector<VkPhysicalDevice> physicalDevices;
+    physicalDevices.resize(deviceCount);
+
+    result = vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data());
+    ASSERT_VULKAN(result);
+
+    return physicalDevices;
+}
+
+void printPhysicalDeviceStats()
+{
+    for (int i = 0; i < physicalDevices.size(); i++)
+    {
+        printStats(physicalDevices[i]);
+    }
+}
+
+bool isDeviceExtensionSupported(const char *extensionName)
+{
+    for (const VkExtensionProperties &extension : deviceExtensionProperties)
+    {
+        if (strcmp(extension.extensionName, extensionName) == 0)
+            return true;
+    }
+    return false;
+}
+
+PFN_vkVoidFunction getDeviceFunction(const char *coreName, const char *extensionName, uint32_t coreVersion)
+{
+    if (deviceCapabilities.apiVersion >= coreVersion)
+        return vkGetDeviceProcAddr(device, coreName);
+    return vkGetDeviceProcAddr(device, extensionName);
+}
+
+void queryDeviceCapabilities()
+{
+    VkPhysicalDeviceProperties deviceProps;
+    vkGetPhysicalDeviceProperties(physicalDevices[0], &deviceProps);
+    deviceCapabilities.apiVersion = std::min(instanceApiVersion, deviceProps.apiVersion);
+
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevices[0], nullptr, &extensionCount, nullptr);
+    deviceExtensionProperties.resize(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevices[0], nullptr, &extensionCount, deviceExtensionProperties.data());
+
+    VkPhysicalDeviceFeatures deviceFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevices[0], &deviceFeatures);
+    deviceCapabilities.samplerAnisotropy = deviceFeatures.samplerAnisotropy == VK_TRUE;
+    deviceCapabilities.textureCompressionBC = deviceFeatures.textureCompressionBC == VK_TRUE;
+    deviceCapabilities.textureCompressionASTC = deviceFeatures.textureCompressionASTC_LDR == VK_TRUE;
+    deviceCapabilities.maxSamplerAnisotropy = deviceProps.limits.maxSamplerAnisotropy;
+    deviceCapabilities.framebufferSampleCounts = deviceProps.limits.framebufferColorSampleCounts & deviceProps.limits.framebufferDepthSampleCounts;
+    deviceCapabilities.multiDrawIndirect = deviceFeatures.multiDrawIndirect == VK_TRUE && deviceFeatures.drawIndirectFirstInstance == VK_TRUE;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevices[0], &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevices[0], &queueFamilyCount, queueFamilyProperties.data());
+    deviceCapabilities.timestamps = queueFamilyCount > 0 && queueFamilyProperties[0].timestampValidBits > 0;
+    deviceCapabilities.timestampPeriod = deviceProps.limits.timestampPeriod;
+
+    // A family with compute but without graphics runs alongside the graphics
+    // queue. Family 0 is always used for graphics.
+    int computeQueueFamily = -1;
+    for (uint32_t i = 1; i < queueFamilyCount; i++)
+    {
+        if ((queueFamilyProperties[i].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamilyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            computeQueueFamily = i;
+            break;
+        }
+    }
+
+    VkFormat depthFormats[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D16_UNORM};
+    for (VkFormat depthFormat : depthFormats)
+    {
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevices[0], depthFormat, &formatProperties);
+        if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+        {
+            deviceCapabilities.depthFormat = depthFormat;
+            break;
+        }
+    }
+
+    msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    for (uint32_t samples = requestedMsaaSamples; samples > 1; samples >>= 1)
+    {
+        if (deviceCapabilities.framebufferSampleCounts & samples)
+        {
+            msaaSamples = (VkSampleCountFlagBits)samples;
+            break;
+        }
+    }
+
+    std::cout << "Sampler Anisotropy:  " << deviceCapabilities.samplerAnisotropy << std::endl;
+    std::cout << "BC Compression:      " << deviceCapabilities.textureCompressionBC << std::endl;
+    std::cout << "ASTC Compression:    " << deviceCapabilities.textureCompressionASTC << std::endl;
+    std::cout << "MSAA Samples:        " << msaaSamples << std::endl;
+    std::cout << "Multi-Draw Indirect: " << deviceCapabilities.multiDrawIndirect << std::endl;
+
+    deviceCapabilities.dynamicArrayIndexing = deviceFeatures.shaderSampledImageArrayDynamicIndexing == VK_TRUE && deviceFeatures.shaderStorageBufferArrayDynamicIndexing == VK_TRUE;
+    deviceCapabilities.maxPerStageSampledImages = std::min({deviceProps.limits.maxPerStageDescriptorSamplers, deviceProps.limits.maxPerStageDescriptorSampledImages, deviceProps.limits.maxDescriptorSetSamplers, deviceProps.limits.maxDescriptorSetSampledImages});
+    deviceCapabilities.maxPerStageStorageBuffers = std::min(deviceProps.limits.maxPerStageDescriptorStorageBuffers, deviceProps.limits.maxDescriptorSetStorageBuffers);
+    if (!deviceCapabilities.dynamicArrayIndexing)
+    {
+        std::cerr << "Dynamic indexing of descriptor arrays not supported!" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (getPhysicalDeviceFeatures2 == nullptr)
+        return;
+
+    bool timelineSemaphoreAvailable = deviceCapabilities.apiVersion >= VK_API_VERSION_1_2 || isDeviceExtensionSupported(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    bool descriptorIndexingAvailable = deviceCapabilities.apiVersion >= VK_API_VERSION_1_2 || (isDeviceExtensionSupported(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) && (deviceCapabilities.apiVersion >= VK_API_VERSION_1_1 || isDeviceExtensionSupported(VK_KHR_MAINTENANCE3_EXTENSION_NAME)));
+
+    void *featureChain = nullptr;
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures;
+    timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineSemaphoreFeatures.pNext = nullptr;
+    timelineSemaphoreFeatures.timelineSemaphore = VK_FALSE;
+    if (timelineSemaphoreAvailable)
+    {
+        timelineSemaphoreFeatures.pNext = featureChain;
+        featureChain = &timelineSemaphoreFeatures;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = {};
+    descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    descriptorIndexingFeatures.pNext = nullptr;
+    if (descriptorIndexingAvailable)
+    {
+        descriptorIndexingFeatures.pNext = featureChain;
+        featureChain = &descriptorIndexingFeatures;
+    }
+
+    // Mesh shaders need SPIR-V 1.4, which is core in Vulkan 1.2.
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    meshShaderFeatures.pNext = nullptr;
+    if (deviceCapabilities.apiVersion >= VK_API_VERSION_1_2 && isDeviceExtensionSupported(VK_EXT_MESH_SHADER_EXTENSION_NAME))
+    {
+        meshShaderFeatures.pNext = featureChain;
+        featureChain = &meshShaderFeatures;
+    }
+
+    VkPhysicalDeviceFeatures2 features2;
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = featureChain;
+    getPhysicalDeviceFeatures2(physicalDevices[0], &features2);
+
+    deviceCapabilities.timelineSemaphore = timelineSemaphoreFeatures.timelineSemaphore == VK_TRUE;
+    deviceCapabilities.descriptorIndexing = descriptorIndexingFeatures.descriptorBindingPartiallyBound == VK_TRUE && descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending == VK_TRUE;
+    deviceCapabilities.meshShader = meshShaderFeatures.taskShader == VK_TRUE && meshShaderFeatures.meshShader == VK_TRUE;
+    deviceCapabilities.memoryBudget = getPhysicalDeviceMemoryProperties2 != nullptr && isDeviceExtensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+
+    // The compute queue is ordered against graphics through timeline values.
+    if (computeQueueFamily >= 0 && deviceCapabilities.timelineSemaphore)
+    {
+        deviceCapabilities.asyncCompute = true;
+        deviceCapabilities.computeQueueFamily = computeQueueFamily;
+        if (queueFamilyProperties[computeQueueFamily].timestampValidBits == 0)
+            deviceCapabilities.timestamps = false;
+    }
+
+    std::cout << "Timeline Semaphores: " << deviceCapabilities.timelineSemaphore << std::endl;
+    std::cout << "Descriptor Indexing: " << deviceCapabilities.descriptorIndexing << std::endl;
+    std::cout << "Async Compute:       " << deviceCapabilities.asyncCompute << std::endl;
+    std::cout << "GPU Timestamps:      " << deviceCapabilities.timestamps << std::endl;
+    std::cout << "Mesh Shaders:        " << deviceCapabilities.meshShader << std::endl;
+    std::cout << "Memory Budget:       " << deviceCapabilities.memoryBudget << std::endl;
+}
+
+void createLogicalDevice()
+{
+    float queuPrios[] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    VkDeviceQueueCreateInfo deviceQueueCreateInfos[2];
+    deviceQueueCreateInfos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    deviceQueueCreateInfos[0].pNext = nullptr;
+    deviceQueueCreateInfos[0].flags = 0;
+    deviceQueueCreateInfos[0].queueFamilyIndex = 0; //TODO: Choose correct family index
+    deviceQueueCreateInfos[0].queueCount = 1;
+    deviceQueueCreateInfos[0].pQueuePriorities = queuPrios;
+
+    deviceQueueCreateInfos[1] = deviceQueueCreateInfos[0];
+    deviceQueueCreateInfos[1].queueFamilyIndex = deviceCapabilities.computeQueueFamily;
+
+    VkPhysicalDeviceFeatures usedFeatures = {};
+    usedFeatures.samplerAnisotropy = deviceCapabilities.samplerAnisotropy ? VK_TRUE : VK_FALSE;
+    usedFeatures.textureCompressionBC = deviceCapabilities.textureCompressionBC ? VK_TRUE : VK_FALSE;
+    usedFeatures.textureCompressionASTC_LDR = deviceCapabilities.textureCompressionASTC ? VK_TRUE : VK_FALSE;
+    usedFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    usedFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+    usedFeatures.multiDrawIndirect = deviceCapabilities.multiDrawIndirect ? VK_TRUE : VK_FALSE;
+    usedFeatures.drawIndirectFirstInstance = deviceCapabilities.multiDrawIndirect ? VK_TRUE : VK_FALSE;
+
+    std::vector<const char *> deviceExtensions = {
+        VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures;
+    timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineSemaphoreFeatures.pNext = nullptr;
+    timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+
+    void *featureChain = nullptr;
+    if (deviceCapabilities.timelineSemaphore)
+    {
+        if (deviceCapabilities.apiVersion < VK_API_VERSION_1_2)
+            deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        timelineSemaphoreFeatures.pNext = featureChain;
+        featureChain = &timelineSemaphoreFeatures;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = {};
+    descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    descriptorIndexingFeatures.pNext = nullptr;
+    descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+    if (deviceCapabilities.descriptorIndexing)
+    {
+        if (deviceCapabilities.apiVersion < VK_API_VERSION_1_2)
+            deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        if (deviceCapabilities.apiVersion < VK_API_VERSION_1_1)
+            deviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+        descriptorIndexingFeatures.pNext = featureChain;
+        featureChain = &descriptorIndexingFeatures;
+    }
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    meshShaderFeatures.pNext = nullptr;
+    meshShaderFeatures.taskShader = VK_TRUE;
+    meshShaderFeatures.meshShader = VK_TRUE;
+
+    if (deviceCapabilities.meshShader)
+    {
+        deviceExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+        meshShaderFeatures.pNext = featureChain;
+        featureChain = &meshShaderFeatures;
+    }
+
+    if (deviceCapabilities.memoryBudget)
+        deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    VkDeviceCreateInfo deviceCreateInfo;
+    deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceCreateInfo.pNext = featureChain;
+    deviceCreateInfo.flags = 0;
+    deviceCreateInfo.queueCreateInfoCount = deviceCapabilities.asyncCompute ? 2 : 1;
+    deviceCreateInfo.pQueueCreateInfos = deviceQueueCreateInfos;
+    deviceCreateInfo.enabledLayerCount = 0;
+    deviceCreateInfo.ppEnabledLayerNames = nullptr;
+    deviceCreateInfo.enabledExtensionCount = deviceExtensions.size();
+    deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    deviceCreateInfo.pEnabledFeatures = &usedFeatures;
+
+    //TODO: Pick best device, not first device.
+    VkResult result = vkCreateDevice(physicalDevices[0], &deviceCreateInfo, nullptr, &device);
+    ASSERT_VULKAN(result);
+}
+
+void createQueue()
+{
+    vkGetDeviceQueue(device, 0, 0, &queue);
+    graphicsTimeline.init(queue);
+
+    if (deviceCapabilities.asyncCompute)
+    {
+        vkGetDeviceQueue(device, deviceCapabilities.computeQueueFamily, 0, &computeQueue);
+        computeTimeline.init(computeQueue);
+    }
+}
+
+void checkSurfaceSupport()
+{
+    VkBool32 surfaceSupport = false;
+    VkResult result = vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevices[0], 0, surface, &surfaceSupport);
+    ASSERT_VULKAN(result);
+
+    if (!surfaceSupport)
+    {
+        std::cerr << "Surface not supported!" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// FIFO is the only mode every driver has to support.
+VkPresentModeKHR getPresentMode()
+{
+    if (vsync)
+        return VK_PRESENT_MODE_FIFO_KHR;
+
+    uint32_t presentModeCount = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevices[0], surface, &presentModeCount, nullptr);
+    std::vector<VkPresentModeKHR> presentModes(presentModeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevices[0], surface, &presentModeCount, presentModes.data());
+    for (VkPresentModeKHR presentMode : {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR})
+    {
+        if (std::find(presentModes.begin(), presentModes.end(), presentMode) != presentModes.end())
+            return presentMode;
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+void createSwapchain()
+{
+    VkSwapchainCreateInfoKHR swapChainCreateInfo;
+    swapChainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    swapChainCreateInfo.pNext = nullptr;
+    swapChainCreateInfo.flags = 0;
+    swapChainCreateInfo.surface = surface;
+    swapChainCreateInfo.minImageCount = 3;                                   //TODO: civ
+    swapChainCreateInfo.imageFormat = format;                                //TODO: civ
+    swapChainCreateInfo.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR; //TODO: civ
+    swapChainCreateInfo.imageExtent = VkExtent2D{width, height};
+    swapChainCreateInfo.imageArrayLayers = 1;
+    swapChainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (frameCaptureSettings.enabled)
+        swapChainCreateInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    swapChainCreateInfo.queueFamilyIndexCount = 0;
+    swapChainCreateInfo.pQueueFamilyIndices = nullptr;
+    swapChainCreateInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    swapChainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    swapChainCreateInfo.presentMode = getPresentMode();
+    swapChainCreateInfo.clipped = VK_TRUE;
+    swapChainCreateInfo.oldSwapchain = swapchain;
+
+    VkResult result = vkCreateSwapchainKHR(device, &swapChainCreateInfo, nullptr, &swapchain);
+    ASSERT_VULKAN(result);
+}
+
+void createImageViews()
+{
+    vkGetSwapchainImagesKHR(device, swapchain, &swapchainImageCount, nullptr);
+    swapchainImages = new VkImage[swapchainImageCount];
+    VkResult result = vkGetSwapchainImagesKHR(device, swapchain, &swapchainImageCount, swapchainImages);
+    ASSERT_VULKAN(result);
+
+    imageViews = new VkImageView[swapchainImageCount];
+
+    for (int i = 0; i < swapchainImageCount; i++)
+    {
+        createImageView(swapchainImages[i], format, VK_IMAGE_ASPECT_COLOR_BIT, 1, imageViews[i]);
+    }
+}
+
+
+void createDescriptorSetLayout()
+{
+    VkDescriptorSetLayoutBinding descriptorSetLayoutBinding;
+    descriptorSetLayoutBinding.binding = 0;
+    descriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorSetLayoutBinding.descriptorCount = 1;
+    descriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    descriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutCreateInfo.pNext = nullptr;
+    descriptorSetLayoutCreateInfo.flags = 0;
+    descriptorSetLayoutCreateInfo.bindingCount = 1;
+    descriptorSetLayoutCreateInfo.pBindings = &descriptorSetLayoutBinding;
+
+    descriptorSetLayout = descriptorLayoutCache.createLayout(descriptorSetLayoutCreateInfo);
+}
+
+void createPipelineLayout()
+{
+    VkDescriptorSetLayout setLayouts[] = {descriptorSetLayout, bindlessSetLayout, getLightingSetLayout()};
+
+    VkPushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DrawConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.pNext = nullptr;
+    pipelineLayoutCreateInfo.flags = 0;
+    pipelineLayoutCreateInfo.setLayoutCount = 3;
+    pipelineLayoutCreateInfo.pSetLayouts = setLayouts;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+    ASSERT_VULKAN(result);
+}
+
+void createShaderModules()
+{
+    createShaderModule(getShaderCode("shader.vert"), &shaderModuleVert);
+    createShaderModule(getShaderCode("shader.frag"), &shaderModuleFrag);
+}
+
+VkPipeline createScenePipeline(uint32_t features)
+{
+    SpecializationConstants specializationConstants;
+    specializationConstants.set(SHADER_CONSTANT_TEXTURE_CAPACITY, bindlessTextureCapacity);
+    specializationConstants.set(SHADER_CONSTANT_BUFFER_CAPACITY, bindlessBufferCapacity);
+    specializationConstants.set(SHADER_CONSTANT_VERTEX_COLOR, (features & SHADER_FEATURE_VERTEX_COLOR_BIT) != 0);
+    specializationConstants.set(SHADER_CONSTANT_TEXTURED, (features & SHADER_FEATURE_TEXTURED_BIT) != 0);
+    specializationConstants.set(SHADER_CONSTANT_INSTANCED, (features & SHADER_FEATURE_INSTANCED_BIT) != 0);
+    specializationConstants.set(SHADER_CONSTANT_QUANTIZED_POSITIONS, (features & SHADER_FEATURE_QUANTIZED_POSITIONS_BIT) != 0);
+    specializationConstants.set(SHADER_CONSTANT_POSITION_SCALE, positionScale);
+    specializationConstants.set(SHADER_CONSTANT_LIT, (features & SHADER_FEATURE_LIT_BIT) != 0);
+
+    VkPipelineShaderStageCreateInfo shaderStageCreateInfoVert;
+    shaderStageCreateInfoVert.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageCreateInfoVert.pNext = nullptr;
+    shaderStageCreateInfoVert.flags = 0;
+    shaderStageCreateInfoVert.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStageCreateInfoVert.module = shaderModuleVert;
+    shaderStageCreateInfoVert.pName = "main";
+    shaderStageCreateInfoVert.pSpecializationInfo = specializationConstants.getInfo();
+
+    VkPipelineShaderStageCreateInfo shaderStageCreateInfoFrag;
+    shaderStageCreateInfoFrag.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageCreateInfoFrag.pNext = nullptr;
+    shaderStageCreateInfoFrag.flags = 0;
+    shaderStageCreateInfoFrag.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStageCreateInfoFrag.module = shaderModuleFrag;
+    shaderStageCreateInfoFrag.pName = "main";
+    shaderStageCreateInfoFrag.pSpecializationInfo = specializationConstants.getInfo();
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {shaderStageCreateInfoVert, shaderStageCreateInfoFrag};
+
+    bool quantized = (features & SHADER_FEATURE_QUANTIZED_POSITIONS_BIT) != 0;
+
+    constexpr auto attributeDescriptions = joinAttributeDescriptions(Vertex::getLayout().getAttributeDescriptions(0, 0),
+                                                                     InstanceData::getLayout().getAttributeDescriptions(1, INSTANCE_ATTRIBUTE_LOCATION));
+    constexpr auto quantizedAttributeDescriptions = joinAttributeDescriptions(QuantizedVertex::getLayout().getAttributeDescriptions(0, 0),
+                                                                              InstanceData::getLayout().getAttributeDescriptions(1, INSTANCE_ATTRIBUTE_LOCATION));
+    const auto &vertexAttributeDescriptions = quantized ? quantizedAttributeDescriptions : attributeDescriptions;
+
+    VkVertexInputBindingDescription vertexBindingDescriptions[] = {
+        quantized ? QuantizedVertex::getLayout().getBindingDescription(0) : Vertex::getLayout().getBindingDescription(0),
+        InstanceData::getLayout().getBindingDescription(1)};
+
+    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo;
+    vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputStateCreateInfo.pNext = nullptr;
+    vertexInputStateCreateInfo.flags = 0;
+    vertexInputStateCreateInfo.vertexBindingDescriptionCount = 2;
+    vertexInputStateCreateInfo.pVertexBindingDescriptions = vertexBindingDescriptions;
+    vertexInputStateCreateInfo.vertexAttributeDescriptionCount = vertexAttributeDescriptions.size();
+    vertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexAttributeDescriptions.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo;
+    inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyCreateInfo.pNext = nullptr;
+    inputAssemblyCreateInfo.flags = 0;
+    inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+    VkViewport viewport;
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = width;
+    viewport.height = height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor;
+    scissor.offset = {0, 0};
+    scissor.extent = {width, height};
+
+    VkPipelineViewportStateCreateInfo viewportStateCreateInfo;
+    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportStateCreateInfo.pNext = nullptr;
+    viewportStateCreateInfo.flags = 0;
+    viewportStateCreateInfo.viewportCount = 1;
+    viewportStateCreateInfo.pViewports = &viewport;
+    viewportStateCreateInfo.scissorCount = 1;
+    viewportStateCreateInfo.pScissors = &scissor;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationCreateInfo;
+    rasterizationCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationCreateInfo.pNext = nullptr;
+    rasterizationCreateInfo.flags = 0;
+    rasterizationCreateInfo.depthClampEnable = VK_FALSE;
+    rasterizationCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+    rasterizationCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizationCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizationCreateInfo.depthBiasEnable = VK_FALSE;
+    rasterizationCreateInfo.depthBiasConstantFactor = 0.0f;
+    rasterizationCreateInfo.depthBiasClamp = 0.0f;
+    rasterizationCreateInfo.depthBiasSlopeFactor = 0.0f;
+    rasterizationCreateInfo.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampleCreateInfo;
+    multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleCreateInfo.pNext = nullptr;
+    multisampleCreateInfo.flags = 0;
+    multisampleCreateInfo.rasterizationSamples = msaaSamples;
+    multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
+    multisampleCreateInfo.minSampleShading = 1.0f;
+    multisampleCreateInfo.pSampleMask = nullptr;
+    multisampleCreateInfo.alphaToCoverageEnable = VK_FALSE;
+    multisampleCreateInfo.alphaToOneEnable = VK_FALSE;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo;
+    depthStencilStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilStateCreateInfo.pNext = nullptr;
+    depthStencilStateCreateInfo.flags = 0;
+    depthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
+    depthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
+    depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    depthStencilStateCreateInfo.depthBoundsTestEnable = VK_FALSE;
+    depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
+    depthStencilStateCreateInfo.front = {};
+    depthStencilStateCreateInfo.back = {};
+    depthStencilStateCreateInfo.minDepthBounds = 0.0f;
+    depthStencilStateCreateInfo.maxDepthBounds = 1.0f;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachmentState;
+    colorBlendAttachmentState.blendEnable = VK_TRUE;
+    colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo;
+    colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendStateCreateInfo.pNext = nullptr;
+    colorBlendStateCreateInfo.flags = 0;
+    colorBlendStateCreateInfo.logicOpEnable = VK_FALSE;
+    colorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_NO_OP;
+    colorBlendStateCreateInfo.attachmentCount = 1;
+    colorBlendStateCreateInfo.pAttachments = &colorBlendAttachmentState;
+    colorBlendStateCreateInfo.blendConstants[0] = 0.0f;
+    colorBlendStateCreateInfo.blendConstants[1] = 0.0f;
+    colorBlendStateCreateInfo.blendConstants[2] = 0.0f;
+    colorBlendStateCreateInfo.blendConstants[3] = 0.0f;
+
+    VkDynamicState dynamicStates[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR};
+
+    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo;
+    dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateCreateInfo.pNext = nullptr;
+    dynamicStateCreateInfo.flags = 0;
+    dynamicStateCreateInfo.dynamicStateCount = 2;
+    dynamicStateCreateInfo.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.pNext = nullptr;
+    pipelineCreateInfo.flags = 0;
+    pipelineCreateInfo.stageCount = 2;
+    pipelineCreateInfo.pStages = shaderStages;
+    pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+    pipelineCreateInfo.pTessellationState = nullptr;
+    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+    pipelineCreateInfo.pRasterizationState = &rasterizationCreateInfo;
+    pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
+    pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
+    pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
+    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+    pipelineCreateInfo.layout = pipelineLayout;
+    pipelineCreateInfo.renderPass = renderGraph.getRenderPass("scene");
+    pipelineCreateInfo.subpass = 0;
+    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineCreateInfo.basePipelineIndex = 0;
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+    ASSERT_VULKAN(result);
+
+    return pipeline;
+}
+
+
+void createCommandPool()
+{
+    VkCommandPoolCreateInfo commandPoolCreateInfo;
+    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolCreateInfo.pNext = nullptr;
+    commandPoolCreateInfo.flags = 0;
+    commandPoolCreateInfo.queueFamilyIndex = 0;
+
+    VkResult result = vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool);
+    ASSERT_VULKAN(result);
+}
+
+uint32_t getMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+    VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevices[0], &physicalDeviceMemoryProperties);
+    for (int i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; i++)
+    {
+        if ((typeFilter & (1 << i)) && (physicalDeviceMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("Found no correct memory type!");
+}
+
+void createBuffer(VkDeviceSize deviceSize, VkBufferUsageFlags bufferUsageFlags, VkBuffer &buffer, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceMemory &deviceMemory,
+                  bool concurrent)
+{
+    uint32_t queueFamilyIndices[] = {0, deviceCapabilities.computeQueueFamily};
+
+    VkBufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.pNext = nullptr;
+    bufferCreateInfo.flags = 0;
+    bufferCreateInfo.size = deviceSize;
+    bufferCreateInfo.usage = bufferUsageFlags;
+    if (concurrent && deviceCapabilities.asyncCompute)
+    {
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferCreateInfo.queueFamilyIndexCount = 2;
+        bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
+    }
+    else
+    {
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        bufferCreateInfo.queueFamilyIndexCount = 0;
+        bufferCreateInfo.pQueueFamilyIndices = nullptr;
+    }
+
+    VkResult result = vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer);
+    ASSERT_VULKAN(result);
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+
+    allocateDeviceMemory(memoryRequirements.size, getMemoryTypeIndex(memoryRequirements.memoryTypeBits, memoryPropertyFlags), deviceMemory);
+
+    vkBindBufferMemory(device, buffer, deviceMemory, 0);
+}
+
+void createStagingBuffer(const void *data, VkDeviceSize size, VkBuffer &buffer, VkDeviceMemory &deviceMemory)
+{
+    COUNT_FRAME_STAT(UploadBytes, size);
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, deviceMemory);
+
+    if (data != nullptr)
+    {
+        void *memory;
+        COUNT_FRAME_STAT(MemoryMaps, 1);
+        vkMapMemory(device, deviceMemory, 0, size, 0, &memory);
+        memcpy(memory, data, size);
+        vkUnmapMemory(device, deviceMemory);
+    }
+}
+
+void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags memoryPropertyFlags, VkImage &image, VkDeviceMemory &deviceMemory)
+{
+    VkImageCreateInfo imageCreateInfo;
+    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageCreateInfo.pNext = nullptr;
+    imageCreateInfo.flags = 0;
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = format;
+    imageCreateInfo.extent = {width, height, 1};
+    imageCreateInfo.mipLevels = mipLevels;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.usage = usage;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageCreateInfo.queueFamilyIndexCount = 0;
+    imageCreateInfo.pQueueFamilyIndices = nullptr;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, &image);
+    ASSERT_VULKAN(result);
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+
+    allocateDeviceMemory(memoryRequirements.size, getMemoryTypeIndex(memoryRequirements.memoryTypeBits, memoryPropertyFlags), deviceMemory);
+
+    vkBindImageMemory(device, image, deviceMemory, 0);
+}
+
+void createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectMask, uint32_t mipLevels, VkImageView &imageView)
+{
+    VkImageViewCreateInfo imageViewCreateInfo;
+    imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imageViewCreateInfo.pNext = nullptr;
+    imageViewCreateInfo.flags = 0;
+    imageViewCreateInfo.image = image;
+    imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imageViewCreateInfo.format = format;
+    imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewCreateInfo.subresourceRange.aspectMask = aspectMask;
+    imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+    imageViewCreateInfo.subresourceRange.levelCount = mipLevels;
+    imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+    imageViewCreateInfo.subresourceRange.layerCount = 1;
+
+    VkResult result = vkCreateImageView(device, &imageViewCreateInfo, nullptr, &imageView);
+    ASSERT_VULKAN(result);
+}
+
+void cmdImageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectMask, uint32_t baseMipLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout,
+                     VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+{
+    VkImageMemoryBarrier imageMemoryBarrier;
+    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageMemoryBarrier.pNext = nullptr;
+    imageMemoryBarrier.srcAccessMask = srcAccessMask;
+    imageMemoryBarrier.dstAccessMask = dstAccessMask;
+    imageMemoryBarrier.oldLayout = oldLayout;
+    imageMemoryBarrier.newLayout = newLayout;
+    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.image = image;
+    imageMemoryBarrier.subresourceRange.aspectMask = aspectMask;
+    imageMemoryBarrier.subresourceRange.baseMipLevel = baseMipLevel;
+    imageMemoryBarrier.subresourceRange.levelCount = levelCount;
+    imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+    imageMemoryBarrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+}
+
+// One-time command buffers are batched into the next submit and freed once it completes.
+VkCommandBuffer beginOneTimeCommands()
+{
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.pNext = nullptr;
+    commandBufferAllocateInfo.commandPool = commandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    VkResult result = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer);
+    ASSERT_VULKAN(result);
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.pNext = nullptr;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = nullptr;
+
+    result = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+    ASSERT_VULKAN(result);
+
+    return commandBuffer;
+}
+
+void endOneTimeCommands(VkCommandBuffer commandBuffer)
+{
+    VkResult result = vkEndCommandBuffer(commandBuffer);
+    ASSERT_VULKAN(result);
+
+    graphicsTimeline.addCommandBuffer(commandBuffer);
+    graphicsTimeline.freeOnCompletion(commandPool, commandBuffer);
+}
+
+void copyBuffer(VkBuffer src, VkBuffer dest, VkDeviceSize size)
+{
+    VkCommandBuffer commandBuffer = beginOneTimeCommands();
+
+    VkBufferCopy bufferCopy;
+    bufferCopy.srcOffset = 0;
+    bufferCopy.dstOffset = 0;
+    bufferCopy.size = size;
+    vkCmdCopyBuffer(commandBuffer, src, dest, 1, &bufferCopy);
+
+    VkMemoryBarrier memoryBarrier;
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = nullptr;
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    endOneTimeCommands(commandBuffer);
+}
+
+void createAndUploadBuffer(const void *data, VkDeviceSize bufferSize, VkBufferUsageFlags usage, VkBuffer &buffer, VkDeviceMemory &deviceMemory)
+{
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createStagingBuffer(data, bufferSize, stagingBuffer, stagingBufferMemory);
+
+    createBuffer(bufferSize, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, deviceMemory);
+
+    copyBuffer(stagingBuffer, buffer, bufferSize);
+
+    deletionQueue.destroyBuffer(stagingBuffer);
+    deletionQueue.freeMemory(stagingBufferMemory);
+}
+
+void createDeviceBuffer(const void *data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, VkDeviceMemory &deviceMemory)
+{
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createStagingBuffer(data, size, stagingBuffer, stagingBufferMemory);
+
+    createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, deviceMemory, true);
+
+    VkCommandBuffer commandBuffer = beginOneTimeCommands();
+    VkBufferCopy bufferCopy;
+    bufferCopy.srcOffset = 0;
+    bufferCopy.dstOffset = 0;
+    bufferCopy.size = size;
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer, 1, &bufferCopy);
+
+    // Waiting for the submit on the host doesn't make the copy visible to
+    // later reads on the device.
+    VkMemoryBarrier memoryBarrier;
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = nullptr;
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    endOneTimeCommands(commandBuffer);
+
+    deletionQueue.destroyBuffer(stagingBuffer);
+    deletionQueue.freeMemory(stagingBufferMemory);
+}
+
+void createGeometryPools()
+{
+    sceneGeometry.init(sizeof(Vertex), 1 << 16, 1 << 18);
+    quantizedSceneGeometry.init(sizeof(QuantizedVertex), 1 << 16, 1 << 18);
+
+    addMemoryEvictor([](VkDeviceSize bytes, EvictionReason reason) {
+        if (reason == EvictionReason::OutOfMemory)
+        {
+            VkDeviceSize released = quantizedSceneGeometry.release();
+            if (released < bytes)
+                released += sceneGeometry.release();
+            return released;
+        }
+
+        VkDeviceSize released = quantizedSceneGeometry.evict(bytes);
+        if (released < bytes)
+            released += sceneGeometry.evict(bytes - released);
+        return released;
+    });
+}
+
+void uploadQuad()
+{
+    quadMesh = sceneGeometry.addMesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+}
+
+void uploadQuantizedQuad()
+{
+    positionScale = 0.0f;
+    for (const Vertex &vertex : vertices)
+    {
+        positionScale = std::max(positionScale, std::max(std::abs(vertex.pos.x), std::abs(vertex.pos.y)));
+    }
+    if (positionScale == 0.0f)
+        positionScale = 1.0f;
+
+    quantizedVertices.clear();
+    for (const Vertex &vertex : vertices)
+    {
+        QuantizedVertex quantizedVertex;
+        quantizedVertex.pos[0] = (int16_t)std::round(vertex.pos.x / positionScale * 32767.0f);
+        quantizedVertex.pos[1] = (int16_t)std::round(vertex.pos.y / positionScale * 32767.0f);
+        quantizedVertex.color = vertex.color;
+        quantizedVertex.texCoord = vertex.texCoord;
+        quantizedVertices.push_back(quantizedVertex);
+    }
+
+    quantizedQuadMesh = quantizedSceneGeometry.addMesh(quantizedVertices.data(), quantizedVertices.size(), indices.data(), indices.size());
+}
+
+void createInstanceBuffer()
+{
+    createAndUploadBuffer(instances, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, instanceBuffer, instanceBufferDeviceMemory);
+}
+
+void createUniformBuffers()
+{
+    VkDeviceSize bufferSize = sizeof(SceneUniforms);
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, uniformBuffers[i], VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBufferDeviceMemories[i]);
+    }
+}
+
+void createTextures()
+{
+    texture = loadTexture("res/textures/texture");
+    if (texture != nullptr)
+        return;
+
+    const uint32_t size = 256;
+    std::vector<uint8_t> pixels(size * size * 4);
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            uint8_t value = ((x / 32 + y / 32) % 2 == 0) ? 255 : 64;
+            uint8_t *pixel = &pixels[(y * size + x) * 4];
+            pixel[0] = value;
+            pixel[1] = value;
+            pixel[2] = value;
+            pixel[3] = 255;
+        }
+    }
+    texture = createTexture(size, size, pixels.data());
+}
+
+void createMaterialBuffer()
+{
+    createAndUploadBuffer(materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, materialBuffer, materialBufferDeviceMemory);
+    materialBufferIndex = allocateBindlessBuffer(materialBuffer, 0, sizeof(Material) * materials.size());
+}
+
+void initDescriptorAllocators()
+{
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        frameDescriptorAllocators[i].init();
+    }
+}
+
+VkDescriptorSet createFrameDescriptorSet()
+{
+    VkDescriptorSet descriptorSet = frameDescriptorAllocators[currentFrame].allocate(descriptorSetLayout);
+
+    VkDescriptorBufferInfo descriptorBufferInfo;
+    descriptorBufferInfo.buffer = uniformBuffers[currentFrame];
+    descriptorBufferInfo.offset = 0;
+    descriptorBufferInfo.range = sizeof(SceneUniforms);
+
+    VkWriteDescriptorSet descriptorWrite;
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.pNext = nullptr;
+    descriptorWrite.dstSet = descriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorWrite.pImageInfo = nullptr;
+    descriptorWrite.pBufferInfo = &descriptorBufferInfo;
+    descriptorWrite.pTexelBufferView = nullptr;
+
+    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+
+    return descriptorSet;
+}
+
+void recordScenePass(VkCommandBuffer commandBuffer)
+{
+    COUNT_FRAME_STAT(PipelineBinds, 1);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scenePipelines.get(sceneFeatures));
+
+    VkViewport viewport;
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = renderWidth;
+    viewport.height = renderHeight;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor;
+    scissor.offset = {0, 0};
+    scissor.extent = {renderWidth, renderHeight};
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    bool quantized = (sceneFeatures & SHADER_FEATURE_QUANTIZED_POSITIONS_BIT) != 0;
+    GeometryPool &geometry = quantized ? quantizedSceneGeometry : sceneGeometry;
+    geometry.bind(commandBuffer);
+    VkDeviceSize offset = 0;
+    COUNT_FRAME_STAT(BufferBinds, 1);
+    vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer, &offset);
+
+    VkDescriptorSet frameDescriptorSets[] = {frameDescriptorSet, bindlessDescriptorSet, getLightingDescriptorSet()};
+    COUNT_FRAME_STAT(DescriptorSetBinds, 1);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 3, frameDescriptorSets, 0, nullptr);
+
+    DrawConstants drawConstants;
+    markTextureUsed(texture);
+    drawConstants.textureIndex = texture->bindlessIndex;
+    drawConstants.materialBufferIndex = materialBufferIndex;
+    drawConstants.materialIndex = 0;
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DrawConstants), &drawConstants);
+
+    //vkCmdDraw(commandBuffer, vertices.size(), 1, 0, 0);
+    uint32_t instanceCount = (sceneFeatures & SHADER_FEATURE_INSTANCED_BIT) ? instances.size() : 1;
+    if (isStressSceneEnabled())
+    {
+        const std::vector<GeometryHandle> &meshes = getStressSceneMeshes();
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            drawConstants.materialIndex = i % materials.size();
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DrawConstants), &drawConstants);
+            geometry.draw(commandBuffer, meshes[i], instanceCount);
+        }
+        return;
+    }
+    if (isSceneOpen())
+    {
+        for (GeometryHandle mesh : getSceneMeshes())
+        {
+            geometry.draw(commandBuffer, mesh, instanceCount);
+        }
+        return;
+    }
+    geometry.draw(commandBuffer, quantized ? quantizedQuadMesh : quadMesh, instanceCount);
+}
+
+void buildRenderGraph()
+{
+    VkExtent2D renderExtent = getRenderExtent(width, height);
+    renderWidth = renderExtent.width;
+    renderHeight = renderExtent.height;
+
+    RenderGraphImageInfo backbufferInfo;
+    backbufferInfo.format = format;
+    backbufferInfo.width = width;
+    backbufferInfo.height = height;
+    // The acquire semaphore is waited on at the color attachment output stage.
+    backbuffer = renderGraph.importImage("backbuffer", backbufferInfo, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+    RenderGraphImageInfo hdrInfo = backbufferInfo;
+    hdrInfo.format = POST_PROCESS_HDR_FORMAT;
+    hdrInfo.width = renderWidth;
+    hdrInfo.height = renderHeight;
+    RenderGraphResource hdr = renderGraph.createImage("sceneHdr", hdrInfo);
+
+    RenderGraphImageInfo depthInfo;
+    depthInfo.format = deviceCapabilities.depthFormat;
+    depthInfo.width = renderWidth;
+    depthInfo.height = renderHeight;
+    depthInfo.samples = msaaSamples;
+    RenderGraphResource depth = renderGraph.createImage("depth", depthInfo);
+
+    VkClearValue clearValue = {0.0f, 0.15f, 0.3f, 1.0f};
+    VkClearValue depthClearValue;
+    depthClearValue.depthStencil = {1.0f, 0};
+
+    RenderGraphImageInfo colorInfo = hdrInfo;
+    RenderGraphResource color = hdr;
+    if (msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+    {
+        colorInfo.samples = msaaSamples;
+        color = renderGraph.createImage("sceneColor", colorInfo);
+    }
+
+    bool lit = (sceneFeatures & SHADER_FEATURE_LIT_BIT) != 0;
+    if (lit)
+        lightClusters = addLightBinningPass(renderGraph);
+
+    RenderGraphPass &scenePass = renderGraph.addPass("scene", RenderGraphQueue::Graphics);
+    scenePass.write(depth, RenderGraphAccess::DepthAttachment).clear(depth, depthClearValue).execute(recordScenePass);
+    scenePass.write(color, RenderGraphAccess::ColorAttachment).clear(color, clearValue);
+    if (lit)
+        scenePass.read(lightClusters, RenderGraphAccess::StorageReadGraphics);
+
+    DepthPyramid depthPyramid;
+    RenderGraphPass *lastColorPass = &scenePass;
+    if (occlusionCullingSettings.enabled)
+        lastColorPass = &addOcclusionCullingPasses(renderGraph, color, depth, depthInfo, &depthPyramid);
+    if (meshletSettings.enabled)
+        lastColorPass = &addMeshletPasses(renderGraph, color, depth, depthInfo, occlusionCullingSettings.enabled ? &depthPyramid : nullptr);
+    if (particleSettings.enabled)
+        lastColorPass = &addParticlePasses(renderGraph, color, depth, colorInfo);
+
+    // The multisampled color target is resolved straight into the HDR target
+    // at the end of the last pass drawing into it.
+    if (color != hdr)
+        lastColorPass->resolve(color, hdr);
+
+    addPostProcessPasses(renderGraph, hdr, backbuffer, renderWidth, renderHeight, width, height);
+    addFrameCapturePass(renderGraph, backbuffer, format, width, height);
+    // After the capture, so captures don't depend on the overlay.
+    addFrameStatsOverlayPass(renderGraph, backbuffer, width, height);
+
+    renderGraph.compile();
+
+    std::cout << "Render graph: " << renderWidth << "x" << renderHeight << " (scale " << getRenderScale() << "), " << renderGraph.getBarrierCount() << " barriers, " << renderGraph.getTransientMemorySize() / 1024
+              << " KiB transient memory (" << renderGraph.getUnaliasedTransientMemorySize() / 1024 << " KiB without aliasing), "
+              << renderGraph.getLazilyAllocatedMemorySize() / 1024 << " KiB lazily allocated" << std::endl;
+}
+
+void createSemaphores()
+{
+    VkSemaphoreCreateInfo semaphoreCreateInfo;
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreCreateInfo.pNext = nullptr;
+    semaphoreCreateInfo.flags = 0;
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        VkResult result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphoresImageAvailable[i]);
+        ASSERT_VULKAN(result);
+        result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphoresRenderingDone[i]);
+        ASSERT_VULKAN(result);
+    }
+}
+
+void initVulkan()
+{
+
+    createInstance();
+    physicalDevices = getAllPhysicalDevices();
+    printInstanceLayers();
+    printInstanceExtensions();
+    createGlfwWindowSurface();
+    printPhysicalDeviceStats();
+    queryDeviceCapabilities();
+    createLogicalDevice();
+    initMemoryBudget();
+    createQueue();
+    checkSurfaceSupport();
+    createSwapchain();
+    createImageViews();
+    createDescriptorSetLayout();
+    createCommandPool();
+    initTextures();
+    initBindless(textureSampler);
+    initClusteredLighting();
+    initShaderManager("res/shaders", "shaderCache");
+    initPipelineCache("shaderCache/pipelines.bin");
+    createPipelineLayout();
+    createShaderModules();
+    initPostProcess();
+    initParticles();
+    initOcclusionCulling();
+    initMeshlets();
+    createGeometryPools();
+    // Scene files only hold quantized vertices. The meshes are uploaded by
+    // the render loop as the loader finishes them.
+    if (isStressSceneEnabled())
+    {
+        createStressScene(quantizedSceneGeometry);
+        positionScale = 1.0f;
+        sceneFeatures |= SHADER_FEATURE_QUANTIZED_POSITIONS_BIT | SHADER_FEATURE_INSTANCED_BIT;
+        instances.clear();
+        for (const glm::vec2 &offset : getStressSceneInstanceOffsets())
+        {
+            instances.push_back({offset});
+        }
+        materials.clear();
+        for (const glm::vec4 &color : getStressSceneMaterialColors())
+        {
+            materials.push_back({color});
+        }
+    }
+    else if (!sceneFileName.empty() && openScene(sceneFileName))
+    {
+        positionScale = getScenePositionScale();
+        sceneFeatures |= SHADER_FEATURE_QUANTIZED_POSITIONS_BIT;
+    }
+    else
+    {
+        uploadQuad();
+        uploadQuantizedQuad();
+    }
+    createInstanceBuffer();
+    createUniformBuffers();
+    createTextures();
+    createMaterialBuffer();
+    buildRenderGraph();
+    // Build the permutation used by the first frame up front.
+    scenePipelines.get(sceneFeatures);
+    initDescriptorAllocators();
+    createSemaphores();
+}
+
+void recreateSwapchain()
+{
+    renderGraph.destroy();
+    //vkDestroyPipeline(device, pipeline, nullptr);
+    for (int i = 0; i < swapchainImageCount; i++)
+    {
+        deletionQueue.destroyImageView(imageViews[i]);
+    }
+    delete[] imageViews;
+    delete[] swapchainImages;
+    //vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    //vkDestroyShaderModule(device, shaderModuleVert, nullptr);
+    //vkDestroyShaderModule(device, shaderModuleFrag, nullptr);
+
+    VkSwapchainKHR oldSwapchain = swapchain;
+
+    createSwapchain();
+    createImageViews();
+    //createPipeline();
+    buildRenderGraph();
+
+    deletionQueue.destroySwapchain(oldSwapchain);
+}
+
+// Swaps in a pipeline built from freshly compiled shaders. Frames still in
+// flight keep using the old one until the deletion queue releases it.
+void reloadShaders()
+{
+    std::vector<std::string> changedShaders = takeChangedShaders();
+    if (changedShaders.empty())
+        return;
+
+    for (const std::string &name : changedShaders)
+    {
+        std::cout << "Reloading shader " << name << std::endl;
+    }
+
+    bool sceneShadersChanged = false;
+    bool postProcessShadersChanged = false;
+    bool particleShadersChanged = false;
+    bool cullingShadersChanged = false;
+    bool meshletShadersChanged = false;
+    bool lightingShadersChanged = false;
+    for (const std::string &name : changedShaders)
+    {
+        if (name.compare(0, 4, "post") == 0)
+            postProcessShadersChanged = true;
+        else if (name.compare(0, 8, "particle") == 0)
+            particleShadersChanged = true;
+        else if (name.compare(0, 4, "cull") == 0 || name.compare(0, 3, "hiZ") == 0)
+            cullingShadersChanged = true;
+        else if (name.compare(0, 7, "meshlet") == 0)
+            meshletShadersChanged = true;
+        else if (name.compare(0, 5, "light") == 0)
+            lightingShadersChanged = true;
+        else
+            sceneShadersChanged = true;
+    }
+
+    if (postProcessShadersChanged)
+        recreatePostProcessPipelines();
+    if (particleShadersChanged)
+        recreateParticlePipelines();
+    if (cullingShadersChanged)
+        recreateOcclusionCullingPipelines();
+    if (meshletShadersChanged)
+        recreateMeshletPipelines();
+    if (lightingShadersChanged)
+        recreateClusteredLightingPipelines();
+
+    if (!sceneShadersChanged)
+        return;
+
+    scenePipelines.invalidate();
+    deletionQueue.destroyShaderModule(shaderModuleVert);
+    deletionQueue.destroyShaderModule(shaderModuleFrag);
+
+    createShaderModules();
+    scenePipelines.get(sceneFeatures);
+}
+
+// Post-processing and particle toggles add or remove passes, so the graph is
+// rebuilt between frames. The old one is released through the deletion queue.
+void rebuildRenderGraph()
+{
+    if (!renderGraphDirty)
+        return;
+    renderGraphDirty = false;
+
+    std::cout << "Post-processing: bloom " << postProcessSettings.bloom << ", tonemap " << postProcessSettings.tonemap << ", fxaa "
+              << postProcessSettings.fxaa << ", particles " << particleSettings.enabled << ", mesh shading " << isMeshShadingActive() << ", render size " << renderWidth
+              << "x" << renderHeight << std::endl;
+
+    renderGraph.destroy();
+    buildRenderGraph();
+}
+
+// The frame slot has just been waited on, so its queries are available.
+void printPassTimings()
+{
+    if (!printPassTimingsRequested)
+        return;
+    printPassTimingsRequested = false;
+
+    std::vector<RenderGraphPassTiming> timings = renderGraph.getPassTimings(currentFrame);
+    if (timings.empty())
+    {
+        std::cout << "No GPU timings available" << std::endl;
+        return;
+    }
+
+    double total = 0.0;
+    double computeTotal = 0.0;
+    for (const RenderGraphPassTiming &timing : timings)
+    {
+        bool async = timing.queue == RenderGraphQueue::Compute;
+        std::cout << "  " << timing.name << (async ? " (async)" : "") << ": " << timing.milliseconds << " ms at " << timing.startMilliseconds << " ms" << std::endl;
+        total += timing.milliseconds;
+        if (async)
+            computeTotal += timing.milliseconds;
+    }
+    std::cout << "  total: " << total << " ms" << std::endl;
+    if (deviceCapabilities.asyncCompute)
+        std::cout << "  async compute: " << computeTotal << " ms, " << getQueueOverlapMilliseconds(timings) << " ms overlapped with graphics" << std::endl;
+}
+
+// Averages the particle pass timings once the system has filled up, then
+// quits. The frame slot has just been waited on, like for printPassTimings.
+void updateParticleBenchmark(const FrameState &frameState)
+{
+    if (!particleBenchmark)
+        return;
+
+    static const uint32_t BENCHMARK_FRAMES = 500;
+    static uint32_t sampledFrames = 0;
+    static double simulationMilliseconds = 0.0;
+    static double renderMilliseconds = 0.0;
+
+    if (frameState.time < particleSettings.lifetime)
+        return;
+
+    std::vector<RenderGraphPassTiming> timings = renderGraph.getPassTimings(currentFrame);
+    if (timings.empty())
+    {
+        std::cout << "Particle benchmark needs GPU timestamps, which this device does not support" << std::endl;
+        requestClose();
+        return;
+    }
+
+    for (const RenderGraphPassTiming &timing : timings)
+    {
+        if (timing.name == "particles")
+            renderMilliseconds += timing.milliseconds;
+        else if (timing.name.compare(0, 8, "particle") == 0)
+            simulationMilliseconds += timing.milliseconds;
+    }
+
+    if (++sampledFrames < BENCHMARK_FRAMES)
+        return;
+
+    std::cout << "Particle benchmark, " << particleSettings.capacity << " particles over " << sampledFrames << " frames:" << std::endl;
+    std::cout << "  simulation: " << simulationMilliseconds / sampledFrames << " ms" << (deviceCapabilities.asyncCompute ? " (async)" : "") << std::endl;
+    std::cout << "  rendering: " << renderMilliseconds / sampledFrames << " ms" << std::endl;
+    requestClose();
+}
+
+// Renders each light count for a while and averages the GPU time of the
+// binning and scene passes, then quits. Like the particle benchmark, it reads
+// the timings of the frame slot that has just been waited on.
+void updateLightBenchmark()
+{
+    if (!lightBenchmark)
+        return;
+
+    static const uint32_t LIGHT_COUNTS[] = {0, 16, 64, 256, 1024};
+    static const uint32_t WARMUP_FRAMES = 30;
+    static const uint32_t BENCHMARK_FRAMES = 300;
+    static uint32_t step = 0;
+    static uint32_t frame = 0;
+    static double binningMilliseconds = 0.0;
+    static double sceneMilliseconds = 0.0;
+    static double gpuMilliseconds = 0.0;
+    static std::chrono::steady_clock::time_point startTime;
+    static const uint32_t STEP_COUNT = sizeof(LIGHT_COUNTS) / sizeof(LIGHT_COUNTS[0]);
+
+    if (step == STEP_COUNT)
+        return;
+
+    if (step == 0 && frame == 0)
+    {
+        if (!deviceCapabilities.timestamps)
+        {
+            std::cout << "Light benchmark needs GPU timestamps, which this device does not support" << std::endl;
+            requestClose();
+            return;
+        }
+        std::cout << "Light benchmark, " << LIGHT_CLUSTERS_X << "x" << LIGHT_CLUSTERS_Y << "x" << LIGHT_CLUSTERS_Z << " clusters, " << width << "x" << height
+                  << ":" << std::endl;
+    }
+
+    if (frame == 0)
+    {
+        lightingSettings.lightCount = LIGHT_COUNTS[step];
+        binningMilliseconds = 0.0;
+        sceneMilliseconds = 0.0;
+        gpuMilliseconds = 0.0;
+    }
+
+    // Frames still in flight were recorded with the previous light count.
+    if (frame++ < WARMUP_FRAMES)
+    {
+        startTime = std::chrono::steady_clock::now();
+        return;
+    }
+
+    for (const RenderGraphPassTiming &timing : renderGraph.getPassTimings(currentFrame))
+    {
+        if (timing.name == "lightBinning")
+            binningMilliseconds += timing.milliseconds;
+        else if (timing.name == "scene")
+            sceneMilliseconds += timing.milliseconds;
+        gpuMilliseconds += timing.milliseconds;
+    }
+
+    if (frame < WARMUP_FRAMES + BENCHMARK_FRAMES)
+        return;
+
+    double frameMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() / BENCHMARK_FRAMES;
+    std::cout << "  " << LIGHT_COUNTS[step] << " lights: binning " << binningMilliseconds / BENCHMARK_FRAMES << " ms, scene "
+              << sceneMilliseconds / BENCHMARK_FRAMES << " ms, all passes " << gpuMilliseconds / BENCHMARK_FRAMES << " ms, frame " << frameMilliseconds << " ms"
+              << std::endl;
+
+    frame = 0;
+    if (++step == STEP_COUNT)
+        requestClose();
+}
+
+void waitForFrame()
+{
+    graphicsTimeline.waitForValue(frameTimelineValues[currentFrame]);
+    deletionQueue.collect();
+    frameDescriptorAllocators[currentFrame].reset();
+}
+
+void drawFrame()
+{
+    TIME_FRAME_SCOPE(DrawFrame);
+    uint32_t imageIndex;
+    VkResult result = vkAcquireNextImageKHR(device, swapchain, std::numeric_limits<uint64_t>::max(), semaphoresImageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        recreateSwapchain();
+        return;
+    }
+
+    updateTextureStreaming();
+    frameDescriptorSet = createFrameDescriptorSet();
+    bindlessDescriptorSet = beginBindlessFrame(currentFrame);
+
+    renderGraph.setImportedImage(backbuffer, swapchainImages[imageIndex], imageViews[imageIndex]);
+    if (sceneFeatures & SHADER_FEATURE_LIT_BIT)
+        renderGraph.setImportedBuffer(lightClusters, getLightClusterBuffer());
+    beginFrameCapture(renderGraph, currentFrame);
+    {
+        TIME_FRAME_SCOPE(Recording);
+        frameTimelineValues[currentFrame] = renderGraph.execute(currentFrame, semaphoresImageAvailable[currentFrame], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                                                semaphoresRenderingDone[currentFrame]);
+    }
+
+    VkPresentInfoKHR presentInfo;
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.pNext = nullptr;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &semaphoresRenderingDone[currentFrame];
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &swapchain;
+    presentInfo.pImageIndices = &imageIndex;
+    presentInfo.pResults = nullptr;
+
+    result = vkQueuePresentKHR(queue, &presentInfo);
+    ASSERT_VULKAN(result);
+
+    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+void updateMVP(const FrameState &frameState)
+{
+    TIME_FRAME_SCOPE(UpdateMVP);
+    viewMatrix = frameState.view;
+    projectionMatrix = glm::perspective(glm::radians(60.0f), width / (float)height, Z_NEAR, Z_FAR);
+    projectionMatrix[1][1] *= -1;
+
+    sceneUniforms.MVP = projectionMatrix * viewMatrix * frameState.model;
+    sceneUniforms.model = frameState.model;
+
+    void *memory;
+    COUNT_FRAME_STAT(MemoryMaps, 1);
+    vkMapMemory(device, uniformBufferDeviceMemories[currentFrame], 0, sizeof(SceneUniforms), 0, &memory);
+    memcpy(memory, &sceneUniforms, sizeof(SceneUniforms));
+    COUNT_FRAME_STAT(UploadBytes, sizeof(SceneUniforms));
+    vkUnmapMemory(device, uniformBufferDeviceMemories[currentFrame]);
+
+    updateClusteredLighting(frameState.time, viewMatrix, projectionMatrix, Z_NEAR, Z_FAR, renderWidth, renderHeight);
+}
+
+static double lastFrameTime = 0.0;
+
+void renderFrame()
+{
+    processInput();
+
+    waitForFrame();
+
+    updateMemoryBudget();
+    sceneGeometry.updateResidency();
+    quantizedSceneGeometry.updateResidency();
+    updateSceneLoading(quantizedSceneGeometry);
+
+    collectFrameCapture(currentFrame);
+    if (isFrameCaptureDone())
+        requestClose();
+
+    const FrameState &frameState = acquireFrameState();
+    float deltaTime = (float)(frameState.time - lastFrameTime);
+    lastFrameTime = frameState.time;
+
+    printPassTimings();
+
+    updateParticleBenchmark(frameState);
+    updateLightBenchmark();
+
+    reloadShaders();
+
+    if (updateDynamicResolution(renderGraph.getPassTimings(currentFrame)))
+        renderGraphDirty = true;
+    rebuildRenderGraph();
+
+    updateMVP(frameState);
+
+    updateParticles(deltaTime, viewMatrix, projectionMatrix);
+    updateOcclusionCulling(viewMatrix, projectionMatrix);
+    updateMeshlets(viewMatrix, projectionMatrix);
+
+    drawFrame();
+
+    endFrameStats();
+}
+
+std::atomic<bool> rendering(false);
+
+// Owns the device queues and every setting the key bindings touch, from
+// initVulkan returning until shutDownVulkan.
+void renderLoop()
+{
+    while (rendering)
+    {
+        renderFrame();
+    }
+}
+
+// The main thread only handles window events, simulation and rendering each
+// run on their own thread and meet through the frame state triple buffer.
+void gameLoop()
+{
+    startSimulation();
+    rendering = true;
+    std::thread renderThread(renderLoop);
+
+    while (!glfwWindowShouldClose(window))
+    {
+        glfwWaitEvents();
+
+        std::string title;
+        if (takeFrameStatsTitle(title))
+            glfwSetWindowTitle(window, title.empty() ? windowTitle : title.c_str());
+    }
+
+    rendering = false;
+    renderThread.join();
+    stopSimulation();
+}
+
+void shutDownVulkan()
+{
+    vkDeviceWaitIdle(device);
+    shutDownSceneLoader();
+    shutDownFrameCapture();
+    shutDownFrameStats();
+    shutDownShaderManager();
+    shutDownTextures();
+    releaseBindlessBuffer(materialBufferIndex);
+    renderGraph.destroy();
+    deletionQueue.flush();
+    shutDownBindless();
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        frameDescriptorAllocators[i].destroy();
+    }
+    descriptorLayoutCache.destroy();
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        freeDeviceMemory(uniformBufferDeviceMemories[i]);
+        vkDestroyBuffer(device, uniformBuffers[i], nullptr);
+    }
+
+    freeDeviceMemory(materialBufferDeviceMemory);
+    vkDestroyBuffer(device, materialBuffer, nullptr);
+
+    freeDeviceMemory(instanceBufferDeviceMemory);
+    vkDestroyBuffer(device, instanceBuffer, nullptr);
+
+    quantizedSceneGeometry.destroy();
+    sceneGeometry.destroy();
+
+    graphicsTimeline.destroy();
+    computeTimeline.destroy();
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroySemaphore(device, semaphoresImageAvailable[i], nullptr);
+        vkDestroySemaphore(device, semaphoresRenderingDone[i], nullptr);
+    }
+
+    vkDestroyCommandPool(device, commandPool, nullptr);
+
+    scenePipelines.destroy();
+    shutDownMeshlets();
+    shutDownOcclusionCulling();
+    shutDownParticles();
+    shutDownClusteredLighting();
+    shutDownPostProcess();
+    shutDownPipelineCache();
+
+    for (int i = 0; i < swapchainImageCount; i++)
+    {
+        vkDestroyImageView(device, imageViews[i], nullptr);
+    }
+    delete[] imageViews;
+    delete[] swapchainImages;
+
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+
+    vkDestroyShaderModule(device, shaderModuleVert, nullptr);
+    vkDestroyShaderModule(device, shaderModuleFrag, nullptr);
+
+    vkDestroySwapchainKHR(device, swapchain, nullptr);
+    vkDestroyDevice(device, nullptr);
+    vkDestroySurfaceKHR(instance, surface, nullptr);
+    vkDestroyInstance(instance, nullptr);
+}
+
+void shutDownWindow()
+{
+    glfwDestroyWindow(window);
+
+    glfwTerminate();
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+
+#define ASSERT_VULKAN(val)                        \
+    if (val != VK_SUCCESS)                        \
+    {                                             \
+        std::cerr << "Error VULKAN" << std::endl; \
+        exit(EXIT_FAILURE);                       \
+    }
+
+const int MAX_FRAMES_IN_FLIGHT = 2;
+
+struct DeviceCapabilities
+{
+    uint32_t apiVersion = VK_API_VERSION_1_0;
+    bool timelineSemaphore = false;
+    bool samplerAnisotropy = false;
+    bool textureCompressionBC = false;
+    bool textureCompressionASTC = false;
+    float maxSamplerAnisotropy = 1.0f;
+    bool descriptorIndexing = false;
+    bool dynamicArrayIndexing = false;
+    uint32_t maxPerStageSampledImages = 16;
+    uint32_t maxPerStageStorageBuffers = 4;
+    VkSampleCountFlags framebufferSampleCounts = VK_SAMPLE_COUNT_1_BIT;
+    VkFormat depthFormat = VK_FORMAT_D16_UNORM;
+    bool timestamps = false;
+    float timestampPeriod = 1.0f;
+    bool asyncCompute = false;
+    uint32_t computeQueueFamily = 0;
+    // Multi-draw indirect with a non-zero firstInstance per draw.
+    bool multiDrawIndirect = false;
+    // Task and mesh shaders through VK_EXT_mesh_shader, only used on Vulkan 1.2.
+    bool meshShader = false;
+    // Per-heap budget and usage through VK_EXT_memory_budget.
+    bool memoryBudget = false;
+};
+
+extern VkInstance instance;
+extern std::vector<VkPhysicalDevice> physicalDevices;
+extern VkDevice device;
+extern VkQueue queue;
+extern VkQueue computeQueue;
+extern VkCommandPool commandPool;
+extern DeviceCapabilities deviceCapabilities;
+extern uint32_t currentFrame;
+extern PFN_vkGetPhysicalDeviceMemoryProperties2 getPhysicalDeviceMemoryProperties2;
+
+bool isDeviceExtensionSupported(const char *extensionName);
+PFN_vkVoidFunction getDeviceFunction(const char *coreName, const char *extensionName, uint32_t coreVersion);
+
+std::vector<char> readFile(const std::string &fileName);
+void createShaderModule(const std::vector<char> &code, VkShaderModule *shaderModule);
+uint32_t getMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+// A concurrent buffer is shared with the async compute queue family, if there
+// is one, so it needs no ownership transfers.
+void createBuffer(VkDeviceSize deviceSize, VkBufferUsageFlags bufferUsageFlags, VkBuffer &buffer, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceMemory &deviceMemory,
+                  bool concurrent = false);
+void createStagingBuffer(const void *data, VkDeviceSize size, VkBuffer &buffer, VkDeviceMemory &deviceMemory);
+void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags memoryPropertyFlags, VkImage &image, VkDeviceMemory &deviceMemory);
+void createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectMask, uint32_t mipLevels, VkImageView &imageView);
+void cmdImageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectMask, uint32_t baseMipLevel, uint32_t levelCount,
+                     VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+                     VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask);
+VkCommandBuffer beginOneTimeCommands();
+void endOneTimeCommands(VkCommandBuffer commandBuffer);
+
+void copyBuffer(VkBuffer src, VkBuffer dest, VkDeviceSize size);
+// Goes through a staging buffer released by the deletion queue.
+void createAndUploadBuffer(const void *data, VkDeviceSize bufferSize, VkBufferUsageFlags usage, VkBuffer &buffer, VkDeviceMemory &deviceMemory);
+
+// Device local and concurrent, for static data read by any queue. The copy
+// is visible to every later command.
+void createDeviceBuffer(const void *data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, VkDeviceMemory &deviceMemory);
+
+template <typename T>
+void createAndUploadBuffer(const std::vector<T> &data, VkBufferUsageFlags usage, VkBuffer &buffer, VkDeviceMemory &deviceMemory)
+{
+    createAndUploadBuffer(data.data(), sizeof(T) * data.size(), usage, buffer, deviceMemory);
+}
+
+// Set from the command line before initVulkan, see main.cpp and bench.
+extern std::string sceneFileName;
+extern bool particleBenchmark;
+extern bool lightBenchmark;
+// Without it frames are presented immediately if the driver allows it.
+extern bool vsync;
+
+void initWindow();
+void initVulkan();
+// Renders on its own thread until the window is closed.
+void gameLoop();
+// One iteration of the render loop, for callers driving frames themselves.
+// startSimulation must have been called.
+void renderFrame();
+void shutDownVulkan();
+void shutDownWindow();
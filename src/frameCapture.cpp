@@ -0,0 +1,235 @@
+#include "frameCapture.h"
+#include "deletionQueue.h"
+#include "memoryBudget.h"
+#include "frameStats.h"
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <sys/stat.h>
+
+FrameCaptureSettings frameCaptureSettings;
+
+struct CapturedFrame
+{
+    uint32_t index;
+    uint32_t width;
+    uint32_t height;
+    bool bgra;
+    std::vector<uint8_t> pixels;
+};
+
+static VkBuffer captureBuffers[MAX_FRAMES_IN_FLIGHT] = {};
+static VkDeviceMemory captureBufferMemories[MAX_FRAMES_IN_FLIGHT] = {};
+static void *captureBufferData[MAX_FRAMES_IN_FLIGHT] = {};
+// Index of the frame whose copy is in flight in each slot.
+static bool framePending[MAX_FRAMES_IN_FLIGHT] = {};
+static uint32_t pendingFrameIndices[MAX_FRAMES_IN_FLIGHT];
+static uint32_t captureWidth = 0;
+static uint32_t captureHeight = 0;
+static bool captureBgra = false;
+static RenderGraphResource captureResource;
+
+static uint32_t nextFrameIndex = 0;
+static uint32_t collectedFrames = 0;
+
+static std::thread writerThread;
+static std::mutex writerMutex;
+static std::condition_variable writerCondition;
+static std::deque<CapturedFrame> writerQueue;
+static bool writerStopping = false;
+
+static void writeFrame(const CapturedFrame &frame)
+{
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "frame_%05u.ppm", frame.index);
+    std::string path = frameCaptureSettings.directory + "/" + fileName;
+
+    std::vector<uint8_t> rgb(frame.width * frame.height * 3);
+    for (size_t i = 0; i < (size_t)frame.width * frame.height; i++)
+    {
+        const uint8_t *pixel = &frame.pixels[i * 4];
+        rgb[i * 3 + 0] = frame.bgra ? pixel[2] : pixel[0];
+        rgb[i * 3 + 1] = pixel[1];
+        rgb[i * 3 + 2] = frame.bgra ? pixel[0] : pixel[2];
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n"
+         << frame.width << " " << frame.height << "\n255\n";
+    file.write((const char *)rgb.data(), rgb.size());
+    if (!file)
+        std::cerr << "Failed to write " << path << std::endl;
+}
+
+// Drains the queue before returning once stopping is requested.
+static void runWriter()
+{
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(writerMutex);
+        writerCondition.wait(lock, [] { return writerStopping || !writerQueue.empty(); });
+        if (writerQueue.empty())
+            return;
+
+        CapturedFrame frame = std::move(writerQueue.front());
+        writerQueue.pop_front();
+        lock.unlock();
+
+        writeFrame(frame);
+    }
+}
+
+static void destroyCaptureBuffers()
+{
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        if (captureBuffers[i] == VK_NULL_HANDLE)
+            continue;
+
+        deletionQueue.destroyBuffer(captureBuffers[i]);
+        deletionQueue.freeMemory(captureBufferMemories[i]);
+        captureBuffers[i] = VK_NULL_HANDLE;
+        framePending[i] = false;
+    }
+}
+
+static void createCaptureBuffers(uint32_t width, uint32_t height)
+{
+    VkDeviceSize size = (VkDeviceSize)width * height * 4;
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, captureBuffers[i], VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     captureBufferMemories[i]);
+        COUNT_FRAME_STAT(MemoryMaps, 1);
+        VkResult result = vkMapMemory(device, captureBufferMemories[i], 0, size, 0, &captureBufferData[i]);
+        ASSERT_VULKAN(result);
+    }
+    captureWidth = width;
+    captureHeight = height;
+}
+
+void addFrameCapturePass(RenderGraph &graph, RenderGraphResource output, VkFormat format, uint32_t width, uint32_t height)
+{
+    if (!frameCaptureSettings.enabled)
+        return;
+
+    if (format != VK_FORMAT_B8G8R8A8_UNORM && format != VK_FORMAT_B8G8R8A8_SRGB && format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB)
+    {
+        std::cerr << "Frame capture only supports 8 bit RGBA and BGRA swapchains" << std::endl;
+        frameCaptureSettings.enabled = false;
+        return;
+    }
+    captureBgra = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+
+    if (width != captureWidth || height != captureHeight)
+    {
+        destroyCaptureBuffers();
+        createCaptureBuffers(width, height);
+    }
+
+    if (!writerThread.joinable())
+    {
+        mkdir(frameCaptureSettings.directory.c_str(), 0755);
+        writerThread = std::thread(runWriter);
+    }
+
+    captureResource = graph.importBuffer("frameCapture", captureBuffers[0]);
+    graph.addPass("frameCapture", RenderGraphQueue::Graphics)
+        .read(output, RenderGraphAccess::TransferSrc)
+        .write(captureResource, RenderGraphAccess::TransferDst)
+        .execute([&graph, output, width, height](VkCommandBuffer commandBuffer) {
+            VkBuffer buffer = graph.getBuffer(captureResource);
+
+            VkBufferImageCopy bufferImageCopy;
+            bufferImageCopy.bufferOffset = 0;
+            bufferImageCopy.bufferRowLength = 0;
+            bufferImageCopy.bufferImageHeight = 0;
+            bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            bufferImageCopy.imageSubresource.mipLevel = 0;
+            bufferImageCopy.imageSubresource.baseArrayLayer = 0;
+            bufferImageCopy.imageSubresource.layerCount = 1;
+            bufferImageCopy.imageOffset = {0, 0, 0};
+            bufferImageCopy.imageExtent = {width, height, 1};
+            vkCmdCopyImageToBuffer(commandBuffer, graph.getImage(output), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &bufferImageCopy);
+
+            // Waiting on the frame doesn't make the copy visible to the host
+            // by itself.
+            VkBufferMemoryBarrier bufferMemoryBarrier;
+            bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            bufferMemoryBarrier.pNext = nullptr;
+            bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            bufferMemoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferMemoryBarrier.buffer = buffer;
+            bufferMemoryBarrier.offset = 0;
+            bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+        });
+}
+
+void beginFrameCapture(RenderGraph &graph, uint32_t frame)
+{
+    if (!frameCaptureSettings.enabled)
+        return;
+
+    graph.setImportedBuffer(captureResource, captureBuffers[frame]);
+    framePending[frame] = frameCaptureSettings.frameCount == 0 || nextFrameIndex < frameCaptureSettings.frameCount;
+    if (framePending[frame])
+        pendingFrameIndices[frame] = nextFrameIndex++;
+}
+
+void collectFrameCapture(uint32_t frame)
+{
+    if (!framePending[frame])
+        return;
+
+    CapturedFrame capturedFrame;
+    capturedFrame.index = pendingFrameIndices[frame];
+    capturedFrame.width = captureWidth;
+    capturedFrame.height = captureHeight;
+    capturedFrame.bgra = captureBgra;
+    capturedFrame.pixels.resize((size_t)captureWidth * captureHeight * 4);
+    memcpy(capturedFrame.pixels.data(), captureBufferData[frame], capturedFrame.pixels.size());
+    framePending[frame] = false;
+    collectedFrames++;
+
+    std::lock_guard<std::mutex> lock(writerMutex);
+    writerQueue.push_back(std::move(capturedFrame));
+    writerCondition.notify_one();
+}
+
+bool isFrameCaptureDone()
+{
+    return frameCaptureSettings.enabled && frameCaptureSettings.frameCount > 0 && collectedFrames >= frameCaptureSettings.frameCount;
+}
+
+// The device must be idle, which completes the copies still in flight.
+void shutDownFrameCapture()
+{
+    if (!writerThread.joinable())
+        return;
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        collectFrameCapture(i);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        writerStopping = true;
+    }
+    writerCondition.notify_one();
+    writerThread.join();
+
+    std::cout << "Captured " << collectedFrames << " frames to " << frameCaptureSettings.directory << std::endl;
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        freeDeviceMemory(captureBufferMemories[i]);
+        vkDestroyBuffer(device, captureBuffers[i], nullptr);
+    }
+}
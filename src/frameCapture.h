@@ -0,0 +1,33 @@
+#pragma once
+
+#include "engine.h"
+#include "renderGraph.h"
+
+#include <string>
+
+// Copies every presented frame into a host visible buffer and writes it to
+// directory/frame_NNNNN.ppm on a writer thread, so the frame loop only pays
+// for a memcpy. Frames are read back once their frame slot has been waited
+// on, MAX_FRAMES_IN_FLIGHT frames later.
+struct FrameCaptureSettings
+{
+    bool enabled = false;
+    std::string directory = "captures";
+    // Stop after this many frames, 0 captures until the window is closed.
+    uint32_t frameCount = 0;
+};
+
+extern FrameCaptureSettings frameCaptureSettings;
+
+void shutDownFrameCapture();
+
+// Adds a pass copying output, the swapchain image, into the capture buffer.
+// The swapchain needs VK_IMAGE_USAGE_TRANSFER_SRC_BIT.
+void addFrameCapturePass(RenderGraph &graph, RenderGraphResource output, VkFormat format, uint32_t width, uint32_t height);
+
+// Call before executing the graph for frame.
+void beginFrameCapture(RenderGraph &graph, uint32_t frame);
+// Call once frame's previous submission has completed.
+void collectFrameCapture(uint32_t frame);
+// True once frameCount frames have been handed to the writer.
+bool isFrameCaptureDone();
@@ -0,0 +1,335 @@
+#include "frameStats.h"
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+FrameStatsSettings frameStatsSettings;
+
+#if ENGINE_STATS
+uint64_t frameCounters[(size_t)FrameCounter::Count] = {};
+double frameTimerMilliseconds[(size_t)FrameTimer::Count] = {};
+#endif
+
+static const char *counterNames[] = {"queueSubmits", "draws", "dispatches", "pipelineBinds", "descriptorSetBinds", "bufferBinds", "memoryMaps", "allocations",
+                                     "uploadBytes"};
+static const char *timerNames[] = {"updateMVP", "drawFrame", "recording"};
+static_assert(sizeof(counterNames) / sizeof(counterNames[0]) == (size_t)FrameCounter::Count, "missing counter name");
+static_assert(sizeof(timerNames) / sizeof(timerNames[0]) == (size_t)FrameTimer::Count, "missing timer name");
+
+static FrameStatsSample history[FRAME_STATS_HISTORY];
+static uint32_t sampleCount = 0;
+static uint32_t nextSample = 0;
+static std::chrono::steady_clock::time_point lastFrameEnd;
+
+static std::ofstream exportFile;
+static bool exportCsv = false;
+static FrameStatsSample exportSum;
+static double exportMaxFrameMilliseconds = 0.0;
+static uint32_t exportFrames = 0;
+static double exportElapsed = 0.0;
+static double exportTime = 0.0;
+
+static std::mutex titleMutex;
+static std::string pendingTitle;
+static bool titlePending = false;
+static bool titleShown = false;
+static double titleElapsed = 0.0;
+
+// Frame time scale of the overlay graph, twice a 60 Hz frame.
+static const double overlayMaxMilliseconds = 1000.0 / 30.0;
+
+static void addSample(FrameStatsSample &sum, const FrameStatsSample &sample)
+{
+    for (size_t i = 0; i < (size_t)FrameCounter::Count; i++)
+    {
+        sum.counters[i] += sample.counters[i];
+    }
+    for (size_t i = 0; i < (size_t)FrameTimer::Count; i++)
+    {
+        sum.timerMilliseconds[i] += sample.timerMilliseconds[i];
+    }
+    sum.frameMilliseconds += sample.frameMilliseconds;
+}
+
+static std::string getSummary(const FrameStatsSample &sum, uint32_t frames)
+{
+    std::ostringstream summary;
+    summary.precision(3);
+    summary << sum.frameMilliseconds / frames << " ms, " << sum.counters[(size_t)FrameCounter::Draws] / frames << " draws, "
+            << sum.counters[(size_t)FrameCounter::QueueSubmits] / frames << " submits, " << sum.counters[(size_t)FrameCounter::MemoryMaps] / frames << " maps, "
+            << sum.counters[(size_t)FrameCounter::UploadBytes] / frames / 1024 << " KiB uploaded";
+    return summary.str();
+}
+
+static void writeExport()
+{
+    if (!exportFile.is_open())
+    {
+        exportFile.open(frameStatsSettings.exportFileName);
+        if (!exportFile)
+        {
+            std::cerr << "Failed to open " << frameStatsSettings.exportFileName << ", stats export disabled" << std::endl;
+            frameStatsSettings.exportFileName.clear();
+            return;
+        }
+
+        const std::string &fileName = frameStatsSettings.exportFileName;
+        exportCsv = fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".csv") == 0;
+        if (exportCsv)
+        {
+            exportFile << "time,frames,frameMs,maxFrameMs";
+            for (const char *name : counterNames)
+            {
+                exportFile << "," << name;
+            }
+            for (const char *name : timerNames)
+            {
+                exportFile << "," << name << "Ms";
+            }
+            exportFile << "\n";
+        }
+    }
+
+    // Counters and timers are per frame averages over the interval.
+    if (exportCsv)
+    {
+        exportFile << exportTime << "," << exportFrames << "," << exportSum.frameMilliseconds / exportFrames << "," << exportMaxFrameMilliseconds;
+        for (size_t i = 0; i < (size_t)FrameCounter::Count; i++)
+        {
+            exportFile << "," << (double)exportSum.counters[i] / exportFrames;
+        }
+        for (size_t i = 0; i < (size_t)FrameTimer::Count; i++)
+        {
+            exportFile << "," << exportSum.timerMilliseconds[i] / exportFrames;
+        }
+        exportFile << "\n";
+    }
+    else
+    {
+        exportFile << "{\"time\": " << exportTime << ", \"frames\": " << exportFrames << ", \"frameMs\": " << exportSum.frameMilliseconds / exportFrames
+                   << ", \"maxFrameMs\": " << exportMaxFrameMilliseconds;
+        for (size_t i = 0; i < (size_t)FrameCounter::Count; i++)
+        {
+            exportFile << ", \"" << counterNames[i] << "\": " << (double)exportSum.counters[i] / exportFrames;
+        }
+        for (size_t i = 0; i < (size_t)FrameTimer::Count; i++)
+        {
+            exportFile << ", \"" << timerNames[i] << "Ms\": " << exportSum.timerMilliseconds[i] / exportFrames;
+        }
+        exportFile << "}\n";
+    }
+    exportFile.flush();
+}
+
+void endFrameStats()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    bool firstFrame = lastFrameEnd == std::chrono::steady_clock::time_point();
+
+    FrameStatsSample &sample = history[nextSample];
+    memset(&sample, 0, sizeof(sample));
+#if ENGINE_STATS
+    memcpy(sample.counters, frameCounters, sizeof(frameCounters));
+    memcpy(sample.timerMilliseconds, frameTimerMilliseconds, sizeof(frameTimerMilliseconds));
+    memset(frameCounters, 0, sizeof(frameCounters));
+    memset(frameTimerMilliseconds, 0, sizeof(frameTimerMilliseconds));
+#endif
+    sample.frameMilliseconds = firstFrame ? 0.0 : std::chrono::duration<double, std::milli>(now - lastFrameEnd).count();
+    lastFrameEnd = now;
+
+    // The first frame also carries all of the loading work.
+    if (firstFrame)
+        return;
+
+    nextSample = (nextSample + 1) % FRAME_STATS_HISTORY;
+    sampleCount = std::min(sampleCount + 1, (uint32_t)FRAME_STATS_HISTORY);
+
+    if (!frameStatsSettings.exportFileName.empty())
+    {
+        addSample(exportSum, sample);
+        exportMaxFrameMilliseconds = std::max(exportMaxFrameMilliseconds, sample.frameMilliseconds);
+        exportFrames++;
+        exportElapsed += sample.frameMilliseconds / 1000.0;
+        exportTime += sample.frameMilliseconds / 1000.0;
+        if (exportElapsed >= frameStatsSettings.exportInterval)
+        {
+            writeExport();
+            memset(&exportSum, 0, sizeof(exportSum));
+            exportMaxFrameMilliseconds = 0.0;
+            exportFrames = 0;
+            exportElapsed = 0.0;
+        }
+    }
+
+    titleElapsed += sample.frameMilliseconds / 1000.0;
+    if (frameStatsSettings.overlay ? titleElapsed >= 0.5 : titleShown)
+    {
+        FrameStatsSample sum = {};
+        uint32_t frames = std::min(sampleCount, 30u);
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            addSample(sum, history[(nextSample + FRAME_STATS_HISTORY - 1 - i) % FRAME_STATS_HISTORY]);
+        }
+
+        std::lock_guard<std::mutex> lock(titleMutex);
+        pendingTitle = frameStatsSettings.overlay ? getSummary(sum, frames) : std::string();
+        titlePending = true;
+        titleShown = frameStatsSettings.overlay;
+        titleElapsed = 0.0;
+        glfwPostEmptyEvent();
+    }
+}
+
+void shutDownFrameStats()
+{
+    if (exportFile.is_open() && exportFrames > 0)
+        writeExport();
+    exportFile.close();
+}
+
+uint32_t getFrameStatsAverage(FrameStatsAverage &average)
+{
+    memset(&average, 0, sizeof(average));
+    FrameStatsSample sum = {};
+    for (uint32_t i = 0; i < sampleCount; i++)
+    {
+        addSample(sum, history[i]);
+        average.maxFrameMilliseconds = std::max(average.maxFrameMilliseconds, history[i].frameMilliseconds);
+    }
+    if (sampleCount == 0)
+        return 0;
+
+    for (size_t i = 0; i < (size_t)FrameCounter::Count; i++)
+    {
+        average.counters[i] = (double)sum.counters[i] / sampleCount;
+    }
+    for (size_t i = 0; i < (size_t)FrameTimer::Count; i++)
+    {
+        average.timerMilliseconds[i] = sum.timerMilliseconds[i] / sampleCount;
+    }
+    average.frameMilliseconds = sum.frameMilliseconds / sampleCount;
+    return sampleCount;
+}
+
+const char *getFrameCounterName(FrameCounter counter)
+{
+    return counterNames[(size_t)counter];
+}
+
+const char *getFrameTimerName(FrameTimer timer)
+{
+    return timerNames[(size_t)timer];
+}
+
+void printFrameStats()
+{
+    FrameStatsAverage average;
+    uint32_t frames = getFrameStatsAverage(average);
+    if (frames == 0)
+    {
+        std::cout << "No frame stats yet" << std::endl;
+        return;
+    }
+
+    std::cout << "Frame stats over " << frames << " frames: " << average.frameMilliseconds << " ms, max " << average.maxFrameMilliseconds << " ms" << std::endl;
+#if ENGINE_STATS
+    for (size_t i = 0; i < (size_t)FrameCounter::Count; i++)
+    {
+        std::cout << "  " << counterNames[i] << ": " << average.counters[i] << std::endl;
+    }
+    for (size_t i = 0; i < (size_t)FrameTimer::Count; i++)
+    {
+        std::cout << "  " << timerNames[i] << ": " << average.timerMilliseconds[i] << " ms" << std::endl;
+    }
+#else
+    std::cout << "  counters compiled out (ENGINE_STATS=0)" << std::endl;
+#endif
+}
+
+bool takeFrameStatsTitle(std::string &title)
+{
+    std::lock_guard<std::mutex> lock(titleMutex);
+    if (!titlePending)
+        return false;
+
+    title = pendingTitle;
+    titlePending = false;
+    return true;
+}
+
+static void clearRects(VkCommandBuffer commandBuffer, const std::vector<VkClearRect> &rects, float r, float g, float b)
+{
+    if (rects.empty())
+        return;
+
+    VkClearAttachment clearAttachment;
+    clearAttachment.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    clearAttachment.colorAttachment = 0;
+    clearAttachment.clearValue.color = {{r, g, b, 1.0f}};
+    vkCmdClearAttachments(commandBuffer, 1, &clearAttachment, rects.size(), rects.data());
+}
+
+static VkClearRect getClearRect(int32_t x, int32_t y, uint32_t width, uint32_t height)
+{
+    VkClearRect clearRect;
+    clearRect.rect.offset = {x, y};
+    clearRect.rect.extent = {width, height};
+    clearRect.baseArrayLayer = 0;
+    clearRect.layerCount = 1;
+    return clearRect;
+}
+
+// Without a text renderer the graph is drawn with clear rects: one bar per
+// frame, green within 60 Hz, yellow within 30 Hz and red beyond, with the CPU
+// time of drawFrame in a darker shade at the bottom of each bar.
+static void recordOverlay(VkCommandBuffer commandBuffer, uint32_t width, uint32_t height)
+{
+    const uint32_t barWidth = 2;
+    const uint32_t graphHeight = 100;
+    const uint32_t margin = 8;
+    if (width < FRAME_STATS_HISTORY * barWidth + 2 * margin || height < graphHeight + 2 * margin)
+        return;
+
+    int32_t left = margin;
+    int32_t bottom = height - margin;
+    std::vector<VkClearRect> background = {getClearRect(left, bottom - graphHeight, FRAME_STATS_HISTORY * barWidth, graphHeight)};
+    clearRects(commandBuffer, background, 0.0f, 0.0f, 0.0f);
+
+    std::vector<VkClearRect> bars[3];
+    std::vector<VkClearRect> cpuBars;
+    for (uint32_t i = 0; i < sampleCount; i++)
+    {
+        // Oldest on the left.
+        const FrameStatsSample &sample = history[(nextSample + FRAME_STATS_HISTORY - sampleCount + i) % FRAME_STATS_HISTORY];
+        int32_t x = left + (FRAME_STATS_HISTORY - sampleCount + i) * barWidth;
+
+        uint32_t barHeight = std::min(sample.frameMilliseconds / overlayMaxMilliseconds, 1.0) * graphHeight;
+        uint32_t level = sample.frameMilliseconds <= 1000.0 / 60.0 ? 0 : (sample.frameMilliseconds <= 1000.0 / 30.0 ? 1 : 2);
+        if (barHeight > 0)
+            bars[level].push_back(getClearRect(x, bottom - barHeight, barWidth, barHeight));
+
+        uint32_t cpuHeight = std::min(sample.timerMilliseconds[(size_t)FrameTimer::DrawFrame] / overlayMaxMilliseconds, 1.0) * graphHeight;
+        cpuHeight = std::min(cpuHeight, barHeight);
+        if (cpuHeight > 0)
+            cpuBars.push_back(getClearRect(x, bottom - cpuHeight, barWidth, cpuHeight));
+    }
+    clearRects(commandBuffer, bars[0], 0.1f, 0.8f, 0.1f);
+    clearRects(commandBuffer, bars[1], 0.9f, 0.8f, 0.1f);
+    clearRects(commandBuffer, bars[2], 0.9f, 0.1f, 0.1f);
+    clearRects(commandBuffer, cpuBars, 0.1f, 0.3f, 0.6f);
+
+    std::vector<VkClearRect> budgetLine = {getClearRect(left, bottom - graphHeight / 2, FRAME_STATS_HISTORY * barWidth, 1)};
+    clearRects(commandBuffer, budgetLine, 1.0f, 1.0f, 1.0f);
+}
+
+void addFrameStatsOverlayPass(RenderGraph &graph, RenderGraphResource output, uint32_t width, uint32_t height)
+{
+    if (!frameStatsSettings.overlay)
+        return;
+
+    graph.addPass("frameStatsOverlay", RenderGraphQueue::Graphics)
+        .write(output, RenderGraphAccess::ColorAttachment)
+        .execute([width, height](VkCommandBuffer commandBuffer) { recordOverlay(commandBuffer, width, height); });
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "engine.h"
+#include "renderGraph.h"
+
+#include <chrono>
+
+// Build with -DENGINE_STATS=0 to compile the counters and timers out.
+#ifndef ENGINE_STATS
+#define ENGINE_STATS 1
+#endif
+
+#define FRAME_STATS_HISTORY 240
+
+enum class FrameCounter
+{
+    QueueSubmits,
+    Draws,
+    Dispatches,
+    PipelineBinds,
+    DescriptorSetBinds,
+    BufferBinds,
+    MemoryMaps,
+    Allocations,
+    UploadBytes,
+    Count,
+};
+
+enum class FrameTimer
+{
+    UpdateMVP,
+    DrawFrame,
+    Recording,
+    Count,
+};
+
+struct FrameStatsSettings
+{
+    // Frame time graph in the corner and a summary in the window title.
+    bool overlay = false;
+    // Written every exportInterval seconds when set, as CSV if the name ends
+    // in .csv and as one JSON object per line otherwise.
+    std::string exportFileName;
+    double exportInterval = 1.0;
+};
+
+extern FrameStatsSettings frameStatsSettings;
+
+struct FrameStatsSample
+{
+    uint64_t counters[(size_t)FrameCounter::Count];
+    double timerMilliseconds[(size_t)FrameTimer::Count];
+    double frameMilliseconds;
+};
+
+#if ENGINE_STATS
+
+// Counted on whichever thread records and submits, one at a time, so the
+// counters are plain integers.
+extern uint64_t frameCounters[(size_t)FrameCounter::Count];
+extern double frameTimerMilliseconds[(size_t)FrameTimer::Count];
+
+inline void countFrameStat(FrameCounter counter, uint64_t value)
+{
+    frameCounters[(size_t)counter] += value;
+}
+
+class FrameTimerScope
+{
+  public:
+    explicit FrameTimerScope(FrameTimer timer) : timer(timer), start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~FrameTimerScope()
+    {
+        frameTimerMilliseconds[(size_t)timer] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+  private:
+    FrameTimer timer;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define COUNT_FRAME_STAT(counter, value) countFrameStat(FrameCounter::counter, value)
+#define TIME_FRAME_SCOPE(timer) FrameTimerScope frameTimerScope##timer(FrameTimer::timer)
+
+#else
+
+#define COUNT_FRAME_STAT(counter, value) ((void)0)
+#define TIME_FRAME_SCOPE(timer) ((void)0)
+
+#endif
+
+// Samples this frame's counters into the history and starts the next frame.
+// Called once per frame by the render loop.
+void endFrameStats();
+void shutDownFrameStats();
+
+struct FrameStatsAverage
+{
+    double counters[(size_t)FrameCounter::Count];
+    double timerMilliseconds[(size_t)FrameTimer::Count];
+    double frameMilliseconds;
+    double maxFrameMilliseconds;
+};
+
+// Averages over the history. Returns the number of frames averaged.
+uint32_t getFrameStatsAverage(FrameStatsAverage &average);
+const char *getFrameCounterName(FrameCounter counter);
+const char *getFrameTimerName(FrameTimer timer);
+void printFrameStats();
+// The overlay title, once per refresh. An empty title restores the window's
+// own after the overlay was turned off.
+bool takeFrameStatsTitle(std::string &title);
+
+void addFrameStatsOverlayPass(RenderGraph &graph, RenderGraphResource output, uint32_t width, uint32_t height);
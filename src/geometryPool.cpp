@@ -0,0 +1,465 @@
+#include "geometryPool.h"
+#include "deletionQueue.h"
+#include "memoryBudget.h"
+#include "frameStats.h"
+
+#include <algorithm>
+
+void FreeListAllocator::init(uint32_t capacity)
+{
+    this->capacity = capacity;
+    freeSize = capacity;
+    freeBlocks.clear();
+    if (capacity > 0)
+        freeBlocks[0] = capacity;
+}
+
+bool FreeListAllocator::allocate(uint32_t size, uint32_t &offset)
+{
+    for (auto block = freeBlocks.begin(); block != freeBlocks.end(); ++block)
+    {
+        if (block->second < size)
+            continue;
+
+        offset = block->first;
+        uint32_t remaining = block->second - size;
+        freeBlocks.erase(block);
+        if (remaining > 0)
+            freeBlocks[offset + size] = remaining;
+        freeSize -= size;
+        return true;
+    }
+    return false;
+}
+
+void FreeListAllocator::free(uint32_t offset, uint32_t size)
+{
+    if (size == 0)
+        return;
+
+    auto block = freeBlocks.emplace(offset, size).first;
+    freeSize += size;
+
+    auto next = std::next(block);
+    if (next != freeBlocks.end() && block->first + block->second == next->first)
+    {
+        block->second += next->second;
+        freeBlocks.erase(next);
+    }
+
+    if (block != freeBlocks.begin())
+    {
+        auto previous = std::prev(block);
+        if (previous->first + previous->second == block->first)
+        {
+            previous->second += block->second;
+            freeBlocks.erase(block);
+        }
+    }
+}
+
+uint32_t FreeListAllocator::getCapacity() const
+{
+    return capacity;
+}
+
+uint32_t FreeListAllocator::getFreeSize() const
+{
+    return freeSize;
+}
+
+// Makes transfer writes visible to vertex input and to later copies out of
+// the pool.
+static void cmdGeometryBarrier(VkCommandBuffer commandBuffer)
+{
+    VkMemoryBarrier memoryBarrier;
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = nullptr;
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0,
+                         nullptr, 0, nullptr);
+}
+
+void GeometryPool::init(uint32_t vertexStride, uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+    this->vertexStride = vertexStride;
+    reallocate(vertexCapacity, indexCapacity);
+}
+
+void GeometryPool::destroy()
+{
+    freeDeviceMemory(indexBufferMemory);
+    vkDestroyBuffer(device, indexBuffer, nullptr);
+    freeDeviceMemory(vertexBufferMemory);
+    vkDestroyBuffer(device, vertexBuffer, nullptr);
+    indexBuffer = VK_NULL_HANDLE;
+    vertexBuffer = VK_NULL_HANDLE;
+
+    meshes.clear();
+    freeHandles.clear();
+}
+
+bool GeometryPool::allocateRange(uint32_t vertexCount, uint32_t indexCount, GeometryRange &range)
+{
+    uint32_t vertexOffset;
+    if (!vertexAllocator.allocate(vertexCount, vertexOffset))
+        return false;
+
+    if (!indexAllocator.allocate(indexCount, range.firstIndex))
+    {
+        vertexAllocator.free(vertexOffset, vertexCount);
+        return false;
+    }
+
+    range.vertexOffset = (int32_t)vertexOffset;
+    range.vertexCount = vertexCount;
+    range.indexCount = indexCount;
+    return true;
+}
+
+void GeometryPool::uploadMesh(Mesh &mesh)
+{
+    VkDeviceSize vertexSize = (VkDeviceSize)mesh.vertexCount * vertexStride;
+    VkDeviceSize indexSize = (VkDeviceSize)mesh.indexCount * sizeof(uint32_t);
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createStagingBuffer(nullptr, vertexSize + indexSize, stagingBuffer, stagingBufferMemory);
+
+    void *stagingData;
+    COUNT_FRAME_STAT(MemoryMaps, 1);
+    vkMapMemory(device, stagingBufferMemory, 0, vertexSize + indexSize, 0, &stagingData);
+    memcpy(stagingData, mesh.vertexData, vertexSize);
+    memcpy((char *)stagingData + vertexSize, mesh.indexData, indexSize);
+    vkUnmapMemory(device, stagingBufferMemory);
+
+    uploadMesh(mesh, stagingBuffer, stagingBufferMemory);
+}
+
+// The staging buffer has to be created first, allocating it may evict and
+// reallocate this pool.
+void GeometryPool::uploadMesh(Mesh &mesh, VkBuffer stagingBuffer, VkDeviceMemory stagingBufferMemory)
+{
+    uint32_t vertexCount = mesh.vertexCount;
+    uint32_t indexCount = mesh.indexCount;
+    VkDeviceSize vertexSize = (VkDeviceSize)vertexCount * vertexStride;
+    VkDeviceSize indexSize = (VkDeviceSize)indexCount * sizeof(uint32_t);
+
+    GeometryRange range;
+    if (!allocateRange(vertexCount, indexCount, range))
+    {
+        // Compacting is enough if the free space is only fragmented,
+        // otherwise grow to at least twice the size.
+        uint32_t vertexCapacity = vertexAllocator.getCapacity();
+        if (vertexAllocator.getFreeSize() < vertexCount)
+            vertexCapacity = std::max(vertexCapacity * 2, vertexCapacity - vertexAllocator.getFreeSize() + vertexCount);
+        uint32_t indexCapacity = indexAllocator.getCapacity();
+        if (indexAllocator.getFreeSize() < indexCount)
+            indexCapacity = std::max(indexCapacity * 2, indexCapacity - indexAllocator.getFreeSize() + indexCount);
+
+        reallocate(vertexCapacity, indexCapacity);
+        if (!allocateRange(vertexCount, indexCount, range))
+        {
+            // The mesh stays evicted, draw requests it again.
+            std::cerr << "Failed to fit a mesh of " << vertexCount << " vertices and " << indexCount << " indices into the geometry pool" << std::endl;
+            deletionQueue.destroyBuffer(stagingBuffer);
+            deletionQueue.freeMemory(stagingBufferMemory);
+            mesh.requested = false;
+            return;
+        }
+    }
+
+    VkCommandBuffer commandBuffer = beginOneTimeCommands();
+
+    // The range may have belonged to a removed mesh still drawn by frames in
+    // flight, which were submitted earlier on the same queue.
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy bufferCopy;
+    bufferCopy.srcOffset = 0;
+    bufferCopy.dstOffset = (VkDeviceSize)range.vertexOffset * vertexStride;
+    bufferCopy.size = vertexSize;
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, vertexBuffer, 1, &bufferCopy);
+
+    bufferCopy.srcOffset = vertexSize;
+    bufferCopy.dstOffset = (VkDeviceSize)range.firstIndex * sizeof(uint32_t);
+    bufferCopy.size = indexSize;
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, indexBuffer, 1, &bufferCopy);
+
+    cmdGeometryBarrier(commandBuffer);
+    endOneTimeCommands(commandBuffer);
+    lastCommandValue = graphicsTimeline.getPendingValue();
+
+    deletionQueue.destroyBuffer(stagingBuffer);
+    deletionQueue.freeMemory(stagingBufferMemory);
+
+    mesh.range = range;
+    mesh.resident = true;
+    mesh.requested = false;
+}
+
+GeometryHandle GeometryPool::createMesh(const void *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount)
+{
+    GeometryHandle handle;
+    if (freeHandles.empty())
+    {
+        handle = meshes.size();
+        meshes.emplace_back();
+    }
+    else
+    {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    }
+
+    Mesh &mesh = meshes[handle];
+    mesh.used = true;
+    mesh.resident = false;
+    mesh.requested = false;
+    mesh.lastUsedFrame = getResidencyFrame();
+    mesh.vertexCount = vertexCount;
+    mesh.indexCount = indexCount;
+    mesh.vertexData = (const char *)vertices;
+    mesh.indexData = indices;
+    return handle;
+}
+
+GeometryHandle GeometryPool::addMesh(const void *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount)
+{
+    GeometryHandle handle = createMesh(vertices, vertexCount, indices, indexCount);
+    Mesh &mesh = meshes[handle];
+    mesh.vertices.assign((const char *)vertices, (const char *)vertices + (size_t)vertexCount * vertexStride);
+    mesh.indices.assign(indices, indices + indexCount);
+    mesh.vertexData = mesh.vertices.data();
+    mesh.indexData = mesh.indices.data();
+
+    uploadMesh(mesh);
+    return handle;
+}
+
+GeometryHandle GeometryPool::addMesh(VkBuffer stagingBuffer, VkDeviceMemory stagingBufferMemory, const void *vertices, uint32_t vertexCount,
+                                     const uint32_t *indices, uint32_t indexCount)
+{
+    GeometryHandle handle = createMesh(vertices, vertexCount, indices, indexCount);
+    uploadMesh(meshes[handle], stagingBuffer, stagingBufferMemory);
+    return handle;
+}
+
+void GeometryPool::removeMesh(GeometryHandle handle)
+{
+    Mesh &mesh = meshes[handle];
+    if (mesh.resident)
+    {
+        vertexAllocator.free(mesh.range.vertexOffset, mesh.range.vertexCount);
+        indexAllocator.free(mesh.range.firstIndex, mesh.range.indexCount);
+    }
+    mesh.used = false;
+    mesh.resident = false;
+    mesh.vertexData = nullptr;
+    mesh.indexData = nullptr;
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    freeHandles.push_back(handle);
+}
+
+bool GeometryPool::isResident(GeometryHandle handle) const
+{
+    return meshes[handle].resident;
+}
+
+const GeometryRange &GeometryPool::getRange(GeometryHandle handle) const
+{
+    return meshes[handle].range;
+}
+
+void GeometryPool::defragment()
+{
+    reallocate(vertexAllocator.getCapacity(), indexAllocator.getCapacity());
+}
+
+void GeometryPool::updateResidency()
+{
+    for (Mesh &mesh : meshes)
+    {
+        if (mesh.used && mesh.requested && !mesh.resident)
+            uploadMesh(mesh);
+    }
+}
+
+VkDeviceSize GeometryPool::evict(VkDeviceSize bytes)
+{
+    uint64_t frame = getResidencyFrame();
+    std::vector<Mesh *> candidates;
+    for (Mesh &mesh : meshes)
+    {
+        if (mesh.used && mesh.resident && mesh.lastUsedFrame + MAX_FRAMES_IN_FLIGHT < frame)
+            candidates.push_back(&mesh);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Mesh *a, const Mesh *b) { return a->lastUsedFrame < b->lastUsedFrame; });
+
+    VkDeviceSize evictedBytes = 0;
+    for (Mesh *mesh : candidates)
+    {
+        if (evictedBytes >= bytes)
+            break;
+
+        vertexAllocator.free(mesh->range.vertexOffset, mesh->range.vertexCount);
+        indexAllocator.free(mesh->range.firstIndex, mesh->range.indexCount);
+        mesh->resident = false;
+        evictedBytes += (VkDeviceSize)mesh->vertexCount * vertexStride + (VkDeviceSize)mesh->indexCount * sizeof(uint32_t);
+    }
+
+    // Only shrinking the buffers gives memory back.
+    uint32_t usedVertices = std::max(vertexAllocator.getCapacity() - vertexAllocator.getFreeSize(), 1u);
+    uint32_t usedIndices = std::max(indexAllocator.getCapacity() - indexAllocator.getFreeSize(), 1u);
+    VkDeviceSize allocatedBytes = getAllocatedBytes();
+    VkDeviceSize usedBytes = (VkDeviceSize)usedVertices * vertexStride + (VkDeviceSize)usedIndices * sizeof(uint32_t);
+    if (usedBytes >= allocatedBytes)
+        return 0;
+
+    reallocate(usedVertices, usedIndices);
+    return allocatedBytes - usedBytes;
+}
+
+VkDeviceSize GeometryPool::release()
+{
+    // Ran out of memory while growing this pool, the old buffers are still
+    // copied from.
+    if (reallocating || vertexBuffer == VK_NULL_HANDLE || lastBoundFrame >= getResidencyFrame() || lastCommandValue > graphicsTimeline.getSubmittedValue())
+        return 0;
+
+    for (Mesh &mesh : meshes)
+    {
+        mesh.resident = false;
+    }
+
+    // Frames in flight are waited for before the memory is freed.
+    VkDeviceSize released = getAllocatedBytes();
+    VkBuffer oldVertexBuffer = vertexBuffer;
+    VkDeviceMemory oldVertexBufferMemory = vertexBufferMemory;
+    VkBuffer oldIndexBuffer = indexBuffer;
+    VkDeviceMemory oldIndexBufferMemory = indexBufferMemory;
+    deletionQueue.pushSubmitted([=]() {
+        vkDestroyBuffer(device, oldVertexBuffer, nullptr);
+        freeDeviceMemory(oldVertexBufferMemory);
+        vkDestroyBuffer(device, oldIndexBuffer, nullptr);
+        freeDeviceMemory(oldIndexBufferMemory);
+    });
+
+    vertexBuffer = VK_NULL_HANDLE;
+    vertexBufferMemory = VK_NULL_HANDLE;
+    indexBuffer = VK_NULL_HANDLE;
+    indexBufferMemory = VK_NULL_HANDLE;
+    vertexAllocator.init(0);
+    indexAllocator.init(0);
+    return released;
+}
+
+VkDeviceSize GeometryPool::getAllocatedBytes() const
+{
+    return (VkDeviceSize)vertexAllocator.getCapacity() * vertexStride + (VkDeviceSize)indexAllocator.getCapacity() * sizeof(uint32_t);
+}
+
+void GeometryPool::reallocate(uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+    VkBuffer oldVertexBuffer = vertexBuffer;
+    VkDeviceMemory oldVertexBufferMemory = vertexBufferMemory;
+    VkBuffer oldIndexBuffer = indexBuffer;
+    VkDeviceMemory oldIndexBufferMemory = indexBufferMemory;
+
+    reallocating = true;
+    createBuffer((VkDeviceSize)vertexCapacity * vertexStride, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 vertexBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBufferMemory);
+    createBuffer((VkDeviceSize)indexCapacity * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 indexBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBufferMemory);
+    reallocating = false;
+
+    vertexAllocator.init(vertexCapacity);
+    indexAllocator.init(indexCapacity);
+
+    if (oldVertexBuffer == VK_NULL_HANDLE)
+        return;
+
+    // Ranges are packed in handle order, each allocation is then the block
+    // right after the previous one.
+    std::vector<VkBufferCopy> vertexCopies;
+    std::vector<VkBufferCopy> indexCopies;
+    for (Mesh &mesh : meshes)
+    {
+        if (!mesh.used || !mesh.resident)
+            continue;
+
+        GeometryRange &range = mesh.range;
+        GeometryRange packedRange;
+        allocateRange(range.vertexCount, range.indexCount, packedRange);
+
+        VkBufferCopy bufferCopy;
+        bufferCopy.srcOffset = (VkDeviceSize)range.vertexOffset * vertexStride;
+        bufferCopy.dstOffset = (VkDeviceSize)packedRange.vertexOffset * vertexStride;
+        bufferCopy.size = (VkDeviceSize)range.vertexCount * vertexStride;
+        if (bufferCopy.size > 0)
+            vertexCopies.push_back(bufferCopy);
+
+        bufferCopy.srcOffset = (VkDeviceSize)range.firstIndex * sizeof(uint32_t);
+        bufferCopy.dstOffset = (VkDeviceSize)packedRange.firstIndex * sizeof(uint32_t);
+        bufferCopy.size = (VkDeviceSize)range.indexCount * sizeof(uint32_t);
+        if (bufferCopy.size > 0)
+            indexCopies.push_back(bufferCopy);
+
+        range = packedRange;
+    }
+
+    if (!vertexCopies.empty() || !indexCopies.empty())
+    {
+        VkCommandBuffer commandBuffer = beginOneTimeCommands();
+        if (!vertexCopies.empty())
+            vkCmdCopyBuffer(commandBuffer, oldVertexBuffer, vertexBuffer, vertexCopies.size(), vertexCopies.data());
+        if (!indexCopies.empty())
+            vkCmdCopyBuffer(commandBuffer, oldIndexBuffer, indexBuffer, indexCopies.size(), indexCopies.data());
+        cmdGeometryBarrier(commandBuffer);
+        endOneTimeCommands(commandBuffer);
+        lastCommandValue = graphicsTimeline.getPendingValue();
+    }
+
+    deletionQueue.destroyBuffer(oldVertexBuffer);
+    deletionQueue.freeMemory(oldVertexBufferMemory);
+    deletionQueue.destroyBuffer(oldIndexBuffer);
+    deletionQueue.freeMemory(oldIndexBufferMemory);
+}
+
+void GeometryPool::bind(VkCommandBuffer commandBuffer) const
+{
+    lastBoundFrame = getResidencyFrame();
+    if (vertexBuffer == VK_NULL_HANDLE)
+        return;
+
+    VkDeviceSize offset = 0;
+    COUNT_FRAME_STAT(BufferBinds, 2);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void GeometryPool::draw(VkCommandBuffer commandBuffer, GeometryHandle handle, uint32_t instanceCount)
+{
+    Mesh &mesh = meshes[handle];
+    mesh.lastUsedFrame = getResidencyFrame();
+    if (!mesh.resident)
+    {
+        mesh.requested = true;
+        return;
+    }
+
+    COUNT_FRAME_STAT(Draws, 1);
+    vkCmdDrawIndexed(commandBuffer, mesh.range.indexCount, instanceCount, mesh.range.firstIndex, mesh.range.vertexOffset, 0);
+}
+
+VkBuffer GeometryPool::getVertexBuffer() const
+{
+    return vertexBuffer;
+}
+
+VkBuffer GeometryPool::getIndexBuffer() const
+{
+    return indexBuffer;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "engine.h"
+
+#include <map>
+
+// Hands out ranges of [0, capacity) first fit. Freed ranges are merged with
+// their free neighbours.
+class FreeListAllocator
+{
+  public:
+    void init(uint32_t capacity);
+
+    // Returns false if no free block is large enough.
+    bool allocate(uint32_t size, uint32_t &offset);
+    void free(uint32_t offset, uint32_t size);
+
+    uint32_t getCapacity() const;
+    uint32_t getFreeSize() const;
+
+  private:
+    // Offset to size of every free block.
+    std::map<uint32_t, uint32_t> freeBlocks;
+    uint32_t capacity = 0;
+    uint32_t freeSize = 0;
+};
+
+// Where a mesh lives in its pool, in vertices and indices, ready to be passed
+// to vkCmdDrawIndexed.
+struct GeometryRange
+{
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+typedef uint32_t GeometryHandle;
+
+// One device local vertex buffer and one 32 bit index buffer shared by every
+// mesh with the same vertex layout, so they are bound once and each mesh is
+// only a range within them. When a mesh doesn't fit the live meshes are
+// packed into new buffers, grown if compacting alone doesn't make room.
+// Ranges change when that happens, so look them up again when recording.
+//
+// Meshes that haven't been drawn for a while can be evicted to get under the
+// memory budget. The pool keeps a copy of every mesh in system memory, or
+// points at the caller's, an evicted mesh is skipped by draw and uploaded
+// again by the next updateResidency.
+class GeometryPool
+{
+  public:
+    void init(uint32_t vertexStride, uint32_t vertexCapacity, uint32_t indexCapacity);
+    void destroy();
+
+    // Indices are relative to the mesh's first vertex.
+    GeometryHandle addMesh(const void *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount);
+    // Same without the system memory copy, the data has to stay valid until
+    // the mesh is removed, e.g. a mapped file. The first upload is recorded
+    // from stagingBuffer, already filled with the vertices followed by the
+    // indices, which the pool then releases.
+    GeometryHandle addMesh(VkBuffer stagingBuffer, VkDeviceMemory stagingBufferMemory, const void *vertices, uint32_t vertexCount, const uint32_t *indices,
+                           uint32_t indexCount);
+    void removeMesh(GeometryHandle handle);
+    bool isResident(GeometryHandle handle) const;
+    const GeometryRange &getRange(GeometryHandle handle) const;
+
+    // Packs the live meshes to the start of new buffers. The old ones are
+    // released through the deletion queue, frames in flight keep using them.
+    void defragment();
+
+    // Uploads the evicted meshes draw was asked for. Call before recording.
+    void updateResidency();
+    // Evicts the least recently drawn meshes not drawn by any frame in
+    // flight, then shrinks the buffers to what is left. Returns the bytes
+    // released by shrinking.
+    VkDeviceSize evict(VkDeviceSize bytes);
+    // Evicts every mesh and frees the buffers without allocating or recording
+    // anything, for running out of memory. Does nothing if the frame being
+    // recorded or the batch of one time commands uses the buffers. Returns the
+    // bytes released.
+    VkDeviceSize release();
+
+    // Binds the vertex buffer to binding 0 and the index buffer, if the pool
+    // hasn't been released.
+    void bind(VkCommandBuffer commandBuffer) const;
+    void draw(VkCommandBuffer commandBuffer, GeometryHandle handle, uint32_t instanceCount);
+
+    VkBuffer getVertexBuffer() const;
+    VkBuffer getIndexBuffer() const;
+
+  private:
+    struct Mesh
+    {
+        GeometryRange range;
+        bool used;
+        bool resident;
+        bool requested;
+        uint64_t lastUsedFrame;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        // Either point into the copies or at the caller's data.
+        const char *vertexData;
+        const uint32_t *indexData;
+        std::vector<char> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    void reallocate(uint32_t vertexCapacity, uint32_t indexCapacity);
+    bool allocateRange(uint32_t vertexCount, uint32_t indexCount, GeometryRange &range);
+    GeometryHandle createMesh(const void *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount);
+    void uploadMesh(Mesh &mesh);
+    void uploadMesh(Mesh &mesh, VkBuffer stagingBuffer, VkDeviceMemory stagingBufferMemory);
+    VkDeviceSize getAllocatedBytes() const;
+
+    uint32_t vertexStride = 0;
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+
+    FreeListAllocator vertexAllocator;
+    FreeListAllocator indexAllocator;
+
+    std::vector<Mesh> meshes;
+    std::vector<GeometryHandle> freeHandles;
+    bool reallocating = false;
+    mutable uint64_t lastBoundFrame = 0;
+    // Graphics timeline value of the last commands recorded on the buffers.
+    uint64_t lastCommandValue = 0;
+};
@@ -1,1226 +1,92 @@
-#define GLFW_INCLUDE_VULKAN
-#include <GLFW/glfw3.h>
-#include <iostream>
-#include <vector>
-#include <fstream>
-#include <limits>
+#include "engine.h"
+#include "clusteredLighting.h"
+#include "dynamicResolution.h"
+#include "frameCapture.h"
+#include "frameStats.h"
+#include "particles.h"
+#include "simulation.h"
+#include "stressScene.h"
 
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <chrono>
+#include <algorithm>
 
-#define ASSERT_VULKAN(val)                        \
-    if (val != VK_SUCCESS)                        \
-    {                                             \
-        std::cerr << "Error VULKAN" << std::endl; \
-        exit(EXIT_FAILURE);                       \
-    }
-
-VkInstance instance;
-std::vector<VkPhysicalDevice> physicalDevices;
-VkSurfaceKHR surface;
-VkDevice device;
-VkSwapchainKHR swapchain = VK_NULL_HANDLE;
-VkImageView *imageViews;
-VkFramebuffer *framebuffers;
-VkShaderModule shaderModuleVert;
-VkShaderModule shaderModuleFrag;
-VkPipelineLayout pipelineLayout;
-VkRenderPass renderPass;
-VkPipeline pipeline;
-VkCommandPool commandPool;
-VkCommandBuffer *commandBuffers;
-VkSemaphore semaphoreImageAvailable;
-VkSemaphore semaphoreRenderingDone;
-VkQueue queue;
-
-VkBuffer vertexBuffer;
-VkDeviceMemory vertexBufferDeviceMemory;
-VkBuffer indexBufer;
-VkDeviceMemory indexBufferDeviceMemory;
-VkBuffer uniformBuffer;
-VkDeviceMemory uniformBufferDeviceMemory;
-
-GLFWwindow *window;
-
-uint32_t swapchainImageCount = 0;
-
-uint32_t width = 800;
-uint32_t height = 600;
-const VkFormat format = VK_FORMAT_B8G8R8A8_UNORM;
-
-glm::mat4 MVP;
-VkDescriptorSetLayout descriptorSetLayout;
-VkDescriptorPool descriptorPool;
-VkDescriptorSet descriptorSet;
-
-class Vertex
-{
-  public:
-    glm::vec2 pos;
-    glm::vec3 color;
-
-    Vertex(glm::vec2 pos, glm::vec3 color)
-        : pos(pos), color(color)
-    {
-    }
-
-    static VkVertexInputBindingDescription getBindingDescription()
-    {
-        VkVertexInputBindingDescription vertexInputBindingDescription;
-        vertexInputBindingDescription.binding = 0;
-        vertexInputBindingDescription.stride = sizeof(Vertex);
-        vertexInputBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-        return vertexInputBindingDescription;
-    }
-
-    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions()
-    {
-        std::vector<VkVertexInputAttributeDescription> vertexInputAttributeDescriptions(2);
-        vertexInputAttributeDescriptions[0].location = 0;
-        vertexInputAttributeDescriptions[0].binding = 0;
-        vertexInputAttributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-        vertexInputAttributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-        vertexInputAttributeDescriptions[1].location = 1;
-        vertexInputAttributeDescriptions[1].binding = 0;
-        vertexInputAttributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        vertexInputAttributeDescriptions[1].offset = offsetof(Vertex, color);
-
-        return vertexInputAttributeDescriptions;
-    }
-};
-
-std::vector<Vertex> vertices =
-    {
-        Vertex({-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}),
-        Vertex({0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}),
-        Vertex({-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}),
-        Vertex({0.5f, -0.5f}, {1.0f, 1.0f, 1.0f})};
-
-std::vector<uint32_t> indices = {
-    0, 1, 2,
-    0, 3, 1};
-
-void printStats(VkPhysicalDevice &device)
-{
-    VkPhysicalDeviceProperties deviceProps;
-    vkGetPhysicalDeviceProperties(device, &deviceProps);
-
-    uint32_t apiVer = deviceProps.apiVersion;
-
-    std::cout << std::endl;
-    std::cout << std::endl;
-    std::cout << std::endl;
-
-    std::cout << "Name:                      " << deviceProps.deviceName << std::endl;
-    std::cout << "API Version:               " << VK_VERSION_MAJOR(apiVer) << "." << VK_VERSION_MINOR(apiVer) << "." << VK_VERSION_PATCH(apiVer) << std::endl;
-    std::cout << "Driver Version:            " << deviceProps.driverVersion << std::endl;
-    std::cout << "Vendor ID:                 " << deviceProps.vendorID << std::endl;
-    std::cout << "Device ID:                 " << deviceProps.deviceID << std::endl;
-    std::cout << "Device Type:               " << deviceProps.deviceType << std::endl;
-    std::cout << "Discrete Queue Priorities: " << deviceProps.limits.discreteQueuePriorities << std::endl;
-
-    VkPhysicalDeviceFeatures deviceFeatures;
-    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
-    std::cout << "Geometry Shader:    " << deviceFeatures.geometryShader << std::endl;
-
-    std::cout << std::endl;
-
-    VkPhysicalDeviceMemoryProperties deviceMemProps;
-    vkGetPhysicalDeviceMemoryProperties(device, &deviceMemProps);
-    std::cout << "Memory Type:        " << deviceMemProps.memoryTypes << std::endl;
-    std::cout << "Memory Heaps:       " << deviceMemProps.memoryHeaps << std::endl;
-
-    std::cout << std::endl;
-
-    uint32_t familyQueueCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &familyQueueCount, nullptr);
-    VkQueueFamilyProperties *familyProperties = new VkQueueFamilyProperties[familyQueueCount];
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &familyQueueCount, familyProperties);
-
-    std::cout << "Queue Family Count: " << familyQueueCount << std::endl;
-
-    for (int i = 0; i < familyQueueCount; i++)
-    {
-        std::cout << std::endl;
-        std::cout << "Queue Family # " << i << std::endl;
-        std::cout << "VK_QUEUE_GRAPHICS_BIT       " << ((familyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0) << std::endl;
-        std::cout << "VK_QUEUE_COMPUTE_BIT        " << ((familyProperties[i].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0) << std::endl;
-        std::cout << "VK_QUEUE_TRANSFER_BIT       " << ((familyProperties[i].queueFlags & VK_QUEUE_TRANSFER_BIT) != 0) << std::endl;
-        std::cout << "VK_QUEUE_SPARSE_BINDING_BIT " << ((familyProperties[i].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT) != 0) << std::endl;
-        std::cout << "Queue Count:          " << familyProperties[i].queueCount << std::endl;
-        std::cout << "Timestamp Valid Bits: " << familyProperties[i].timestampValidBits << std::endl;
-        uint32_t width = familyProperties[i].minImageTransferGranularity.width;
-        uint32_t height = familyProperties[i].minImageTransferGranularity.height;
-        uint32_t depth = familyProperties[i].minImageTransferGranularity.depth;
-        std::cout << "Min Image Timestamp Granularity : " << width << ", " << height << ", " << depth << std::endl;
-    }
-
-    VkSurfaceCapabilitiesKHR surfaceCapabilities;
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &surfaceCapabilities);
-    std::cout << std::endl;
-    std::cout << std::endl;
-    std::cout << std::endl;
-    std::cout << "Surface capabilities: " << std::endl;
-    std::cout << "      minImageCount: " << surfaceCapabilities.minImageCount << std::endl;
-    std::cout << "      maxImageCount: " << surfaceCapabilities.maxImageCount << std::endl;
-    std::cout << "      currentExtent: " << surfaceCapabilities.currentExtent.width << "/" << surfaceCapabilities.currentExtent.height << std::endl;
-    std::cout << "      minImageExtent: " << surfaceCapabilities.currentExtent.width << "/" << surfaceCapabilities.currentExtent.height << std::endl;
-    std::cout << "      maxImageExtent: " << surfaceCapabilities.currentExtent.width << "/" << surfaceCapabilities.currentExtent.height << std::endl;
-    std::cout << "      maxImageArrayLayers: " << surfaceCapabilities.maxImageArrayLayers << std::endl;
-    std::cout << "      supportedTransforms: " << surfaceCapabilities.supportedTransforms << std::endl;
-    std::cout << "      currentTransform: " << surfaceCapabilities.currentTransform << std::endl;
-    std::cout << "      supportedCompositeA: " << surfaceCapabilities.supportedCompositeAlpha << std::endl;
-    std::cout << "      supportedUsageFlags: " << surfaceCapabilities.supportedUsageFlags << std::endl;
-
-    uint32_t formateCount = 0;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formateCount, nullptr);
-    VkSurfaceFormatKHR *surfaceFormats = new VkSurfaceFormatKHR[formateCount];
-    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formateCount, surfaceFormats);
-
-    std::cout << std::endl;
-    std::cout << "Amount of Formats: " << formateCount << std::endl;
-
-    for (int i = 0; i < formateCount; i++)
-    {
-        std::cout << "Format: " << surfaceFormats[i].format << std::endl;
-    }
-
-    uint32_t presentationModeCount = 0;
-    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentationModeCount, nullptr);
-    VkPresentModeKHR *presentModes = new VkPresentModeKHR[presentationModeCount];
-    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentationModeCount, presentModes);
-
-    std::cout << std::endl;
-    std::cout << "Amount of Presentation Modes: " << presentationModeCount << std::endl;
-
-    for (int i = 0; i < presentationModeCount; i++)
-    {
-        std::cout << "Supported presentation mod: " << presentModes[i] << std::endl;
-    }
-
-    std::cout << std::endl;
-    delete[] familyProperties;
-    delete[] surfaceFormats;
-    delete[] presentModes;
-}
-
-std::vector<char> readFile(const std::string &fileName)
-{
-    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
-
-    if (file)
-    {
-        size_t fileSize = (size_t)file.tellg();
-        std::vector<char> fileBuffer(fileSize);
-        file.seekg(0);
-        file.read(fileBuffer.data(), fileSize);
-        file.close();
-        return fileBuffer;
-    }
-    else
-    {
-        throw std::runtime_error("Failed to open file!");
-    }
-}
-
-void recreateSwapchain();
-
-void windowResizeCallback(GLFWwindow *window, int w, int h)
-{
-    VkSurfaceCapabilitiesKHR surfaceCapabilities;
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevices[0], surface, &surfaceCapabilities);
-    if (w > surfaceCapabilities.maxImageExtent.width)
-        w = surfaceCapabilities.maxImageExtent.width;
-    if (h > surfaceCapabilities.maxImageExtent.height)
-        h = surfaceCapabilities.maxImageExtent.height;
-
-    if (w == 0 || h == 0)
-        return;
-
-    width = w;
-    height = h;
-
-    recreateSwapchain();
-}
-
-void initWindow()
-{
-    glfwInit();
-
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-
-    window = glfwCreateWindow(width, height, "Vulkan", nullptr, nullptr);
-    glfwSetWindowSizeCallback(window, windowResizeCallback);
-}
-
-void createShaderModule(const std::vector<char> &code, VkShaderModule *shaderModule)
-{
-    VkShaderModuleCreateInfo shaderCreateInfo;
-    shaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shaderCreateInfo.pNext = nullptr;
-    shaderCreateInfo.flags = 0;
-    shaderCreateInfo.codeSize = code.size();
-    shaderCreateInfo.pCode = (uint32_t *)code.data();
-
-    VkResult result = vkCreateShaderModule(device, &shaderCreateInfo, nullptr, shaderModule);
-    ASSERT_VULKAN(result);
-}
-
-void createInstance()
-{
-    VkApplicationInfo appInfo;
-    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-    appInfo.pNext = nullptr;
-    appInfo.pApplicationName = "Vulkan";
-    appInfo.applicationVersion = VK_MAKE_VERSION(0, 0, 0);
-    appInfo.pEngineName = "Vulkan Engine";
-    appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
-
-    const std::vector<const char *> validationLayers = {
-        "VK_LAYER_LUNARG_standard_validation"};
-
-    uint32_t glfwExtensionCount = 0;
-    auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    VkInstanceCreateInfo instanceInfo;
-    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-    instanceInfo.pNext = nullptr;
-    instanceInfo.flags = 0;
-    instanceInfo.pApplicationInfo = &appInfo;
-    instanceInfo.enabledLayerCount = validationLayers.size();
-    instanceInfo.ppEnabledLayerNames = validationLayers.data();
-    instanceInfo.enabledExtensionCount = glfwExtensionCount;
-    instanceInfo.ppEnabledExtensionNames = glfwExtensions;
-
-    VkResult result = vkCreateInstance(&instanceInfo, nullptr, &instance);
-    ASSERT_VULKAN(result);
-}
-
-void printInstanceLayers()
-{
-    uint32_t layerCount = 0;
-    vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
-    VkLayerProperties *layers = new VkLayerProperties[layerCount];
-    vkEnumerateInstanceLayerProperties(&layerCount, layers);
-
-    std::cout << std::endl;
-
-    std::cout << "Amount of Instance layers: " << layerCount << std::endl;
-
-    for (int i = 0; i < layerCount; i++)
-    {
-        std::cout << std::endl;
-        std::cout << "Name:         " << layers[i].layerName << std::endl;
-        std::cout << "Spec Version: " << layers[i].specVersion << std::endl;
-        std::cout << "Impl Version: " << layers[i].implementationVersion << std::endl;
-        std::cout << "Description:  " << layers[i].description << std::endl;
-    }
-
-    delete[] layers;
-}
-
-void printInstanceExtensions()
-{
-    uint32_t extensionCount = 0;
-    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
-    VkExtensionProperties *extensions = new VkExtensionProperties[extensionCount];
-    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions);
-
-    std::cout << std::endl;
-    std::cout << "Amount of Extensions: " << extensionCount << std::endl;
-
-    for (int i = 0; i < extensionCount; i++)
-    {
-        std::cout << std::endl;
-        std::cout << "Name:         " << extensions[i].extensionName << std::endl;
-        std::cout << "Spec Version: " << extensions[i].specVersion << std::endl;
-    }
-
-    delete[] extensions;
-}
-
-void createGlfwWindowSurface()
-{
-    VkResult result = glfwCreateWindowSurface(instance, window, nullptr, &surface);
-    ASSERT_VULKAN(result);
-}
-
-std::vector<VkPhysicalDevice> getAllPhysicalDevices()
-{
-    uint32_t deviceCount = 0;
-    VkResult result = vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
-    ASSERT_VULKAN(result);
-
-    std::vector<VkPhysicalDevice> physicalDevices;
-    physicalDevices.resize(deviceCount);
-
-    result = vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data());
-    ASSERT_VULKAN(result);
-
-    return physicalDevices;
-}
-
-void printPhysicalDeviceStats()
-{
-    for (int i = 0; i < physicalDevices.size(); i++)
-    {
-        printStats(physicalDevices[i]);
-    }
-}
-
-void createLogicalDevice()
-{
-    float queuPrios[] = {1.0f, 1.0f, 1.0f, 1.0f};
-
-    VkDeviceQueueCreateInfo deviceQueueCreateInfo;
-    deviceQueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    deviceQueueCreateInfo.pNext = nullptr;
-    deviceQueueCreateInfo.flags = 0;
-    deviceQueueCreateInfo.queueFamilyIndex = 0; //TODO: Choose correct family index
-    deviceQueueCreateInfo.queueCount = 1;       //TODO:
-    deviceQueueCreateInfo.pQueuePriorities = queuPrios;
-
-    VkPhysicalDeviceFeatures usedFeatures = {};
-
-    const std::vector<const char *> deviceExtensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME};
-
-    VkDeviceCreateInfo deviceCreateInfo;
-    deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    deviceCreateInfo.pNext = nullptr;
-    deviceCreateInfo.flags = 0;
-    deviceCreateInfo.queueCreateInfoCount = 1;
-    deviceCreateInfo.pQueueCreateInfos = &deviceQueueCreateInfo;
-    deviceCreateInfo.enabledLayerCount = 0;
-    deviceCreateInfo.ppEnabledLayerNames = nullptr;
-    deviceCreateInfo.enabledExtensionCount = deviceExtensions.size();
-    deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
-    deviceCreateInfo.pEnabledFeatures = &usedFeatures;
-
-    //TODO: Pick best device, not first device.
-    VkResult result = vkCreateDevice(physicalDevices[0], &deviceCreateInfo, nullptr, &device);
-    ASSERT_VULKAN(result);
-}
-
-void createQueue()
-{
-    vkGetDeviceQueue(device, 0, 0, &queue);
-}
-
-void checkSurfaceSupport()
-{
-    VkBool32 surfaceSupport = false;
-    VkResult result = vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevices[0], 0, surface, &surfaceSupport);
-    ASSERT_VULKAN(result);
-
-    if (!surfaceSupport)
-    {
-        std::cerr << "Surface not supported!" << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
-
-void createSwapchain()
-{
-    VkSwapchainCreateInfoKHR swapChainCreateInfo;
-    swapChainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    swapChainCreateInfo.pNext = nullptr;
-    swapChainCreateInfo.flags = 0;
-    swapChainCreateInfo.surface = surface;
-    swapChainCreateInfo.minImageCount = 3;                                   //TODO: civ
-    swapChainCreateInfo.imageFormat = format;                                //TODO: civ
-    swapChainCreateInfo.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR; //TODO: civ
-    swapChainCreateInfo.imageExtent = VkExtent2D{width, height};
-    swapChainCreateInfo.imageArrayLayers = 1;
-    swapChainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    swapChainCreateInfo.queueFamilyIndexCount = 0;
-    swapChainCreateInfo.pQueueFamilyIndices = nullptr;
-    swapChainCreateInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
-    swapChainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    swapChainCreateInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
-    swapChainCreateInfo.clipped = VK_TRUE;
-    swapChainCreateInfo.oldSwapchain = swapchain;
-
-    VkResult result = vkCreateSwapchainKHR(device, &swapChainCreateInfo, nullptr, &swapchain);
-    ASSERT_VULKAN(result);
-}
-
-void createImageViews()
-{
-    vkGetSwapchainImagesKHR(device, swapchain, &swapchainImageCount, nullptr);
-    VkImage *swapchainImages = new VkImage[swapchainImageCount];
-    VkResult result = vkGetSwapchainImagesKHR(device, swapchain, &swapchainImageCount, swapchainImages);
-    ASSERT_VULKAN(result);
-
-    imageViews = new VkImageView[swapchainImageCount];
-
-    for (int i = 0; i < swapchainImageCount; i++)
-    {
-        VkImageViewCreateInfo imageViewCreateInfo;
-        imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        imageViewCreateInfo.pNext = nullptr;
-        imageViewCreateInfo.flags = 0;
-        imageViewCreateInfo.image = swapchainImages[i];
-        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        imageViewCreateInfo.format = format;
-        imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-        imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-        imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-        imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-        imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-        imageViewCreateInfo.subresourceRange.levelCount = 1;
-        imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-        imageViewCreateInfo.subresourceRange.layerCount = 1;
-
-        result = vkCreateImageView(device, &imageViewCreateInfo, nullptr, &imageViews[i]);
-        ASSERT_VULKAN(result);
-    }
-
-    delete[] swapchainImages;
-}
-
-void createRenderPass()
-{
-    VkAttachmentDescription attachmentDescription;
-    attachmentDescription.flags = 0;
-    attachmentDescription.format = format;
-    attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-    attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference attachmentReference;
-    attachmentReference.attachment = 0;
-    attachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpassDescription;
-    subpassDescription.flags = 0;
-    subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpassDescription.inputAttachmentCount = 0;
-    subpassDescription.pInputAttachments = nullptr;
-    subpassDescription.colorAttachmentCount = 1;
-    subpassDescription.pColorAttachments = &attachmentReference;
-    subpassDescription.pResolveAttachments = nullptr;
-    subpassDescription.pDepthStencilAttachment = nullptr;
-    subpassDescription.preserveAttachmentCount = 0;
-    subpassDescription.pPreserveAttachments = nullptr;
-
-    VkSubpassDependency subpassDependency;
-    subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    subpassDependency.dstSubpass = 0;
-    subpassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependency.srcAccessMask = 0;
-    subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    subpassDependency.dependencyFlags = 0;
-
-    VkRenderPassCreateInfo renderPassCreateInfo;
-    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassCreateInfo.pNext = nullptr;
-    renderPassCreateInfo.flags = 0;
-    renderPassCreateInfo.attachmentCount = 1;
-    renderPassCreateInfo.pAttachments = &attachmentDescription;
-    renderPassCreateInfo.subpassCount = 1;
-    renderPassCreateInfo.pSubpasses = &subpassDescription;
-    renderPassCreateInfo.dependencyCount = 1;
-    renderPassCreateInfo.pDependencies = &subpassDependency;
-
-    VkResult result = vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass);
-    ASSERT_VULKAN(result);
-}
-
-void createDescriptorSetLayout()
-{
-    VkDescriptorSetLayoutBinding descriptorSetLayoutBinding;
-    descriptorSetLayoutBinding.binding = 0;
-    descriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    descriptorSetLayoutBinding.descriptorCount = 1;
-    descriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    descriptorSetLayoutBinding.pImmutableSamplers = nullptr;
-
-    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
-    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptorSetLayoutCreateInfo.pNext = nullptr;
-    descriptorSetLayoutCreateInfo.flags = 0;
-    descriptorSetLayoutCreateInfo.bindingCount = 1;
-    descriptorSetLayoutCreateInfo.pBindings = &descriptorSetLayoutBinding;
-
-    VkResult result = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout);
-    ASSERT_VULKAN(result);
-}
-
-void createPipeline()
-{
-    auto shaderCodeVert = readFile("vert.spv");
-    auto shaderCodeFrag = readFile("frag.spv");
-
-    createShaderModule(shaderCodeVert, &shaderModuleVert);
-    createShaderModule(shaderCodeFrag, &shaderModuleFrag);
-
-    VkPipelineShaderStageCreateInfo shaderStageCreateInfoVert;
-    shaderStageCreateInfoVert.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStageCreateInfoVert.pNext = nullptr;
-    shaderStageCreateInfoVert.flags = 0;
-    shaderStageCreateInfoVert.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    shaderStageCreateInfoVert.module = shaderModuleVert;
-    shaderStageCreateInfoVert.pName = "main";
-    shaderStageCreateInfoVert.pSpecializationInfo = nullptr;
-
-    VkPipelineShaderStageCreateInfo shaderStageCreateInfoFrag;
-    shaderStageCreateInfoFrag.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStageCreateInfoFrag.pNext = nullptr;
-    shaderStageCreateInfoFrag.flags = 0;
-    shaderStageCreateInfoFrag.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shaderStageCreateInfoFrag.module = shaderModuleFrag;
-    shaderStageCreateInfoFrag.pName = "main";
-    shaderStageCreateInfoFrag.pSpecializationInfo = nullptr;
-
-    VkPipelineShaderStageCreateInfo shaderStages[] = {shaderStageCreateInfoVert, shaderStageCreateInfoFrag};
-
-    auto vertexBindingDescription = Vertex::getBindingDescription();
-    auto vertexAttributeDescriptions = Vertex::getAttributeDescriptions();
-
-    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo;
-    vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputStateCreateInfo.pNext = nullptr;
-    vertexInputStateCreateInfo.flags = 0;
-    vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
-    vertexInputStateCreateInfo.pVertexBindingDescriptions = &vertexBindingDescription;
-    vertexInputStateCreateInfo.vertexAttributeDescriptionCount = vertexAttributeDescriptions.size();
-    vertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexAttributeDescriptions.data();
-
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo;
-    inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssemblyCreateInfo.pNext = nullptr;
-    inputAssemblyCreateInfo.flags = 0;
-    inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
-
-    VkViewport viewport;
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = width;
-    viewport.height = height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor;
-    scissor.offset = {0, 0};
-    scissor.extent = {width, height};
-
-    VkPipelineViewportStateCreateInfo viewportStateCreateInfo;
-    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportStateCreateInfo.pNext = nullptr;
-    viewportStateCreateInfo.flags = 0;
-    viewportStateCreateInfo.viewportCount = 1;
-    viewportStateCreateInfo.pViewports = &viewport;
-    viewportStateCreateInfo.scissorCount = 1;
-    viewportStateCreateInfo.pScissors = &scissor;
-
-    VkPipelineRasterizationStateCreateInfo rasterizationCreateInfo;
-    rasterizationCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizationCreateInfo.pNext = nullptr;
-    rasterizationCreateInfo.flags = 0;
-    rasterizationCreateInfo.depthClampEnable = VK_FALSE;
-    rasterizationCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-    rasterizationCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizationCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizationCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterizationCreateInfo.depthBiasEnable = VK_FALSE;
-    rasterizationCreateInfo.depthBiasConstantFactor = 0.0f;
-    rasterizationCreateInfo.depthBiasClamp = 0.0f;
-    rasterizationCreateInfo.depthBiasSlopeFactor = 0.0f;
-    rasterizationCreateInfo.lineWidth = 1.0f;
-
-    VkPipelineMultisampleStateCreateInfo multisampleCreateInfo;
-    multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampleCreateInfo.pNext = nullptr;
-    multisampleCreateInfo.flags = 0;
-    multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
-    multisampleCreateInfo.minSampleShading = 1.0f;
-    multisampleCreateInfo.pSampleMask = nullptr;
-    multisampleCreateInfo.alphaToCoverageEnable = VK_FALSE;
-    multisampleCreateInfo.alphaToOneEnable = VK_FALSE;
-
-    VkPipelineColorBlendAttachmentState colorBlendAttachmentState;
-    colorBlendAttachmentState.blendEnable = VK_TRUE;
-    colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-    VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo;
-    colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlendStateCreateInfo.pNext = nullptr;
-    colorBlendStateCreateInfo.flags = 0;
-    colorBlendStateCreateInfo.logicOpEnable = VK_FALSE;
-    colorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_NO_OP;
-    colorBlendStateCreateInfo.attachmentCount = 1;
-    colorBlendStateCreateInfo.pAttachments = &colorBlendAttachmentState;
-    colorBlendStateCreateInfo.blendConstants[0] = 0.0f;
-    colorBlendStateCreateInfo.blendConstants[1] = 0.0f;
-    colorBlendStateCreateInfo.blendConstants[2] = 0.0f;
-    colorBlendStateCreateInfo.blendConstants[3] = 0.0f;
-
-    VkDynamicState dynamicStates[] = {
-        VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_SCISSOR};
-
-    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo;
-    dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicStateCreateInfo.pNext = nullptr;
-    dynamicStateCreateInfo.flags = 0;
-    dynamicStateCreateInfo.dynamicStateCount = 2;
-    dynamicStateCreateInfo.pDynamicStates = dynamicStates;
-
-    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
-    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutCreateInfo.pNext = nullptr;
-    pipelineLayoutCreateInfo.flags = 0;
-    pipelineLayoutCreateInfo.setLayoutCount = 1;
-    pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
-    pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-    pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
-
-    VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
-    ASSERT_VULKAN(result);
-
-    VkGraphicsPipelineCreateInfo pipelineCreateInfo;
-    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineCreateInfo.pNext = nullptr;
-    pipelineCreateInfo.flags = 0;
-    pipelineCreateInfo.stageCount = 2;
-    pipelineCreateInfo.pStages = shaderStages;
-    pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
-    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
-    pipelineCreateInfo.pTessellationState = nullptr;
-    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-    pipelineCreateInfo.pRasterizationState = &rasterizationCreateInfo;
-    pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = nullptr;
-    pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
-    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
-    pipelineCreateInfo.layout = pipelineLayout;
-    pipelineCreateInfo.renderPass = renderPass;
-    pipelineCreateInfo.subpass = 0;
-    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
-    pipelineCreateInfo.basePipelineIndex = 0;
-
-    result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline);
-    ASSERT_VULKAN(result);
-}
-
-void createFramebuffers()
-{
-    framebuffers = new VkFramebuffer[swapchainImageCount];
-    for (int i = 0; i < swapchainImageCount; i++)
-    {
-        VkFramebufferCreateInfo frameBufferCreateInfo;
-        frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        frameBufferCreateInfo.pNext = nullptr;
-        frameBufferCreateInfo.flags = 0;
-        frameBufferCreateInfo.renderPass = renderPass;
-        frameBufferCreateInfo.attachmentCount = 1;
-        frameBufferCreateInfo.pAttachments = &(imageViews[i]);
-        frameBufferCreateInfo.width = width;
-        frameBufferCreateInfo.height = height;
-        frameBufferCreateInfo.layers = 1;
-
-        VkResult result = vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &(framebuffers[i]));
-        ASSERT_VULKAN(result);
-    }
-}
-
-void createCommandPool()
-{
-    VkCommandPoolCreateInfo commandPoolCreateInfo;
-    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    commandPoolCreateInfo.pNext = nullptr;
-    commandPoolCreateInfo.flags = 0;
-    commandPoolCreateInfo.queueFamilyIndex = 0;
-
-    VkResult result = vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool);
-    ASSERT_VULKAN(result);
-}
-
-void createCommandBuffers()
-{
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo;
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.pNext = nullptr;
-    commandBufferAllocateInfo.commandPool = commandPool;
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferAllocateInfo.commandBufferCount = swapchainImageCount;
-
-    commandBuffers = new VkCommandBuffer[swapchainImageCount];
-    VkResult result = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, commandBuffers);
-    ASSERT_VULKAN(result);
-}
-
-uint32_t getMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+int main(int argc, char const *argv[])
 {
-    VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevices[0], &physicalDeviceMemoryProperties);
-    for (int i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; i++)
+    for (int i = 1; i < argc; i++)
     {
-        if ((typeFilter & (1 << i)) && (physicalDeviceMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        std::string argument = argv[i];
+        if (argument == "--particle-benchmark")
         {
-            return i;
+            particleBenchmark = true;
+        }
+        else if (argument == "--capture" && i + 1 < argc)
+        {
+            frameCaptureSettings.enabled = true;
+            frameCaptureSettings.directory = argv[++i];
+        }
+        else if (argument == "--capture-frames" && i + 1 < argc)
+        {
+            frameCaptureSettings.frameCount = std::stoul(argv[++i]);
+        }
+        else if (argument == "--fixed-timestep" && i + 1 < argc)
+        {
+            simulationSettings.tickSeconds = std::stof(argv[++i]);
+            simulationSettings.lockstep = true;
+        }
+        else if (argument == "--scene" && i + 1 < argc)
+        {
+            sceneFileName = argv[++i];
+        }
+        else if (argument == "--lights" && i + 1 < argc)
+        {
+            lightingSettings.lightCount = std::min((uint32_t)std::stoul(argv[++i]), (uint32_t)MAX_LIGHTS);
+        }
+        else if (argument == "--light-benchmark")
+        {
+            lightBenchmark = true;
+        }
+        else if (argument == "--stats-overlay")
+        {
+            frameStatsSettings.overlay = true;
+        }
+        else if (argument == "--stats-export" && i + 1 < argc)
+        {
+            frameStatsSettings.exportFileName = argv[++i];
+        }
+        else if (argument == "--render-scale" && i + 1 < argc)
+        {
+            setRenderScale(std::stof(argv[++i]));
+        }
+        else if (argument == "--target-frame-ms" && i + 1 < argc)
+        {
+            dynamicResolutionSettings.targetMilliseconds = std::stof(argv[++i]);
+        }
+        else if (argument == "--stress-scene" && i + 3 < argc)
+        {
+            stressSceneSettings.meshCount = std::stoul(argv[++i]);
+            stressSceneSettings.instanceCount = std::stoul(argv[++i]);
+            stressSceneSettings.materialCount = std::stoul(argv[++i]);
+        }
+        else if (argument == "--no-vsync")
+        {
+            vsync = false;
         }
     }
 
-    throw std::runtime_error("Found no correct memory type!");
-}
-
-void createBuffer(VkDeviceSize deviceSize, VkBufferUsageFlags bufferUsageFlags, VkBuffer &buffer, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceMemory &deviceMemory)
-{
-    VkBufferCreateInfo bufferCreateInfo;
-    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferCreateInfo.pNext = nullptr;
-    bufferCreateInfo.flags = 0;
-    bufferCreateInfo.size = deviceSize;
-    bufferCreateInfo.usage = bufferUsageFlags;
-    bufferCreateInfo.sharingMode = VK_SHARING_MODE_BEGIN_RANGE;
-    bufferCreateInfo.queueFamilyIndexCount = 0;
-    bufferCreateInfo.pQueueFamilyIndices = nullptr;
-
-    VkResult result = vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer);
-    ASSERT_VULKAN(result);
-
-    VkMemoryRequirements memoryRequirements;
-    vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
-
-    VkMemoryAllocateInfo memoryAllocateInfo;
-    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memoryAllocateInfo.pNext = nullptr;
-    memoryAllocateInfo.allocationSize = memoryRequirements.size;
-    memoryAllocateInfo.memoryTypeIndex = getMemoryTypeIndex(memoryRequirements.memoryTypeBits, memoryPropertyFlags);
-
-    result = vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &deviceMemory);
-    ASSERT_VULKAN(result);
-
-    vkBindBufferMemory(device, buffer, deviceMemory, 0);
-}
-
-void copyBuffer(VkBuffer src, VkBuffer dest, VkDeviceSize size)
-{
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo;
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.pNext = nullptr;
-    commandBufferAllocateInfo.commandPool = commandPool;
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferAllocateInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    VkResult result = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer);
-    ASSERT_VULKAN(result);
-
-    VkCommandBufferBeginInfo commandBufferBeginInfo;
-    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    commandBufferBeginInfo.pNext = nullptr;
-    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    commandBufferBeginInfo.pInheritanceInfo = nullptr;
-
-    result = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
-    ASSERT_VULKAN(result);
-
-    VkBufferCopy bufferCopy;
-    bufferCopy.srcOffset = 0;
-    bufferCopy.dstOffset = 0;
-    bufferCopy.size = size;
-    vkCmdCopyBuffer(commandBuffer, src, dest, 1, &bufferCopy);
-
-    result = vkEndCommandBuffer(commandBuffer);
-    ASSERT_VULKAN(result);
-
-    VkSubmitInfo submitInfo;
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pNext = nullptr;
-    submitInfo.waitSemaphoreCount = 0;
-    submitInfo.pWaitSemaphores = nullptr;
-    submitInfo.pWaitDstStageMask = 0;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-    submitInfo.signalSemaphoreCount = 0;
-    submitInfo.pSignalSemaphores = nullptr;
-
-    result = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-    ASSERT_VULKAN(result);
-
-    vkQueueWaitIdle(queue);
-
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-}
-
-template <typename T>
-void createAndUploadBuffer(std::vector<T> data, VkBufferUsageFlags usage, VkBuffer &buffer, VkDeviceMemory &deviceMemory)
-{
-    VkDeviceSize bufferSize = sizeof(T) * data.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, stagingBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBufferMemory);
-
-    void *memory;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &memory);
-    memcpy(memory, data.data(), bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    createBuffer(bufferSize, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, deviceMemory);
-
-    copyBuffer(stagingBuffer, buffer, bufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
-}
-
-void createVertexBuffer()
-{
-    createAndUploadBuffer(vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexBufferDeviceMemory);
-}
-
-void createIndexBuffer()
-{
-    createAndUploadBuffer(indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBufer, indexBufferDeviceMemory);
-}
-
-void createUniformBuffer()
-{
-    VkDeviceSize bufferSize = sizeof(MVP);
-    createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, uniformBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBufferDeviceMemory);
-}
-
-void createDescriptorPool()
-{
-    VkDescriptorPoolSize descriptorPoolSize;
-    descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    descriptorPoolSize.descriptorCount = 1;
-
-    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
-    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descriptorPoolCreateInfo.pNext = nullptr;
-    descriptorPoolCreateInfo.flags = 0;
-    descriptorPoolCreateInfo.maxSets = 1;
-    descriptorPoolCreateInfo.poolSizeCount = 1;
-    descriptorPoolCreateInfo.pPoolSizes = &descriptorPoolSize;
-
-    VkResult result = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool);
-    ASSERT_VULKAN(result);
-}
-
-void createDescriptorSet()
-{
-    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
-    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptorSetAllocateInfo.pNext = nullptr;
-    descriptorSetAllocateInfo.descriptorPool = descriptorPool;
-    descriptorSetAllocateInfo.descriptorSetCount = 1;
-    descriptorSetAllocateInfo.pSetLayouts = &descriptorSetLayout;
-
-    VkResult result = vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet);
-    ASSERT_VULKAN(result);
-
-    VkDescriptorBufferInfo descriptorBufferInfo;
-    descriptorBufferInfo.buffer = uniformBuffer;
-    descriptorBufferInfo.offset = 0;
-    descriptorBufferInfo.range = sizeof(MVP);
-
-    VkWriteDescriptorSet descriptorWrite;
-    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrite.pNext = nullptr;
-    descriptorWrite.dstSet = descriptorSet;
-    descriptorWrite.dstBinding = 0;
-    descriptorWrite.dstArrayElement = 0;
-    descriptorWrite.descriptorCount = 1;
-    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    descriptorWrite.pImageInfo = nullptr;
-    descriptorWrite.pBufferInfo = &descriptorBufferInfo;
-    descriptorWrite.pTexelBufferView = nullptr;
-
-    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
-}
-
-void recordCommandBuffers()
-{
-    VkCommandBufferBeginInfo commandBufferBeginInfo;
-    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    commandBufferBeginInfo.pNext = nullptr;
-    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-    commandBufferBeginInfo.pInheritanceInfo = nullptr;
-
-    for (int i = 0; i < swapchainImageCount; i++)
-    {
-        VkResult result = vkBeginCommandBuffer(commandBuffers[i], &commandBufferBeginInfo);
-        ASSERT_VULKAN(result);
-
-        VkRenderPassBeginInfo renderPassBeginInfo;
-        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassBeginInfo.pNext = nullptr;
-        renderPassBeginInfo.renderPass = renderPass;
-        renderPassBeginInfo.framebuffer = framebuffers[i];
-        renderPassBeginInfo.renderArea.offset = {0, 0};
-        renderPassBeginInfo.renderArea.extent = {width, height};
-        VkClearValue clearValue = {0.0f, 0.15f, 0.3f, 1.0f};
-        renderPassBeginInfo.clearValueCount = 1;
-        renderPassBeginInfo.pClearValues = &clearValue;
-
-        vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-
-        VkViewport viewport;
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = width;
-        viewport.height = height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
-
-        VkRect2D scissor;
-        scissor.offset = {0, 0};
-        scissor.extent = {width, height};
-        vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
-
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, &vertexBuffer, offsets);
-        vkCmdBindIndexBuffer(commandBuffers[i], indexBufer, 0, VK_INDEX_TYPE_UINT32);
-
-        vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-
-        //vkCmdDraw(commandBuffers[i], vertices.size(), 1, 0, 0);
-        vkCmdDrawIndexed(commandBuffers[i], indices.size(), 1, 0, 0, 0);
-
-        vkCmdEndRenderPass(commandBuffers[i]);
-
-        result = vkEndCommandBuffer(commandBuffers[i]);
-        ASSERT_VULKAN(result);
-    }
-}
-
-void createSemaphores()
-{
-    VkSemaphoreCreateInfo semaphoreCreateInfo;
-    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    semaphoreCreateInfo.pNext = nullptr;
-    semaphoreCreateInfo.flags = 0;
-
-    VkResult result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphoreImageAvailable);
-    ASSERT_VULKAN(result);
-    result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphoreRenderingDone);
-    ASSERT_VULKAN(result);
-}
-
-void initVulkan()
-{
-
-    createInstance();
-    physicalDevices = getAllPhysicalDevices();
-    printInstanceLayers();
-    printInstanceExtensions();
-    createGlfwWindowSurface();
-    printPhysicalDeviceStats();
-    createLogicalDevice();
-    createQueue();
-    checkSurfaceSupport();
-    createSwapchain();
-    createImageViews();
-    createRenderPass();
-    createDescriptorSetLayout();
-    createPipeline();
-    createFramebuffers();
-    createCommandPool();
-    createCommandBuffers();
-    createVertexBuffer();
-    createIndexBuffer();
-    createUniformBuffer();
-    createDescriptorPool();
-    createDescriptorSet();
-    recordCommandBuffers();
-    createSemaphores();
-}
-
-void recreateSwapchain()
-{
-    vkDeviceWaitIdle(device);
-
-    vkFreeCommandBuffers(device, commandPool, swapchainImageCount, commandBuffers);
-    delete[] commandBuffers;
-    vkDestroyCommandPool(device, commandPool, nullptr);
-    for (int i = 0; i < swapchainImageCount; i++)
-    {
-        vkDestroyFramebuffer(device, framebuffers[i], nullptr);
-    }
-    delete[] framebuffers;
-    //vkDestroyPipeline(device, pipeline, nullptr);
-    vkDestroyRenderPass(device, renderPass, nullptr);
-    for (int i = 0; i < swapchainImageCount; i++)
-    {
-        vkDestroyImageView(device, imageViews[i], nullptr);
-    }
-    delete[] imageViews;
-    //vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-    //vkDestroyShaderModule(device, shaderModuleVert, nullptr);
-    //vkDestroyShaderModule(device, shaderModuleFrag, nullptr);
-
-    VkSwapchainKHR oldSwapchain = swapchain;
-
-    createSwapchain();
-    createImageViews();
-    createRenderPass();
-    //createPipeline();
-    createFramebuffers();
-    createCommandPool();
-    createCommandBuffers();
-    recordCommandBuffers();
-
-    vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
-}
-
-void drawFrame()
-{
-    uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(device, swapchain, std::numeric_limits<uint64_t>::max(), semaphoreImageAvailable, VK_NULL_HANDLE, &imageIndex);
-
-    if (result == VK_ERROR_OUT_OF_DATE_KHR)
-    {
-        recreateSwapchain();
-        return;
-    }
-
-    VkSubmitInfo submitInfo;
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pNext = nullptr;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &semaphoreImageAvailable;
-    VkPipelineStageFlags waitStageMask[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.pWaitDstStageMask = waitStageMask;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &(commandBuffers[imageIndex]);
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &semaphoreRenderingDone;
-
-    result = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-    ASSERT_VULKAN(result);
-
-    VkPresentInfoKHR presentInfo;
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.pNext = nullptr;
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = &semaphoreRenderingDone;
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = &swapchain;
-    presentInfo.pImageIndices = &imageIndex;
-    presentInfo.pResults = nullptr;
-
-    result = vkQueuePresentKHR(queue, &presentInfo);
-    ASSERT_VULKAN(result);
-}
-
-auto gameStart = std::chrono::high_resolution_clock::now();
-void updateMVP()
-{
-    auto frameTime = std::chrono::high_resolution_clock::now();
-
-    float timeSinceStart = std::chrono::duration_cast<std::chrono::milliseconds>(frameTime - gameStart).count() / 1000.0f;
-
-    glm::mat4 model = glm::rotate(glm::mat4(1), timeSinceStart * glm::radians(30.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    glm::mat4 view = glm::lookAt(glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    glm::mat4 projection = glm::perspective(glm::radians(60.0f), width / (float)height, 0.01f, 10.0f);
-    projection[1][1] *= -1;
-
-    MVP = projection * view * model;
-
-    void *memory;
-    vkMapMemory(device, uniformBufferDeviceMemory, 0, sizeof(MVP), 0, &memory);
-    memcpy(memory, &MVP, sizeof(MVP));
-    vkUnmapMemory(device, uniformBufferDeviceMemory);
-}
-
-void gameLoop()
-{
-    while (!glfwWindowShouldClose(window))
-    {
-        glfwPollEvents();
-
-        updateMVP();
-
-        drawFrame();
-    }
-}
-
-void shutDownVulkan()
-{
-    vkDeviceWaitIdle(device);
-
-    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-    vkFreeMemory(device, uniformBufferDeviceMemory, nullptr);
-    vkDestroyBuffer(device, uniformBuffer, nullptr);
-
-    vkFreeMemory(device, indexBufferDeviceMemory, nullptr);
-    vkDestroyBuffer(device, indexBufer, nullptr);
-
-    vkFreeMemory(device, vertexBufferDeviceMemory, nullptr);
-    vkDestroyBuffer(device, vertexBuffer, nullptr);
-
-    vkDestroySemaphore(device, semaphoreImageAvailable, nullptr);
-    vkDestroySemaphore(device, semaphoreRenderingDone, nullptr);
-
-    vkFreeCommandBuffers(device, commandPool, swapchainImageCount, commandBuffers);
-    delete[] commandBuffers;
-
-    vkDestroyCommandPool(device, commandPool, nullptr);
-
-    for (int i = 0; i < swapchainImageCount; i++)
-    {
-        vkDestroyFramebuffer(device, framebuffers[i], nullptr);
-    }
-    delete[] framebuffers;
-
-    vkDestroyPipeline(device, pipeline, nullptr);
-    vkDestroyRenderPass(device, renderPass, nullptr);
-
-    for (int i = 0; i < swapchainImageCount; i++)
+    // Captures are compared against each other, so they must not depend on
+    // how fast frames were rendered.
+    if (frameCaptureSettings.enabled && !simulationSettings.lockstep)
     {
-        vkDestroyImageView(device, imageViews[i], nullptr);
+        simulationSettings.tickSeconds = 1.0f / 60.0f;
+        simulationSettings.lockstep = true;
     }
-    delete[] imageViews;
+    if (frameCaptureSettings.enabled)
+        dynamicResolutionSettings.enabled = false;
 
-    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    // Enough emission to keep the buffer full, given the average lifetime of
+    // three quarters of the maximum.
+    if (particleBenchmark)
+        particleSettings.emitRate = particleSettings.capacity / (particleSettings.lifetime * 0.75f);
 
-    vkDestroyShaderModule(device, shaderModuleVert, nullptr);
-    vkDestroyShaderModule(device, shaderModuleFrag, nullptr);
-
-    vkDestroySwapchainKHR(device, swapchain, nullptr);
-    vkDestroyDevice(device, nullptr);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
-    vkDestroyInstance(instance, nullptr);
-}
-
-void shutDownWindow()
-{
-    glfwDestroyWindow(window);
-
-    glfwTerminate();
-}
-
-int main(int argc, char const *argv[])
-{
     initWindow();
     initVulkan();
     gameLoop();
@@ -1228,4 +94,4 @@ int main(int argc, char const *argv[])
     shutDownWindow();
 
     return 0;
-}
\ No newline at end of file
+}
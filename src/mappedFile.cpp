@@ -0,0 +1,67 @@
+#include "mappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile()
+    : mappedData(nullptr), mappedSize(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string &fileName)
+{
+    close();
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+        return false;
+
+    mappedData = (const uint8_t *)mapping;
+    mappedSize = fileStat.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mappedData != nullptr)
+    {
+        munmap((void *)mappedData, mappedSize);
+        mappedData = nullptr;
+        mappedSize = 0;
+    }
+}
+
+bool MappedFile::isOpen() const
+{
+    return mappedData != nullptr;
+}
+
+const uint8_t *MappedFile::data() const
+{
+    return mappedData;
+}
+
+size_t MappedFile::size() const
+{
+    return mappedSize;
+}
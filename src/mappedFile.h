@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+  public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &fileName);
+    void close();
+
+    bool isOpen() const;
+    const uint8_t *data() const;
+    size_t size() const;
+
+  private:
+    const uint8_t *mappedData;
+    size_t mappedSize;
+};
@@ -0,0 +1,223 @@
+#include "memoryBudget.h"
+#include "deletionQueue.h"
+#include "frameStats.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+MemoryBudgetSettings memoryBudgetSettings;
+
+struct Allocation
+{
+    uint32_t heapIndex;
+    VkDeviceSize size;
+};
+
+static VkPhysicalDeviceMemoryProperties memoryProperties;
+static std::vector<HeapBudget> heapBudgets;
+// Driver usage and our own allocations as of the last query, see HeapBudget.
+static std::vector<VkDeviceSize> queriedUsages;
+static std::vector<VkDeviceSize> queriedAllocations;
+static std::map<VkDeviceMemory, Allocation> allocations;
+
+static std::vector<MemoryEvictor> evictors;
+// Evicted memory is freed frames later, evicting again before that would
+// evict twice for the same overshoot.
+static uint32_t evictionCooldown = 0;
+static uint64_t residencyFrame = 0;
+
+static void queryHeapBudgets()
+{
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudgetProperties = {};
+    memoryBudgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    memoryBudgetProperties.pNext = nullptr;
+
+    if (deviceCapabilities.memoryBudget)
+    {
+        VkPhysicalDeviceMemoryProperties2 memoryProperties2;
+        memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memoryProperties2.pNext = &memoryBudgetProperties;
+        getPhysicalDeviceMemoryProperties2(physicalDevices[0], &memoryProperties2);
+    }
+
+    for (uint32_t i = 0; i < heapBudgets.size(); i++)
+    {
+        HeapBudget &heapBudget = heapBudgets[i];
+        if (deviceCapabilities.memoryBudget)
+        {
+            heapBudget.budget = memoryBudgetProperties.heapBudget[i];
+            queriedUsages[i] = memoryBudgetProperties.heapUsage[i];
+        }
+        else
+        {
+            heapBudget.budget = (VkDeviceSize)(heapBudget.size * memoryBudgetSettings.fallbackBudget);
+            queriedUsages[i] = heapBudget.allocated;
+        }
+        queriedAllocations[i] = heapBudget.allocated;
+        heapBudget.usage = queriedUsages[i];
+    }
+}
+
+static void updateHeapUsage(uint32_t heapIndex)
+{
+    HeapBudget &heapBudget = heapBudgets[heapIndex];
+    if (heapBudget.allocated + queriedUsages[heapIndex] >= queriedAllocations[heapIndex])
+        heapBudget.usage = heapBudget.allocated + queriedUsages[heapIndex] - queriedAllocations[heapIndex];
+    else
+        heapBudget.usage = 0;
+}
+
+static VkDeviceSize getTargetUsage(const HeapBudget &heapBudget)
+{
+    return (VkDeviceSize)(heapBudget.budget * memoryBudgetSettings.targetUsage);
+}
+
+static VkDeviceSize evict(VkDeviceSize bytes, EvictionReason reason)
+{
+    VkDeviceSize released = 0;
+    for (MemoryEvictor &evictor : evictors)
+    {
+        if (released >= bytes)
+            break;
+        released += evictor(bytes - released, reason);
+    }
+    return released;
+}
+
+void initMemoryBudget()
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevices[0], &memoryProperties);
+
+    heapBudgets.resize(memoryProperties.memoryHeapCount);
+    queriedUsages.resize(memoryProperties.memoryHeapCount);
+    queriedAllocations.resize(memoryProperties.memoryHeapCount);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+    {
+        heapBudgets[i].size = memoryProperties.memoryHeaps[i].size;
+        heapBudgets[i].allocated = 0;
+        heapBudgets[i].deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+
+    queryHeapBudgets();
+}
+
+void updateMemoryBudget()
+{
+    residencyFrame++;
+    queryHeapBudgets();
+
+    if (evictionCooldown > 0)
+    {
+        evictionCooldown--;
+        return;
+    }
+
+    VkDeviceSize excess = 0;
+    for (const HeapBudget &heapBudget : heapBudgets)
+    {
+        if (heapBudget.deviceLocal && heapBudget.usage > getTargetUsage(heapBudget))
+            excess = std::max(excess, heapBudget.usage - getTargetUsage(heapBudget));
+    }
+    if (excess == 0)
+        return;
+
+    VkDeviceSize released = evict(excess, EvictionReason::OverBudget);
+    if (released > 0)
+        evictionCooldown = MAX_FRAMES_IN_FLIGHT;
+    std::cout << "Over memory budget by " << excess / 1024 << " KiB, evicted " << released / 1024 << " KiB" << std::endl;
+}
+
+void printMemoryBudget()
+{
+    for (uint32_t i = 0; i < heapBudgets.size(); i++)
+    {
+        const HeapBudget &heapBudget = heapBudgets[i];
+        std::cout << "  heap " << i << (heapBudget.deviceLocal ? " (device local)" : "") << ": " << heapBudget.usage / (1024 * 1024) << " / "
+                  << heapBudget.budget / (1024 * 1024) << " MiB budget, " << heapBudget.size / (1024 * 1024) << " MiB total, "
+                  << heapBudget.allocated / (1024 * 1024) << " MiB allocated by the engine" << std::endl;
+    }
+}
+
+uint64_t getResidencyFrame()
+{
+    return residencyFrame;
+}
+
+void addMemoryEvictor(MemoryEvictor evictor)
+{
+    evictors.push_back(std::move(evictor));
+}
+
+VkDeviceSize getAvailableDeviceMemory()
+{
+    VkDeviceSize available = std::numeric_limits<VkDeviceSize>::max();
+    for (const HeapBudget &heapBudget : heapBudgets)
+    {
+        if (!heapBudget.deviceLocal)
+            continue;
+        VkDeviceSize target = getTargetUsage(heapBudget);
+        available = std::min(available, heapBudget.usage < target ? target - heapBudget.usage : 0);
+    }
+    return available;
+}
+
+const std::vector<HeapBudget> &getHeapBudgets()
+{
+    return heapBudgets;
+}
+
+void allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkDeviceMemory &deviceMemory)
+{
+    VkMemoryAllocateInfo memoryAllocateInfo;
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.pNext = nullptr;
+    memoryAllocateInfo.allocationSize = size;
+    memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+    uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    while (true)
+    {
+        COUNT_FRAME_STAT(Allocations, 1);
+        VkResult result = vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &deviceMemory);
+        if (result == VK_SUCCESS)
+            break;
+
+        // The batch being recorded isn't submitted from here, released
+        // resources are only freed once the work already submitted is done.
+        // Retry as long as that actually gives memory back to the heap.
+        bool outOfMemory = result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY;
+        if (outOfMemory)
+        {
+            VkDeviceSize allocated = heapBudgets[heapIndex].allocated;
+            evict(size, EvictionReason::OutOfMemory);
+            graphicsTimeline.waitForValue(graphicsTimeline.getSubmittedValue());
+            deletionQueue.collect();
+            if (heapBudgets[heapIndex].allocated < allocated)
+                continue;
+        }
+
+        std::cerr << "Failed to allocate " << size << " bytes of memory type " << memoryTypeIndex << std::endl;
+        ASSERT_VULKAN(result);
+    }
+
+    allocations[deviceMemory] = {heapIndex, size};
+    heapBudgets[heapIndex].allocated += size;
+    updateHeapUsage(heapIndex);
+}
+
+void freeDeviceMemory(VkDeviceMemory deviceMemory)
+{
+    if (deviceMemory == VK_NULL_HANDLE)
+        return;
+
+    auto allocation = allocations.find(deviceMemory);
+    if (allocation != allocations.end())
+    {
+        heapBudgets[allocation->second.heapIndex].allocated -= allocation->second.size;
+        updateHeapUsage(allocation->second.heapIndex);
+        allocations.erase(allocation);
+    }
+
+    vkFreeMemory(device, deviceMemory, nullptr);
+}
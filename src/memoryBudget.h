@@ -0,0 +1,66 @@
+#pragma once
+
+#include "engine.h"
+
+#include <functional>
+
+struct MemoryBudgetSettings
+{
+    // Device local heaps are kept below this fraction of their budget. Above
+    // it resources are evicted, streaming only fills up to it.
+    float targetUsage = 0.9f;
+    // Budget as a fraction of the heap size without VK_EXT_memory_budget.
+    float fallbackBudget = 0.8f;
+};
+
+// Without VK_EXT_memory_budget usage only counts memory allocated through
+// allocateDeviceMemory. With it, it is the driver's figure for this process
+// as of the last updateMemoryBudget, plus whatever was allocated since.
+struct HeapBudget
+{
+    VkDeviceSize size;
+    VkDeviceSize budget;
+    VkDeviceSize usage;
+    VkDeviceSize allocated;
+    bool deviceLocal;
+};
+
+// Over budget, evictors may shrink resources into smaller allocations and
+// record copies into them. Out of memory they are called from within an
+// allocation, possibly while recording, and may only release whole resources
+// that neither a frame in flight nor the batch being recorded uses.
+enum class EvictionReason
+{
+    OverBudget,
+    OutOfMemory,
+};
+
+// Releases memory held by the least recently used resources and returns how
+// many bytes it released. The memory only goes back to the heap once the
+// deletion queue has freed it.
+typedef std::function<VkDeviceSize(VkDeviceSize bytes, EvictionReason reason)> MemoryEvictor;
+
+extern MemoryBudgetSettings memoryBudgetSettings;
+
+void initMemoryBudget();
+// Call once per frame, after the frame slot has been waited on. Evicts until
+// the device local heaps are back under the target.
+void updateMemoryBudget();
+void printMemoryBudget();
+
+// Advanced by updateMemoryBudget, resources record it when used to find the
+// least recently used ones.
+uint64_t getResidencyFrame();
+
+// Evictors are asked in the order they were added.
+void addMemoryEvictor(MemoryEvictor evictor);
+// Bytes that can still be made resident before any device local heap goes
+// over the target.
+VkDeviceSize getAvailableDeviceMemory();
+const std::vector<HeapBudget> &getHeapBudgets();
+
+// Running out of memory releases whole resources, waits for the work already
+// submitted and retries as long as that gave memory back to the heap. Exits
+// once nothing more can be released.
+void allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkDeviceMemory &deviceMemory);
+void freeDeviceMemory(VkDeviceMemory deviceMemory);
@@ -0,0 +1,683 @@
+#include "meshlets.h"
+#include "descriptorAllocator.h"
+#include "deletionQueue.h"
+#include "frameStats.h"
+#include "memoryBudget.h"
+#include "pipelineCache.h"
+#include "shaderManager.h"
+#include "submission.h"
+
+#include <algorithm>
+#include <cmath>
+
+MeshletSettings meshletSettings;
+
+static const uint32_t CULL_GROUP_SIZE = 64;
+static const uint32_t TASK_GROUP_SIZE = 32;
+static const uint32_t MESHLET_OCCLUSION_BIT = 0x00000001;
+
+// Match the push constant block and vertex struct of the meshlet shaders.
+struct MeshletConstants
+{
+    glm::mat4 viewProjection;
+    glm::vec4 cameraPosition;
+    int32_t depthSize[2];
+    uint32_t meshletCount;
+    uint32_t levelCount;
+    uint32_t flags;
+};
+
+struct MeshletVertex
+{
+    glm::vec4 position;
+    glm::vec4 normal;
+};
+
+static uint32_t meshletCount = 0;
+static VkBuffer vertexBuffer;
+static VkDeviceMemory vertexBufferMemory;
+static VkBuffer meshletBuffer;
+static VkDeviceMemory meshletBufferMemory;
+static VkBuffer meshletVertexBuffer;
+static VkDeviceMemory meshletVertexBufferMemory;
+static VkBuffer meshletTriangleBuffer;
+static VkDeviceMemory meshletTriangleBufferMemory;
+// Only used without mesh shaders.
+static VkBuffer indexBuffer;
+static VkDeviceMemory indexBufferMemory;
+static VkBuffer drawBuffer;
+static VkDeviceMemory drawBufferMemory;
+
+static VkShaderStageFlags meshletStages;
+static VkDescriptorSetLayout meshletSetLayout;
+static VkPipelineLayout meshletPipelineLayout;
+static VkPipeline cullPipeline = VK_NULL_HANDLE;
+// Need the draw pass's render pass, so they are built on first use.
+static VkPipeline drawPipeline = VK_NULL_HANDLE;
+static VkPipeline meshShadingPipeline = VK_NULL_HANDLE;
+static PFN_vkCmdDrawMeshTasksEXT cmdDrawMeshTasks = nullptr;
+
+static MeshletConstants frameConstants;
+
+static void finishMeshlet(MeshletMesh &mesh, Meshlet &meshlet, const std::vector<glm::vec3> &positions, std::vector<int32_t> &localIndices)
+{
+    glm::vec3 boundsMin = positions[mesh.vertices[meshlet.vertexOffset]];
+    glm::vec3 boundsMax = boundsMin;
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+    {
+        uint32_t vertex = mesh.vertices[meshlet.vertexOffset + i];
+        boundsMin = glm::min(boundsMin, positions[vertex]);
+        boundsMax = glm::max(boundsMax, positions[vertex]);
+        localIndices[vertex] = -1;
+    }
+
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+    {
+        radius = std::max(radius, glm::length(positions[mesh.vertices[meshlet.vertexOffset + i]] - center));
+    }
+
+    std::vector<glm::vec3> normals;
+    glm::vec3 axis(0.0f);
+    for (uint32_t i = 0; i < meshlet.triangleCount; i++)
+    {
+        uint32_t triangle = mesh.triangles[meshlet.triangleOffset + i];
+        glm::vec3 p0 = positions[mesh.vertices[meshlet.vertexOffset + (triangle & 0xff)]];
+        glm::vec3 p1 = positions[mesh.vertices[meshlet.vertexOffset + ((triangle >> 8) & 0xff)]];
+        glm::vec3 p2 = positions[mesh.vertices[meshlet.vertexOffset + ((triangle >> 16) & 0xff)]];
+
+        // Area weighted, degenerate triangles don't constrain the cone.
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+        if (area == 0.0f)
+            continue;
+        axis += normal;
+        normals.push_back(normal / area);
+    }
+
+    // A cutoff of 1 never culls, which is what a cone wider than a
+    // hemisphere needs.
+    float cutoff = 1.0f;
+    if (glm::length(axis) > 0.0f)
+    {
+        axis = glm::normalize(axis);
+        float minimumDot = 1.0f;
+        for (const glm::vec3 &normal : normals)
+        {
+            minimumDot = std::min(minimumDot, glm::dot(normal, axis));
+        }
+        if (minimumDot > 0.0f)
+            cutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+    }
+
+    meshlet.sphere = glm::vec4(center, radius);
+    meshlet.cone = glm::vec4(axis, cutoff);
+    mesh.meshlets.push_back(meshlet);
+}
+
+MeshletMesh buildMeshlets(const std::vector<glm::vec3> &positions, const std::vector<uint32_t> &indices)
+{
+    MeshletMesh mesh;
+    std::vector<int32_t> localIndices(positions.size(), -1);
+
+    Meshlet meshlet = {};
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        uint32_t newVertices = 0;
+        for (size_t j = i; j < i + 3; j++)
+        {
+            if (localIndices[indices[j]] < 0)
+                newVertices++;
+        }
+
+        if (meshlet.vertexCount + newVertices > MESHLET_MAX_VERTICES || meshlet.triangleCount == MESHLET_MAX_TRIANGLES)
+        {
+            finishMeshlet(mesh, meshlet, positions, localIndices);
+            meshlet = {};
+            meshlet.vertexOffset = mesh.vertices.size();
+            meshlet.triangleOffset = mesh.triangles.size();
+        }
+
+        uint32_t triangle = 0;
+        for (size_t j = i; j < i + 3; j++)
+        {
+            if (localIndices[indices[j]] < 0)
+            {
+                localIndices[indices[j]] = meshlet.vertexCount++;
+                mesh.vertices.push_back(indices[j]);
+            }
+            triangle |= localIndices[indices[j]] << (8 * (j - i));
+        }
+        mesh.triangles.push_back(triangle);
+        meshlet.triangleCount++;
+    }
+
+    if (meshlet.triangleCount > 0)
+        finishMeshlet(mesh, meshlet, positions, localIndices);
+
+    return mesh;
+}
+
+// A torus around the rest of the scene. The quads are emitted in tiles of 7x7
+// whose 64 vertices fill exactly one meshlet.
+static void createTorus(std::vector<glm::vec3> &positions, std::vector<glm::vec3> &normals, std::vector<uint32_t> &indices)
+{
+    const float ringRadius = 2.0f;
+    const float tubeRadius = 0.15f;
+    const float height = 0.25f;
+    const uint32_t tileSize = 7;
+
+    uint32_t ringSegments = meshletSettings.ringSegments;
+    uint32_t tubeSegments = meshletSettings.tubeSegments;
+    for (uint32_t i = 0; i < ringSegments; i++)
+    {
+        float u = glm::radians(360.0f) * i / ringSegments;
+        glm::vec3 ringDirection(std::cos(u), std::sin(u), 0.0f);
+        for (uint32_t j = 0; j < tubeSegments; j++)
+        {
+            float v = glm::radians(360.0f) * j / tubeSegments;
+            glm::vec3 normal = ringDirection * std::cos(v) + glm::vec3(0.0f, 0.0f, std::sin(v));
+            positions.push_back(ringDirection * ringRadius + normal * tubeRadius + glm::vec3(0.0f, 0.0f, height));
+            normals.push_back(normal);
+        }
+    }
+
+    for (uint32_t tileI = 0; tileI < ringSegments; tileI += tileSize)
+    {
+        for (uint32_t tileJ = 0; tileJ < tubeSegments; tileJ += tileSize)
+        {
+            for (uint32_t i = tileI; i < std::min(tileI + tileSize, ringSegments); i++)
+            {
+                for (uint32_t j = tileJ; j < std::min(tileJ + tileSize, tubeSegments); j++)
+                {
+                    uint32_t nextI = (i + 1) % ringSegments;
+                    uint32_t nextJ = (j + 1) % tubeSegments;
+                    uint32_t quad[] = {i * tubeSegments + j, nextI * tubeSegments + j, nextI * tubeSegments + nextJ, i * tubeSegments + nextJ};
+                    indices.insert(indices.end(), {quad[0], quad[1], quad[2], quad[0], quad[2], quad[3]});
+                }
+            }
+        }
+    }
+}
+
+bool isMeshShadingActive()
+{
+    return meshletSettings.meshShading && deviceCapabilities.meshShader;
+}
+
+static VkPipeline createDrawPipeline(VkRenderPass renderPass, VkSampleCountFlagBits samples, bool meshShading)
+{
+    std::vector<std::string> shaderNames = {"meshlet.vert", "meshlet.frag"};
+    std::vector<VkShaderStageFlagBits> stages = {VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT};
+    if (meshShading)
+    {
+        shaderNames = {"meshlet.task", "meshlet.mesh", "meshlet.frag"};
+        stages = {VK_SHADER_STAGE_TASK_BIT_EXT, VK_SHADER_STAGE_MESH_BIT_EXT, VK_SHADER_STAGE_FRAGMENT_BIT};
+    }
+
+    std::vector<VkShaderModule> shaderModules(shaderNames.size());
+    std::vector<VkPipelineShaderStageCreateInfo> shaderStages(shaderNames.size());
+    for (size_t i = 0; i < shaderNames.size(); i++)
+    {
+        createShaderModule(getShaderCode(shaderNames[i]), &shaderModules[i]);
+
+        shaderStages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[i].pNext = nullptr;
+        shaderStages[i].flags = 0;
+        shaderStages[i].stage = stages[i];
+        shaderStages[i].module = shaderModules[i];
+        shaderStages[i].pName = "main";
+        shaderStages[i].pSpecializationInfo = nullptr;
+    }
+
+    // Vertices are pulled from the storage buffer.
+    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo;
+    vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputStateCreateInfo.pNext = nullptr;
+    vertexInputStateCreateInfo.flags = 0;
+    vertexInputStateCreateInfo.vertexBindingDescriptionCount = 0;
+    vertexInputStateCreateInfo.pVertexBindingDescriptions = nullptr;
+    vertexInputStateCreateInfo.vertexAttributeDescriptionCount = 0;
+    vertexInputStateCreateInfo.pVertexAttributeDescriptions = nullptr;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo;
+    inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyCreateInfo.pNext = nullptr;
+    inputAssemblyCreateInfo.flags = 0;
+    inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewportStateCreateInfo;
+    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportStateCreateInfo.pNext = nullptr;
+    viewportStateCreateInfo.flags = 0;
+    viewportStateCreateInfo.viewportCount = 1;
+    viewportStateCreateInfo.pViewports = nullptr;
+    viewportStateCreateInfo.scissorCount = 1;
+    viewportStateCreateInfo.pScissors = nullptr;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationCreateInfo;
+    rasterizationCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationCreateInfo.pNext = nullptr;
+    rasterizationCreateInfo.flags = 0;
+    rasterizationCreateInfo.depthClampEnable = VK_FALSE;
+    rasterizationCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+    rasterizationCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizationCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizationCreateInfo.depthBiasEnable = VK_FALSE;
+    rasterizationCreateInfo.depthBiasConstantFactor = 0.0f;
+    rasterizationCreateInfo.depthBiasClamp = 0.0f;
+    rasterizationCreateInfo.depthBiasSlopeFactor = 0.0f;
+    rasterizationCreateInfo.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampleCreateInfo;
+    multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleCreateInfo.pNext = nullptr;
+    multisampleCreateInfo.flags = 0;
+    multisampleCreateInfo.rasterizationSamples = samples;
+    multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
+    multisampleCreateInfo.minSampleShading = 1.0f;
+    multisampleCreateInfo.pSampleMask = nullptr;
+    multisampleCreateInfo.alphaToCoverageEnable = VK_FALSE;
+    multisampleCreateInfo.alphaToOneEnable = VK_FALSE;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo;
+    depthStencilStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilStateCreateInfo.pNext = nullptr;
+    depthStencilStateCreateInfo.flags = 0;
+    depthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
+    depthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
+    depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    depthStencilStateCreateInfo.depthBoundsTestEnable = VK_FALSE;
+    depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
+    depthStencilStateCreateInfo.front = {};
+    depthStencilStateCreateInfo.back = {};
+    depthStencilStateCreateInfo.minDepthBounds = 0.0f;
+    depthStencilStateCreateInfo.maxDepthBounds = 1.0f;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachmentState;
+    colorBlendAttachmentState.blendEnable = VK_FALSE;
+    colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo;
+    colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendStateCreateInfo.pNext = nullptr;
+    colorBlendStateCreateInfo.flags = 0;
+    colorBlendStateCreateInfo.logicOpEnable = VK_FALSE;
+    colorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_NO_OP;
+    colorBlendStateCreateInfo.attachmentCount = 1;
+    colorBlendStateCreateInfo.pAttachments = &colorBlendAttachmentState;
+    colorBlendStateCreateInfo.blendConstants[0] = 0.0f;
+    colorBlendStateCreateInfo.blendConstants[1] = 0.0f;
+    colorBlendStateCreateInfo.blendConstants[2] = 0.0f;
+    colorBlendStateCreateInfo.blendConstants[3] = 0.0f;
+
+    VkDynamicState dynamicStates[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR};
+
+    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo;
+    dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateCreateInfo.pNext = nullptr;
+    dynamicStateCreateInfo.flags = 0;
+    dynamicStateCreateInfo.dynamicStateCount = 2;
+    dynamicStateCreateInfo.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.pNext = nullptr;
+    pipelineCreateInfo.flags = 0;
+    pipelineCreateInfo.stageCount = shaderStages.size();
+    pipelineCreateInfo.pStages = shaderStages.data();
+    // Mesh shading pipelines have no vertex input stage.
+    pipelineCreateInfo.pVertexInputState = meshShading ? nullptr : &vertexInputStateCreateInfo;
+    pipelineCreateInfo.pInputAssemblyState = meshShading ? nullptr : &inputAssemblyCreateInfo;
+    pipelineCreateInfo.pTessellationState = nullptr;
+    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+    pipelineCreateInfo.pRasterizationState = &rasterizationCreateInfo;
+    pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
+    pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
+    pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
+    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+    pipelineCreateInfo.layout = meshletPipelineLayout;
+    pipelineCreateInfo.renderPass = renderPass;
+    pipelineCreateInfo.subpass = 0;
+    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+    ASSERT_VULKAN(result);
+
+    for (VkShaderModule shaderModule : shaderModules)
+    {
+        vkDestroyShaderModule(device, shaderModule, nullptr);
+    }
+
+    return pipeline;
+}
+
+void initMeshlets()
+{
+    if (!deviceCapabilities.meshShader && !deviceCapabilities.multiDrawIndirect)
+    {
+        std::cout << "Meshlets disabled, they need mesh shaders or multi-draw indirect" << std::endl;
+        meshletSettings.enabled = false;
+    }
+    if (!meshletSettings.enabled)
+        return;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<uint32_t> indices;
+    createTorus(positions, normals, indices);
+
+    MeshletMesh mesh = buildMeshlets(positions, indices);
+    meshletCount = mesh.meshlets.size();
+    std::cout << "Meshlets: " << meshletCount << " for " << indices.size() / 3 << " triangles" << std::endl;
+
+    std::vector<MeshletVertex> vertices(positions.size());
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        vertices[i].position = glm::vec4(positions[i], 1.0f);
+        vertices[i].normal = glm::vec4(normals[i], 0.0f);
+    }
+
+    // The index buffer the indirect draws read is the meshlet triangles
+    // expanded back to mesh vertex indices, one range per meshlet.
+    std::vector<uint32_t> flattenedIndices;
+    flattenedIndices.reserve(mesh.triangles.size() * 3);
+    for (const Meshlet &meshlet : mesh.meshlets)
+    {
+        for (uint32_t i = 0; i < meshlet.triangleCount; i++)
+        {
+            uint32_t triangle = mesh.triangles[meshlet.triangleOffset + i];
+            for (uint32_t j = 0; j < 3; j++)
+            {
+                flattenedIndices.push_back(mesh.vertices[meshlet.vertexOffset + ((triangle >> (8 * j)) & 0xff)]);
+            }
+        }
+    }
+
+    createDeviceBuffer(vertices.data(), vertices.size() * sizeof(MeshletVertex), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vertexBuffer, vertexBufferMemory);
+    createDeviceBuffer(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletBuffer, meshletBufferMemory);
+    createDeviceBuffer(mesh.vertices.data(), mesh.vertices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletVertexBuffer, meshletVertexBufferMemory);
+    createDeviceBuffer(mesh.triangles.data(), mesh.triangles.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletTriangleBuffer, meshletTriangleBufferMemory);
+    createDeviceBuffer(flattenedIndices.data(), flattenedIndices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexBufferMemory);
+    createBuffer(meshletCount * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, drawBuffer,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawBufferMemory, true);
+
+    // The culling pass may run on async compute, which does not wait on the
+    // graphics queue before its first frame.
+    graphicsTimeline.waitForValue(graphicsTimeline.flush());
+
+    meshletStages = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+    if (deviceCapabilities.meshShader)
+    {
+        meshletStages |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+        cmdDrawMeshTasks = (PFN_vkCmdDrawMeshTasksEXT)vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT");
+    }
+
+    // binding 0: vertices, binding 1: meshlets, binding 2: meshlet vertices,
+    // binding 3: meshlet triangles, binding 4: draws, binding 5: depth pyramid
+    VkDescriptorSetLayoutBinding bindings[6];
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = meshletStages;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+    bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutCreateInfo.pNext = nullptr;
+    descriptorSetLayoutCreateInfo.flags = 0;
+    descriptorSetLayoutCreateInfo.bindingCount = 6;
+    descriptorSetLayoutCreateInfo.pBindings = bindings;
+
+    meshletSetLayout = descriptorLayoutCache.createLayout(descriptorSetLayoutCreateInfo);
+
+    VkPushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = meshletStages;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(MeshletConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.pNext = nullptr;
+    pipelineLayoutCreateInfo.flags = 0;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &meshletSetLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &meshletPipelineLayout);
+    ASSERT_VULKAN(result);
+
+    cullPipeline = createComputePipeline("meshletCull.comp", meshletPipelineLayout);
+}
+
+void shutDownMeshlets()
+{
+    if (!meshletSettings.enabled)
+        return;
+
+    if (meshShadingPipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(device, meshShadingPipeline, nullptr);
+    if (drawPipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(device, drawPipeline, nullptr);
+    vkDestroyPipeline(device, cullPipeline, nullptr);
+    vkDestroyPipelineLayout(device, meshletPipelineLayout, nullptr);
+
+    freeDeviceMemory(drawBufferMemory);
+    vkDestroyBuffer(device, drawBuffer, nullptr);
+    freeDeviceMemory(indexBufferMemory);
+    vkDestroyBuffer(device, indexBuffer, nullptr);
+    freeDeviceMemory(meshletTriangleBufferMemory);
+    vkDestroyBuffer(device, meshletTriangleBuffer, nullptr);
+    freeDeviceMemory(meshletVertexBufferMemory);
+    vkDestroyBuffer(device, meshletVertexBuffer, nullptr);
+    freeDeviceMemory(meshletBufferMemory);
+    vkDestroyBuffer(device, meshletBuffer, nullptr);
+    freeDeviceMemory(vertexBufferMemory);
+    vkDestroyBuffer(device, vertexBuffer, nullptr);
+}
+
+void recreateMeshletPipelines()
+{
+    if (!meshletSettings.enabled)
+        return;
+
+    if (meshShadingPipeline != VK_NULL_HANDLE)
+        deletionQueue.destroyPipeline(meshShadingPipeline);
+    meshShadingPipeline = VK_NULL_HANDLE;
+    if (drawPipeline != VK_NULL_HANDLE)
+        deletionQueue.destroyPipeline(drawPipeline);
+    drawPipeline = VK_NULL_HANDLE;
+    deletionQueue.destroyPipeline(cullPipeline);
+
+    cullPipeline = createComputePipeline("meshletCull.comp", meshletPipelineLayout);
+}
+
+void updateMeshlets(const glm::mat4 &view, const glm::mat4 &projection)
+{
+    frameConstants.viewProjection = projection * view;
+    frameConstants.cameraPosition = glm::inverse(view)[3];
+    frameConstants.meshletCount = meshletCount;
+}
+
+// The pyramid is left unwritten without a view, the vertex shader path
+// doesn't use it.
+static VkDescriptorSet allocateMeshletSet(VkImageView hiZView)
+{
+    VkDescriptorSet descriptorSet = frameDescriptorAllocators[currentFrame].allocate(meshletSetLayout);
+
+    VkDescriptorBufferInfo bufferInfos[5];
+    bufferInfos[0].buffer = vertexBuffer;
+    bufferInfos[1].buffer = meshletBuffer;
+    bufferInfos[2].buffer = meshletVertexBuffer;
+    bufferInfos[3].buffer = meshletTriangleBuffer;
+    bufferInfos[4].buffer = drawBuffer;
+
+    VkDescriptorImageInfo imageInfo;
+    imageInfo.sampler = VK_NULL_HANDLE;
+    imageInfo.imageView = hiZView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkWriteDescriptorSet descriptorWrites[6];
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].pNext = nullptr;
+        descriptorWrites[i].dstSet = descriptorSet;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[i].pImageInfo = nullptr;
+        descriptorWrites[i].pBufferInfo = nullptr;
+        descriptorWrites[i].pTexelBufferView = nullptr;
+        if (i < 5)
+        {
+            bufferInfos[i].offset = 0;
+            bufferInfos[i].range = VK_WHOLE_SIZE;
+            descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+        }
+    }
+    descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    descriptorWrites[5].pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(device, hiZView != VK_NULL_HANDLE ? 6 : 5, descriptorWrites, 0, nullptr);
+
+    return descriptorSet;
+}
+
+static void recordDraw(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkImageView hiZView, const MeshletConstants &constants,
+                       const RenderGraphImageInfo &info, bool meshShading)
+{
+    VkPipeline &pipeline = meshShading ? meshShadingPipeline : drawPipeline;
+    if (pipeline == VK_NULL_HANDLE)
+        pipeline = createDrawPipeline(renderPass, info.samples, meshShading);
+
+    COUNT_FRAME_STAT(PipelineBinds, 1);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    VkViewport viewport;
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = info.width;
+    viewport.height = info.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor;
+    scissor.offset = {0, 0};
+    scissor.extent = {info.width, info.height};
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    VkDescriptorSet descriptorSet = allocateMeshletSet(hiZView);
+    COUNT_FRAME_STAT(DescriptorSetBinds, 1);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshletPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, meshletPipelineLayout, meshletStages, 0, sizeof(MeshletConstants), &constants);
+
+    if (meshShading)
+    {
+        COUNT_FRAME_STAT(Draws, 1);
+        cmdDrawMeshTasks(commandBuffer, (meshletCount + TASK_GROUP_SIZE - 1) / TASK_GROUP_SIZE, 1, 1);
+    }
+    else
+    {
+        COUNT_FRAME_STAT(BufferBinds, 1);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        COUNT_FRAME_STAT(Draws, 1);
+        vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, 0, meshletCount, sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+RenderGraphPass &addMeshletPasses(RenderGraph &graph, RenderGraphResource color, RenderGraphResource depth, const RenderGraphImageInfo &depthInfo,
+                                  const DepthPyramid *depthPyramid)
+{
+    bool meshShading = isMeshShadingActive();
+
+    // The shaders always declare the pyramid, without one they get a texel
+    // that is never read.
+    RenderGraphResource hiZ;
+    uint32_t levelCount = 0;
+    if (depthPyramid != nullptr)
+    {
+        hiZ = depthPyramid->image;
+        levelCount = depthPyramid->levelCount;
+    }
+    else
+    {
+        RenderGraphImageInfo hiZInfo;
+        hiZInfo.format = VK_FORMAT_R32G32_SFLOAT;
+        hiZInfo.width = 1;
+        hiZInfo.height = 1;
+        hiZ = graph.createImage("meshletNoHiZ", hiZInfo);
+    }
+
+    MeshletConstants constants;
+    constants.depthSize[0] = depthInfo.width;
+    constants.depthSize[1] = depthInfo.height;
+    constants.levelCount = levelCount;
+
+    bool hasDepthPyramid = depthPyramid != nullptr;
+    auto getConstants = [constants, hasDepthPyramid]() {
+        MeshletConstants frame = constants;
+        frame.viewProjection = frameConstants.viewProjection;
+        frame.cameraPosition = frameConstants.cameraPosition;
+        frame.meshletCount = frameConstants.meshletCount;
+        frame.flags = hasDepthPyramid && occlusionCullingSettings.occlusion ? MESHLET_OCCLUSION_BIT : 0;
+        return frame;
+    };
+
+    if (meshShading)
+    {
+        return graph.addPass("meshlets", RenderGraphQueue::Graphics)
+            .read(hiZ, RenderGraphAccess::StorageReadTaskShader)
+            .write(color, RenderGraphAccess::ColorAttachment)
+            .write(depth, RenderGraphAccess::DepthAttachment)
+            .execute([&graph, hiZ, depthInfo, getConstants](VkCommandBuffer commandBuffer) {
+                recordDraw(commandBuffer, graph.getRenderPass("meshlets"), graph.getImageView(hiZ), getConstants(), depthInfo, true);
+            });
+    }
+
+    RenderGraphResource draws = graph.importBuffer("meshletDraws", drawBuffer, deviceCapabilities.asyncCompute);
+
+    graph.addPass("meshletCull", RenderGraphQueue::Compute)
+        .read(hiZ, RenderGraphAccess::StorageReadCompute)
+        .write(draws, RenderGraphAccess::StorageWriteCompute)
+        .execute([&graph, hiZ, getConstants](VkCommandBuffer commandBuffer) {
+            MeshletConstants constants = getConstants();
+            VkDescriptorSet descriptorSet = allocateMeshletSet(graph.getImageView(hiZ));
+
+            COUNT_FRAME_STAT(PipelineBinds, 1);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+            COUNT_FRAME_STAT(DescriptorSetBinds, 1);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, meshletPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+            vkCmdPushConstants(commandBuffer, meshletPipelineLayout, meshletStages, 0, sizeof(MeshletConstants), &constants);
+            COUNT_FRAME_STAT(Dispatches, 1);
+            vkCmdDispatch(commandBuffer, (meshletCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+        });
+
+    return graph.addPass("meshlets", RenderGraphQueue::Graphics)
+        .read(draws, RenderGraphAccess::IndirectBuffer)
+        .write(color, RenderGraphAccess::ColorAttachment)
+        .write(depth, RenderGraphAccess::DepthAttachment)
+        .execute([&graph, depthInfo, getConstants](VkCommandBuffer commandBuffer) {
+            recordDraw(commandBuffer, graph.getRenderPass("meshlets"), VK_NULL_HANDLE, getConstants(), depthInfo, false);
+        });
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "engine.h"
+#include "occlusionCulling.h"
+#include "renderGraph.h"
+
+#include <glm/glm.hpp>
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// A cluster of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES
+// triangles. The cone holds the average normal and the cutoff for backface
+// culling the whole cluster: it faces away from a camera at p if
+// dot(center - p, axis) >= cutoff * length(center - p) + radius.
+// Matches the layout the meshlet shaders read.
+struct Meshlet
+{
+    glm::vec4 sphere;
+    glm::vec4 cone;
+    uint32_t vertexOffset;
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+
+// vertices maps meshlet-local vertices to mesh vertices, triangles holds the
+// three local indices of each triangle in its low three bytes.
+struct MeshletMesh
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;
+    std::vector<uint32_t> triangles;
+};
+
+// Packs triangles into meshlets greedily in index order, so the quality of the
+// clusters depends on the locality of the index buffer.
+MeshletMesh buildMeshlets(const std::vector<glm::vec3> &positions, const std::vector<uint32_t> &indices);
+
+// A large mesh split into meshlets that are culled on the GPU against their
+// normal cone, the frustum and the occlusion culling depth pyramid. With task
+// and mesh shaders the task shader culls and the mesh shader only expands the
+// survivors. Otherwise a compute pass writes one indirect draw per meshlet
+// into a flattened index buffer.
+struct MeshletSettings
+{
+    // Cleared by initMeshlets if the device has neither mesh shaders nor
+    // multi-draw indirect.
+    bool enabled = true;
+    // Only has an effect where the device supports mesh shaders.
+    bool meshShading = true;
+
+    // Fixed once initMeshlets has run.
+    uint32_t ringSegments = 896;
+    uint32_t tubeSegments = 56;
+};
+
+extern MeshletSettings meshletSettings;
+
+void initMeshlets();
+void shutDownMeshlets();
+void recreateMeshletPipelines();
+bool isMeshShadingActive();
+
+void updateMeshlets(const glm::mat4 &view, const glm::mat4 &projection);
+
+// Adds the culling and draw passes drawing into color and depth, which share
+// depthInfo's size and sample count. Without a depth pyramid only the cone and
+// frustum tests run. The draw pass is returned so the caller can resolve from
+// it.
+RenderGraphPass &addMeshletPasses(RenderGraph &graph, RenderGraphResource color, RenderGraphResource depth, const RenderGraphImageInfo &depthInfo,
+                                  const DepthPyramid *depthPyramid);
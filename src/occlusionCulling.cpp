@@ -0,0 +1,648 @@
+#include "occlusionCulling.h"
+#include "descriptorAllocator.h"
+#include "deletionQueue.h"
+#include "frameStats.h"
+#include "memoryBudget.h"
+#include "pipelineCache.h"
+#include "shaderManager.h"
+#include "submission.h"
+
+#include <algorithm>
+
+OcclusionCullingSettings occlusionCullingSettings;
+
+static const uint32_t CULL_GROUP_SIZE = 64;
+static const uint32_t HI_Z_GROUP_SIZE = 8;
+static const uint32_t CULL_OCCLUSION_BIT = 0x00000001;
+static const VkFormat HI_Z_FORMAT = VK_FORMAT_R32G32_SFLOAT;
+
+// Match the structs and push constant block of the culling shaders.
+struct CullObject
+{
+    glm::vec4 center;
+    glm::vec4 extent;
+};
+
+struct CullConstants
+{
+    glm::mat4 viewProjection;
+    int32_t depthSize[2];
+    uint32_t objectCount;
+    uint32_t level;
+    uint32_t levelCount;
+    uint32_t flags;
+};
+
+// The pyramid levels are packed into one image, see getLevel in the shaders.
+struct HiZLayout
+{
+    uint32_t levelCount;
+    VkExtent2D extent;
+};
+
+static uint32_t objectCount = 0;
+static VkBuffer objectBuffer;
+static VkDeviceMemory objectBufferMemory;
+static VkBuffer visibilityBuffer;
+static VkDeviceMemory visibilityBufferMemory;
+static VkBuffer earlyDrawBuffer;
+static VkDeviceMemory earlyDrawBufferMemory;
+static VkBuffer lateDrawBuffer;
+static VkDeviceMemory lateDrawBufferMemory;
+static VkBuffer boxIndexBuffer;
+static VkDeviceMemory boxIndexBufferMemory;
+
+static VkSampler depthSampler;
+static VkDescriptorSetLayout cullSetLayout;
+static VkPipelineLayout cullPipelineLayout;
+static VkPipeline cullEarlyPipeline = VK_NULL_HANDLE;
+static VkPipeline cullLatePipeline = VK_NULL_HANDLE;
+static VkPipeline hiZDepthPipeline = VK_NULL_HANDLE;
+static VkPipeline hiZDepthMultisampledPipeline = VK_NULL_HANDLE;
+static VkPipeline hiZReducePipeline = VK_NULL_HANDLE;
+// Needs the draw passes' render pass, so it is built on first use.
+static VkPipeline drawPipeline = VK_NULL_HANDLE;
+
+static CullConstants frameConstants;
+
+// Corners are numbered by their x, y and z bits, faces wind counter-clockwise
+// seen from outside.
+static const uint16_t boxIndices[] = {
+    0, 2, 3, 0, 3, 1,
+    4, 5, 7, 4, 7, 6,
+    0, 1, 5, 0, 5, 4,
+    2, 6, 7, 2, 7, 3,
+    0, 4, 6, 0, 6, 2,
+    1, 3, 7, 1, 7, 5};
+
+// A grid of small boxes of varying height, with the middle left free for the
+// rest of the scene, and two walls hiding a corner of it from the camera.
+static std::vector<CullObject> createObjects()
+{
+    std::vector<CullObject> objects;
+    objects.push_back({glm::vec4(-0.6f, -1.6f, 0.4f, 0.0f), glm::vec4(0.04f, 1.0f, 0.4f, 0.0f)});
+    objects.push_back({glm::vec4(-1.6f, -0.6f, 0.4f, 0.0f), glm::vec4(1.0f, 0.04f, 0.4f, 0.0f)});
+
+    uint32_t gridSize = occlusionCullingSettings.gridSize;
+    float spacing = 8.0f / gridSize;
+    for (uint32_t y = 0; y < gridSize; y++)
+    {
+        for (uint32_t x = 0; x < gridSize; x++)
+        {
+            float centerX = -4.0f + (x + 0.5f) * spacing;
+            float centerY = -4.0f + (y + 0.5f) * spacing;
+            if (std::abs(centerX) < 0.75f && std::abs(centerY) < 0.75f)
+                continue;
+
+            float height = 0.02f + 0.08f * ((x * 7919 + y * 104729) % 97) / 96.0f;
+            objects.push_back({glm::vec4(centerX, centerY, height, 0.0f), glm::vec4(spacing * 0.3f, spacing * 0.3f, height, 0.0f)});
+        }
+    }
+    return objects;
+}
+
+static HiZLayout getHiZLayout(uint32_t depthWidth, uint32_t depthHeight)
+{
+    uint32_t width = std::max(depthWidth / 2, 1u);
+    uint32_t height = std::max(depthHeight / 2, 1u);
+
+    HiZLayout layout;
+    layout.levelCount = 1;
+    layout.extent = {width, height};
+
+    uint32_t offsetX = width;
+    uint32_t offsetY = 0;
+    while (width > 1 || height > 1)
+    {
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+        layout.extent.width = std::max(layout.extent.width, offsetX + width);
+        layout.extent.height = std::max(layout.extent.height, offsetY + height);
+        offsetY += height;
+        layout.levelCount++;
+    }
+    return layout;
+}
+
+static void createCullPipelines()
+{
+    cullEarlyPipeline = createComputePipeline("cullEarly.comp", cullPipelineLayout);
+    cullLatePipeline = createComputePipeline("cullLate.comp", cullPipelineLayout);
+    hiZDepthPipeline = createComputePipeline("hiZDepth.comp", cullPipelineLayout);
+    hiZDepthMultisampledPipeline = createComputePipeline("hiZDepthMultisampled.comp", cullPipelineLayout);
+    hiZReducePipeline = createComputePipeline("hiZReduce.comp", cullPipelineLayout);
+}
+
+static VkPipeline createDrawPipeline(VkRenderPass renderPass, VkSampleCountFlagBits samples)
+{
+    VkShaderModule shaderModuleVert;
+    VkShaderModule shaderModuleFrag;
+    createShaderModule(getShaderCode("cullObject.vert"), &shaderModuleVert);
+    createShaderModule(getShaderCode("cullObject.frag"), &shaderModuleFrag);
+
+    VkPipelineShaderStageCreateInfo shaderStages[2];
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        shaderStages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[i].pNext = nullptr;
+        shaderStages[i].flags = 0;
+        shaderStages[i].stage = i == 0 ? VK_SHADER_STAGE_VERTEX_BIT : VK_SHADER_STAGE_FRAGMENT_BIT;
+        shaderStages[i].module = i == 0 ? shaderModuleVert : shaderModuleFrag;
+        shaderStages[i].pName = "main";
+        shaderStages[i].pSpecializationInfo = nullptr;
+    }
+
+    // Objects are pulled from the storage buffer, the box corners come from
+    // the vertex index.
+    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo;
+    vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputStateCreateInfo.pNext = nullptr;
+    vertexInputStateCreateInfo.flags = 0;
+    vertexInputStateCreateInfo.vertexBindingDescriptionCount = 0;
+    vertexInputStateCreateInfo.pVertexBindingDescriptions = nullptr;
+    vertexInputStateCreateInfo.vertexAttributeDescriptionCount = 0;
+    vertexInputStateCreateInfo.pVertexAttributeDescriptions = nullptr;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo;
+    inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyCreateInfo.pNext = nullptr;
+    inputAssemblyCreateInfo.flags = 0;
+    inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewportStateCreateInfo;
+    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportStateCreateInfo.pNext = nullptr;
+    viewportStateCreateInfo.flags = 0;
+    viewportStateCreateInfo.viewportCount = 1;
+    viewportStateCreateInfo.pViewports = nullptr;
+    viewportStateCreateInfo.scissorCount = 1;
+    viewportStateCreateInfo.pScissors = nullptr;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationCreateInfo;
+    rasterizationCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationCreateInfo.pNext = nullptr;
+    rasterizationCreateInfo.flags = 0;
+    rasterizationCreateInfo.depthClampEnable = VK_FALSE;
+    rasterizationCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+    rasterizationCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizationCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizationCreateInfo.depthBiasEnable = VK_FALSE;
+    rasterizationCreateInfo.depthBiasConstantFactor = 0.0f;
+    rasterizationCreateInfo.depthBiasClamp = 0.0f;
+    rasterizationCreateInfo.depthBiasSlopeFactor = 0.0f;
+    rasterizationCreateInfo.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampleCreateInfo;
+    multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleCreateInfo.pNext = nullptr;
+    multisampleCreateInfo.flags = 0;
+    multisampleCreateInfo.rasterizationSamples = samples;
+    multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
+    multisampleCreateInfo.minSampleShading = 1.0f;
+    multisampleCreateInfo.pSampleMask = nullptr;
+    multisampleCreateInfo.alphaToCoverageEnable = VK_FALSE;
+    multisampleCreateInfo.alphaToOneEnable = VK_FALSE;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo;
+    depthStencilStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilStateCreateInfo.pNext = nullptr;
+    depthStencilStateCreateInfo.flags = 0;
+    depthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
+    depthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
+    depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    depthStencilStateCreateInfo.depthBoundsTestEnable = VK_FALSE;
+    depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
+    depthStencilStateCreateInfo.front = {};
+    depthStencilStateCreateInfo.back = {};
+    depthStencilStateCreateInfo.minDepthBounds = 0.0f;
+    depthStencilStateCreateInfo.maxDepthBounds = 1.0f;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachmentState;
+    colorBlendAttachmentState.blendEnable = VK_FALSE;
+    colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo;
+    colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendStateCreateInfo.pNext = nullptr;
+    colorBlendStateCreateInfo.flags = 0;
+    colorBlendStateCreateInfo.logicOpEnable = VK_FALSE;
+    colorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_NO_OP;
+    colorBlendStateCreateInfo.attachmentCount = 1;
+    colorBlendStateCreateInfo.pAttachments = &colorBlendAttachmentState;
+    colorBlendStateCreateInfo.blendConstants[0] = 0.0f;
+    colorBlendStateCreateInfo.blendConstants[1] = 0.0f;
+    colorBlendStateCreateInfo.blendConstants[2] = 0.0f;
+    colorBlendStateCreateInfo.blendConstants[3] = 0.0f;
+
+    VkDynamicState dynamicStates[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR};
+
+    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo;
+    dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateCreateInfo.pNext = nullptr;
+    dynamicStateCreateInfo.flags = 0;
+    dynamicStateCreateInfo.dynamicStateCount = 2;
+    dynamicStateCreateInfo.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.pNext = nullptr;
+    pipelineCreateInfo.flags = 0;
+    pipelineCreateInfo.stageCount = 2;
+    pipelineCreateInfo.pStages = shaderStages;
+    pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+    pipelineCreateInfo.pTessellationState = nullptr;
+    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+    pipelineCreateInfo.pRasterizationState = &rasterizationCreateInfo;
+    pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
+    pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
+    pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
+    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+    pipelineCreateInfo.layout = cullPipelineLayout;
+    pipelineCreateInfo.renderPass = renderPass;
+    pipelineCreateInfo.subpass = 0;
+    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+    ASSERT_VULKAN(result);
+
+    vkDestroyShaderModule(device, shaderModuleFrag, nullptr);
+    vkDestroyShaderModule(device, shaderModuleVert, nullptr);
+
+    return pipeline;
+}
+
+void initOcclusionCulling()
+{
+    VkFormatProperties depthFormatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevices[0], deviceCapabilities.depthFormat, &depthFormatProperties);
+    if (!deviceCapabilities.multiDrawIndirect || !(depthFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+    {
+        std::cout << "Occlusion culling disabled, it needs multi-draw indirect and a sampled depth format" << std::endl;
+        occlusionCullingSettings.enabled = false;
+    }
+    if (!occlusionCullingSettings.enabled)
+        return;
+
+    std::vector<CullObject> objects = createObjects();
+    objectCount = objects.size();
+
+    // The culling passes may run on async compute, so everything they touch
+    // is shared with that queue.
+    createDeviceBuffer(objects.data(), objects.size() * sizeof(CullObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, objectBuffer, objectBufferMemory);
+    createDeviceBuffer(boxIndices, sizeof(boxIndices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, boxIndexBuffer, boxIndexBufferMemory);
+    createBuffer(objectCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, visibilityBuffer,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, visibilityBufferMemory, true);
+    createBuffer(objectCount * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, earlyDrawBuffer,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, earlyDrawBufferMemory, true);
+    createBuffer(objectCount * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, lateDrawBuffer,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, lateDrawBufferMemory, true);
+
+    // Nothing counts as visible in the first frame, so the first phase draws
+    // nothing and the second one everything in the frustum.
+    VkCommandBuffer commandBuffer = beginOneTimeCommands();
+    vkCmdFillBuffer(commandBuffer, visibilityBuffer, 0, VK_WHOLE_SIZE, 0);
+
+    VkMemoryBarrier memoryBarrier;
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = nullptr;
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    endOneTimeCommands(commandBuffer);
+    // The compute queue does not wait on the graphics one before its first
+    // frame, so the uploads have to be done by then.
+    graphicsTimeline.waitForValue(graphicsTimeline.flush());
+
+    VkSamplerCreateInfo samplerCreateInfo;
+    samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerCreateInfo.pNext = nullptr;
+    samplerCreateInfo.flags = 0;
+    samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.mipLodBias = 0.0f;
+    samplerCreateInfo.anisotropyEnable = VK_FALSE;
+    samplerCreateInfo.maxAnisotropy = 1.0f;
+    samplerCreateInfo.compareEnable = VK_FALSE;
+    samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerCreateInfo.minLod = 0.0f;
+    samplerCreateInfo.maxLod = 0.0f;
+    samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+    samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+
+    VkResult result = vkCreateSampler(device, &samplerCreateInfo, nullptr, &depthSampler);
+    ASSERT_VULKAN(result);
+
+    // binding 0: objects, binding 1: visibility, binding 2: early draws,
+    // binding 3: late draws, binding 4: depth pyramid, binding 5: depth
+    VkDescriptorSetLayoutBinding bindings[6];
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+    bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutCreateInfo.pNext = nullptr;
+    descriptorSetLayoutCreateInfo.flags = 0;
+    descriptorSetLayoutCreateInfo.bindingCount = 6;
+    descriptorSetLayoutCreateInfo.pBindings = bindings;
+
+    cullSetLayout = descriptorLayoutCache.createLayout(descriptorSetLayoutCreateInfo);
+
+    VkPushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.pNext = nullptr;
+    pipelineLayoutCreateInfo.flags = 0;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &cullSetLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &cullPipelineLayout);
+    ASSERT_VULKAN(result);
+
+    createCullPipelines();
+}
+
+void shutDownOcclusionCulling()
+{
+    if (!occlusionCullingSettings.enabled)
+        return;
+
+    if (drawPipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(device, drawPipeline, nullptr);
+    vkDestroyPipeline(device, hiZReducePipeline, nullptr);
+    vkDestroyPipeline(device, hiZDepthMultisampledPipeline, nullptr);
+    vkDestroyPipeline(device, hiZDepthPipeline, nullptr);
+    vkDestroyPipeline(device, cullLatePipeline, nullptr);
+    vkDestroyPipeline(device, cullEarlyPipeline, nullptr);
+    vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+    vkDestroySampler(device, depthSampler, nullptr);
+
+    freeDeviceMemory(boxIndexBufferMemory);
+    vkDestroyBuffer(device, boxIndexBuffer, nullptr);
+    freeDeviceMemory(lateDrawBufferMemory);
+    vkDestroyBuffer(device, lateDrawBuffer, nullptr);
+    freeDeviceMemory(earlyDrawBufferMemory);
+    vkDestroyBuffer(device, earlyDrawBuffer, nullptr);
+    freeDeviceMemory(visibilityBufferMemory);
+    vkDestroyBuffer(device, visibilityBuffer, nullptr);
+    freeDeviceMemory(objectBufferMemory);
+    vkDestroyBuffer(device, objectBuffer, nullptr);
+}
+
+void recreateOcclusionCullingPipelines()
+{
+    if (!occlusionCullingSettings.enabled)
+        return;
+
+    if (drawPipeline != VK_NULL_HANDLE)
+        deletionQueue.destroyPipeline(drawPipeline);
+    drawPipeline = VK_NULL_HANDLE;
+    deletionQueue.destroyPipeline(hiZReducePipeline);
+    deletionQueue.destroyPipeline(hiZDepthMultisampledPipeline);
+    deletionQueue.destroyPipeline(hiZDepthPipeline);
+    deletionQueue.destroyPipeline(cullLatePipeline);
+    deletionQueue.destroyPipeline(cullEarlyPipeline);
+
+    createCullPipelines();
+}
+
+void updateOcclusionCulling(const glm::mat4 &view, const glm::mat4 &projection)
+{
+    frameConstants.viewProjection = projection * view;
+    frameConstants.objectCount = objectCount;
+    frameConstants.flags = occlusionCullingSettings.occlusion ? CULL_OCCLUSION_BIT : 0;
+}
+
+// Bindings without a view are left unwritten, the shaders of the passes
+// that have none don't use them.
+static VkDescriptorSet allocateCullSet(VkImageView hiZView, VkImageView depthView)
+{
+    VkDescriptorSet descriptorSet = frameDescriptorAllocators[currentFrame].allocate(cullSetLayout);
+
+    VkDescriptorBufferInfo bufferInfos[4];
+    bufferInfos[0].buffer = objectBuffer;
+    bufferInfos[1].buffer = visibilityBuffer;
+    bufferInfos[2].buffer = earlyDrawBuffer;
+    bufferInfos[3].buffer = lateDrawBuffer;
+
+    VkDescriptorImageInfo imageInfos[2];
+    imageInfos[0].sampler = VK_NULL_HANDLE;
+    imageInfos[0].imageView = hiZView;
+    imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageInfos[1].sampler = depthSampler;
+    imageInfos[1].imageView = depthView;
+    imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    std::vector<VkWriteDescriptorSet> descriptorWrites;
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        if (i >= 4 && imageInfos[i - 4].imageView == VK_NULL_HANDLE)
+            continue;
+
+        VkWriteDescriptorSet descriptorWrite;
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.pNext = nullptr;
+        descriptorWrite.dstSet = descriptorSet;
+        descriptorWrite.dstBinding = i;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = nullptr;
+        descriptorWrite.pBufferInfo = nullptr;
+        descriptorWrite.pTexelBufferView = nullptr;
+        if (i < 4)
+        {
+            bufferInfos[i].offset = 0;
+            bufferInfos[i].range = VK_WHOLE_SIZE;
+            descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrite.pBufferInfo = &bufferInfos[i];
+        }
+        else
+        {
+            descriptorWrite.descriptorType = i == 4 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            descriptorWrite.pImageInfo = &imageInfos[i - 4];
+        }
+        descriptorWrites.push_back(descriptorWrite);
+    }
+
+    vkUpdateDescriptorSets(device, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+
+    return descriptorSet;
+}
+
+static void dispatchCull(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkImageView hiZView, VkImageView depthView, const CullConstants &constants,
+                         uint32_t groupCountX, uint32_t groupCountY)
+{
+    VkDescriptorSet descriptorSet = allocateCullSet(hiZView, depthView);
+
+    COUNT_FRAME_STAT(PipelineBinds, 1);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    COUNT_FRAME_STAT(DescriptorSetBinds, 1);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(CullConstants), &constants);
+    COUNT_FRAME_STAT(Dispatches, 1);
+    vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+}
+
+static void recordDraws(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkBuffer drawBuffer, const RenderGraphImageInfo &info)
+{
+    if (drawPipeline == VK_NULL_HANDLE)
+        drawPipeline = createDrawPipeline(renderPass, info.samples);
+
+    COUNT_FRAME_STAT(PipelineBinds, 1);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline);
+
+    VkViewport viewport;
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = info.width;
+    viewport.height = info.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor;
+    scissor.offset = {0, 0};
+    scissor.extent = {info.width, info.height};
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    VkDescriptorSet descriptorSet = allocateCullSet(VK_NULL_HANDLE, VK_NULL_HANDLE);
+    COUNT_FRAME_STAT(DescriptorSetBinds, 1);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, cullPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(CullConstants), &frameConstants);
+
+    // One command per object, the culled ones have an instance count of 0.
+    COUNT_FRAME_STAT(BufferBinds, 1);
+    vkCmdBindIndexBuffer(commandBuffer, boxIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
+    COUNT_FRAME_STAT(Draws, 1);
+    vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, 0, objectCount, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+static uint32_t getGroupCount(uint32_t size, uint32_t groupSize)
+{
+    return (size + groupSize - 1) / groupSize;
+}
+
+RenderGraphPass &addOcclusionCullingPasses(RenderGraph &graph, RenderGraphResource color, RenderGraphResource depth, const RenderGraphImageInfo &depthInfo,
+                                           DepthPyramid *depthPyramid)
+{
+    bool concurrent = deviceCapabilities.asyncCompute;
+    RenderGraphResource objects = graph.importBuffer("cullObjects", objectBuffer, concurrent);
+    RenderGraphResource visibility = graph.importBuffer("cullVisibility", visibilityBuffer, concurrent);
+    RenderGraphResource earlyDraws = graph.importBuffer("earlyDraws", earlyDrawBuffer, concurrent);
+    RenderGraphResource lateDraws = graph.importBuffer("lateDraws", lateDrawBuffer, concurrent);
+
+    HiZLayout hiZLayout = getHiZLayout(depthInfo.width, depthInfo.height);
+    RenderGraphImageInfo hiZInfo;
+    hiZInfo.format = HI_Z_FORMAT;
+    hiZInfo.width = hiZLayout.extent.width;
+    hiZInfo.height = hiZLayout.extent.height;
+    RenderGraphResource hiZ = graph.createImage("hiZ", hiZInfo);
+    if (depthPyramid != nullptr)
+    {
+        depthPyramid->image = hiZ;
+        depthPyramid->levelCount = hiZLayout.levelCount;
+    }
+
+    CullConstants constants;
+    constants.depthSize[0] = depthInfo.width;
+    constants.depthSize[1] = depthInfo.height;
+    constants.level = 0;
+    constants.levelCount = hiZLayout.levelCount;
+
+    graph.addPass("cullEarly", RenderGraphQueue::Compute)
+        .read(objects, RenderGraphAccess::StorageReadCompute)
+        .read(visibility, RenderGraphAccess::StorageReadCompute)
+        .write(earlyDraws, RenderGraphAccess::StorageWriteCompute)
+        .execute([constants](VkCommandBuffer commandBuffer) {
+            CullConstants cullConstants = constants;
+            cullConstants.viewProjection = frameConstants.viewProjection;
+            cullConstants.objectCount = frameConstants.objectCount;
+            cullConstants.flags = frameConstants.flags;
+            dispatchCull(commandBuffer, cullEarlyPipeline, VK_NULL_HANDLE, VK_NULL_HANDLE, cullConstants, getGroupCount(objectCount, CULL_GROUP_SIZE), 1);
+        });
+
+    graph.addPass("drawEarly", RenderGraphQueue::Graphics)
+        .read(objects, RenderGraphAccess::StorageReadGraphics)
+        .read(earlyDraws, RenderGraphAccess::IndirectBuffer)
+        .write(color, RenderGraphAccess::ColorAttachment)
+        .write(depth, RenderGraphAccess::DepthAttachment)
+        .execute([&graph, depthInfo](VkCommandBuffer commandBuffer) {
+            recordDraws(commandBuffer, graph.getRenderPass("drawEarly"), earlyDrawBuffer, depthInfo);
+        });
+
+    // Depth pyramid, one pass per level.
+    VkExtent2D levelExtent = {std::max(depthInfo.width / 2, 1u), std::max(depthInfo.height / 2, 1u)};
+    VkPipeline *hiZDepth = depthInfo.samples == VK_SAMPLE_COUNT_1_BIT ? &hiZDepthPipeline : &hiZDepthMultisampledPipeline;
+    graph.addPass("hiZ0", RenderGraphQueue::Compute)
+        .read(depth, RenderGraphAccess::SampledCompute)
+        .write(hiZ, RenderGraphAccess::StorageWriteCompute)
+        .execute([&graph, depth, hiZ, hiZDepth, constants, levelExtent](VkCommandBuffer commandBuffer) {
+            dispatchCull(commandBuffer, *hiZDepth, graph.getImageView(hiZ), graph.getImageView(depth), constants,
+                         getGroupCount(levelExtent.width, HI_Z_GROUP_SIZE), getGroupCount(levelExtent.height, HI_Z_GROUP_SIZE));
+        });
+    for (uint32_t level = 1; level < hiZLayout.levelCount; level++)
+    {
+        levelExtent = {std::max(levelExtent.width / 2, 1u), std::max(levelExtent.height / 2, 1u)};
+        CullConstants levelConstants = constants;
+        levelConstants.level = level;
+        graph.addPass("hiZ" + std::to_string(level), RenderGraphQueue::Compute)
+            .write(hiZ, RenderGraphAccess::StorageWriteCompute)
+            .execute([&graph, hiZ, levelConstants, levelExtent](VkCommandBuffer commandBuffer) {
+                dispatchCull(commandBuffer, hiZReducePipeline, graph.getImageView(hiZ), VK_NULL_HANDLE, levelConstants,
+                             getGroupCount(levelExtent.width, HI_Z_GROUP_SIZE), getGroupCount(levelExtent.height, HI_Z_GROUP_SIZE));
+            });
+    }
+
+    graph.addPass("cullLate", RenderGraphQueue::Compute)
+        .read(objects, RenderGraphAccess::StorageReadCompute)
+        .read(hiZ, RenderGraphAccess::StorageReadCompute)
+        .write(visibility, RenderGraphAccess::StorageWriteCompute)
+        .write(lateDraws, RenderGraphAccess::StorageWriteCompute)
+        .execute([&graph, hiZ, constants](VkCommandBuffer commandBuffer) {
+            CullConstants cullConstants = constants;
+            cullConstants.viewProjection = frameConstants.viewProjection;
+            cullConstants.objectCount = frameConstants.objectCount;
+            cullConstants.flags = frameConstants.flags;
+            dispatchCull(commandBuffer, cullLatePipeline, graph.getImageView(hiZ), VK_NULL_HANDLE, cullConstants, getGroupCount(objectCount, CULL_GROUP_SIZE), 1);
+        });
+
+    return graph.addPass("drawLate", RenderGraphQueue::Graphics)
+        .read(objects, RenderGraphAccess::StorageReadGraphics)
+        .read(lateDraws, RenderGraphAccess::IndirectBuffer)
+        .write(color, RenderGraphAccess::ColorAttachment)
+        .write(depth, RenderGraphAccess::DepthAttachment)
+        .execute([&graph, depthInfo](VkCommandBuffer commandBuffer) {
+            recordDraws(commandBuffer, graph.getRenderPass("drawLate"), lateDrawBuffer, depthInfo);
+        });
+}
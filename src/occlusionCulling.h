@@ -0,0 +1,46 @@
+#pragma once
+
+#include "engine.h"
+#include "renderGraph.h"
+
+#include <glm/glm.hpp>
+
+// GPU driven drawing of a field of boxes with two-phase occlusion culling.
+// The first phase draws what was visible last frame; a min/max depth pyramid
+// is built from the result and everything is tested against it, drawing what
+// became visible in a second phase. Draws are vkCmdDrawIndexedIndirect
+// commands written by compute shaders, one per object.
+struct OcclusionCullingSettings
+{
+    // Cleared by initOcclusionCulling if the device lacks multi-draw indirect.
+    bool enabled = true;
+    // Off leaves only frustum culling, for comparison.
+    bool occlusion = true;
+
+    // Fixed once initOcclusionCulling has run.
+    uint32_t gridSize = 64;
+};
+
+extern OcclusionCullingSettings occlusionCullingSettings;
+
+// Lets later passes cull against the depth pyramid, which holds the depth of
+// everything drawn before the second phase. See getLevel in cullLate.comp for
+// how the levels are laid out.
+struct DepthPyramid
+{
+    RenderGraphResource image;
+    uint32_t levelCount;
+};
+
+void initOcclusionCulling();
+void shutDownOcclusionCulling();
+void recreateOcclusionCullingPipelines();
+
+void updateOcclusionCulling(const glm::mat4 &view, const glm::mat4 &projection);
+
+// Adds the culling, depth pyramid and draw passes drawing into color and
+// depth, which share depthInfo's size and sample count. The second draw pass
+// is the last one writing color and is returned so the caller can resolve
+// from it. The depth pyramid is stored in depthPyramid if given.
+RenderGraphPass &addOcclusionCullingPasses(RenderGraph &graph, RenderGraphResource color, RenderGraphResource depth, const RenderGraphImageInfo &depthInfo,
+                                           DepthPyramid *depthPyramid = nullptr);
@@ -0,0 +1,514 @@
+#include "particles.h"
+#include "descriptorAllocator.h"
+#include "deletionQueue.h"
+#include "frameStats.h"
+#include "memoryBudget.h"
+#include "pipelineCache.h"
+#include "shaderManager.h"
+#include "submission.h"
+
+#include <algorithm>
+#include <cstddef>
+
+ParticleSettings particleSettings;
+
+static const uint32_t PARTICLE_EMIT_GROUP_SIZE = 64;
+
+// Match the structs and push constant blocks of the particle shaders.
+struct Particle
+{
+    float positionLife[4];
+    float velocityLifetime[4];
+};
+
+struct ParticleCounter
+{
+    uint32_t count;
+    VkDrawIndirectCommand draw;
+    VkDispatchIndirectCommand dispatch;
+};
+
+struct ParticleConstants
+{
+    float emitterPosition[3];
+    float deltaTime;
+    float gravity[3];
+    float lifetime;
+    uint32_t capacity;
+    uint32_t emitCount;
+    uint32_t seed;
+    float speed;
+    uint32_t sourceIndex;
+};
+
+struct ParticleDrawConstants
+{
+    glm::mat4 viewProjection;
+    glm::vec4 cameraRight;
+    glm::vec4 cameraUp;
+};
+
+static VkBuffer particleBuffers[2];
+static VkDeviceMemory particleBufferMemories[2];
+static VkBuffer counterBuffer;
+static VkDeviceMemory counterBufferMemory;
+
+static VkDescriptorSetLayout particleSetLayout;
+static VkPipelineLayout simulationPipelineLayout;
+static VkPipelineLayout drawPipelineLayout;
+static VkPipeline simulatePipeline = VK_NULL_HANDLE;
+static VkPipeline emitPipeline = VK_NULL_HANDLE;
+static VkPipeline finalizePipeline = VK_NULL_HANDLE;
+// Needs the draw pass's render pass, so it is built on first use.
+static VkPipeline drawPipeline = VK_NULL_HANDLE;
+
+// Buffer the simulation reads from; the other one is written. The finalize
+// pass flips it as it is recorded, so the draw pass recorded after it sees
+// the buffer that was just written.
+static uint32_t sourceIndex = 0;
+// Set once a frame's simulation has been recorded, the next updateParticles
+// swaps the buffers. The passes themselves leave sourceIndex alone, so
+// recording a frame again simulates from the same buffer.
+static bool simulated = false;
+static ParticleConstants simulationConstants;
+static ParticleDrawConstants drawConstants;
+static float emitAccumulator = 0.0f;
+static uint32_t frameSeed = 0;
+
+static void createSimulationPipelines()
+{
+    simulatePipeline = createComputePipeline("particleSimulate.comp", simulationPipelineLayout);
+    emitPipeline = createComputePipeline("particleEmit.comp", simulationPipelineLayout);
+    finalizePipeline = createComputePipeline("particleFinalize.comp", simulationPipelineLayout);
+}
+
+static VkPipeline createDrawPipeline(VkRenderPass renderPass, VkSampleCountFlagBits samples)
+{
+    VkShaderModule shaderModuleVert;
+    VkShaderModule shaderModuleFrag;
+    createShaderModule(getShaderCode("particle.vert"), &shaderModuleVert);
+    createShaderModule(getShaderCode("particle.frag"), &shaderModuleFrag);
+
+    VkPipelineShaderStageCreateInfo shaderStages[2];
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        shaderStages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[i].pNext = nullptr;
+        shaderStages[i].flags = 0;
+        shaderStages[i].stage = i == 0 ? VK_SHADER_STAGE_VERTEX_BIT : VK_SHADER_STAGE_FRAGMENT_BIT;
+        shaderStages[i].module = i == 0 ? shaderModuleVert : shaderModuleFrag;
+        shaderStages[i].pName = "main";
+        shaderStages[i].pSpecializationInfo = nullptr;
+    }
+
+    // Particles are pulled from the storage buffer, there are no vertex inputs.
+    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo;
+    vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputStateCreateInfo.pNext = nullptr;
+    vertexInputStateCreateInfo.flags = 0;
+    vertexInputStateCreateInfo.vertexBindingDescriptionCount = 0;
+    vertexInputStateCreateInfo.pVertexBindingDescriptions = nullptr;
+    vertexInputStateCreateInfo.vertexAttributeDescriptionCount = 0;
+    vertexInputStateCreateInfo.pVertexAttributeDescriptions = nullptr;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo;
+    inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyCreateInfo.pNext = nullptr;
+    inputAssemblyCreateInfo.flags = 0;
+    inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewportStateCreateInfo;
+    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportStateCreateInfo.pNext = nullptr;
+    viewportStateCreateInfo.flags = 0;
+    viewportStateCreateInfo.viewportCount = 1;
+    viewportStateCreateInfo.pViewports = nullptr;
+    viewportStateCreateInfo.scissorCount = 1;
+    viewportStateCreateInfo.pScissors = nullptr;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationCreateInfo;
+    rasterizationCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationCreateInfo.pNext = nullptr;
+    rasterizationCreateInfo.flags = 0;
+    rasterizationCreateInfo.depthClampEnable = VK_FALSE;
+    rasterizationCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+    rasterizationCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationCreateInfo.cullMode = VK_CULL_MODE_NONE;
+    rasterizationCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizationCreateInfo.depthBiasEnable = VK_FALSE;
+    rasterizationCreateInfo.depthBiasConstantFactor = 0.0f;
+    rasterizationCreateInfo.depthBiasClamp = 0.0f;
+    rasterizationCreateInfo.depthBiasSlopeFactor = 0.0f;
+    rasterizationCreateInfo.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampleCreateInfo;
+    multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleCreateInfo.pNext = nullptr;
+    multisampleCreateInfo.flags = 0;
+    multisampleCreateInfo.rasterizationSamples = samples;
+    multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
+    multisampleCreateInfo.minSampleShading = 1.0f;
+    multisampleCreateInfo.pSampleMask = nullptr;
+    multisampleCreateInfo.alphaToCoverageEnable = VK_FALSE;
+    multisampleCreateInfo.alphaToOneEnable = VK_FALSE;
+
+    // Tested against the scene depth but not written, additive blending makes
+    // the draw order irrelevant.
+    VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo;
+    depthStencilStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilStateCreateInfo.pNext = nullptr;
+    depthStencilStateCreateInfo.flags = 0;
+    depthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
+    depthStencilStateCreateInfo.depthWriteEnable = VK_FALSE;
+    depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    depthStencilStateCreateInfo.depthBoundsTestEnable = VK_FALSE;
+    depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
+    depthStencilStateCreateInfo.front = {};
+    depthStencilStateCreateInfo.back = {};
+    depthStencilStateCreateInfo.minDepthBounds = 0.0f;
+    depthStencilStateCreateInfo.maxDepthBounds = 1.0f;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachmentState;
+    colorBlendAttachmentState.blendEnable = VK_TRUE;
+    colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo;
+    colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendStateCreateInfo.pNext = nullptr;
+    colorBlendStateCreateInfo.flags = 0;
+    colorBlendStateCreateInfo.logicOpEnable = VK_FALSE;
+    colorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_NO_OP;
+    colorBlendStateCreateInfo.attachmentCount = 1;
+    colorBlendStateCreateInfo.pAttachments = &colorBlendAttachmentState;
+    colorBlendStateCreateInfo.blendConstants[0] = 0.0f;
+    colorBlendStateCreateInfo.blendConstants[1] = 0.0f;
+    colorBlendStateCreateInfo.blendConstants[2] = 0.0f;
+    colorBlendStateCreateInfo.blendConstants[3] = 0.0f;
+
+    VkDynamicState dynamicStates[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR};
+
+    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo;
+    dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateCreateInfo.pNext = nullptr;
+    dynamicStateCreateInfo.flags = 0;
+    dynamicStateCreateInfo.dynamicStateCount = 2;
+    dynamicStateCreateInfo.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.pNext = nullptr;
+    pipelineCreateInfo.flags = 0;
+    pipelineCreateInfo.stageCount = 2;
+    pipelineCreateInfo.pStages = shaderStages;
+    pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+    pipelineCreateInfo.pTessellationState = nullptr;
+    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+    pipelineCreateInfo.pRasterizationState = &rasterizationCreateInfo;
+    pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
+    pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
+    pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
+    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+    pipelineCreateInfo.layout = drawPipelineLayout;
+    pipelineCreateInfo.renderPass = renderPass;
+    pipelineCreateInfo.subpass = 0;
+    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+    ASSERT_VULKAN(result);
+
+    vkDestroyShaderModule(device, shaderModuleFrag, nullptr);
+    vkDestroyShaderModule(device, shaderModuleVert, nullptr);
+
+    return pipeline;
+}
+
+static VkPipelineLayout createParticlePipelineLayout(VkShaderStageFlags pushConstantStages, uint32_t pushConstantSize)
+{
+    VkPushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = pushConstantStages;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = pushConstantSize;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.pNext = nullptr;
+    pipelineLayoutCreateInfo.flags = 0;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &particleSetLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    VkPipelineLayout pipelineLayout;
+    VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+    ASSERT_VULKAN(result);
+
+    return pipelineLayout;
+}
+
+void initParticles()
+{
+    // Both queues touch the buffers every frame when the simulation runs on
+    // async compute.
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        createBuffer(particleSettings.capacity * sizeof(Particle), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, particleBuffers[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     particleBufferMemories[i], true);
+    }
+    createBuffer(2 * sizeof(ParticleCounter), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 counterBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, counterBufferMemory, true);
+
+    // All zero counters are an empty system with no-op draw and dispatch
+    // arguments.
+    VkCommandBuffer commandBuffer = beginOneTimeCommands();
+    vkCmdFillBuffer(commandBuffer, counterBuffer, 0, VK_WHOLE_SIZE, 0);
+
+    VkMemoryBarrier memoryBarrier;
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = nullptr;
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    endOneTimeCommands(commandBuffer);
+    // The compute queue does not wait on the graphics one before its first
+    // frame, so the fill has to be done by then.
+    graphicsTimeline.waitForValue(graphicsTimeline.flush());
+
+    // binding 0: source particles, binding 1: target particles, binding 2: counters
+    VkDescriptorSetLayoutBinding bindings[3];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutCreateInfo.pNext = nullptr;
+    descriptorSetLayoutCreateInfo.flags = 0;
+    descriptorSetLayoutCreateInfo.bindingCount = 3;
+    descriptorSetLayoutCreateInfo.pBindings = bindings;
+
+    particleSetLayout = descriptorLayoutCache.createLayout(descriptorSetLayoutCreateInfo);
+
+    simulationPipelineLayout = createParticlePipelineLayout(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ParticleConstants));
+    drawPipelineLayout = createParticlePipelineLayout(VK_SHADER_STAGE_VERTEX_BIT, sizeof(ParticleDrawConstants));
+
+    createSimulationPipelines();
+}
+
+void shutDownParticles()
+{
+    if (drawPipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(device, drawPipeline, nullptr);
+    vkDestroyPipeline(device, finalizePipeline, nullptr);
+    vkDestroyPipeline(device, emitPipeline, nullptr);
+    vkDestroyPipeline(device, simulatePipeline, nullptr);
+    vkDestroyPipelineLayout(device, drawPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(device, simulationPipelineLayout, nullptr);
+
+    freeDeviceMemory(counterBufferMemory);
+    vkDestroyBuffer(device, counterBuffer, nullptr);
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        freeDeviceMemory(particleBufferMemories[i]);
+        vkDestroyBuffer(device, particleBuffers[i], nullptr);
+    }
+}
+
+void recreateParticlePipelines()
+{
+    if (drawPipeline != VK_NULL_HANDLE)
+        deletionQueue.destroyPipeline(drawPipeline);
+    drawPipeline = VK_NULL_HANDLE;
+    deletionQueue.destroyPipeline(finalizePipeline);
+    deletionQueue.destroyPipeline(emitPipeline);
+    deletionQueue.destroyPipeline(simulatePipeline);
+
+    createSimulationPipelines();
+}
+
+void updateParticles(float deltaTime, const glm::mat4 &view, const glm::mat4 &projection)
+{
+    if (simulated)
+    {
+        sourceIndex = 1 - sourceIndex;
+        simulated = false;
+    }
+
+    // A long hitch would otherwise emit its whole backlog in one burst.
+    deltaTime = std::min(deltaTime, 0.1f);
+
+    emitAccumulator += particleSettings.emitRate * deltaTime;
+    uint32_t emitCount = (uint32_t)emitAccumulator;
+    emitAccumulator -= emitCount;
+
+    simulationConstants.emitterPosition[0] = 0.0f;
+    simulationConstants.emitterPosition[1] = 0.0f;
+    simulationConstants.emitterPosition[2] = 0.0f;
+    simulationConstants.deltaTime = deltaTime;
+    simulationConstants.gravity[0] = 0.0f;
+    simulationConstants.gravity[1] = 0.0f;
+    simulationConstants.gravity[2] = -2.0f;
+    simulationConstants.lifetime = particleSettings.lifetime;
+    simulationConstants.capacity = particleSettings.capacity;
+    simulationConstants.emitCount = std::min(emitCount, particleSettings.capacity);
+    simulationConstants.seed = ++frameSeed * 0x9e3779b9u;
+    simulationConstants.speed = particleSettings.speed;
+
+    // The rows of the view matrix are the camera axes in world space.
+    drawConstants.viewProjection = projection * view;
+    drawConstants.cameraRight = glm::vec4(view[0][0], view[1][0], view[2][0], particleSettings.size);
+    drawConstants.cameraUp = glm::vec4(view[0][1], view[1][1], view[2][1], 0.0f);
+}
+
+static VkDescriptorSet allocateParticleSet(uint32_t source)
+{
+    VkDescriptorSet descriptorSet = frameDescriptorAllocators[currentFrame].allocate(particleSetLayout);
+
+    VkDescriptorBufferInfo bufferInfos[3];
+    bufferInfos[0].buffer = particleBuffers[source];
+    bufferInfos[1].buffer = particleBuffers[1 - source];
+    bufferInfos[2].buffer = counterBuffer;
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+    }
+
+    VkWriteDescriptorSet descriptorWrites[3];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].pNext = nullptr;
+        descriptorWrites[i].dstSet = descriptorSet;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[i].pImageInfo = nullptr;
+        descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+        descriptorWrites[i].pTexelBufferView = nullptr;
+    }
+
+    vkUpdateDescriptorSets(device, 3, descriptorWrites, 0, nullptr);
+
+    return descriptorSet;
+}
+
+static void bindSimulation(VkCommandBuffer commandBuffer, VkPipeline pipeline)
+{
+    simulationConstants.sourceIndex = sourceIndex;
+    VkDescriptorSet descriptorSet = allocateParticleSet(sourceIndex);
+
+    COUNT_FRAME_STAT(PipelineBinds, 1);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    COUNT_FRAME_STAT(DescriptorSetBinds, 1);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, simulationPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, simulationPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ParticleConstants), &simulationConstants);
+}
+
+static VkDeviceSize getCounterOffset(uint32_t index)
+{
+    return index * sizeof(ParticleCounter);
+}
+
+// The simulation runs in three compute passes: survivors are compacted into
+// the target buffer, new particles appended behind them, and a single thread
+// writes the indirect arguments. Which buffer is the source flips every frame
+// while the graph stays the same, so every pass declares both as written.
+// Declared after the scene, they overlap it on an async compute queue.
+RenderGraphPass &addParticlePasses(RenderGraph &graph, RenderGraphResource color, RenderGraphResource depth, const RenderGraphImageInfo &colorInfo)
+{
+    bool concurrent = deviceCapabilities.asyncCompute;
+    RenderGraphResource particles[2];
+    particles[0] = graph.importBuffer("particles0", particleBuffers[0], concurrent);
+    particles[1] = graph.importBuffer("particles1", particleBuffers[1], concurrent);
+    RenderGraphResource counters = graph.importBuffer("particleCounters", counterBuffer, concurrent);
+
+    graph.addPass("particleSimulate", RenderGraphQueue::Compute)
+        .read(counters, RenderGraphAccess::IndirectBuffer)
+        .write(particles[0], RenderGraphAccess::StorageWriteCompute)
+        .write(particles[1], RenderGraphAccess::StorageWriteCompute)
+        .write(counters, RenderGraphAccess::StorageWriteCompute)
+        .execute([](VkCommandBuffer commandBuffer) {
+            bindSimulation(commandBuffer, simulatePipeline);
+            COUNT_FRAME_STAT(Dispatches, 1);
+            vkCmdDispatchIndirect(commandBuffer, counterBuffer, getCounterOffset(sourceIndex) + offsetof(ParticleCounter, dispatch));
+        });
+
+    graph.addPass("particleEmit", RenderGraphQueue::Compute)
+        .write(particles[0], RenderGraphAccess::StorageWriteCompute)
+        .write(particles[1], RenderGraphAccess::StorageWriteCompute)
+        .write(counters, RenderGraphAccess::StorageWriteCompute)
+        .execute([](VkCommandBuffer commandBuffer) {
+            if (simulationConstants.emitCount == 0)
+                return;
+            bindSimulation(commandBuffer, emitPipeline);
+            COUNT_FRAME_STAT(Dispatches, 1);
+            vkCmdDispatch(commandBuffer, (simulationConstants.emitCount + PARTICLE_EMIT_GROUP_SIZE - 1) / PARTICLE_EMIT_GROUP_SIZE, 1, 1);
+        });
+
+    graph.addPass("particleFinalize", RenderGraphQueue::Compute)
+        .write(particles[0], RenderGraphAccess::StorageWriteCompute)
+        .write(particles[1], RenderGraphAccess::StorageWriteCompute)
+        .write(counters, RenderGraphAccess::StorageWriteCompute)
+        .execute([](VkCommandBuffer commandBuffer) {
+            bindSimulation(commandBuffer, finalizePipeline);
+            COUNT_FRAME_STAT(Dispatches, 1);
+            vkCmdDispatch(commandBuffer, 1, 1, 1);
+            simulated = true;
+        });
+
+    return graph.addPass("particles", RenderGraphQueue::Graphics)
+        .read(particles[0], RenderGraphAccess::StorageReadGraphics)
+        .read(particles[1], RenderGraphAccess::StorageReadGraphics)
+        .read(counters, RenderGraphAccess::IndirectBuffer)
+        .read(depth, RenderGraphAccess::DepthAttachmentRead)
+        .write(color, RenderGraphAccess::ColorAttachment)
+        .execute([&graph, colorInfo](VkCommandBuffer commandBuffer) {
+            if (drawPipeline == VK_NULL_HANDLE)
+                drawPipeline = createDrawPipeline(graph.getRenderPass("particles"), colorInfo.samples);
+
+            COUNT_FRAME_STAT(PipelineBinds, 1);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline);
+
+            VkViewport viewport;
+            viewport.x = 0.0f;
+            viewport.y = 0.0f;
+            viewport.width = colorInfo.width;
+            viewport.height = colorInfo.height;
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+            VkRect2D scissor;
+            scissor.offset = {0, 0};
+            scissor.extent = {colorInfo.width, colorInfo.height};
+            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+            // The simulation just wrote the other buffer.
+            VkDescriptorSet descriptorSet = allocateParticleSet(1 - sourceIndex);
+            COUNT_FRAME_STAT(DescriptorSetBinds, 1);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+            vkCmdPushConstants(commandBuffer, drawPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ParticleDrawConstants), &drawConstants);
+
+            COUNT_FRAME_STAT(Draws, 1);
+            vkCmdDrawIndirect(commandBuffer, counterBuffer, getCounterOffset(1 - sourceIndex) + offsetof(ParticleCounter, draw), 1, sizeof(VkDrawIndirectCommand));
+        });
+}
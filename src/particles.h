@@ -0,0 +1,35 @@
+#pragma once
+
+#include "engine.h"
+#include "renderGraph.h"
+
+#include <glm/glm.hpp>
+
+// GPU particles. Emission, simulation and compaction run in compute shaders
+// that ping-pong between two storage buffers; the alive count is turned into
+// indirect draw and dispatch arguments on the GPU, so nothing is read back.
+struct ParticleSettings
+{
+    bool enabled = true;
+
+    // Fixed once initParticles has run.
+    uint32_t capacity = 1 << 20;
+
+    float emitRate = 100000.0f;
+    float lifetime = 4.0f;
+    float speed = 1.5f;
+    float size = 0.005f;
+};
+
+extern ParticleSettings particleSettings;
+
+void initParticles();
+void shutDownParticles();
+void recreateParticlePipelines();
+
+void updateParticles(float deltaTime, const glm::mat4 &view, const glm::mat4 &projection);
+
+// Adds the simulation passes and a pass drawing the particles into color,
+// depth tested against depth. The draw pass is returned so the caller can
+// resolve from it.
+RenderGraphPass &addParticlePasses(RenderGraph &graph, RenderGraphResource color, RenderGraphResource depth, const RenderGraphImageInfo &colorInfo);
@@ -0,0 +1,159 @@
+#include "pipelineCache.h"
+#include "deletionQueue.h"
+#include "shaderManager.h"
+
+#include <fstream>
+
+VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+static std::string pipelineCacheFileName;
+
+// Drivers are supposed to reject foreign cache data, but not all of them do,
+// so only hand over data written by this exact device and driver.
+static bool isPipelineCacheCompatible(const std::vector<char> &data)
+{
+    if (data.size() < 16 + VK_UUID_SIZE)
+        return false;
+
+    VkPhysicalDeviceProperties deviceProps;
+    vkGetPhysicalDeviceProperties(physicalDevices[0], &deviceProps);
+
+    uint32_t header[4];
+    memcpy(header, data.data(), sizeof(header));
+    return header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE && header[2] == deviceProps.vendorID && header[3] == deviceProps.deviceID &&
+           memcmp(data.data() + 16, deviceProps.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void initPipelineCache(const std::string &fileName)
+{
+    pipelineCacheFileName = fileName;
+
+    std::vector<char> data;
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (file)
+    {
+        data.resize((size_t)file.tellg());
+        file.seekg(0);
+        file.read(data.data(), data.size());
+    }
+    if (!isPipelineCacheCompatible(data))
+        data.clear();
+
+    VkPipelineCacheCreateInfo pipelineCacheCreateInfo;
+    pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheCreateInfo.pNext = nullptr;
+    pipelineCacheCreateInfo.flags = 0;
+    pipelineCacheCreateInfo.initialDataSize = data.size();
+    pipelineCacheCreateInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    VkResult result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
+    ASSERT_VULKAN(result);
+}
+
+void shutDownPipelineCache()
+{
+    size_t dataSize = 0;
+    vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr);
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) == VK_SUCCESS)
+    {
+        std::ofstream file(pipelineCacheFileName, std::ios::binary);
+        file.write(data.data(), dataSize);
+    }
+
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+}
+
+void SpecializationConstants::set(uint32_t constantId, uint32_t value)
+{
+    VkSpecializationMapEntry mapEntry;
+    mapEntry.constantID = constantId;
+    mapEntry.offset = data.size() * sizeof(uint32_t);
+    mapEntry.size = sizeof(uint32_t);
+    mapEntries.push_back(mapEntry);
+    data.push_back(value);
+}
+
+void SpecializationConstants::set(uint32_t constantId, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    set(constantId, bits);
+}
+
+void SpecializationConstants::set(uint32_t constantId, bool value)
+{
+    set(constantId, (uint32_t)(value ? VK_TRUE : VK_FALSE));
+}
+
+const VkSpecializationInfo *SpecializationConstants::getInfo()
+{
+    specializationInfo.mapEntryCount = mapEntries.size();
+    specializationInfo.pMapEntries = mapEntries.data();
+    specializationInfo.dataSize = data.size() * sizeof(uint32_t);
+    specializationInfo.pData = data.data();
+    return &specializationInfo;
+}
+
+PipelinePermutations::PipelinePermutations(std::function<VkPipeline(uint32_t features)> createFunction)
+    : createFunction(createFunction)
+{
+}
+
+VkPipeline PipelinePermutations::get(uint32_t features)
+{
+    auto it = pipelines.find(features);
+    if (it != pipelines.end())
+        return it->second;
+
+    VkPipeline pipeline = createFunction(features);
+    pipelines[features] = pipeline;
+    return pipeline;
+}
+
+void PipelinePermutations::invalidate()
+{
+    for (auto &entry : pipelines)
+    {
+        deletionQueue.destroyPipeline(entry.second);
+    }
+    pipelines.clear();
+}
+
+void PipelinePermutations::destroy()
+{
+    for (auto &entry : pipelines)
+    {
+        vkDestroyPipeline(device, entry.second, nullptr);
+    }
+    pipelines.clear();
+}
+
+VkPipeline createComputePipeline(const std::string &shaderName, VkPipelineLayout layout)
+{
+    VkShaderModule shaderModule;
+    createShaderModule(getShaderCode(shaderName), &shaderModule);
+
+    VkComputePipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.pNext = nullptr;
+    pipelineCreateInfo.flags = 0;
+    pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineCreateInfo.stage.pNext = nullptr;
+    pipelineCreateInfo.stage.flags = 0;
+    pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineCreateInfo.stage.module = shaderModule;
+    pipelineCreateInfo.stage.pName = "main";
+    pipelineCreateInfo.stage.pSpecializationInfo = nullptr;
+    pipelineCreateInfo.layout = layout;
+    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+    ASSERT_VULKAN(result);
+
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+
+    return pipeline;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "engine.h"
+
+#include <functional>
+#include <unordered_map>
+
+// Driver pipeline cache, loaded from and saved to disk so pipelines compiled
+// in earlier runs come back quickly.
+extern VkPipelineCache pipelineCache;
+
+void initPipelineCache(const std::string &fileName);
+void shutDownPipelineCache();
+
+// Builds a compute pipeline from the shader manager's SPIR-V for shaderName.
+VkPipeline createComputePipeline(const std::string &shaderName, VkPipelineLayout layout);
+
+// Collects specialization constant values and the map entries describing them.
+class SpecializationConstants
+{
+  public:
+    void set(uint32_t constantId, uint32_t value);
+    void set(uint32_t constantId, float value);
+    void set(uint32_t constantId, bool value);
+
+    const VkSpecializationInfo *getInfo();
+
+  private:
+    std::vector<VkSpecializationMapEntry> mapEntries;
+    std::vector<uint32_t> data;
+    VkSpecializationInfo specializationInfo;
+};
+
+// Lazily creates one pipeline per combination of feature flags and keeps it
+// for reuse. invalidate() drops every permutation, e.g. after a shader reload.
+class PipelinePermutations
+{
+  public:
+    PipelinePermutations(std::function<VkPipeline(uint32_t features)> createFunction);
+
+    VkPipeline get(uint32_t features);
+    void invalidate();
+    void destroy();
+
+  private:
+    std::function<VkPipeline(uint32_t features)> createFunction;
+    std::unordered_map<uint32_t, VkPipeline> pipelines;
+};
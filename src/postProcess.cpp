@@ -0,0 +1,333 @@
+#include "postProcess.h"
+#include "descriptorAllocator.h"
+#include "deletionQueue.h"
+#include "frameStats.h"
+#include "pipelineCache.h"
+
+#include <algorithm>
+
+PostProcessSettings postProcessSettings;
+
+static const VkFormat POST_PROCESS_LDR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+static const uint32_t POST_PROCESS_TONEMAP_BIT = 0x00000001;
+
+// Matches the push constant block of the post-processing shaders.
+struct PostProcessConstants
+{
+    float inputTexelSize[2];
+    float threshold;
+    float strength;
+    float exposure;
+    uint32_t flags;
+};
+
+static VkSampler postProcessSampler;
+static VkDescriptorSetLayout postProcessSetLayout;
+static VkPipelineLayout postProcessPipelineLayout;
+static VkPipeline downsamplePipeline = VK_NULL_HANDLE;
+static VkPipeline upsamplePipeline = VK_NULL_HANDLE;
+static VkPipeline tonemapPipeline = VK_NULL_HANDLE;
+static VkPipeline fxaaPipeline = VK_NULL_HANDLE;
+static VkPipeline upscalePipeline = VK_NULL_HANDLE;
+
+static void createPostProcessPipelines()
+{
+    downsamplePipeline = createComputePipeline("postDownsample.comp", postProcessPipelineLayout);
+    upsamplePipeline = createComputePipeline("postUpsample.comp", postProcessPipelineLayout);
+    tonemapPipeline = createComputePipeline("postTonemap.comp", postProcessPipelineLayout);
+    fxaaPipeline = createComputePipeline("postFxaa.comp", postProcessPipelineLayout);
+    upscalePipeline = createComputePipeline("postUpscale.comp", postProcessPipelineLayout);
+}
+
+void initPostProcess()
+{
+    VkSamplerCreateInfo samplerCreateInfo;
+    samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerCreateInfo.pNext = nullptr;
+    samplerCreateInfo.flags = 0;
+    samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.mipLodBias = 0.0f;
+    samplerCreateInfo.anisotropyEnable = VK_FALSE;
+    samplerCreateInfo.maxAnisotropy = 1.0f;
+    samplerCreateInfo.compareEnable = VK_FALSE;
+    samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerCreateInfo.minLod = 0.0f;
+    samplerCreateInfo.maxLod = 0.0f;
+    samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+    samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+
+    VkResult result = vkCreateSampler(device, &samplerCreateInfo, nullptr, &postProcessSampler);
+    ASSERT_VULKAN(result);
+
+    // binding 0: input, binding 1: second input, binding 2: output
+    VkDescriptorSetLayoutBinding bindings[3];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i < 2 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutCreateInfo.pNext = nullptr;
+    descriptorSetLayoutCreateInfo.flags = 0;
+    descriptorSetLayoutCreateInfo.bindingCount = 3;
+    descriptorSetLayoutCreateInfo.pBindings = bindings;
+
+    postProcessSetLayout = descriptorLayoutCache.createLayout(descriptorSetLayoutCreateInfo);
+
+    VkPushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PostProcessConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.pNext = nullptr;
+    pipelineLayoutCreateInfo.flags = 0;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &postProcessSetLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &postProcessPipelineLayout);
+    ASSERT_VULKAN(result);
+
+    createPostProcessPipelines();
+}
+
+void shutDownPostProcess()
+{
+    vkDestroyPipeline(device, upscalePipeline, nullptr);
+    vkDestroyPipeline(device, fxaaPipeline, nullptr);
+    vkDestroyPipeline(device, tonemapPipeline, nullptr);
+    vkDestroyPipeline(device, upsamplePipeline, nullptr);
+    vkDestroyPipeline(device, downsamplePipeline, nullptr);
+    vkDestroyPipelineLayout(device, postProcessPipelineLayout, nullptr);
+    vkDestroySampler(device, postProcessSampler, nullptr);
+}
+
+void recreatePostProcessPipelines()
+{
+    deletionQueue.destroyPipeline(upscalePipeline);
+    deletionQueue.destroyPipeline(fxaaPipeline);
+    deletionQueue.destroyPipeline(tonemapPipeline);
+    deletionQueue.destroyPipeline(upsamplePipeline);
+    deletionQueue.destroyPipeline(downsamplePipeline);
+
+    createPostProcessPipelines();
+}
+
+static void dispatchPostProcess(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkImageView input, VkImageView secondInput, VkImageView output,
+                                const PostProcessConstants &constants, uint32_t groupCountX, uint32_t groupCountY)
+{
+    VkDescriptorSet descriptorSet = frameDescriptorAllocators[currentFrame].allocate(postProcessSetLayout);
+
+    VkDescriptorImageInfo imageInfos[3];
+    imageInfos[0].sampler = postProcessSampler;
+    imageInfos[0].imageView = input;
+    imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfos[1].sampler = postProcessSampler;
+    imageInfos[1].imageView = secondInput;
+    imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfos[2].sampler = VK_NULL_HANDLE;
+    imageInfos[2].imageView = output;
+    imageInfos[2].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkWriteDescriptorSet descriptorWrites[3];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].pNext = nullptr;
+        descriptorWrites[i].dstSet = descriptorSet;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].descriptorType = i < 2 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptorWrites[i].pImageInfo = &imageInfos[i];
+        descriptorWrites[i].pBufferInfo = nullptr;
+        descriptorWrites[i].pTexelBufferView = nullptr;
+    }
+
+    vkUpdateDescriptorSets(device, 3, descriptorWrites, 0, nullptr);
+
+    COUNT_FRAME_STAT(PipelineBinds, 1);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    COUNT_FRAME_STAT(DescriptorSetBinds, 1);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, postProcessPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, postProcessPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PostProcessConstants), &constants);
+    COUNT_FRAME_STAT(Dispatches, 1);
+    vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+}
+
+static PostProcessConstants getConstants(uint32_t inputWidth, uint32_t inputHeight)
+{
+    PostProcessConstants constants;
+    constants.inputTexelSize[0] = 1.0f / inputWidth;
+    constants.inputTexelSize[1] = 1.0f / inputHeight;
+    constants.threshold = 0.0f;
+    constants.strength = 0.0f;
+    constants.exposure = postProcessSettings.exposure;
+    constants.flags = postProcessSettings.tonemap ? POST_PROCESS_TONEMAP_BIT : 0;
+    return constants;
+}
+
+static uint32_t getGroupCount(uint32_t size, uint32_t groupSize)
+{
+    return (size + groupSize - 1) / groupSize;
+}
+
+// Bloom is a chain of half resolution downsamples followed by upsamples that
+// add each level back onto the next larger one. Every level is its own
+// transient image, so the render graph can alias the short-lived ones.
+static RenderGraphResource addBloomPasses(RenderGraph &graph, RenderGraphResource hdr, uint32_t width, uint32_t height)
+{
+    uint32_t levelCount = std::max(postProcessSettings.bloomLevels, 2u);
+
+    std::vector<RenderGraphResource> downsampled;
+    std::vector<VkExtent2D> extents;
+    RenderGraphResource input = hdr;
+    VkExtent2D inputExtent = {width, height};
+    for (uint32_t i = 0; i < levelCount; i++)
+    {
+        RenderGraphImageInfo info;
+        info.format = POST_PROCESS_HDR_FORMAT;
+        info.width = std::max(inputExtent.width / 2, 1u);
+        info.height = std::max(inputExtent.height / 2, 1u);
+        RenderGraphResource output = graph.createImage("bloomDown" + std::to_string(i), info);
+
+        PostProcessConstants constants = getConstants(inputExtent.width, inputExtent.height);
+        constants.threshold = i == 0 ? postProcessSettings.bloomThreshold : 0.0f;
+        graph.addPass("bloomDown" + std::to_string(i), RenderGraphQueue::Compute)
+            .read(input, RenderGraphAccess::SampledCompute)
+            .write(output, RenderGraphAccess::StorageWriteCompute)
+            .execute([&graph, input, output, constants, info](VkCommandBuffer commandBuffer) {
+                dispatchPostProcess(commandBuffer, downsamplePipeline, graph.getImageView(input), graph.getImageView(input), graph.getImageView(output),
+                                    constants, getGroupCount(info.width, 8), getGroupCount(info.height, 8));
+            });
+
+        downsampled.push_back(output);
+        extents.push_back({info.width, info.height});
+        input = output;
+        inputExtent = {info.width, info.height};
+    }
+
+    RenderGraphResource lower = downsampled[levelCount - 1];
+    for (int i = levelCount - 2; i >= 0; i--)
+    {
+        RenderGraphImageInfo info;
+        info.format = POST_PROCESS_HDR_FORMAT;
+        info.width = extents[i].width;
+        info.height = extents[i].height;
+        RenderGraphResource output = graph.createImage("bloomUp" + std::to_string(i), info);
+
+        PostProcessConstants constants = getConstants(extents[i + 1].width, extents[i + 1].height);
+        RenderGraphResource current = downsampled[i];
+        graph.addPass("bloomUp" + std::to_string(i), RenderGraphQueue::Compute)
+            .read(lower, RenderGraphAccess::SampledCompute)
+            .read(current, RenderGraphAccess::SampledCompute)
+            .write(output, RenderGraphAccess::StorageWriteCompute)
+            .execute([&graph, lower, current, output, constants, info](VkCommandBuffer commandBuffer) {
+                dispatchPostProcess(commandBuffer, upsamplePipeline, graph.getImageView(lower), graph.getImageView(current), graph.getImageView(output),
+                                    constants, getGroupCount(info.width, 8), getGroupCount(info.height, 8));
+            });
+
+        lower = output;
+    }
+
+    return lower;
+}
+
+void addPostProcessPasses(RenderGraph &graph, RenderGraphResource hdr, RenderGraphResource output, uint32_t width, uint32_t height, uint32_t outputWidth,
+                          uint32_t outputHeight)
+{
+    RenderGraphResource bloom = hdr;
+    float bloomStrength = 0.0f;
+    if (postProcessSettings.bloom)
+    {
+        bloom = addBloomPasses(graph, hdr, width, height);
+        bloomStrength = postProcessSettings.bloomStrength;
+    }
+
+    RenderGraphImageInfo ldrInfo;
+    ldrInfo.format = POST_PROCESS_LDR_FORMAT;
+    ldrInfo.width = width;
+    ldrInfo.height = height;
+
+    // Tonemapping also converts to LDR, so the pass always runs; switching it
+    // off only replaces the curve with a clamp.
+    RenderGraphResource ldr = graph.createImage("ldr", ldrInfo);
+    PostProcessConstants tonemapConstants = getConstants(width, height);
+    tonemapConstants.strength = bloomStrength;
+    RenderGraphPass &tonemapPass = graph.addPass("tonemap", RenderGraphQueue::Compute);
+    tonemapPass.read(hdr, RenderGraphAccess::SampledCompute);
+    if (bloom != hdr)
+        tonemapPass.read(bloom, RenderGraphAccess::SampledCompute);
+    tonemapPass.write(ldr, RenderGraphAccess::StorageWriteCompute)
+        .execute([&graph, hdr, bloom, ldr, tonemapConstants, width, height](VkCommandBuffer commandBuffer) {
+            dispatchPostProcess(commandBuffer, tonemapPipeline, graph.getImageView(hdr), graph.getImageView(bloom), graph.getImageView(ldr),
+                                tonemapConstants, getGroupCount(width, 8), getGroupCount(height, 8));
+        });
+
+    RenderGraphResource finalImage = ldr;
+    if (postProcessSettings.fxaa)
+    {
+        finalImage = graph.createImage("antiAliased", ldrInfo);
+        PostProcessConstants fxaaConstants = getConstants(width, height);
+        graph.addPass("fxaa", RenderGraphQueue::Compute)
+            .read(ldr, RenderGraphAccess::SampledCompute)
+            .write(finalImage, RenderGraphAccess::StorageWriteCompute)
+            .execute([&graph, ldr, finalImage, fxaaConstants, width, height](VkCommandBuffer commandBuffer) {
+                dispatchPostProcess(commandBuffer, fxaaPipeline, graph.getImageView(ldr), graph.getImageView(ldr), graph.getImageView(finalImage),
+                                    fxaaConstants, getGroupCount(width, 16), getGroupCount(height, 16));
+            });
+    }
+
+    // A blit would only filter bilinearly, the upscale pass uses a bicubic
+    // filter.
+    if (width != outputWidth || height != outputHeight)
+    {
+        RenderGraphImageInfo upscaledInfo = ldrInfo;
+        upscaledInfo.width = outputWidth;
+        upscaledInfo.height = outputHeight;
+        RenderGraphResource upscaled = graph.createImage("upscaled", upscaledInfo);
+        PostProcessConstants upscaleConstants = getConstants(width, height);
+        RenderGraphResource source = finalImage;
+        graph.addPass("upscale", RenderGraphQueue::Compute)
+            .read(source, RenderGraphAccess::SampledCompute)
+            .write(upscaled, RenderGraphAccess::StorageWriteCompute)
+            .execute([&graph, source, upscaled, upscaleConstants, outputWidth, outputHeight](VkCommandBuffer commandBuffer) {
+                dispatchPostProcess(commandBuffer, upscalePipeline, graph.getImageView(source), graph.getImageView(source), graph.getImageView(upscaled),
+                                    upscaleConstants, getGroupCount(outputWidth, 8), getGroupCount(outputHeight, 8));
+            });
+        finalImage = upscaled;
+    }
+
+    // Swapchain formats rarely support storage, so the result is blitted over.
+    graph.addPass("blit", RenderGraphQueue::Graphics)
+        .read(finalImage, RenderGraphAccess::TransferSrc)
+        .write(output, RenderGraphAccess::TransferDst)
+        .execute([&graph, finalImage, output, outputWidth, outputHeight](VkCommandBuffer commandBuffer) {
+            VkImageBlit imageBlit;
+            imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            imageBlit.srcSubresource.mipLevel = 0;
+            imageBlit.srcSubresource.baseArrayLayer = 0;
+            imageBlit.srcSubresource.layerCount = 1;
+            imageBlit.srcOffsets[0] = {0, 0, 0};
+            imageBlit.srcOffsets[1] = {(int32_t)outputWidth, (int32_t)outputHeight, 1};
+            imageBlit.dstSubresource = imageBlit.srcSubresource;
+            imageBlit.dstOffsets[0] = {0, 0, 0};
+            imageBlit.dstOffsets[1] = {(int32_t)outputWidth, (int32_t)outputHeight, 1};
+
+            vkCmdBlitImage(commandBuffer, graph.getImage(finalImage), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, graph.getImage(output), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           1, &imageBlit, VK_FILTER_NEAREST);
+        });
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "engine.h"
+#include "renderGraph.h"
+
+// Compute post-processing between the HDR scene target and the swapchain.
+// Passes that are switched off are simply not added to the render graph, so
+// changing a toggle needs a graph rebuild.
+struct PostProcessSettings
+{
+    bool bloom = true;
+    bool tonemap = true;
+    bool fxaa = true;
+
+    uint32_t bloomLevels = 5;
+    float bloomThreshold = 1.0f;
+    float bloomStrength = 0.05f;
+    float exposure = 1.0f;
+};
+
+extern PostProcessSettings postProcessSettings;
+
+const VkFormat POST_PROCESS_HDR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+void initPostProcess();
+void shutDownPostProcess();
+void recreatePostProcessPipelines();
+
+// Adds the enabled passes reading hdr and ending with a blit into output. hdr
+// is width x height, and is upscaled when output is larger.
+void addPostProcessPasses(RenderGraph &graph, RenderGraphResource hdr, RenderGraphResource output, uint32_t width, uint32_t height, uint32_t outputWidth,
+                          uint32_t outputHeight);
@@ -0,0 +1,1248 @@
+#include "renderGraph.h"
+#include "deletionQueue.h"
+#include "memoryBudget.h"
+#include "submission.h"
+
+#include <algorithm>
+
+struct AccessInfo
+{
+    VkImageLayout layout;
+    VkPipelineStageFlags stageMask;
+    VkAccessFlags accessMask;
+    VkImageUsageFlags imageUsage;
+};
+
+static const VkAccessFlags WRITE_ACCESS_MASK = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                               VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+static AccessInfo getAccessInfo(RenderGraphAccess access)
+{
+    switch (access)
+    {
+    case RenderGraphAccess::ColorAttachment:
+        return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+    case RenderGraphAccess::DepthAttachment:
+        return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+    case RenderGraphAccess::DepthAttachmentRead:
+        return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+    case RenderGraphAccess::ResolveAttachment:
+        return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+    case RenderGraphAccess::SampledFragment:
+        return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_SAMPLED_BIT};
+    case RenderGraphAccess::SampledCompute:
+        return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_SAMPLED_BIT};
+    case RenderGraphAccess::StorageReadGraphics:
+        return {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_STORAGE_BIT};
+    case RenderGraphAccess::StorageReadTaskShader:
+        return {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_STORAGE_BIT};
+    case RenderGraphAccess::StorageReadCompute:
+        return {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_STORAGE_BIT};
+    case RenderGraphAccess::StorageWriteCompute:
+        return {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_USAGE_STORAGE_BIT};
+    case RenderGraphAccess::VertexBuffer:
+        return {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0};
+    case RenderGraphAccess::IndexBuffer:
+        return {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, 0};
+    case RenderGraphAccess::IndirectBuffer:
+        return {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, 0};
+    case RenderGraphAccess::TransferSrc:
+        return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+    case RenderGraphAccess::TransferDst:
+        return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+    }
+    throw std::runtime_error("Unknown render graph access");
+}
+
+static bool isAttachmentAccess(RenderGraphAccess access)
+{
+    return access == RenderGraphAccess::ColorAttachment || access == RenderGraphAccess::DepthAttachment || access == RenderGraphAccess::DepthAttachmentRead ||
+           access == RenderGraphAccess::ResolveAttachment;
+}
+
+static bool findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t &memoryTypeIndex)
+{
+    VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevices[0], &physicalDeviceMemoryProperties);
+
+    for (uint32_t i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; i++)
+    {
+        if ((typeFilter & (1 << i)) && (physicalDeviceMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            memoryTypeIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isDepthFormat(VkFormat format)
+{
+    return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_D32_SFLOAT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+static VkImageAspectFlags getAspectMask(VkFormat format)
+{
+    return isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+}
+
+RenderGraphPass &RenderGraphPass::read(RenderGraphResource resource, RenderGraphAccess access)
+{
+    uses.push_back({resource, access, false});
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::write(RenderGraphResource resource, RenderGraphAccess access)
+{
+    uses.push_back({resource, access, true});
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::clear(RenderGraphResource resource, VkClearValue clearValue)
+{
+    clearValues[resource] = clearValue;
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::resolve(RenderGraphResource source, RenderGraphResource target)
+{
+    resolves[source] = target;
+    return write(target, RenderGraphAccess::ResolveAttachment);
+}
+
+RenderGraphPass &RenderGraphPass::sideEffects()
+{
+    hasSideEffects = true;
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::execute(std::function<void(VkCommandBuffer commandBuffer)> executeFunction)
+{
+    this->executeFunction = executeFunction;
+    return *this;
+}
+
+RenderGraphResource RenderGraph::importImage(const std::string &name, const RenderGraphImageInfo &info, VkImageLayout initialLayout,
+                                             VkPipelineStageFlags initialStageMask, VkImageLayout finalLayout)
+{
+    Resource resource;
+    resource.name = name;
+    resource.isImage = true;
+    resource.imported = true;
+    resource.info = info;
+    resource.initialLayout = initialLayout;
+    resource.initialStageMask = initialStageMask;
+    resource.finalLayout = finalLayout;
+    resources.push_back(resource);
+    return resources.size() - 1;
+}
+
+RenderGraphResource RenderGraph::importBuffer(const std::string &name, VkBuffer buffer, bool concurrent)
+{
+    Resource resource;
+    resource.name = name;
+    resource.isImage = false;
+    resource.imported = true;
+    resource.concurrent = concurrent;
+    resource.buffer = buffer;
+    resources.push_back(resource);
+    return resources.size() - 1;
+}
+
+RenderGraphResource RenderGraph::createImage(const std::string &name, const RenderGraphImageInfo &info)
+{
+    Resource resource;
+    resource.name = name;
+    resource.isImage = true;
+    resource.imported = false;
+    resource.info = info;
+    resources.push_back(resource);
+    return resources.size() - 1;
+}
+
+void RenderGraph::setImportedImage(RenderGraphResource resource, VkImage image, VkImageView imageView)
+{
+    resources[resource].image = image;
+    resources[resource].imageView = imageView;
+}
+
+void RenderGraph::setImportedBuffer(RenderGraphResource resource, VkBuffer buffer)
+{
+    resources[resource].buffer = buffer;
+}
+
+RenderGraphPass &RenderGraph::addPass(const std::string &name, RenderGraphQueue queue)
+{
+    passes.push_back(std::unique_ptr<RenderGraphPass>(new RenderGraphPass()));
+    passes.back()->name = name;
+    passes.back()->queue = queue;
+    return *passes.back();
+}
+
+void RenderGraph::compile()
+{
+    cullPasses();
+    scheduleBatches();
+    allocateTransients();
+    placeBarriers();
+    createRenderPasses();
+    createTimestampQueries();
+    createCommandBuffers();
+}
+
+// Reference counting from the outputs backwards: a pass survives if one of
+// the resources it writes is read by a surviving pass, is imported, or if
+// the pass is marked as having side effects.
+void RenderGraph::cullPasses()
+{
+    for (uint32_t i = 0; i < passes.size(); i++)
+    {
+        for (const RenderGraphPass::Use &use : passes[i]->uses)
+        {
+            if (use.write)
+            {
+                passes[i]->refCount++;
+                resources[use.resource].writers.push_back(i);
+            }
+            else
+            {
+                resources[use.resource].refCount++;
+            }
+        }
+    }
+
+    std::vector<RenderGraphResource> unreferenced;
+    for (RenderGraphResource i = 0; i < resources.size(); i++)
+    {
+        if (resources[i].imported)
+            resources[i].refCount++;
+        if (resources[i].refCount == 0)
+            unreferenced.push_back(i);
+    }
+
+    auto cullPass = [&](RenderGraphPass &pass) {
+        pass.culled = true;
+        for (const RenderGraphPass::Use &use : pass.uses)
+        {
+            if (!use.write && --resources[use.resource].refCount == 0)
+                unreferenced.push_back(use.resource);
+        }
+    };
+
+    for (auto &pass : passes)
+    {
+        if (pass->refCount == 0 && !pass->hasSideEffects)
+            cullPass(*pass);
+    }
+
+    while (!unreferenced.empty())
+    {
+        Resource &resource = resources[unreferenced.back()];
+        unreferenced.pop_back();
+
+        for (uint32_t writer : resource.writers)
+        {
+            RenderGraphPass &pass = *passes[writer];
+            if (pass.culled || pass.hasSideEffects)
+                continue;
+            if (--pass.refCount == 0)
+                cullPass(pass);
+        }
+    }
+
+    for (uint32_t i = 0; i < passes.size(); i++)
+    {
+        if (passes[i]->culled)
+            continue;
+
+        for (const RenderGraphPass::Use &use : passes[i]->uses)
+        {
+            Resource &resource = resources[use.resource];
+            if (resource.firstPass < 0)
+                resource.firstPass = i;
+            resource.lastPass = i;
+            resource.usage |= getAccessInfo(use.access).imageUsage;
+            if (!isAttachmentAccess(use.access) || use.access == RenderGraphAccess::ResolveAttachment)
+                resource.attachmentOnly = false;
+        }
+    }
+
+    // Attachments that live inside a single render pass never reach memory on
+    // tiled GPUs, so they can be backed by lazily allocated memory.
+    for (Resource &resource : resources)
+    {
+        if (resource.isImage && !resource.imported && resource.attachmentOnly && resource.firstPass >= 0 && resource.firstPass == resource.lastPass)
+            resource.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    }
+}
+
+// Compute passes move to the async compute queue unless they touch imported
+// resources owned by the graphics queue, i.e. anything but concurrent buffers. Hazards are found by
+// walking the frame twice: the first walk only leaves behind what the previous
+// frame did last, so resources reused across frames are covered as well.
+// Only hazards between the two queues need a semaphore wait, barriers handle
+// the rest.
+void RenderGraph::scheduleBatches()
+{
+    for (uint32_t i = 0; i < passes.size(); i++)
+    {
+        RenderGraphPass &pass = *passes[i];
+        if (pass.culled)
+            continue;
+
+        pass.async = pass.queue == RenderGraphQueue::Compute && deviceCapabilities.asyncCompute;
+        for (const RenderGraphPass::Use &use : pass.uses)
+        {
+            if (resources[use.resource].imported && !resources[use.resource].concurrent)
+                pass.async = false;
+        }
+
+        if (batches.empty() || batches.back().async != pass.async)
+        {
+            Batch batch;
+            batch.async = pass.async;
+            batch.firstPass = i;
+            batches.push_back(batch);
+        }
+        batches.back().endPass = i + 1;
+        pass.batch = batches.size() - 1;
+
+        for (const RenderGraphPass::Use &use : pass.uses)
+        {
+            resources[use.resource].queueMask |= pass.async ? 2 : 1;
+        }
+    }
+
+    // The frame ends on the graphics queue, after the final transitions.
+    if (batches.empty() || batches.back().async)
+    {
+        Batch batch;
+        batch.async = false;
+        batch.firstPass = passes.size();
+        batch.endPass = passes.size();
+        batches.push_back(batch);
+    }
+
+    struct PassUse
+    {
+        uint32_t pass;
+        bool previousFrame;
+    };
+    std::vector<std::vector<PassUse>> writers(resources.size());
+    std::vector<std::vector<PassUse>> readers(resources.size());
+    std::vector<VkImageLayout> layouts(resources.size(), VK_IMAGE_LAYOUT_UNDEFINED);
+
+    for (uint32_t walk = 0; walk < 2; walk++)
+    {
+        bool previousFrame = walk == 0;
+        if (!previousFrame)
+        {
+            for (RenderGraphResource i = 0; i < resources.size(); i++)
+            {
+                if (resources[i].isImage && !resources[i].imported)
+                    layouts[i] = VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+        }
+
+        for (uint32_t i = 0; i < passes.size(); i++)
+        {
+            RenderGraphPass &pass = *passes[i];
+            if (pass.culled)
+                continue;
+            Batch &batch = batches[pass.batch];
+
+            auto dependOn = [&](const PassUse &other) {
+                if (previousFrame || passes[other.pass]->async == pass.async)
+                    return;
+                int &waitBatch = other.previousFrame ? batch.previousFrameWaitBatch : batch.waitBatch;
+                waitBatch = std::max(waitBatch, (int)passes[other.pass]->batch);
+            };
+
+            for (const RenderGraphPass::Use &use : pass.uses)
+            {
+                RenderGraphResource resource = use.resource;
+                VkImageLayout layout = getAccessInfo(use.access).layout;
+                bool exclusive = use.write || (resources[resource].isImage && layouts[resource] != layout);
+
+                for (const PassUse &writer : writers[resource])
+                {
+                    dependOn(writer);
+                }
+                if (exclusive)
+                {
+                    for (const PassUse &reader : readers[resource])
+                    {
+                        dependOn(reader);
+                    }
+                    writers[resource] = {{i, previousFrame}};
+                    readers[resource].clear();
+                }
+                else
+                {
+                    readers[resource].push_back({i, previousFrame});
+                }
+                layouts[resource] = layout;
+            }
+        }
+    }
+
+    // Everything the frame submitted has to be done once the graphics queue
+    // is, the deletion queue and the per-frame allocators rely on that.
+    for (int i = batches.size() - 1; i >= 0; i--)
+    {
+        if (batches[i].async)
+        {
+            batches.back().waitBatch = std::max(batches.back().waitBatch, i);
+            break;
+        }
+    }
+}
+
+// Transient images are created without memory, then placed greedily into
+// memory slots: an image reuses a slot once the previous occupant's last
+// pass is done. Each slot becomes one allocation sized for its largest image.
+// Images used by both queues get a slot of their own, so aliasing never needs
+// synchronization across queues.
+void RenderGraph::allocateTransients()
+{
+    uint32_t queueFamilyIndices[] = {0, deviceCapabilities.computeQueueFamily};
+
+    std::vector<RenderGraphResource> transients;
+    for (RenderGraphResource i = 0; i < resources.size(); i++)
+    {
+        if (resources[i].isImage && !resources[i].imported && resources[i].firstPass >= 0)
+            transients.push_back(i);
+    }
+    std::sort(transients.begin(), transients.end(), [&](RenderGraphResource a, RenderGraphResource b) {
+        return resources[a].firstPass < resources[b].firstPass;
+    });
+
+    unaliasedTransientMemorySize = 0;
+    for (RenderGraphResource index : transients)
+    {
+        Resource &resource = resources[index];
+
+        VkImageCreateInfo imageCreateInfo;
+        imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageCreateInfo.pNext = nullptr;
+        imageCreateInfo.flags = 0;
+        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.format = resource.info.format;
+        imageCreateInfo.extent.width = resource.info.width;
+        imageCreateInfo.extent.height = resource.info.height;
+        imageCreateInfo.extent.depth = 1;
+        imageCreateInfo.mipLevels = 1;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.samples = resource.info.samples;
+        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageCreateInfo.usage = resource.usage;
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageCreateInfo.queueFamilyIndexCount = 0;
+        imageCreateInfo.pQueueFamilyIndices = nullptr;
+        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        bool shared = resource.queueMask == 3;
+        if (shared)
+        {
+            imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            imageCreateInfo.queueFamilyIndexCount = 2;
+            imageCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
+        }
+        uint32_t queue = passes[resource.lastPass]->async ? 1 : 0;
+
+        VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, &resource.image);
+        ASSERT_VULKAN(result);
+
+        VkMemoryRequirements memoryRequirements;
+        vkGetImageMemoryRequirements(device, resource.image, &memoryRequirements);
+        unaliasedTransientMemorySize += memoryRequirements.size;
+
+        uint32_t lazyMemoryTypeIndex = 0;
+        bool lazilyAllocated = (resource.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) &&
+                               findMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, lazyMemoryTypeIndex);
+
+        int slotIndex = -1;
+        for (uint32_t i = 0; i < memorySlots.size() && !lazilyAllocated && !shared; i++)
+        {
+            if (!memorySlots[i].lazilyAllocated && !memorySlots[i].shared && memorySlots[i].queue == queue && memorySlots[i].lastPass < resource.firstPass &&
+                (memorySlots[i].memoryTypeBits & memoryRequirements.memoryTypeBits) != 0)
+            {
+                slotIndex = i;
+                break;
+            }
+        }
+        if (slotIndex < 0)
+        {
+            memorySlots.push_back(MemorySlot());
+            slotIndex = memorySlots.size() - 1;
+            memorySlots[slotIndex].lazilyAllocated = lazilyAllocated;
+            memorySlots[slotIndex].memoryTypeIndex = lazyMemoryTypeIndex;
+            memorySlots[slotIndex].queue = queue;
+            memorySlots[slotIndex].shared = shared;
+        }
+
+        MemorySlot &slot = memorySlots[slotIndex];
+        slot.size = std::max(slot.size, memoryRequirements.size);
+        slot.memoryTypeBits &= memoryRequirements.memoryTypeBits;
+        slot.lastPass = resource.lastPass;
+        resource.memorySlot = slotIndex;
+
+        for (int i = resource.firstPass; i <= resource.lastPass; i++)
+        {
+            const RenderGraphPass &pass = *passes[(size_t)i];
+            for (const RenderGraphPass::Use &use : pass.uses)
+            {
+                if (use.resource != index || pass.culled || (pass.async ? 1u : 0u) != slot.queue)
+                    continue;
+                AccessInfo accessInfo = getAccessInfo(use.access);
+                slot.stageMask |= accessInfo.stageMask;
+                slot.writeAccessMask |= accessInfo.accessMask & WRITE_ACCESS_MASK;
+            }
+        }
+    }
+
+    for (MemorySlot &slot : memorySlots)
+    {
+        uint32_t memoryTypeIndex = slot.lazilyAllocated ? slot.memoryTypeIndex : getMemoryTypeIndex(slot.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        allocateDeviceMemory(slot.size, memoryTypeIndex, slot.deviceMemory);
+    }
+
+    for (RenderGraphResource index : transients)
+    {
+        Resource &resource = resources[index];
+        vkBindImageMemory(device, resource.image, memorySlots[resource.memorySlot].deviceMemory, 0);
+        createImageView(resource.image, resource.info.format, getAspectMask(resource.info.format), 1, resource.imageView);
+    }
+}
+
+// Walks the surviving passes in order, tracking the layout, the last write and
+// the stages that already see it for every resource. Reads that are already
+// visible get no barrier; everything else gets one, merged per pass. When the
+// last write happened on the other queue, the batch's semaphore wait already
+// made it visible and only a layout change still needs a barrier.
+void RenderGraph::placeBarriers()
+{
+    for (RenderGraphResource i = 0; i < resources.size(); i++)
+    {
+        Resource &resource = resources[i];
+        if (resource.isImage && resource.imported)
+        {
+            resource.state = {resource.initialLayout, 0, resource.initialStageMask, 0, {0, 0}};
+        }
+        else if (resource.isImage)
+        {
+            if (resource.memorySlot < 0)
+                continue;
+            // Aliased memory: wait for whatever used the slot before, including
+            // the previous frame, and discard the contents.
+            MemorySlot &slot = memorySlots[resource.memorySlot];
+            resource.state = {VK_IMAGE_LAYOUT_UNDEFINED, slot.queue, slot.stageMask, slot.writeAccessMask, {0, 0}};
+        }
+        else
+        {
+            // Buffers keep their contents across frames, so the frame starts
+            // in the state the previous frame left them in.
+            resource.state = {VK_IMAGE_LAYOUT_UNDEFINED, 0, 0, 0, {0, 0}};
+            for (auto &pass : passes)
+            {
+                if (pass->culled)
+                    continue;
+                uint32_t queue = pass->async ? 1 : 0;
+                for (const RenderGraphPass::Use &use : pass->uses)
+                {
+                    if (use.resource != i)
+                        continue;
+                    AccessInfo accessInfo = getAccessInfo(use.access);
+                    if (use.write)
+                        resource.state = {VK_IMAGE_LAYOUT_UNDEFINED, queue, accessInfo.stageMask, accessInfo.accessMask & WRITE_ACCESS_MASK, {0, 0}};
+                    else
+                        resource.state.readStageMasks[queue] |= accessInfo.stageMask;
+                }
+            }
+        }
+    }
+
+    for (auto &pass : passes)
+    {
+        if (pass->culled)
+            continue;
+        uint32_t queue = pass->async ? 1 : 0;
+
+        for (const RenderGraphPass::Use &use : pass->uses)
+        {
+            Resource &resource = resources[use.resource];
+            ResourceState &state = resource.state;
+            AccessInfo next = getAccessInfo(use.access);
+            bool layoutChange = resource.isImage && state.layout != next.layout;
+            bool sameQueue = state.queue == queue;
+
+            VkPipelineStageFlags srcStageMask;
+            if (!use.write && !layoutChange)
+            {
+                if (!sameQueue || state.writeStageMask == 0)
+                {
+                    state.readStageMasks[queue] |= next.stageMask;
+                    continue;
+                }
+                if ((next.stageMask & ~state.readStageMasks[queue]) == 0)
+                    continue;
+                srcStageMask = state.writeStageMask;
+            }
+            else
+            {
+                // Across queues the barrier chains onto the semaphore wait.
+                srcStageMask = state.readStageMasks[queue] | (sameQueue ? state.writeStageMask : next.stageMask);
+            }
+            if (srcStageMask == 0)
+                srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            VkAccessFlags srcAccessMask = sameQueue ? state.writeAccessMask : 0;
+
+            if (resource.isImage)
+            {
+                VkImageMemoryBarrier imageMemoryBarrier;
+                imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                imageMemoryBarrier.pNext = nullptr;
+                imageMemoryBarrier.srcAccessMask = srcAccessMask;
+                imageMemoryBarrier.dstAccessMask = next.accessMask;
+                imageMemoryBarrier.oldLayout = state.layout;
+                imageMemoryBarrier.newLayout = next.layout;
+                imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                imageMemoryBarrier.image = VK_NULL_HANDLE;
+                imageMemoryBarrier.subresourceRange.aspectMask = getAspectMask(resource.info.format);
+                imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+                imageMemoryBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+                imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+                imageMemoryBarrier.subresourceRange.layerCount = 1;
+
+                pass->imageBarriers.push_back(imageMemoryBarrier);
+                pass->imageBarrierResources.push_back(use.resource);
+            }
+            else
+            {
+                VkBufferMemoryBarrier bufferMemoryBarrier;
+                bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                bufferMemoryBarrier.pNext = nullptr;
+                bufferMemoryBarrier.srcAccessMask = srcAccessMask;
+                bufferMemoryBarrier.dstAccessMask = next.accessMask;
+                bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                bufferMemoryBarrier.buffer = VK_NULL_HANDLE;
+                bufferMemoryBarrier.offset = 0;
+                bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+
+                pass->bufferBarriers.push_back(bufferMemoryBarrier);
+                pass->bufferBarrierResources.push_back(use.resource);
+            }
+            pass->barrierSrcStageMask |= srcStageMask;
+            pass->barrierDstStageMask |= next.stageMask;
+
+            if (use.write)
+            {
+                state = {next.layout, queue, next.stageMask, next.accessMask & WRITE_ACCESS_MASK, {0, 0}};
+            }
+            else if (layoutChange)
+            {
+                // The transition itself is a write the other readers must wait for.
+                state = {next.layout, queue, next.stageMask, 0, {0, 0}};
+                state.readStageMasks[queue] = next.stageMask;
+            }
+            else
+            {
+                state.readStageMasks[queue] |= next.stageMask;
+            }
+        }
+    }
+
+    for (RenderGraphResource i = 0; i < resources.size(); i++)
+    {
+        Resource &resource = resources[i];
+        if (!resource.imported || !resource.isImage || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || resource.finalLayout == resource.state.layout)
+            continue;
+
+        VkImageMemoryBarrier imageMemoryBarrier;
+        imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageMemoryBarrier.pNext = nullptr;
+        imageMemoryBarrier.srcAccessMask = resource.state.writeAccessMask;
+        imageMemoryBarrier.dstAccessMask = 0;
+        imageMemoryBarrier.oldLayout = resource.state.layout;
+        imageMemoryBarrier.newLayout = resource.finalLayout;
+        imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageMemoryBarrier.image = VK_NULL_HANDLE;
+        imageMemoryBarrier.subresourceRange.aspectMask = getAspectMask(resource.info.format);
+        imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+        imageMemoryBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+        imageMemoryBarrier.subresourceRange.layerCount = 1;
+
+        finalBarriers.push_back(imageMemoryBarrier);
+        finalBarrierResources.push_back(i);
+        finalSrcStageMask |= resource.state.writeStageMask | resource.state.readStageMasks[0];
+    }
+}
+
+// One single-subpass render pass per graphics pass. Layouts don't change
+// inside the render pass, the barriers placed above already did that.
+void RenderGraph::createRenderPasses()
+{
+    std::vector<bool> hasContents(resources.size());
+    for (RenderGraphResource i = 0; i < resources.size(); i++)
+    {
+        hasContents[i] = resources[i].imported && resources[i].initialLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    for (uint32_t passIndex = 0; passIndex < passes.size(); passIndex++)
+    {
+        RenderGraphPass &pass = *passes[passIndex];
+        if (pass.culled)
+            continue;
+
+        std::vector<VkAttachmentDescription> attachmentDescriptions;
+        std::vector<VkAttachmentReference> colorReferences;
+        std::vector<RenderGraphResource> colorResources;
+        std::map<RenderGraphResource, VkAttachmentReference> resolveReferences;
+        VkAttachmentReference depthReference;
+        bool hasDepth = false;
+
+        for (const RenderGraphPass::Use &use : pass.uses)
+        {
+            if (pass.queue != RenderGraphQueue::Graphics || !isAttachmentAccess(use.access))
+                continue;
+
+            const Resource &resource = resources[use.resource];
+            auto clearValue = pass.clearValues.find(use.resource);
+            bool keep = resource.imported || resource.lastPass > (int)passIndex;
+
+            VkAttachmentDescription attachmentDescription;
+            attachmentDescription.flags = 0;
+            attachmentDescription.format = resource.info.format;
+            attachmentDescription.samples = resource.info.samples;
+            if (use.access == RenderGraphAccess::ResolveAttachment)
+                attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            else if (clearValue != pass.clearValues.end())
+                attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            else if (hasContents[use.resource])
+                attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+            else
+                attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachmentDescription.storeOp = keep ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachmentDescription.initialLayout = getAccessInfo(use.access).layout;
+            attachmentDescription.finalLayout = getAccessInfo(use.access).layout;
+
+            VkAttachmentReference attachmentReference;
+            attachmentReference.attachment = attachmentDescriptions.size();
+            attachmentReference.layout = getAccessInfo(use.access).layout;
+
+            if (use.access == RenderGraphAccess::ColorAttachment)
+            {
+                colorReferences.push_back(attachmentReference);
+                colorResources.push_back(use.resource);
+            }
+            else if (use.access == RenderGraphAccess::ResolveAttachment)
+            {
+                resolveReferences[use.resource] = attachmentReference;
+            }
+            else
+            {
+                depthReference = attachmentReference;
+                hasDepth = true;
+            }
+
+            attachmentDescriptions.push_back(attachmentDescription);
+            pass.attachments.push_back(use.resource);
+            pass.attachmentClearValues.push_back(clearValue != pass.clearValues.end() ? clearValue->second : VkClearValue{});
+            pass.extent = {resource.info.width, resource.info.height};
+        }
+
+        for (const RenderGraphPass::Use &use : pass.uses)
+        {
+            if (use.write)
+                hasContents[use.resource] = true;
+        }
+
+        if (attachmentDescriptions.empty())
+            continue;
+
+        // Resolve references line up with the color references they resolve.
+        std::vector<VkAttachmentReference> resolveReferenceArray;
+        for (RenderGraphResource colorResource : colorResources)
+        {
+            VkAttachmentReference unused;
+            unused.attachment = VK_ATTACHMENT_UNUSED;
+            unused.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            auto resolve = pass.resolves.find(colorResource);
+            resolveReferenceArray.push_back(resolve != pass.resolves.end() ? resolveReferences[resolve->second] : unused);
+        }
+
+        VkSubpassDescription subpassDescription;
+        subpassDescription.flags = 0;
+        subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpassDescription.inputAttachmentCount = 0;
+        subpassDescription.pInputAttachments = nullptr;
+        subpassDescription.colorAttachmentCount = colorReferences.size();
+        subpassDescription.pColorAttachments = colorReferences.data();
+        subpassDescription.pResolveAttachments = pass.resolves.empty() ? nullptr : resolveReferenceArray.data();
+        subpassDescription.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+        subpassDescription.preserveAttachmentCount = 0;
+        subpassDescription.pPreserveAttachments = nullptr;
+
+        VkRenderPassCreateInfo renderPassCreateInfo;
+        renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassCreateInfo.pNext = nullptr;
+        renderPassCreateInfo.flags = 0;
+        renderPassCreateInfo.attachmentCount = attachmentDescriptions.size();
+        renderPassCreateInfo.pAttachments = attachmentDescriptions.data();
+        renderPassCreateInfo.subpassCount = 1;
+        renderPassCreateInfo.pSubpasses = &subpassDescription;
+        renderPassCreateInfo.dependencyCount = 0;
+        renderPassCreateInfo.pDependencies = nullptr;
+
+        VkResult result = vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &pass.renderPass);
+        ASSERT_VULKAN(result);
+    }
+}
+
+void RenderGraph::createTimestampQueries()
+{
+    if (!deviceCapabilities.timestamps)
+        return;
+
+    // Passes of a batch are consecutive, so each batch resets its own range.
+    timestampsPerFrame = 0;
+    for (Batch &batch : batches)
+    {
+        batch.firstTimestamp = timestampsPerFrame;
+        for (uint32_t i = batch.firstPass; i < batch.endPass; i++)
+        {
+            if (passes[i]->culled)
+                continue;
+            passes[i]->timestampIndex = timestampsPerFrame;
+            timestampsPerFrame += 2;
+        }
+        batch.timestampCount = timestampsPerFrame - batch.firstTimestamp;
+    }
+    if (timestampsPerFrame == 0)
+        return;
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo;
+    queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCreateInfo.pNext = nullptr;
+    queryPoolCreateInfo.flags = 0;
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCreateInfo.queryCount = timestampsPerFrame * MAX_FRAMES_IN_FLIGHT;
+    queryPoolCreateInfo.pipelineStatistics = 0;
+
+    VkResult result = vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &timestampQueryPool);
+    ASSERT_VULKAN(result);
+}
+
+// One pool per frame in flight and queue, reset as a whole when the frame
+// slot comes around again.
+void RenderGraph::createCommandBuffers()
+{
+    uint32_t queueFamilyIndices[] = {0, deviceCapabilities.computeQueueFamily};
+
+    for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+    {
+        for (uint32_t queue = 0; queue < 2; queue++)
+        {
+            if (queue == 1 && !deviceCapabilities.asyncCompute)
+                continue;
+
+            VkCommandPoolCreateInfo commandPoolCreateInfo;
+            commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            commandPoolCreateInfo.pNext = nullptr;
+            commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndices[queue];
+
+            VkResult result = vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPools[frame][queue]);
+            ASSERT_VULKAN(result);
+        }
+
+        for (Batch &batch : batches)
+        {
+            VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+            commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            commandBufferAllocateInfo.pNext = nullptr;
+            commandBufferAllocateInfo.commandPool = commandPools[frame][batch.async ? 1 : 0];
+            commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            commandBufferAllocateInfo.commandBufferCount = 1;
+
+            VkResult result = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &batch.commandBuffers[frame]);
+            ASSERT_VULKAN(result);
+        }
+    }
+}
+
+VkFramebuffer RenderGraph::getFramebuffer(const RenderGraphPass &pass)
+{
+    std::vector<VkImageView> views;
+    for (RenderGraphResource attachment : pass.attachments)
+    {
+        views.push_back(resources[attachment].imageView);
+    }
+
+    auto key = std::make_pair(pass.renderPass, views);
+    auto it = framebuffers.find(key);
+    if (it != framebuffers.end())
+        return it->second;
+
+    VkFramebufferCreateInfo frameBufferCreateInfo;
+    frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    frameBufferCreateInfo.pNext = nullptr;
+    frameBufferCreateInfo.flags = 0;
+    frameBufferCreateInfo.renderPass = pass.renderPass;
+    frameBufferCreateInfo.attachmentCount = views.size();
+    frameBufferCreateInfo.pAttachments = views.data();
+    frameBufferCreateInfo.width = pass.extent.width;
+    frameBufferCreateInfo.height = pass.extent.height;
+    frameBufferCreateInfo.layers = 1;
+
+    VkFramebuffer framebuffer;
+    VkResult result = vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &framebuffer);
+    ASSERT_VULKAN(result);
+
+    framebuffers[key] = framebuffer;
+    return framebuffer;
+}
+
+void RenderGraph::recordPass(VkCommandBuffer commandBuffer, RenderGraphPass &pass, uint32_t firstTimestamp)
+{
+    if (timestampQueryPool != VK_NULL_HANDLE)
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, firstTimestamp + pass.timestampIndex);
+
+    for (size_t i = 0; i < pass.imageBarriers.size(); i++)
+    {
+        pass.imageBarriers[i].image = resources[pass.imageBarrierResources[i]].image;
+    }
+    for (size_t i = 0; i < pass.bufferBarriers.size(); i++)
+    {
+        pass.bufferBarriers[i].buffer = resources[pass.bufferBarrierResources[i]].buffer;
+    }
+    if (!pass.imageBarriers.empty() || !pass.bufferBarriers.empty())
+    {
+        vkCmdPipelineBarrier(commandBuffer, pass.barrierSrcStageMask, pass.barrierDstStageMask, 0, 0, nullptr,
+                             pass.bufferBarriers.size(), pass.bufferBarriers.data(), pass.imageBarriers.size(), pass.imageBarriers.data());
+    }
+
+    if (pass.renderPass != VK_NULL_HANDLE)
+    {
+        VkRenderPassBeginInfo renderPassBeginInfo;
+        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassBeginInfo.pNext = nullptr;
+        renderPassBeginInfo.renderPass = pass.renderPass;
+        renderPassBeginInfo.framebuffer = getFramebuffer(pass);
+        renderPassBeginInfo.renderArea.offset = {0, 0};
+        renderPassBeginInfo.renderArea.extent = pass.extent;
+        renderPassBeginInfo.clearValueCount = pass.attachmentClearValues.size();
+        renderPassBeginInfo.pClearValues = pass.attachmentClearValues.data();
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        if (pass.executeFunction)
+            pass.executeFunction(commandBuffer);
+        vkCmdEndRenderPass(commandBuffer);
+    }
+    else if (pass.executeFunction)
+    {
+        pass.executeFunction(commandBuffer);
+    }
+
+    if (timestampQueryPool != VK_NULL_HANDLE)
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, firstTimestamp + pass.timestampIndex + 1);
+}
+
+void RenderGraph::resetCommandPools(uint32_t frame)
+{
+    for (uint32_t queue = 0; queue < 2; queue++)
+    {
+        if (commandPools[frame][queue] == VK_NULL_HANDLE)
+            continue;
+        VkResult result = vkResetCommandPool(device, commandPools[frame][queue], 0);
+        ASSERT_VULKAN(result);
+    }
+}
+
+void RenderGraph::recordBatch(uint32_t frame, uint32_t batchIndex)
+{
+    Batch &batch = batches[batchIndex];
+    VkCommandBuffer commandBuffer = batch.commandBuffers[frame];
+    uint32_t firstTimestamp = frame * timestampsPerFrame;
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.pNext = nullptr;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = nullptr;
+
+    VkResult result = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+    ASSERT_VULKAN(result);
+
+    if (timestampQueryPool != VK_NULL_HANDLE && batch.timestampCount > 0)
+        vkCmdResetQueryPool(commandBuffer, timestampQueryPool, firstTimestamp + batch.firstTimestamp, batch.timestampCount);
+
+    for (uint32_t i = batch.firstPass; i < batch.endPass; i++)
+    {
+        if (!passes[i]->culled)
+            recordPass(commandBuffer, *passes[i], firstTimestamp);
+    }
+
+    if (batchIndex == batches.size() - 1 && !finalBarriers.empty())
+    {
+        for (size_t i = 0; i < finalBarriers.size(); i++)
+        {
+            finalBarriers[i].image = resources[finalBarrierResources[i]].image;
+        }
+        vkCmdPipelineBarrier(commandBuffer, finalSrcStageMask, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+                             finalBarriers.size(), finalBarriers.data());
+    }
+
+    result = vkEndCommandBuffer(commandBuffer);
+    ASSERT_VULKAN(result);
+}
+
+uint64_t RenderGraph::execute(uint32_t frame, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStageMask, VkSemaphore signalSemaphore)
+{
+    resetCommandPools(frame);
+    if (timestampQueryPool != VK_NULL_HANDLE)
+        timestampsWritten[frame] = true;
+
+    bool waitSemaphoreAdded = false;
+    for (uint32_t batchIndex = 0; batchIndex < batches.size(); batchIndex++)
+    {
+        recordBatch(frame, batchIndex);
+
+        Batch &batch = batches[batchIndex];
+        VkCommandBuffer commandBuffer = batch.commandBuffers[frame];
+        bool lastBatch = batchIndex == batches.size() - 1;
+
+        TimelineQueue &timeline = batch.async ? computeTimeline : graphicsTimeline;
+        TimelineQueue &otherTimeline = batch.async ? graphicsTimeline : computeTimeline;
+
+        // A wait within the frame covers the previous frame as well, the
+        // timeline values only grow. Barriers that change layouts after the
+        // wait rely on it covering all stages.
+        int waitBatch = batch.waitBatch >= 0 ? batch.waitBatch : batch.previousFrameWaitBatch;
+        if (waitBatch >= 0 && batches[waitBatch].submittedValue != 0)
+            timeline.addTimelineWait(otherTimeline, batches[waitBatch].submittedValue, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+        if (!batch.async && !waitSemaphoreAdded && waitSemaphore != VK_NULL_HANDLE)
+        {
+            timeline.addWaitSemaphore(waitSemaphore, waitStageMask);
+            waitSemaphoreAdded = true;
+        }
+        timeline.addCommandBuffer(commandBuffer);
+        if (lastBatch && signalSemaphore != VK_NULL_HANDLE)
+            timeline.addSignalSemaphore(signalSemaphore);
+
+        batch.submittedValue = timeline.flush();
+    }
+
+    return batches.back().submittedValue;
+}
+
+void RenderGraph::record(uint32_t frame)
+{
+    resetCommandPools(frame);
+    for (uint32_t batchIndex = 0; batchIndex < batches.size(); batchIndex++)
+    {
+        recordBatch(frame, batchIndex);
+    }
+}
+
+// Everything may still be in use by frames in flight, so destruction goes
+// through the deletion queue. The graph is empty afterwards and can be rebuilt.
+void RenderGraph::destroy()
+{
+    for (auto &entry : framebuffers)
+    {
+        deletionQueue.destroyFramebuffer(entry.second);
+    }
+    for (auto &pass : passes)
+    {
+        if (pass->renderPass != VK_NULL_HANDLE)
+            deletionQueue.destroyRenderPass(pass->renderPass);
+    }
+    for (Resource &resource : resources)
+    {
+        if (resource.imported || resource.image == VK_NULL_HANDLE)
+            continue;
+        deletionQueue.destroyImageView(resource.imageView);
+        deletionQueue.destroyImage(resource.image);
+    }
+    for (MemorySlot &slot : memorySlots)
+    {
+        deletionQueue.freeMemory(slot.deviceMemory);
+    }
+    for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+    {
+        for (uint32_t queue = 0; queue < 2; queue++)
+        {
+            if (commandPools[frame][queue] != VK_NULL_HANDLE)
+                deletionQueue.destroyCommandPool(commandPools[frame][queue]);
+            commandPools[frame][queue] = VK_NULL_HANDLE;
+        }
+    }
+    if (timestampQueryPool != VK_NULL_HANDLE)
+    {
+        VkQueryPool queryPool = timestampQueryPool;
+        deletionQueue.push([queryPool]() {
+            vkDestroyQueryPool(device, queryPool, nullptr);
+        });
+    }
+
+    framebuffers.clear();
+    passes.clear();
+    resources.clear();
+    memorySlots.clear();
+    batches.clear();
+    finalBarriers.clear();
+    finalBarrierResources.clear();
+    finalSrcStageMask = 0;
+    unaliasedTransientMemorySize = 0;
+    timestampQueryPool = VK_NULL_HANDLE;
+    timestampsPerFrame = 0;
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        timestampsWritten[i] = false;
+    }
+}
+
+VkImage RenderGraph::getImage(RenderGraphResource resource) const
+{
+    return resources[resource].image;
+}
+
+VkImageView RenderGraph::getImageView(RenderGraphResource resource) const
+{
+    return resources[resource].imageView;
+}
+
+VkBuffer RenderGraph::getBuffer(RenderGraphResource resource) const
+{
+    return resources[resource].buffer;
+}
+
+VkRenderPass RenderGraph::getRenderPass(const std::string &passName) const
+{
+    for (auto &pass : passes)
+    {
+        if (pass->name == passName && !pass->culled)
+            return pass->renderPass;
+    }
+    return VK_NULL_HANDLE;
+}
+
+// Start times are relative to the earliest pass of the frame. This assumes
+// both queues count on the same clock, which holds on desktop GPUs.
+std::vector<RenderGraphPassTiming> RenderGraph::getPassTimings(uint32_t frame)
+{
+    std::vector<RenderGraphPassTiming> timings;
+    if (timestampQueryPool == VK_NULL_HANDLE || !timestampsWritten[frame])
+        return timings;
+
+    std::vector<uint64_t> timestamps(timestampsPerFrame);
+    VkResult result = vkGetQueryPoolResults(device, timestampQueryPool, frame * timestampsPerFrame, timestampsPerFrame, timestamps.size() * sizeof(uint64_t),
+                                            timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS)
+        return timings;
+
+    uint64_t frameStart = *std::min_element(timestamps.begin(), timestamps.end());
+    double millisecondsPerTick = deviceCapabilities.timestampPeriod / 1000000.0;
+    for (auto &pass : passes)
+    {
+        if (pass->culled)
+            continue;
+        uint64_t start = timestamps[pass->timestampIndex];
+        uint64_t end = timestamps[pass->timestampIndex + 1];
+        RenderGraphQueue queue = pass->async ? RenderGraphQueue::Compute : RenderGraphQueue::Graphics;
+        timings.push_back({pass->name, queue, (start - frameStart) * millisecondsPerTick, (end - start) * millisecondsPerTick});
+    }
+    return timings;
+}
+
+uint32_t RenderGraph::getBarrierCount() const
+{
+    uint32_t count = finalBarriers.size();
+    for (auto &pass : passes)
+    {
+        count += pass->imageBarriers.size() + pass->bufferBarriers.size();
+    }
+    return count;
+}
+
+// Lazily allocated slots are left out, they are only backed if the driver
+// actually needs to spill the attachment.
+VkDeviceSize RenderGraph::getTransientMemorySize() const
+{
+    VkDeviceSize size = 0;
+    for (const MemorySlot &slot : memorySlots)
+    {
+        if (!slot.lazilyAllocated)
+            size += slot.size;
+    }
+    return size;
+}
+
+VkDeviceSize RenderGraph::getLazilyAllocatedMemorySize() const
+{
+    VkDeviceSize size = 0;
+    for (const MemorySlot &slot : memorySlots)
+    {
+        if (slot.lazilyAllocated)
+            size += slot.size;
+    }
+    return size;
+}
+
+VkDeviceSize RenderGraph::getUnaliasedTransientMemorySize() const
+{
+    return unaliasedTransientMemorySize;
+}
+
+// Merges the busy intervals of each queue, then sums their intersections.
+double getQueueOverlapMilliseconds(const std::vector<RenderGraphPassTiming> &timings)
+{
+    std::vector<std::pair<double, double>> busy[2];
+    for (const RenderGraphPassTiming &timing : timings)
+    {
+        uint32_t queue = timing.queue == RenderGraphQueue::Compute ? 1 : 0;
+        busy[queue].push_back({timing.startMilliseconds, timing.startMilliseconds + timing.milliseconds});
+    }
+
+    for (auto &intervals : busy)
+    {
+        std::sort(intervals.begin(), intervals.end());
+        std::vector<std::pair<double, double>> merged;
+        for (auto &interval : intervals)
+        {
+            if (!merged.empty() && interval.first <= merged.back().second)
+                merged.back().second = std::max(merged.back().second, interval.second);
+            else
+                merged.push_back(interval);
+        }
+        intervals.swap(merged);
+    }
+
+    double overlap = 0.0;
+    size_t graphics = 0;
+    size_t compute = 0;
+    while (graphics < busy[0].size() && compute < busy[1].size())
+    {
+        double start = std::max(busy[0][graphics].first, busy[1][compute].first);
+        double end = std::min(busy[0][graphics].second, busy[1][compute].second);
+        if (end > start)
+            overlap += end - start;
+
+        if (busy[0][graphics].second < busy[1][compute].second)
+            graphics++;
+        else
+            compute++;
+    }
+    return overlap;
+}
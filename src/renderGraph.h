@@ -0,0 +1,254 @@
+#pragma once
+
+#include "engine.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+
+typedef uint32_t RenderGraphResource;
+
+// How a pass touches a resource. Each access maps to an image layout, the
+// pipeline stages and access flags it happens in, and the usage the
+// underlying image or buffer needs.
+enum class RenderGraphAccess
+{
+    ColorAttachment,
+    DepthAttachment,
+    DepthAttachmentRead,
+    ResolveAttachment,
+    SampledFragment,
+    SampledCompute,
+    StorageReadGraphics,
+    // Only valid on devices with task shaders.
+    StorageReadTaskShader,
+    StorageReadCompute,
+    StorageWriteCompute,
+    VertexBuffer,
+    IndexBuffer,
+    IndirectBuffer,
+    TransferSrc,
+    TransferDst,
+};
+
+enum class RenderGraphQueue
+{
+    Graphics,
+    Compute,
+};
+
+struct RenderGraphImageInfo
+{
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+struct RenderGraphPassTiming
+{
+    std::string name;
+    // Compute only for passes that ran on the async compute queue.
+    RenderGraphQueue queue;
+    double startMilliseconds;
+    double milliseconds;
+};
+
+// GPU time during which both queues were busy, from one frame's timings.
+double getQueueOverlapMilliseconds(const std::vector<RenderGraphPassTiming> &timings);
+
+class RenderGraph;
+
+class RenderGraphPass
+{
+  public:
+    RenderGraphPass &read(RenderGraphResource resource, RenderGraphAccess access);
+    RenderGraphPass &write(RenderGraphResource resource, RenderGraphAccess access);
+    RenderGraphPass &clear(RenderGraphResource resource, VkClearValue clearValue);
+    // Resolves the multisampled color attachment source into target at the
+    // end of the render pass.
+    RenderGraphPass &resolve(RenderGraphResource source, RenderGraphResource target);
+    // Keeps the pass even if nothing reads what it writes.
+    RenderGraphPass &sideEffects();
+    RenderGraphPass &execute(std::function<void(VkCommandBuffer commandBuffer)> executeFunction);
+
+  private:
+    friend class RenderGraph;
+
+    struct Use
+    {
+        RenderGraphResource resource;
+        RenderGraphAccess access;
+        bool write;
+    };
+
+    std::string name;
+    RenderGraphQueue queue;
+    std::vector<Use> uses;
+    std::map<RenderGraphResource, VkClearValue> clearValues;
+    std::map<RenderGraphResource, RenderGraphResource> resolves;
+    bool hasSideEffects = false;
+    std::function<void(VkCommandBuffer commandBuffer)> executeFunction;
+
+    uint32_t refCount = 0;
+    bool culled = false;
+    bool async = false;
+    uint32_t batch = 0;
+
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    std::vector<RenderGraphResource> imageBarrierResources;
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    std::vector<RenderGraphResource> bufferBarrierResources;
+    VkPipelineStageFlags barrierSrcStageMask = 0;
+    VkPipelineStageFlags barrierDstStageMask = 0;
+
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    std::vector<RenderGraphResource> attachments;
+    std::vector<VkClearValue> attachmentClearValues;
+    VkExtent2D extent = {0, 0};
+
+    uint32_t timestampIndex = 0;
+};
+
+// A frame described as passes that declare what they read and write. compile()
+// drops passes whose results are never used, places the barriers and layout
+// transitions between the remaining ones, and lets transient images whose
+// lifetimes don't overlap share memory. The graph is built once and executed
+// every frame; rebuild it when the swapchain changes.
+//
+// With an async compute queue, compute passes run there. Runs of passes on
+// the same queue form batches, each submitted on its own. Batches wait on the
+// other queue's timeline only where they share a resource.
+class RenderGraph
+{
+  public:
+    RenderGraphResource importImage(const std::string &name, const RenderGraphImageInfo &info, VkImageLayout initialLayout,
+                                    VkPipelineStageFlags initialStageMask, VkImageLayout finalLayout);
+    // A concurrent buffer was created for both queue families, so passes using
+    // it may still run on the async compute queue.
+    RenderGraphResource importBuffer(const std::string &name, VkBuffer buffer, bool concurrent = false);
+    RenderGraphResource createImage(const std::string &name, const RenderGraphImageInfo &info);
+
+    // Imported images may change between frames, e.g. the swapchain image.
+    void setImportedImage(RenderGraphResource resource, VkImage image, VkImageView imageView);
+    void setImportedBuffer(RenderGraphResource resource, VkBuffer buffer);
+
+    RenderGraphPass &addPass(const std::string &name, RenderGraphQueue queue);
+
+    void compile();
+    // Records and submits the frame. The first graphics batch waits for
+    // waitSemaphore and the last one, which also waits for all compute work
+    // of the frame, signals signalSemaphore. Returns the graphics timeline
+    // value that marks the end of the frame.
+    uint64_t execute(uint32_t frame, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStageMask, VkSemaphore signalSemaphore);
+    // Only records the frame, e.g. to time recording alone. The frame's
+    // command buffers must not be in flight.
+    void record(uint32_t frame);
+    void destroy();
+
+    VkImage getImage(RenderGraphResource resource) const;
+    VkImageView getImageView(RenderGraphResource resource) const;
+    VkBuffer getBuffer(RenderGraphResource resource) const;
+    VkRenderPass getRenderPass(const std::string &passName) const;
+
+    // GPU time of every pass from the last execution for this frame index.
+    // Only valid once that frame's submission has completed.
+    std::vector<RenderGraphPassTiming> getPassTimings(uint32_t frame);
+
+    uint32_t getBarrierCount() const;
+    VkDeviceSize getTransientMemorySize() const;
+    VkDeviceSize getUnaliasedTransientMemorySize() const;
+    VkDeviceSize getLazilyAllocatedMemorySize() const;
+
+  private:
+    // Queue 0 is graphics, queue 1 async compute. The write stages belong to
+    // the queue that wrote last, reads are tracked per queue.
+    struct ResourceState
+    {
+        VkImageLayout layout;
+        uint32_t queue;
+        VkPipelineStageFlags writeStageMask;
+        VkAccessFlags writeAccessMask;
+        VkPipelineStageFlags readStageMasks[2];
+    };
+
+    struct Resource
+    {
+        std::string name;
+        bool isImage;
+        bool imported;
+        bool concurrent = false;
+        RenderGraphImageInfo info;
+        VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags initialStageMask = 0;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImageUsageFlags usage = 0;
+        bool attachmentOnly = true;
+        uint32_t queueMask = 0;
+
+        std::vector<uint32_t> writers;
+        uint32_t refCount = 0;
+        int firstPass = -1;
+        int lastPass = -1;
+        int memorySlot = -1;
+        ResourceState state;
+    };
+
+    struct MemorySlot
+    {
+        VkDeviceSize size = 0;
+        uint32_t memoryTypeBits = ~0u;
+        int lastPass = -1;
+        VkPipelineStageFlags stageMask = 0;
+        VkAccessFlags writeAccessMask = 0;
+        bool lazilyAllocated = false;
+        uint32_t memoryTypeIndex = 0;
+        VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+        uint32_t queue = 0;
+        bool shared = false;
+    };
+
+    struct Batch
+    {
+        bool async;
+        uint32_t firstPass;
+        uint32_t endPass;
+        int waitBatch = -1;
+        int previousFrameWaitBatch = -1;
+        uint32_t firstTimestamp = 0;
+        uint32_t timestampCount = 0;
+        VkCommandBuffer commandBuffers[MAX_FRAMES_IN_FLIGHT] = {};
+        uint64_t submittedValue = 0;
+    };
+
+    void cullPasses();
+    void scheduleBatches();
+    void allocateTransients();
+    void placeBarriers();
+    void createRenderPasses();
+    void createTimestampQueries();
+    void createCommandBuffers();
+    VkFramebuffer getFramebuffer(const RenderGraphPass &pass);
+    void resetCommandPools(uint32_t frame);
+    void recordBatch(uint32_t frame, uint32_t batchIndex);
+    void recordPass(VkCommandBuffer commandBuffer, RenderGraphPass &pass, uint32_t firstTimestamp);
+
+    std::vector<Resource> resources;
+    std::vector<std::unique_ptr<RenderGraphPass>> passes;
+    std::vector<MemorySlot> memorySlots;
+    std::vector<Batch> batches;
+    VkCommandPool commandPools[MAX_FRAMES_IN_FLIGHT][2] = {};
+    std::map<std::pair<VkRenderPass, std::vector<VkImageView>>, VkFramebuffer> framebuffers;
+    std::vector<VkImageMemoryBarrier> finalBarriers;
+    std::vector<RenderGraphResource> finalBarrierResources;
+    VkPipelineStageFlags finalSrcStageMask = 0;
+    VkDeviceSize unaliasedTransientMemorySize = 0;
+
+    VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+    uint32_t timestampsPerFrame = 0;
+    bool timestampsWritten[MAX_FRAMES_IN_FLIGHT] = {};
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+// On-disk layout of a .scene file, shared by the engine and
+// tools/sceneBuilder. Everything is little endian and read in place from a
+// memory mapping:
+//
+//   SceneFileHeader
+//   SceneMeshEntry[meshCount] at tableOffset
+//   vertex and index payloads, each aligned to SCENE_PAYLOAD_ALIGNMENT
+//
+// Payloads are stored in the format the GPU consumes, so loading a mesh is a
+// copy into staging memory.
+
+#define SCENE_FILE_MAGIC 0x4e435356 // "VSCN"
+#define SCENE_FILE_VERSION 1
+#define SCENE_PAYLOAD_ALIGNMENT 256
+
+struct SceneFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t meshCount;
+    // Positions of every mesh are stored as 16 bit snorm of position / positionScale.
+    float positionScale;
+    uint64_t tableOffset;
+};
+
+// Byte for byte the engine's QuantizedVertex.
+struct SceneVertex
+{
+    int16_t pos[2];
+    float color[3];
+    float texCoord[2];
+};
+
+// Indices are 32 bit and relative to the mesh's first vertex. The bounding
+// circle is used to load the meshes closest to the camera first.
+struct SceneMeshEntry
+{
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    float center[2];
+    float radius;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(SceneFileHeader) == 24, "SceneFileHeader layout changed");
+static_assert(sizeof(SceneVertex) == 24, "SceneVertex layout changed");
+static_assert(sizeof(SceneMeshEntry) == 40, "SceneMeshEntry layout changed");
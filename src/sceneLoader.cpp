@@ -0,0 +1,288 @@
+#include "sceneLoader.h"
+#include "deletionQueue.h"
+#include "frameStats.h"
+#include "mappedFile.h"
+#include "sceneFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+SceneLoaderSettings sceneLoaderSettings;
+
+struct SceneMeshRequest
+{
+    uint32_t meshIndex;
+    float priority;
+};
+
+// A mesh handed to the workers with mapped staging memory to fill.
+struct SceneMeshUpload
+{
+    uint32_t meshIndex;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    void *stagingData;
+    bool valid;
+};
+
+static MappedFile sceneFile;
+static SceneFileHeader sceneHeader;
+static std::vector<SceneMeshEntry> sceneEntries;
+static std::vector<GeometryHandle> sceneMeshes;
+static uint32_t skippedMeshCount = 0;
+
+// Only touched by the render thread, a heap with the nearest mesh on top.
+static std::vector<SceneMeshRequest> pendingRequests;
+static VkDeviceSize stagedBytes = 0;
+
+static std::vector<std::thread> workerThreads;
+static std::mutex loaderMutex;
+static std::condition_variable loaderCondition;
+static std::deque<SceneMeshUpload> stagedUploads;
+static std::deque<SceneMeshUpload> finishedUploads;
+static bool loaderStopping = false;
+
+static bool isRangeInFile(uint64_t offset, uint64_t size)
+{
+    return offset <= sceneFile.size() && size <= sceneFile.size() - offset;
+}
+
+static bool isRequestFarther(const SceneMeshRequest &a, const SceneMeshRequest &b)
+{
+    return a.priority < b.priority;
+}
+
+static VkDeviceSize getMeshBytes(const SceneMeshEntry &entry)
+{
+    return (VkDeviceSize)entry.vertexCount * sizeof(SceneVertex) + (VkDeviceSize)entry.indexCount * sizeof(uint32_t);
+}
+
+// Copies the vertices followed by the indices straight from the mapping into
+// the staging memory, which also faults the pages in here rather than on the
+// render thread.
+static bool decodeMesh(const SceneMeshUpload &upload)
+{
+    const SceneMeshEntry &entry = sceneEntries[upload.meshIndex];
+    if (entry.vertexOffset % alignof(SceneVertex) != 0 || entry.indexOffset % alignof(uint32_t) != 0)
+        return false;
+
+    const uint32_t *indices = (const uint32_t *)(sceneFile.data() + entry.indexOffset);
+    for (uint32_t i = 0; i < entry.indexCount; i++)
+    {
+        if (indices[i] >= entry.vertexCount)
+            return false;
+    }
+
+    size_t vertexSize = (size_t)entry.vertexCount * sizeof(SceneVertex);
+    memcpy(upload.stagingData, sceneFile.data() + entry.vertexOffset, vertexSize);
+    memcpy((char *)upload.stagingData + vertexSize, indices, (size_t)entry.indexCount * sizeof(uint32_t));
+    return true;
+}
+
+static void runWorker()
+{
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(loaderMutex);
+        loaderCondition.wait(lock, [] { return loaderStopping || !stagedUploads.empty(); });
+        if (loaderStopping)
+            return;
+
+        SceneMeshUpload upload = stagedUploads.front();
+        stagedUploads.pop_front();
+        lock.unlock();
+
+        upload.valid = decodeMesh(upload);
+
+        lock.lock();
+        finishedUploads.push_back(upload);
+    }
+}
+
+// Creating buffers isn't thread safe, so the render thread creates the
+// staging buffers for the nearest pending meshes, about two frames of uploads
+// ahead, and the workers only fill them.
+static void stageRequests()
+{
+    std::vector<SceneMeshUpload> uploads;
+    while (!pendingRequests.empty() && (stagedBytes == 0 || stagedBytes < 2 * sceneLoaderSettings.uploadBytesPerFrame))
+    {
+        std::pop_heap(pendingRequests.begin(), pendingRequests.end(), isRequestFarther);
+        uint32_t meshIndex = pendingRequests.back().meshIndex;
+        pendingRequests.pop_back();
+
+        VkDeviceSize meshBytes = getMeshBytes(sceneEntries[meshIndex]);
+        SceneMeshUpload upload;
+        upload.meshIndex = meshIndex;
+        upload.valid = false;
+        createStagingBuffer(nullptr, meshBytes, upload.stagingBuffer, upload.stagingBufferMemory);
+        COUNT_FRAME_STAT(MemoryMaps, 1);
+        vkMapMemory(device, upload.stagingBufferMemory, 0, meshBytes, 0, &upload.stagingData);
+
+        stagedBytes += meshBytes;
+        uploads.push_back(upload);
+    }
+
+    if (uploads.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        stagedUploads.insert(stagedUploads.end(), uploads.begin(), uploads.end());
+    }
+    loaderCondition.notify_all();
+}
+
+static void releaseUpload(const SceneMeshUpload &upload)
+{
+    vkUnmapMemory(device, upload.stagingBufferMemory);
+    deletionQueue.destroyBuffer(upload.stagingBuffer);
+    deletionQueue.freeMemory(upload.stagingBufferMemory);
+}
+
+bool openScene(const std::string &fileName)
+{
+    if (!sceneFile.open(fileName) || sceneFile.size() < sizeof(SceneFileHeader))
+    {
+        std::cerr << "Failed to open scene " << fileName << std::endl;
+        return false;
+    }
+
+    memcpy(&sceneHeader, sceneFile.data(), sizeof(SceneFileHeader));
+    if (sceneHeader.magic != SCENE_FILE_MAGIC || sceneHeader.version != SCENE_FILE_VERSION || sceneHeader.positionScale <= 0.0f ||
+        !isRangeInFile(sceneHeader.tableOffset, (uint64_t)sceneHeader.meshCount * sizeof(SceneMeshEntry)))
+    {
+        std::cerr << "Invalid scene " << fileName << std::endl;
+        sceneFile.close();
+        return false;
+    }
+
+    sceneEntries.resize(sceneHeader.meshCount);
+    memcpy(sceneEntries.data(), sceneFile.data() + sceneHeader.tableOffset, sceneEntries.size() * sizeof(SceneMeshEntry));
+
+    // Nearest to the origin, where the camera looks, first.
+    skippedMeshCount = 0;
+    for (uint32_t i = 0; i < sceneEntries.size(); i++)
+    {
+        const SceneMeshEntry &entry = sceneEntries[i];
+        if (entry.vertexCount == 0 || entry.indexCount == 0 || !isRangeInFile(entry.vertexOffset, (uint64_t)entry.vertexCount * sizeof(SceneVertex)) ||
+            !isRangeInFile(entry.indexOffset, (uint64_t)entry.indexCount * sizeof(uint32_t)))
+        {
+            std::cerr << "Skipping invalid scene mesh " << i << std::endl;
+            skippedMeshCount++;
+            continue;
+        }
+
+        float distance = std::sqrt(entry.center[0] * entry.center[0] + entry.center[1] * entry.center[1]) - entry.radius;
+        pendingRequests.push_back({i, -distance});
+    }
+    std::make_heap(pendingRequests.begin(), pendingRequests.end(), isRequestFarther);
+
+    std::cout << "Loading scene " << fileName << " (" << sceneHeader.meshCount << " meshes) on " << sceneLoaderSettings.workerCount << " threads" << std::endl;
+
+    loaderStopping = false;
+    for (uint32_t i = 0; i < std::max(sceneLoaderSettings.workerCount, 1u); i++)
+    {
+        workerThreads.emplace_back(runWorker);
+    }
+    return true;
+}
+
+void shutDownSceneLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        loaderStopping = true;
+    }
+    loaderCondition.notify_all();
+
+    for (std::thread &workerThread : workerThreads)
+    {
+        workerThread.join();
+    }
+    workerThreads.clear();
+
+    for (const SceneMeshUpload &upload : stagedUploads)
+    {
+        releaseUpload(upload);
+    }
+    for (const SceneMeshUpload &upload : finishedUploads)
+    {
+        releaseUpload(upload);
+    }
+    stagedUploads.clear();
+    finishedUploads.clear();
+    stagedBytes = 0;
+
+    pendingRequests.clear();
+    sceneEntries.clear();
+    sceneMeshes.clear();
+    skippedMeshCount = 0;
+    sceneFile.close();
+}
+
+bool isSceneOpen()
+{
+    return sceneFile.isOpen();
+}
+
+float getScenePositionScale()
+{
+    return sceneHeader.positionScale;
+}
+
+void updateSceneLoading(GeometryPool &pool)
+{
+    if (!sceneFile.isOpen())
+        return;
+
+    std::vector<SceneMeshUpload> uploads;
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        VkDeviceSize uploadedBytes = 0;
+        while (!finishedUploads.empty())
+        {
+            VkDeviceSize meshBytes = getMeshBytes(sceneEntries[finishedUploads.front().meshIndex]);
+            if (uploadedBytes > 0 && uploadedBytes + meshBytes > sceneLoaderSettings.uploadBytesPerFrame)
+                break;
+
+            uploads.push_back(finishedUploads.front());
+            finishedUploads.pop_front();
+            uploadedBytes += meshBytes;
+        }
+    }
+
+    for (const SceneMeshUpload &upload : uploads)
+    {
+        const SceneMeshEntry &entry = sceneEntries[upload.meshIndex];
+        stagedBytes -= getMeshBytes(entry);
+        if (!upload.valid)
+        {
+            std::cerr << "Skipping invalid scene mesh " << upload.meshIndex << std::endl;
+            releaseUpload(upload);
+            skippedMeshCount++;
+            continue;
+        }
+
+        // The pool reads the mapping again if the mesh is evicted, the file
+        // stays open until the loader shuts down.
+        vkUnmapMemory(device, upload.stagingBufferMemory);
+        const uint32_t *indices = (const uint32_t *)(sceneFile.data() + entry.indexOffset);
+        sceneMeshes.push_back(
+            pool.addMesh(upload.stagingBuffer, upload.stagingBufferMemory, sceneFile.data() + entry.vertexOffset, entry.vertexCount, indices, entry.indexCount));
+    }
+
+    stageRequests();
+
+    if (!uploads.empty() && sceneMeshes.size() + skippedMeshCount == sceneHeader.meshCount)
+        std::cout << "Scene loaded" << std::endl;
+}
+
+const std::vector<GeometryHandle> &getSceneMeshes()
+{
+    return sceneMeshes;
+}
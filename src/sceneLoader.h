@@ -0,0 +1,31 @@
+#pragma once
+
+#include "engine.h"
+#include "geometryPool.h"
+
+struct SceneLoaderSettings
+{
+    uint32_t workerCount = 2;
+    // At least one mesh is uploaded per frame, however large.
+    VkDeviceSize uploadBytesPerFrame = 4 * 1024 * 1024;
+};
+
+extern SceneLoaderSettings sceneLoaderSettings;
+
+// Maps a .scene file (see sceneFormat.h) and queues all its meshes, closest
+// to the origin first. Worker threads validate the meshes and copy them from
+// the mapping straight into staging memory, the render thread only records
+// the copies into the geometry pool, so the first frames show while the rest
+// of the scene is still loading. The pool points into the mapping rather than
+// keeping its own copy, so shut the loader down after the last frame.
+bool openScene(const std::string &fileName);
+void shutDownSceneLoader();
+
+bool isSceneOpen();
+float getScenePositionScale();
+
+// Uploads meshes the workers have finished, up to the per-frame budget, and
+// hands the next ones to the workers.
+void updateSceneLoading(GeometryPool &pool);
+// Handles of the meshes uploaded so far, in load order.
+const std::vector<GeometryHandle> &getSceneMeshes();
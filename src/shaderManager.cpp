@@ -0,0 +1,238 @@
+#include "shaderManager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <cstdio>
+#include <fstream>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static std::string shaderSourceDirectory;
+static std::string shaderCacheDirectory;
+
+static std::map<std::string, std::vector<char>> shaderCodes;
+
+static std::mutex compiledShadersMutex;
+static std::map<std::string, std::vector<char>> compiledShaders;
+
+static std::thread watchThread;
+static std::atomic<bool> watching(false);
+static int inotifyFd = -1;
+
+static const char *glslCompileCommand = "glslangValidator -V";
+
+static bool isShaderSource(const std::string &name)
+{
+    static const char *extensions[] = {".vert", ".frag", ".comp", ".geom", ".tesc", ".tese", ".task", ".mesh"};
+    for (const char *extension : extensions)
+    {
+        size_t length = strlen(extension);
+        if (name.size() > length && name.compare(name.size() - length, length, extension) == 0)
+            return true;
+    }
+    return false;
+}
+
+// GL_EXT_mesh_shader needs SPIR-V 1.4, glslangValidator defaults to 1.0.
+static std::string getCompileCommand(const std::string &name)
+{
+    std::string command = glslCompileCommand;
+    if (name.size() > 5 && (name.compare(name.size() - 5, 5, ".task") == 0 || name.compare(name.size() - 5, 5, ".mesh") == 0))
+        command += " --target-env spirv1.4";
+    return command;
+}
+
+static bool readBinaryFile(const std::string &fileName, std::vector<char> &data)
+{
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+
+    data.resize((size_t)file.tellg());
+    file.seekg(0);
+    file.read(data.data(), data.size());
+    return (bool)file;
+}
+
+// FNV-1a over the compiler command and the source text.
+static uint64_t hashShaderSource(const std::vector<char> &source)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const char *c = glslCompileCommand; *c != '\0'; c++)
+    {
+        hash = (hash ^ (uint8_t)*c) * 0x100000001b3ull;
+    }
+    for (char c : source)
+    {
+        hash = (hash ^ (uint8_t)c) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static bool compileShader(const std::string &name, std::vector<char> &spirv)
+{
+    std::vector<char> source;
+    if (!readBinaryFile(shaderSourceDirectory + "/" + name, source))
+        return false;
+
+    char hashString[17];
+    snprintf(hashString, sizeof(hashString), "%016llx", (unsigned long long)hashShaderSource(source));
+    std::string cachePath = shaderCacheDirectory + "/" + name + "." + hashString + ".spv";
+
+    if (readBinaryFile(cachePath, spirv))
+        return true;
+
+    std::string temporaryPath = cachePath + ".tmp";
+    std::string command = getCompileCommand(name) + " \"" + shaderSourceDirectory + "/" + name + "\" -o \"" + temporaryPath + "\" 2>&1";
+
+    FILE *pipe = popen(command.c_str(), "r");
+    if (pipe == nullptr)
+        return false;
+
+    std::string output;
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+    {
+        output += buffer;
+    }
+
+    if (pclose(pipe) != 0)
+    {
+        std::cerr << "Failed to compile shader " << name << ":" << std::endl
+                  << output;
+        unlink(temporaryPath.c_str());
+        return false;
+    }
+
+    // Renaming makes the cache entry appear atomically.
+    rename(temporaryPath.c_str(), cachePath.c_str());
+    return readBinaryFile(cachePath, spirv);
+}
+
+static void watchShaders()
+{
+    std::vector<char> eventBuffer(4096);
+
+    while (watching)
+    {
+        pollfd pollFd;
+        pollFd.fd = inotifyFd;
+        pollFd.events = POLLIN;
+        pollFd.revents = 0;
+        if (poll(&pollFd, 1, 100) <= 0)
+            continue;
+
+        // Editors often emit several events per save, only compile each file once.
+        std::vector<std::string> changedNames;
+        ssize_t length;
+        while ((length = read(inotifyFd, eventBuffer.data(), eventBuffer.size())) > 0)
+        {
+            for (ssize_t offset = 0; offset < length;)
+            {
+                const inotify_event *event = (const inotify_event *)(eventBuffer.data() + offset);
+                if (event->len > 0)
+                {
+                    std::string name = event->name;
+                    if (isShaderSource(name) && std::find(changedNames.begin(), changedNames.end(), name) == changedNames.end())
+                        changedNames.push_back(name);
+                }
+                offset += sizeof(inotify_event) + event->len;
+            }
+        }
+
+        for (const std::string &name : changedNames)
+        {
+            std::vector<char> spirv;
+            if (!compileShader(name, spirv))
+                continue;
+
+            std::lock_guard<std::mutex> lock(compiledShadersMutex);
+            compiledShaders[name] = std::move(spirv);
+        }
+    }
+}
+
+void initShaderManager(const std::string &sourceDirectory, const std::string &cacheDirectory)
+{
+    shaderSourceDirectory = sourceDirectory;
+    shaderCacheDirectory = cacheDirectory;
+    mkdir(shaderCacheDirectory.c_str(), 0755);
+
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0 || inotify_add_watch(inotifyFd, shaderSourceDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        std::cerr << "Shader hot-reload disabled, cannot watch " << shaderSourceDirectory << std::endl;
+        if (inotifyFd >= 0)
+            close(inotifyFd);
+        inotifyFd = -1;
+        return;
+    }
+
+    watching = true;
+    watchThread = std::thread(watchShaders);
+}
+
+void shutDownShaderManager()
+{
+    if (watching)
+    {
+        watching = false;
+        watchThread.join();
+    }
+    if (inotifyFd >= 0)
+    {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+
+    shaderCodes.clear();
+    compiledShaders.clear();
+}
+
+// The first request compiles synchronously. If no compiler is available the
+// SPIR-V written by the compileShaders script is used instead, either
+// <name>.spv or glslangValidator's default <stage>.spv.
+const std::vector<char> &getShaderCode(const std::string &name)
+{
+    auto it = shaderCodes.find(name);
+    if (it != shaderCodes.end())
+        return it->second;
+
+    std::vector<char> spirv;
+    if (!compileShader(name, spirv))
+    {
+        std::string precompiledPath = name + ".spv";
+        if (!std::ifstream(precompiledPath).good())
+            precompiledPath = name.substr(name.rfind('.') + 1) + ".spv";
+        std::cerr << "Falling back to " << precompiledPath << std::endl;
+        spirv = readFile(precompiledPath);
+    }
+
+    return shaderCodes[name] = std::move(spirv);
+}
+
+std::vector<std::string> takeChangedShaders()
+{
+    std::map<std::string, std::vector<char>> changedShaders;
+    {
+        std::lock_guard<std::mutex> lock(compiledShadersMutex);
+        changedShaders.swap(compiledShaders);
+    }
+
+    std::vector<std::string> changedNames;
+    for (auto &entry : changedShaders)
+    {
+        if (shaderCodes[entry.first] == entry.second)
+            continue;
+
+        shaderCodes[entry.first] = std::move(entry.second);
+        changedNames.push_back(entry.first);
+    }
+    return changedNames;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "engine.h"
+
+// Compiles GLSL from the shader directory to SPIR-V at runtime and keeps the
+// results in a cache keyed by a hash of the source, so unchanged shaders are
+// never recompiled. A background thread watches the directory with inotify and
+// recompiles edited shaders; the render loop picks them up at a frame boundary.
+void initShaderManager(const std::string &sourceDirectory, const std::string &cacheDirectory);
+void shutDownShaderManager();
+
+const std::vector<char> &getShaderCode(const std::string &name);
+
+// Returns the names of shaders whose SPIR-V changed since the last call.
+std::vector<std::string> takeChangedShaders();
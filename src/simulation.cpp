@@ -0,0 +1,73 @@
+#include "simulation.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+SimulationSettings simulationSettings;
+
+static TripleBuffer<FrameState> frameStates;
+static uint64_t simulatedTick = 0;
+
+static std::thread simulationThread;
+static std::atomic<bool> simulating(false);
+
+static void publishFrameState()
+{
+    FrameState &state = frameStates.getWriteBuffer();
+    state.tick = simulatedTick;
+    state.time = simulatedTick * (double)simulationSettings.tickSeconds;
+    state.model = glm::rotate(glm::mat4(1), (float)state.time * glm::radians(30.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    state.view = glm::lookAt(glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    frameStates.publish();
+}
+
+// Ticks that are late run back to back until the simulation has caught up.
+static void runSimulation()
+{
+    auto tickDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(simulationSettings.tickSeconds));
+    auto nextTick = std::chrono::steady_clock::now();
+    while (simulating)
+    {
+        nextTick += tickDuration;
+        std::this_thread::sleep_until(nextTick);
+
+        simulatedTick++;
+        publishFrameState();
+    }
+}
+
+void startSimulation()
+{
+    simulatedTick = 0;
+    publishFrameState();
+
+    if (simulationSettings.lockstep)
+        return;
+
+    simulating = true;
+    simulationThread = std::thread(runSimulation);
+}
+
+void stopSimulation()
+{
+    if (!simulationThread.joinable())
+        return;
+
+    simulating = false;
+    simulationThread.join();
+}
+
+const FrameState &acquireFrameState()
+{
+    if (simulationSettings.lockstep)
+    {
+        simulatedTick++;
+        publishFrameState();
+    }
+
+    frameStates.update();
+    return frameStates.getReadBuffer();
+}
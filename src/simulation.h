@@ -0,0 +1,36 @@
+#pragma once
+
+#include "tripleBuffer.h"
+
+#include <glm/glm.hpp>
+
+// Everything the render thread needs from one simulation tick. Published as a
+// whole and never modified afterwards, so rendering never sees a half updated
+// state.
+struct FrameState
+{
+    uint64_t tick;
+    // Seconds of simulated time, tick * tickSeconds.
+    double time;
+    glm::mat4 model;
+    glm::mat4 view;
+};
+
+// The simulation runs on its own thread at a fixed tick in real time and the
+// render thread draws whatever state is newest. In lockstep it is instead
+// advanced by exactly one tick per rendered frame, so runs are reproducible
+// regardless of frame rate.
+struct SimulationSettings
+{
+    float tickSeconds = 1.0f / 120.0f;
+    bool lockstep = false;
+};
+
+extern SimulationSettings simulationSettings;
+
+void startSimulation();
+void stopSimulation();
+
+// Called by the render thread once per frame. The reference stays valid until
+// the next call.
+const FrameState &acquireFrameState();
@@ -0,0 +1,110 @@
+#include "stressScene.h"
+#include "sceneFormat.h"
+
+#include <algorithm>
+#include <cmath>
+
+StressSceneSettings stressSceneSettings;
+
+static std::vector<GeometryHandle> meshes;
+
+// Spread geometrically, so small and large meshes are equally represented.
+static uint32_t getVertexCount(uint32_t mesh)
+{
+    const StressSceneSettings &settings = stressSceneSettings;
+    uint32_t minVertices = std::max(settings.minVertices, 4u);
+    uint32_t maxVertices = std::max(settings.maxVertices, minVertices);
+    if (settings.meshCount == 1)
+        return minVertices;
+
+    float t = mesh / (float)(settings.meshCount - 1);
+    return (uint32_t)std::lround(minVertices * std::pow(maxVertices / (float)minVertices, t));
+}
+
+static int16_t quantize(float value)
+{
+    return (int16_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+void createStressScene(GeometryPool &geometry)
+{
+    const StressSceneSettings &settings = stressSceneSettings;
+    uint32_t tilesPerRow = (uint32_t)std::ceil(std::sqrt((float)settings.meshCount));
+    float tileSize = 2.0f / tilesPerRow;
+
+    std::vector<SceneVertex> vertices;
+    std::vector<uint32_t> indices;
+    uint64_t vertexTotal = 0;
+    for (uint32_t mesh = 0; mesh < settings.meshCount; mesh++)
+    {
+        // A square grid with at least the requested number of vertices.
+        uint32_t side = std::max((uint32_t)std::ceil(std::sqrt((float)getVertexCount(mesh))), 2u);
+        float left = -1.0f + (mesh % tilesPerRow) * tileSize;
+        float top = -1.0f + (mesh / tilesPerRow) * tileSize;
+        float cellSize = tileSize * 0.9f / (side - 1);
+
+        vertices.clear();
+        for (uint32_t y = 0; y < side; y++)
+        {
+            for (uint32_t x = 0; x < side; x++)
+            {
+                SceneVertex vertex;
+                vertex.pos[0] = quantize(left + x * cellSize);
+                vertex.pos[1] = quantize(top + y * cellSize);
+                vertex.color[0] = x / (float)(side - 1);
+                vertex.color[1] = y / (float)(side - 1);
+                vertex.color[2] = (mesh % 7) / 6.0f;
+                vertex.texCoord[0] = x / (float)(side - 1);
+                vertex.texCoord[1] = y / (float)(side - 1);
+                vertices.push_back(vertex);
+            }
+        }
+
+        indices.clear();
+        for (uint32_t y = 0; y + 1 < side; y++)
+        {
+            for (uint32_t x = 0; x + 1 < side; x++)
+            {
+                uint32_t corner = y * side + x;
+                indices.insert(indices.end(), {corner, corner + side + 1, corner + side, corner, corner + 1, corner + side + 1});
+            }
+        }
+
+        meshes.push_back(geometry.addMesh(vertices.data(), vertices.size(), indices.data(), indices.size()));
+        vertexTotal += vertices.size();
+    }
+
+    std::cout << "Stress scene: " << settings.meshCount << " meshes, " << vertexTotal << " vertices, " << settings.instanceCount << " instances, "
+              << settings.materialCount << " materials" << std::endl;
+}
+
+const std::vector<GeometryHandle> &getStressSceneMeshes()
+{
+    return meshes;
+}
+
+// Small offsets on a grid, so the instances overlap like a dense scene would.
+std::vector<glm::vec2> getStressSceneInstanceOffsets()
+{
+    uint32_t count = std::max(stressSceneSettings.instanceCount, 1u);
+    uint32_t perRow = (uint32_t)std::ceil(std::sqrt((float)count));
+    std::vector<glm::vec2> offsets;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        offsets.push_back(glm::vec2((i % perRow) * 0.01f, (i / perRow) * 0.01f));
+    }
+    return offsets;
+}
+
+std::vector<glm::vec4> getStressSceneMaterialColors()
+{
+    uint32_t count = std::max(stressSceneSettings.materialCount, 1u);
+    std::vector<glm::vec4> colors;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        float hue = i / (float)count;
+        colors.push_back(glm::vec4(0.5f + 0.5f * std::cos(6.28318f * hue), 0.5f + 0.5f * std::cos(6.28318f * (hue - 0.333f)),
+                                   0.5f + 0.5f * std::cos(6.28318f * (hue - 0.667f)), 1.0f));
+    }
+    return colors;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "engine.h"
+#include "geometryPool.h"
+
+#include <glm/glm.hpp>
+
+// Synthetic scene for measuring how the engine scales: meshCount grid meshes
+// with vertex counts spread between minVertices and maxVertices, each drawn
+// with instanceCount instances and one of materialCount materials.
+struct StressSceneSettings
+{
+    uint32_t meshCount = 0;
+    uint32_t instanceCount = 1;
+    uint32_t materialCount = 1;
+    uint32_t minVertices = 4;
+    uint32_t maxVertices = 4096;
+};
+
+extern StressSceneSettings stressSceneSettings;
+
+inline bool isStressSceneEnabled()
+{
+    return stressSceneSettings.meshCount > 0;
+}
+
+// Adds the meshes to a pool of quantized vertices, laid out like
+// SceneVertex, with a position scale of 1.
+void createStressScene(GeometryPool &geometry);
+const std::vector<GeometryHandle> &getStressSceneMeshes();
+
+std::vector<glm::vec2> getStressSceneInstanceOffsets();
+std::vector<glm::vec4> getStressSceneMaterialColors();
@@ -0,0 +1,270 @@
+#include "submission.h"
+#include "frameStats.h"
+
+#include <limits>
+
+TimelineQueue graphicsTimeline;
+TimelineQueue computeTimeline;
+
+static PFN_vkGetSemaphoreCounterValue getSemaphoreCounterValue = nullptr;
+static PFN_vkWaitSemaphores waitSemaphores = nullptr;
+
+void TimelineQueue::init(VkQueue queue)
+{
+    this->queue = queue;
+    submittedValue = 0;
+    completedValue = 0;
+
+    if (!deviceCapabilities.timelineSemaphore)
+        return;
+
+    getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValue)getDeviceFunction("vkGetSemaphoreCounterValue", "vkGetSemaphoreCounterValueKHR", VK_API_VERSION_1_2);
+    waitSemaphores = (PFN_vkWaitSemaphores)getDeviceFunction("vkWaitSemaphores", "vkWaitSemaphoresKHR", VK_API_VERSION_1_2);
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo;
+    semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeCreateInfo.pNext = nullptr;
+    semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeCreateInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo;
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+    semaphoreCreateInfo.flags = 0;
+
+    VkResult result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &timelineSemaphore);
+    ASSERT_VULKAN(result);
+}
+
+void TimelineQueue::destroy()
+{
+    waitForValue(submittedValue);
+    collect();
+
+    if (timelineSemaphore != VK_NULL_HANDLE)
+    {
+        vkDestroySemaphore(device, timelineSemaphore, nullptr);
+        timelineSemaphore = VK_NULL_HANDLE;
+    }
+
+    for (FenceSubmission &submission : fenceSubmissions)
+    {
+        vkDestroyFence(device, submission.fence, nullptr);
+    }
+    fenceSubmissions.clear();
+
+    for (VkFence fence : freeFences)
+    {
+        vkDestroyFence(device, fence, nullptr);
+    }
+    freeFences.clear();
+}
+
+void TimelineQueue::addCommandBuffer(VkCommandBuffer commandBuffer)
+{
+    batchCommandBuffers.push_back(commandBuffer);
+}
+
+void TimelineQueue::addWaitSemaphore(VkSemaphore semaphore, VkPipelineStageFlags stageMask)
+{
+    batchWaitSemaphores.push_back(semaphore);
+    batchWaitStageMasks.push_back(stageMask);
+    batchWaitValues.push_back(0);
+}
+
+void TimelineQueue::addTimelineWait(const TimelineQueue &other, uint64_t value, VkPipelineStageFlags stageMask)
+{
+    batchWaitSemaphores.push_back(other.timelineSemaphore);
+    batchWaitStageMasks.push_back(stageMask);
+    batchWaitValues.push_back(value);
+}
+
+void TimelineQueue::addSignalSemaphore(VkSemaphore semaphore)
+{
+    batchSignalSemaphores.push_back(semaphore);
+}
+
+void TimelineQueue::freeOnCompletion(VkCommandPool commandPool, VkCommandBuffer commandBuffer)
+{
+    pendingFrees.push_back({submittedValue + 1, commandPool, commandBuffer});
+}
+
+VkFence TimelineQueue::acquireFence()
+{
+    if (!freeFences.empty())
+    {
+        VkFence fence = freeFences.back();
+        freeFences.pop_back();
+        return fence;
+    }
+
+    VkFenceCreateInfo fenceCreateInfo;
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceCreateInfo.pNext = nullptr;
+    fenceCreateInfo.flags = 0;
+
+    VkFence fence;
+    VkResult result = vkCreateFence(device, &fenceCreateInfo, nullptr, &fence);
+    ASSERT_VULKAN(result);
+
+    return fence;
+}
+
+uint64_t TimelineQueue::flush()
+{
+    if (batchCommandBuffers.empty() && batchWaitSemaphores.empty() && batchSignalSemaphores.empty())
+        return submittedValue;
+
+    uint64_t signalValue = submittedValue + 1;
+
+    // Binary semaphores ignore their entry in the value arrays.
+    std::vector<uint64_t> signalValues(batchSignalSemaphores.size(), 0);
+
+    VkFence fence = VK_NULL_HANDLE;
+    if (timelineSemaphore != VK_NULL_HANDLE)
+    {
+        batchSignalSemaphores.push_back(timelineSemaphore);
+        signalValues.push_back(signalValue);
+    }
+    else
+    {
+        fence = acquireFence();
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo;
+    timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSubmitInfo.pNext = nullptr;
+    timelineSubmitInfo.waitSemaphoreValueCount = batchWaitValues.size();
+    timelineSubmitInfo.pWaitSemaphoreValues = batchWaitValues.data();
+    timelineSubmitInfo.signalSemaphoreValueCount = signalValues.size();
+    timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+
+    VkSubmitInfo submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = timelineSemaphore != VK_NULL_HANDLE ? &timelineSubmitInfo : nullptr;
+    submitInfo.waitSemaphoreCount = batchWaitSemaphores.size();
+    submitInfo.pWaitSemaphores = batchWaitSemaphores.data();
+    submitInfo.pWaitDstStageMask = batchWaitStageMasks.data();
+    submitInfo.commandBufferCount = batchCommandBuffers.size();
+    submitInfo.pCommandBuffers = batchCommandBuffers.data();
+    submitInfo.signalSemaphoreCount = batchSignalSemaphores.size();
+    submitInfo.pSignalSemaphores = batchSignalSemaphores.data();
+
+    COUNT_FRAME_STAT(QueueSubmits, 1);
+    VkResult result = vkQueueSubmit(queue, 1, &submitInfo, fence);
+    ASSERT_VULKAN(result);
+
+    if (fence != VK_NULL_HANDLE)
+        fenceSubmissions.push_back({signalValue, fence});
+
+    submittedValue = signalValue;
+
+    batchCommandBuffers.clear();
+    batchWaitSemaphores.clear();
+    batchWaitStageMasks.clear();
+    batchWaitValues.clear();
+    batchSignalSemaphores.clear();
+
+    return submittedValue;
+}
+
+uint64_t TimelineQueue::getSubmittedValue() const
+{
+    return submittedValue;
+}
+
+// Value that the work currently being batched will signal once flushed.
+uint64_t TimelineQueue::getPendingValue() const
+{
+    if (batchCommandBuffers.empty() && batchWaitSemaphores.empty() && batchSignalSemaphores.empty())
+        return submittedValue;
+    return submittedValue + 1;
+}
+
+uint64_t TimelineQueue::getCompletedValue()
+{
+    if (timelineSemaphore != VK_NULL_HANDLE)
+    {
+        uint64_t value = 0;
+        VkResult result = getSemaphoreCounterValue(device, timelineSemaphore, &value);
+        ASSERT_VULKAN(result);
+        completedValue = value;
+        return completedValue;
+    }
+
+    while (!fenceSubmissions.empty() && vkGetFenceStatus(device, fenceSubmissions.front().fence) == VK_SUCCESS)
+    {
+        FenceSubmission submission = fenceSubmissions.front();
+        fenceSubmissions.pop_front();
+
+        VkResult result = vkResetFences(device, 1, &submission.fence);
+        ASSERT_VULKAN(result);
+        freeFences.push_back(submission.fence);
+
+        completedValue = submission.value;
+    }
+
+    return completedValue;
+}
+
+bool TimelineQueue::isComplete(uint64_t value)
+{
+    if (value <= completedValue)
+        return true;
+
+    return value <= getCompletedValue();
+}
+
+void TimelineQueue::waitForValue(uint64_t value)
+{
+    if (value > submittedValue)
+        value = submittedValue;
+
+    if (isComplete(value))
+        return;
+
+    if (timelineSemaphore != VK_NULL_HANDLE)
+    {
+        VkSemaphoreWaitInfo semaphoreWaitInfo;
+        semaphoreWaitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        semaphoreWaitInfo.pNext = nullptr;
+        semaphoreWaitInfo.flags = 0;
+        semaphoreWaitInfo.semaphoreCount = 1;
+        semaphoreWaitInfo.pSemaphores = &timelineSemaphore;
+        semaphoreWaitInfo.pValues = &value;
+
+        VkResult result = waitSemaphores(device, &semaphoreWaitInfo, std::numeric_limits<uint64_t>::max());
+        ASSERT_VULKAN(result);
+    }
+    else
+    {
+        for (FenceSubmission &submission : fenceSubmissions)
+        {
+            if (submission.value >= value)
+            {
+                VkResult result = vkWaitForFences(device, 1, &submission.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+                ASSERT_VULKAN(result);
+                break;
+            }
+        }
+    }
+
+    getCompletedValue();
+}
+
+void TimelineQueue::collect()
+{
+    uint64_t completed = getCompletedValue();
+
+    while (!pendingFrees.empty() && pendingFrees.front().value <= completed)
+    {
+        PendingFree &pendingFree = pendingFrees.front();
+        vkFreeCommandBuffers(device, pendingFree.commandPool, 1, &pendingFree.commandBuffer);
+        pendingFrees.pop_front();
+    }
+}
+
+VkQueue TimelineQueue::getQueue() const
+{
+    return queue;
+}
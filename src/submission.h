@@ -0,0 +1,67 @@
+#pragma once
+
+#include "engine.h"
+
+#include <deque>
+
+// Batches command buffers into a single vkQueueSubmit and tracks GPU progress
+// as one monotonically increasing value. Backed by a timeline semaphore when
+// the device supports it, otherwise by one fence per submit.
+class TimelineQueue
+{
+  public:
+    void init(VkQueue queue);
+    void destroy();
+
+    void addCommandBuffer(VkCommandBuffer commandBuffer);
+    void addWaitSemaphore(VkSemaphore semaphore, VkPipelineStageFlags stageMask);
+    // Waits until another queue's timeline has reached value.
+    void addTimelineWait(const TimelineQueue &other, uint64_t value, VkPipelineStageFlags stageMask);
+    void addSignalSemaphore(VkSemaphore semaphore);
+    void freeOnCompletion(VkCommandPool commandPool, VkCommandBuffer commandBuffer);
+
+    uint64_t flush();
+
+    uint64_t getSubmittedValue() const;
+    uint64_t getPendingValue() const;
+    uint64_t getCompletedValue();
+    bool isComplete(uint64_t value);
+    void waitForValue(uint64_t value);
+    void collect();
+
+    VkQueue getQueue() const;
+
+  private:
+    struct PendingFree
+    {
+        uint64_t value;
+        VkCommandPool commandPool;
+        VkCommandBuffer commandBuffer;
+    };
+
+    struct FenceSubmission
+    {
+        uint64_t value;
+        VkFence fence;
+    };
+
+    VkFence acquireFence();
+
+    VkQueue queue = VK_NULL_HANDLE;
+    VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+    uint64_t submittedValue = 0;
+    uint64_t completedValue = 0;
+
+    std::vector<VkCommandBuffer> batchCommandBuffers;
+    std::vector<VkSemaphore> batchWaitSemaphores;
+    std::vector<VkPipelineStageFlags> batchWaitStageMasks;
+    std::vector<uint64_t> batchWaitValues;
+    std::vector<VkSemaphore> batchSignalSemaphores;
+
+    std::deque<PendingFree> pendingFrees;
+    std::deque<FenceSubmission> fenceSubmissions;
+    std::vector<VkFence> freeFences;
+};
+
+extern TimelineQueue graphicsTimeline;
+extern TimelineQueue computeTimeline;
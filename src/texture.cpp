@@ -0,0 +1,760 @@
+#include "texture.h"
+#include "deletionQueue.h"
+#include "bindless.h"
+#include "memoryBudget.h"
+#include "frameStats.h"
+
+#include <algorithm>
+
+TextureStreamingSettings textureStreamingSettings;
+VkSampler textureSampler = VK_NULL_HANDLE;
+
+static std::vector<Texture *> textures;
+static VkDeviceSize totalResidentBytes = 0;
+
+struct KtxHeader
+{
+    uint8_t identifier[12];
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+static const uint8_t ktxIdentifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+static const uint32_t ktxEndianness = 0x04030201;
+
+struct KtxFormat
+{
+    uint32_t glInternalFormat;
+    VkFormat format;
+    bool compressed;
+};
+
+static const KtxFormat ktxFormats[] = {
+    {0x8058, VK_FORMAT_R8G8B8A8_UNORM, false},       // GL_RGBA8
+    {0x8C43, VK_FORMAT_R8G8B8A8_SRGB, false},        // GL_SRGB8_ALPHA8
+    {0x83F1, VK_FORMAT_BC1_RGBA_UNORM_BLOCK, true},  // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+    {0x8C4D, VK_FORMAT_BC1_RGBA_SRGB_BLOCK, true},   // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+    {0x83F3, VK_FORMAT_BC3_UNORM_BLOCK, true},       // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+    {0x8C4F, VK_FORMAT_BC3_SRGB_BLOCK, true},        // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+    {0x8E8C, VK_FORMAT_BC7_UNORM_BLOCK, true},       // GL_COMPRESSED_RGBA_BPTC_UNORM
+    {0x8E8D, VK_FORMAT_BC7_SRGB_BLOCK, true},        // GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+    {0x93B0, VK_FORMAT_ASTC_4x4_UNORM_BLOCK, true},  // GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+    {0x93D0, VK_FORMAT_ASTC_4x4_SRGB_BLOCK, true},   // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR
+};
+
+static bool isFormatSupported(VkFormat format, VkFormatFeatureFlags features)
+{
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevices[0], format, &formatProperties);
+    return (formatProperties.optimalTilingFeatures & features) == features;
+}
+
+static VkDeviceSize evictTextures(VkDeviceSize bytes, EvictionReason reason);
+// Running out of memory while streaming a texture must not evict from it.
+static Texture *streamingTexture = nullptr;
+
+static uint32_t getFullMipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    while ((width | height) >> levels)
+        levels++;
+    return levels;
+}
+
+void initTextures()
+{
+    VkSamplerCreateInfo samplerCreateInfo;
+    samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerCreateInfo.pNext = nullptr;
+    samplerCreateInfo.flags = 0;
+    samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerCreateInfo.mipLodBias = 0.0f;
+    samplerCreateInfo.anisotropyEnable = deviceCapabilities.samplerAnisotropy ? VK_TRUE : VK_FALSE;
+    samplerCreateInfo.maxAnisotropy = std::min(16.0f, deviceCapabilities.maxSamplerAnisotropy);
+    samplerCreateInfo.compareEnable = VK_FALSE;
+    samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerCreateInfo.minLod = 0.0f;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+    samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+    samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+
+    VkResult result = vkCreateSampler(device, &samplerCreateInfo, nullptr, &textureSampler);
+    ASSERT_VULKAN(result);
+
+    addMemoryEvictor(evictTextures);
+}
+
+void shutDownTextures()
+{
+    while (!textures.empty())
+    {
+        destroyTexture(textures.back());
+    }
+
+    vkDestroySampler(device, textureSampler, nullptr);
+}
+
+static void generateMipmaps(VkCommandBuffer commandBuffer, Texture *texture)
+{
+    int32_t mipWidth = texture->width;
+    int32_t mipHeight = texture->height;
+
+    for (uint32_t i = 1; i < texture->mipLevels; i++)
+    {
+        cmdImageBarrier(commandBuffer, texture->image, VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 1,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        VkImageBlit imageBlit;
+        imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageBlit.srcSubresource.mipLevel = i - 1;
+        imageBlit.srcSubresource.baseArrayLayer = 0;
+        imageBlit.srcSubresource.layerCount = 1;
+        imageBlit.srcOffsets[0] = {0, 0, 0};
+        imageBlit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+        imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageBlit.dstSubresource.mipLevel = i;
+        imageBlit.dstSubresource.baseArrayLayer = 0;
+        imageBlit.dstSubresource.layerCount = 1;
+        imageBlit.dstOffsets[0] = {0, 0, 0};
+        imageBlit.dstOffsets[1] = {std::max(mipWidth / 2, 1), std::max(mipHeight / 2, 1), 1};
+
+        vkCmdBlitImage(commandBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+
+        cmdImageBarrier(commandBuffer, texture->image, VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 1,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+        mipWidth = std::max(mipWidth / 2, 1);
+        mipHeight = std::max(mipHeight / 2, 1);
+    }
+
+    cmdImageBarrier(commandBuffer, texture->image, VK_IMAGE_ASPECT_COLOR_BIT, texture->mipLevels - 1, 1,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+static void allocateTextureImage(Texture *texture, uint32_t firstMip, VkImageUsageFlags extraUsage, VkImage &image, VkDeviceMemory &deviceMemory, VkDeviceSize &allocationSize)
+{
+    uint32_t levelCount = texture->mipLevels - firstMip;
+    uint32_t width = std::max(texture->width >> firstMip, 1u);
+    uint32_t height = std::max(texture->height >> firstMip, 1u);
+
+    createImage(width, height, levelCount, texture->format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | extraUsage,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, deviceMemory);
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+    allocationSize = memoryRequirements.size;
+}
+
+static void setTextureImage(Texture *texture, VkImage image, VkDeviceMemory deviceMemory, VkDeviceSize allocationSize, uint32_t residentMip)
+{
+    if (texture->image != VK_NULL_HANDLE)
+    {
+        releaseBindlessTexture(texture->bindlessIndex);
+        deletionQueue.destroyImageView(texture->imageView);
+        deletionQueue.destroyImage(texture->image);
+        deletionQueue.freeMemory(texture->deviceMemory);
+        totalResidentBytes -= texture->residentBytes;
+    }
+
+    texture->image = image;
+    texture->deviceMemory = deviceMemory;
+    texture->residentMip = residentMip;
+    texture->residentBytes = allocationSize;
+    texture->lastCommandValue = graphicsTimeline.getPendingValue();
+    totalResidentBytes += allocationSize;
+
+    createImageView(image, texture->format, VK_IMAGE_ASPECT_COLOR_BIT, texture->mipLevels - residentMip, texture->imageView);
+    texture->bindlessIndex = allocateBindlessTexture(texture->imageView, textureSampler);
+
+    // Streamed textures keep their file mapped, so dropped levels can be
+    // streamed back in.
+    if (residentMip == 0 && texture->mips.size() < texture->mipLevels)
+        texture->file.close();
+}
+
+// Uploads the mip tail starting at firstMip straight from the mapped file.
+static void uploadMipTail(Texture *texture, uint32_t firstMip)
+{
+    VkDeviceSize stagingSize = 0;
+    for (uint32_t i = firstMip; i < texture->mipLevels; i++)
+    {
+        stagingSize += texture->mips[i].size;
+    }
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createStagingBuffer(nullptr, stagingSize, stagingBuffer, stagingBufferMemory);
+
+    void *memory;
+    COUNT_FRAME_STAT(MemoryMaps, 1);
+    vkMapMemory(device, stagingBufferMemory, 0, stagingSize, 0, &memory);
+    std::vector<VkBufferImageCopy> regions;
+    VkDeviceSize stagingOffset = 0;
+    for (uint32_t i = firstMip; i < texture->mipLevels; i++)
+    {
+        const TextureMip &mip = texture->mips[i];
+        memcpy((uint8_t *)memory + stagingOffset, texture->file.data() + mip.offset, mip.size);
+
+        VkBufferImageCopy region;
+        region.bufferOffset = stagingOffset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i - firstMip;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {mip.width, mip.height, 1};
+        regions.push_back(region);
+
+        stagingOffset += mip.size;
+    }
+    vkUnmapMemory(device, stagingBufferMemory);
+
+    VkImage image;
+    VkDeviceMemory deviceMemory;
+    VkDeviceSize allocationSize;
+    allocateTextureImage(texture, firstMip, 0, image, deviceMemory, allocationSize);
+
+    uint32_t levelCount = texture->mipLevels - firstMip;
+    VkCommandBuffer commandBuffer = beginOneTimeCommands();
+    cmdImageBarrier(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions.size(), regions.data());
+    cmdImageBarrier(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    endOneTimeCommands(commandBuffer);
+
+    deletionQueue.destroyBuffer(stagingBuffer);
+    deletionQueue.freeMemory(stagingBufferMemory);
+
+    setTextureImage(texture, image, deviceMemory, allocationSize, firstMip);
+}
+
+// Reallocates the image one level larger, keeping the resident levels and
+// uploading the next finer one.
+static void streamNextMip(Texture *texture)
+{
+    streamingTexture = texture;
+    uint32_t newMip = texture->residentMip - 1;
+    const TextureMip &mip = texture->mips[newMip];
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createStagingBuffer(texture->file.data() + mip.offset, mip.size, stagingBuffer, stagingBufferMemory);
+
+    VkImage image;
+    VkDeviceMemory deviceMemory;
+    VkDeviceSize allocationSize;
+    allocateTextureImage(texture, newMip, 0, image, deviceMemory, allocationSize);
+
+    uint32_t oldLevelCount = texture->mipLevels - texture->residentMip;
+    uint32_t newLevelCount = oldLevelCount + 1;
+
+    VkCommandBuffer commandBuffer = beginOneTimeCommands();
+    cmdImageBarrier(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, 0, newLevelCount,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    cmdImageBarrier(commandBuffer, texture->image, VK_IMAGE_ASPECT_COLOR_BIT, 0, oldLevelCount,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    std::vector<VkImageCopy> imageCopies(oldLevelCount);
+    for (uint32_t i = 0; i < oldLevelCount; i++)
+    {
+        const TextureMip &levelMip = texture->mips[texture->residentMip + i];
+        imageCopies[i].srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageCopies[i].srcSubresource.mipLevel = i;
+        imageCopies[i].srcSubresource.baseArrayLayer = 0;
+        imageCopies[i].srcSubresource.layerCount = 1;
+        imageCopies[i].srcOffset = {0, 0, 0};
+        imageCopies[i].dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageCopies[i].dstSubresource.mipLevel = i + 1;
+        imageCopies[i].dstSubresource.baseArrayLayer = 0;
+        imageCopies[i].dstSubresource.layerCount = 1;
+        imageCopies[i].dstOffset = {0, 0, 0};
+        imageCopies[i].extent = {levelMip.width, levelMip.height, 1};
+    }
+    vkCmdCopyImage(commandBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageCopies.size(), imageCopies.data());
+
+    VkBufferImageCopy region;
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {mip.width, mip.height, 1};
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    cmdImageBarrier(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, 0, newLevelCount,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    endOneTimeCommands(commandBuffer);
+
+    deletionQueue.destroyBuffer(stagingBuffer);
+    deletionQueue.freeMemory(stagingBufferMemory);
+
+    setTextureImage(texture, image, deviceMemory, allocationSize, newMip);
+    streamingTexture = nullptr;
+}
+
+// The inverse of streamNextMip: reallocates the image one level smaller,
+// keeping all but the finest resident level.
+static void dropFinestMip(Texture *texture)
+{
+    streamingTexture = texture;
+    uint32_t newMip = texture->residentMip + 1;
+
+    VkImage image;
+    VkDeviceMemory deviceMemory;
+    VkDeviceSize allocationSize;
+    allocateTextureImage(texture, newMip, 0, image, deviceMemory, allocationSize);
+
+    uint32_t newLevelCount = texture->mipLevels - newMip;
+
+    VkCommandBuffer commandBuffer = beginOneTimeCommands();
+    cmdImageBarrier(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, 0, newLevelCount,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    cmdImageBarrier(commandBuffer, texture->image, VK_IMAGE_ASPECT_COLOR_BIT, 1, newLevelCount,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    std::vector<VkImageCopy> imageCopies(newLevelCount);
+    for (uint32_t i = 0; i < newLevelCount; i++)
+    {
+        const TextureMip &levelMip = texture->mips[newMip + i];
+        imageCopies[i].srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageCopies[i].srcSubresource.mipLevel = i + 1;
+        imageCopies[i].srcSubresource.baseArrayLayer = 0;
+        imageCopies[i].srcSubresource.layerCount = 1;
+        imageCopies[i].srcOffset = {0, 0, 0};
+        imageCopies[i].dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageCopies[i].dstSubresource.mipLevel = i;
+        imageCopies[i].dstSubresource.baseArrayLayer = 0;
+        imageCopies[i].dstSubresource.layerCount = 1;
+        imageCopies[i].dstOffset = {0, 0, 0};
+        imageCopies[i].extent = {levelMip.width, levelMip.height, 1};
+    }
+    vkCmdCopyImage(commandBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageCopies.size(), imageCopies.data());
+
+    cmdImageBarrier(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, 0, newLevelCount,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    endOneTimeCommands(commandBuffer);
+
+    setTextureImage(texture, image, deviceMemory, allocationSize, newMip);
+    streamingTexture = nullptr;
+}
+
+// Only levels that can be streamed back in are dropped, and never below the
+// tail loaded up front.
+static bool canDropMip(const Texture *texture)
+{
+    if (!texture->file.isOpen() || texture->mips.size() < texture->mipLevels || texture->residentMip + 1 >= texture->mipLevels)
+        return false;
+    const TextureMip &mip = texture->mips[texture->residentMip];
+    return std::max(mip.width, mip.height) > textureStreamingSettings.initialResidentDimension;
+}
+
+// Drops the finest level of the least recently used texture until enough has
+// been released. Frames in flight keep sampling the old images.
+static VkDeviceSize evictTextureLevels(VkDeviceSize bytes)
+{
+    VkDeviceSize released = 0;
+    while (released < bytes)
+    {
+        Texture *next = nullptr;
+        for (Texture *texture : textures)
+        {
+            if (texture == streamingTexture || !canDropMip(texture))
+                continue;
+            if (next == nullptr || texture->lastUsedFrame < next->lastUsedFrame ||
+                (texture->lastUsedFrame == next->lastUsedFrame && texture->residentBytes > next->residentBytes))
+                next = texture;
+        }
+
+        if (next == nullptr)
+            break;
+
+        VkDeviceSize residentBytes = next->residentBytes;
+        dropFinestMip(next);
+        released += residentBytes - next->residentBytes;
+    }
+    return released;
+}
+
+// Only textures that can be loaded again from their file, and that neither
+// the frame being recorded nor the batch of one time commands uses. Frames in
+// flight are waited for before the memory is freed.
+static bool canReleaseTexture(const Texture *texture)
+{
+    return texture != streamingTexture && texture->image != VK_NULL_HANDLE && texture->file.isOpen() && texture->mips.size() >= texture->mipLevels &&
+           texture->lastUsedFrame < getResidencyFrame() && texture->lastCommandValue <= graphicsTimeline.getSubmittedValue();
+}
+
+// Frees the least recently used textures whole, without allocating or
+// recording anything. Draws fall back to the default texture in bindless
+// slot 0 until updateTextureStreaming loads them again.
+static VkDeviceSize releaseTextures(VkDeviceSize bytes)
+{
+    VkDeviceSize released = 0;
+    while (released < bytes)
+    {
+        Texture *next = nullptr;
+        for (Texture *texture : textures)
+        {
+            if (canReleaseTexture(texture) && (next == nullptr || texture->lastUsedFrame < next->lastUsedFrame))
+                next = texture;
+        }
+
+        if (next == nullptr)
+            break;
+
+        releaseBindlessTexture(next->bindlessIndex);
+        VkImageView imageView = next->imageView;
+        VkImage image = next->image;
+        VkDeviceMemory deviceMemory = next->deviceMemory;
+        deletionQueue.pushSubmitted([=]() {
+            vkDestroyImageView(device, imageView, nullptr);
+            vkDestroyImage(device, image, nullptr);
+            freeDeviceMemory(deviceMemory);
+        });
+
+        released += next->residentBytes;
+        totalResidentBytes -= next->residentBytes;
+        next->image = VK_NULL_HANDLE;
+        next->deviceMemory = VK_NULL_HANDLE;
+        next->imageView = VK_NULL_HANDLE;
+        next->residentBytes = 0;
+        next->residentMip = next->mipLevels;
+        next->bindlessIndex = 0;
+        next->releasedFrame = getResidencyFrame();
+    }
+    return released;
+}
+
+static VkDeviceSize evictTextures(VkDeviceSize bytes, EvictionReason reason)
+{
+    if (reason == EvictionReason::OutOfMemory)
+        return releaseTextures(bytes);
+    return evictTextureLevels(bytes);
+}
+
+// The finest level still within initialResidentDimension.
+static uint32_t getInitialResidentMip(const Texture *texture)
+{
+    uint32_t firstMip = texture->mipLevels - 1;
+    while (firstMip > 0 && std::max(texture->mips[firstMip - 1].width, texture->mips[firstMip - 1].height) <= textureStreamingSettings.initialResidentDimension)
+        firstMip--;
+    return firstMip;
+}
+
+static bool parseKtx(Texture *texture)
+{
+    const MappedFile &file = texture->file;
+    if (file.size() < sizeof(KtxHeader))
+        return false;
+
+    KtxHeader header;
+    memcpy(&header, file.data(), sizeof(KtxHeader));
+
+    if (memcmp(header.identifier, ktxIdentifier, sizeof(ktxIdentifier)) != 0 || header.endianness != ktxEndianness)
+        return false;
+    if (header.pixelDepth > 1 || header.numberOfArrayElements > 1 || header.numberOfFaces != 1)
+        return false;
+
+    const KtxFormat *ktxFormat = nullptr;
+    for (const KtxFormat &candidate : ktxFormats)
+    {
+        if (candidate.glInternalFormat == header.glInternalFormat)
+            ktxFormat = &candidate;
+    }
+    if (ktxFormat == nullptr || !isFormatSupported(ktxFormat->format, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+        return false;
+
+    texture->format = ktxFormat->format;
+    texture->width = header.pixelWidth;
+    texture->height = std::max(header.pixelHeight, 1u);
+
+    uint32_t storedLevels = std::max(header.numberOfMipmapLevels, 1u);
+    VkDeviceSize offset = sizeof(KtxHeader) + header.bytesOfKeyValueData;
+    for (uint32_t i = 0; i < storedLevels; i++)
+    {
+        if (offset + sizeof(uint32_t) > file.size())
+            return false;
+
+        uint32_t imageSize;
+        memcpy(&imageSize, file.data() + offset, sizeof(uint32_t));
+        offset += sizeof(uint32_t);
+
+        if (offset + imageSize > file.size())
+            return false;
+
+        TextureMip mip;
+        mip.offset = offset;
+        mip.size = imageSize;
+        mip.width = std::max(texture->width >> i, 1u);
+        mip.height = std::max(texture->height >> i, 1u);
+        texture->mips.push_back(mip);
+
+        offset += (imageSize + 3) & ~3u;
+    }
+
+    texture->mipLevels = storedLevels;
+
+    // A single uncompressed level gets its chain generated on the GPU instead.
+    bool canBlit = !ktxFormat->compressed && isFormatSupported(texture->format, VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+    if (storedLevels == 1 && canBlit)
+        texture->mipLevels = getFullMipLevelCount(texture->width, texture->height);
+
+    return true;
+}
+
+static void uploadWithGeneratedMips(Texture *texture)
+{
+    const TextureMip &mip = texture->mips[0];
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createStagingBuffer(texture->file.data() + mip.offset, mip.size, stagingBuffer, stagingBufferMemory);
+
+    VkImage image;
+    VkDeviceMemory deviceMemory;
+    VkDeviceSize allocationSize;
+    allocateTextureImage(texture, 0, 0, image, deviceMemory, allocationSize);
+    setTextureImage(texture, image, deviceMemory, allocationSize, 0);
+
+    VkCommandBuffer commandBuffer = beginOneTimeCommands();
+    cmdImageBarrier(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, 0, texture->mipLevels,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkBufferImageCopy region;
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {mip.width, mip.height, 1};
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    generateMipmaps(commandBuffer, texture);
+    endOneTimeCommands(commandBuffer);
+
+    deletionQueue.destroyBuffer(stagingBuffer);
+    deletionQueue.freeMemory(stagingBufferMemory);
+}
+
+// Picks the best variant the device can sample: <basePath>.astc.ktx,
+// <basePath>.bc.ktx, then the uncompressed <basePath>.ktx.
+Texture *loadTexture(const std::string &basePath)
+{
+    std::vector<std::string> candidates;
+    if (deviceCapabilities.textureCompressionASTC)
+        candidates.push_back(basePath + ".astc.ktx");
+    if (deviceCapabilities.textureCompressionBC)
+        candidates.push_back(basePath + ".bc.ktx");
+    candidates.push_back(basePath + ".ktx");
+
+    for (const std::string &candidate : candidates)
+    {
+        Texture *texture = new Texture();
+        if (!texture->file.open(candidate) || !parseKtx(texture))
+        {
+            delete texture;
+            continue;
+        }
+
+        if (texture->mips.size() < texture->mipLevels)
+        {
+            uploadWithGeneratedMips(texture);
+        }
+        else
+        {
+            uploadMipTail(texture, getInitialResidentMip(texture));
+        }
+
+        std::cout << "Loaded texture " << candidate << " (" << texture->width << "x" << texture->height << ", " << texture->mipLevels << " mips, format " << texture->format << ")" << std::endl;
+
+        textures.push_back(texture);
+        return texture;
+    }
+
+    std::cerr << "Failed to load texture " << basePath << std::endl;
+    return nullptr;
+}
+
+Texture *createTexture(uint32_t width, uint32_t height, const uint8_t *rgba)
+{
+    Texture *texture = new Texture();
+    texture->format = VK_FORMAT_R8G8B8A8_UNORM;
+    texture->width = width;
+    texture->height = height;
+    texture->mipLevels = isFormatSupported(texture->format, VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? getFullMipLevelCount(width, height) : 1;
+    texture->residentMip = 0;
+
+    TextureMip mip;
+    mip.offset = 0;
+    mip.size = (VkDeviceSize)width * height * 4;
+    mip.width = width;
+    mip.height = height;
+    texture->mips.push_back(mip);
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createStagingBuffer(rgba, mip.size, stagingBuffer, stagingBufferMemory);
+
+    VkImage image;
+    VkDeviceMemory deviceMemory;
+    VkDeviceSize allocationSize;
+    allocateTextureImage(texture, 0, 0, image, deviceMemory, allocationSize);
+    setTextureImage(texture, image, deviceMemory, allocationSize, 0);
+
+    VkCommandBuffer commandBuffer = beginOneTimeCommands();
+    cmdImageBarrier(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, 0, texture->mipLevels,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkBufferImageCopy region;
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {width, height, 1};
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    generateMipmaps(commandBuffer, texture);
+    endOneTimeCommands(commandBuffer);
+
+    deletionQueue.destroyBuffer(stagingBuffer);
+    deletionQueue.freeMemory(stagingBufferMemory);
+
+    textures.push_back(texture);
+    return texture;
+}
+
+void destroyTexture(Texture *texture)
+{
+    textures.erase(std::remove(textures.begin(), textures.end(), texture), textures.end());
+
+    if (texture->image != VK_NULL_HANDLE)
+    {
+        releaseBindlessTexture(texture->bindlessIndex);
+        deletionQueue.destroyImageView(texture->imageView);
+        deletionQueue.destroyImage(texture->image);
+        deletionQueue.freeMemory(texture->deviceMemory);
+        totalResidentBytes -= texture->residentBytes;
+    }
+
+    delete texture;
+}
+
+void markTextureUsed(Texture *texture)
+{
+    texture->lastUsedFrame = getResidencyFrame();
+}
+
+// Streams finer mips of recently used textures in, always picking the
+// smallest pending level first, until the texture budget, the device memory
+// budget or the per-frame upload budget is used up.
+void updateTextureStreaming()
+{
+    VkDeviceSize uploadedBytes = 0;
+    uint64_t frame = getResidencyFrame();
+
+    // Released textures drawn since come back with their initial mip tail.
+    for (Texture *texture : textures)
+    {
+        if (texture->image != VK_NULL_HANDLE || texture->lastUsedFrame <= texture->releasedFrame)
+            continue;
+
+        uint32_t firstMip = getInitialResidentMip(texture);
+        VkDeviceSize tailSize = 0;
+        for (uint32_t i = firstMip; i < texture->mipLevels; i++)
+        {
+            tailSize += texture->mips[i].size;
+        }
+        if (uploadedBytes > 0 && uploadedBytes + tailSize > textureStreamingSettings.uploadBytesPerFrame)
+            return;
+        if (tailSize > getAvailableDeviceMemory())
+            return;
+
+        uploadMipTail(texture, firstMip);
+        uploadedBytes += tailSize;
+    }
+
+    while (true)
+    {
+        Texture *next = nullptr;
+        for (Texture *texture : textures)
+        {
+            if (texture->image == VK_NULL_HANDLE || texture->residentMip == 0 || !texture->file.isOpen() ||
+                texture->lastUsedFrame + textureStreamingSettings.idleFrames < frame)
+                continue;
+            if (next == nullptr || texture->mips[texture->residentMip - 1].size < next->mips[next->residentMip - 1].size)
+                next = texture;
+        }
+
+        if (next == nullptr)
+            return;
+
+        VkDeviceSize levelSize = next->mips[next->residentMip - 1].size;
+        if (uploadedBytes > 0 && uploadedBytes + levelSize > textureStreamingSettings.uploadBytesPerFrame)
+            return;
+        if (totalResidentBytes + levelSize > textureStreamingSettings.memoryBudget || levelSize > getAvailableDeviceMemory())
+            return;
+
+        streamNextMip(next);
+        uploadedBytes += levelSize;
+    }
+}
+
+VkDeviceSize getTextureResidentBytes()
+{
+    return totalResidentBytes;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "engine.h"
+#include "mappedFile.h"
+
+struct TextureStreamingSettings
+{
+    VkDeviceSize memoryBudget = 256 * 1024 * 1024;
+    VkDeviceSize uploadBytesPerFrame = 8 * 1024 * 1024;
+    uint32_t initialResidentDimension = 64;
+    // Textures that haven't been used for this many frames aren't streamed
+    // further and are the first to lose levels when over the memory budget.
+    uint32_t idleFrames = 300;
+};
+
+struct TextureMip
+{
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t width;
+    uint32_t height;
+};
+
+// A texture keeps only the mip levels from residentMip down to the smallest
+// in VRAM. Finer levels are streamed in from the mapped file one at a time,
+// and dropped again, least recently used first, when over the memory budget.
+// Running out of memory releases least recently used textures entirely, they
+// sample the default texture until drawn again and reloaded.
+struct Texture
+{
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t residentMip;
+
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+    VkDeviceSize residentBytes = 0;
+    uint64_t lastUsedFrame = 0;
+    uint64_t releasedFrame = 0;
+    // Graphics timeline value of the last commands recorded on image.
+    uint64_t lastCommandValue = 0;
+
+    // Slot in the bindless texture array. A new slot is taken whenever
+    // imageView is replaced, the old one is released with the old view.
+    uint32_t bindlessIndex = 0;
+
+    MappedFile file;
+    std::vector<TextureMip> mips;
+};
+
+extern TextureStreamingSettings textureStreamingSettings;
+extern VkSampler textureSampler;
+
+void initTextures();
+void shutDownTextures();
+
+Texture *loadTexture(const std::string &basePath);
+Texture *createTexture(uint32_t width, uint32_t height, const uint8_t *rgba);
+void destroyTexture(Texture *texture);
+
+void markTextureUsed(Texture *texture);
+void updateTextureStreaming();
+VkDeviceSize getTextureResidentBytes();
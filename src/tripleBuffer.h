@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Hands the newest of a stream of values from one producer thread to one
+// consumer thread without locks. The producer fills the write buffer and
+// publishes it, the consumer swaps in the latest published buffer. Neither
+// side ever waits for the other, values the consumer was too slow for are
+// dropped.
+template <typename T>
+class TripleBuffer
+{
+  public:
+    T &getWriteBuffer()
+    {
+        return buffers[writeIndex];
+    }
+
+    void publish()
+    {
+        uint8_t previous = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+    }
+
+    // Returns false if nothing was published since the last call, the read
+    // buffer is then left as it was.
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH_BIT))
+            return false;
+
+        uint8_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T &getReadBuffer() const
+    {
+        return buffers[readIndex];
+    }
+
+  private:
+    static const uint8_t INDEX_MASK = 0x3;
+    static const uint8_t FRESH_BIT = 0x4;
+
+    T buffers[3] = {};
+    // Only touched by the producer and the consumer respectively, the
+    // middle index is the only state they share.
+    uint8_t writeIndex = 0;
+    std::atomic<uint8_t> middle{1};
+    uint8_t readIndex = 2;
+};
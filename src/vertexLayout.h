@@ -0,0 +1,144 @@
+#pragma once
+
+#include "engine.h"
+
+#include <array>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// Integer components the vertex fetch converts to floats, in [-1, 1] for
+// signed and [0, 1] for unsigned types. Plain integer members stay integers.
+template <typename T, uint32_t N>
+struct Normalized
+{
+    T components[N];
+
+    T &operator[](uint32_t i) { return components[i]; }
+    const T &operator[](uint32_t i) const { return components[i]; }
+};
+
+using Snorm16x2 = Normalized<int16_t, 2>;
+using Snorm16x4 = Normalized<int16_t, 4>;
+using Unorm16x2 = Normalized<uint16_t, 2>;
+using Unorm16x4 = Normalized<uint16_t, 4>;
+using Snorm8x4 = Normalized<int8_t, 4>;
+using Unorm8x4 = Normalized<uint8_t, 4>;
+
+// x, y and z as 10 bit snorm in one word, e.g. for normals.
+struct PackedSnorm10x3
+{
+    uint32_t bits;
+};
+
+// Maps a member type to the format it is read with. Unsupported types fail to
+// compile instead of silently picking a wrong format.
+template <typename T>
+struct VertexFormat;
+
+#define VERTEX_FORMAT(type, format)               \
+    template <>                                   \
+    struct VertexFormat<type>                     \
+    {                                             \
+        static constexpr VkFormat value = format; \
+    };
+
+VERTEX_FORMAT(float, VK_FORMAT_R32_SFLOAT)
+VERTEX_FORMAT(glm::vec2, VK_FORMAT_R32G32_SFLOAT)
+VERTEX_FORMAT(glm::vec3, VK_FORMAT_R32G32B32_SFLOAT)
+VERTEX_FORMAT(glm::vec4, VK_FORMAT_R32G32B32A32_SFLOAT)
+VERTEX_FORMAT(int32_t, VK_FORMAT_R32_SINT)
+VERTEX_FORMAT(glm::ivec2, VK_FORMAT_R32G32_SINT)
+VERTEX_FORMAT(glm::ivec3, VK_FORMAT_R32G32B32_SINT)
+VERTEX_FORMAT(glm::ivec4, VK_FORMAT_R32G32B32A32_SINT)
+VERTEX_FORMAT(uint32_t, VK_FORMAT_R32_UINT)
+VERTEX_FORMAT(glm::uvec2, VK_FORMAT_R32G32_UINT)
+VERTEX_FORMAT(glm::uvec3, VK_FORMAT_R32G32B32_UINT)
+VERTEX_FORMAT(glm::uvec4, VK_FORMAT_R32G32B32A32_UINT)
+VERTEX_FORMAT(int16_t[2], VK_FORMAT_R16G16_SINT)
+VERTEX_FORMAT(int16_t[4], VK_FORMAT_R16G16B16A16_SINT)
+VERTEX_FORMAT(uint16_t[2], VK_FORMAT_R16G16_UINT)
+VERTEX_FORMAT(uint16_t[4], VK_FORMAT_R16G16B16A16_UINT)
+VERTEX_FORMAT(uint8_t[4], VK_FORMAT_R8G8B8A8_UINT)
+VERTEX_FORMAT(Snorm16x2, VK_FORMAT_R16G16_SNORM)
+VERTEX_FORMAT(Snorm16x4, VK_FORMAT_R16G16B16A16_SNORM)
+VERTEX_FORMAT(Unorm16x2, VK_FORMAT_R16G16_UNORM)
+VERTEX_FORMAT(Unorm16x4, VK_FORMAT_R16G16B16A16_UNORM)
+VERTEX_FORMAT(Snorm8x4, VK_FORMAT_R8G8B8A8_SNORM)
+VERTEX_FORMAT(Unorm8x4, VK_FORMAT_R8G8B8A8_UNORM)
+VERTEX_FORMAT(PackedSnorm10x3, VK_FORMAT_A2B10G10R10_SNORM_PACK32)
+
+#undef VERTEX_FORMAT
+
+struct VertexAttribute
+{
+    VkFormat format;
+    uint32_t offset;
+    uint32_t size;
+};
+
+// Usage: VERTEX_ATTRIBUTE(Vertex, pos). The format comes from the member type.
+#define VERTEX_ATTRIBUTE(type, member) \
+    VertexAttribute{VertexFormat<decltype(type::member)>::value, (uint32_t)offsetof(type, member), (uint32_t)sizeof(type::member)}
+
+// Binding and attribute descriptions of one vertex buffer binding, built at
+// compile time from the member list of the vertex type. Attributes take
+// consecutive locations from firstLocation, in the order they are listed.
+template <size_t N>
+struct VertexLayout
+{
+    uint32_t stride;
+    VkVertexInputRate inputRate;
+    std::array<VertexAttribute, N> attributes;
+
+    constexpr VkVertexInputBindingDescription getBindingDescription(uint32_t binding) const
+    {
+        return {binding, stride, inputRate};
+    }
+
+    constexpr std::array<VkVertexInputAttributeDescription, N> getAttributeDescriptions(uint32_t binding, uint32_t firstLocation) const
+    {
+        std::array<VkVertexInputAttributeDescription, N> vertexInputAttributeDescriptions = {};
+        for (size_t i = 0; i < N; i++)
+        {
+            vertexInputAttributeDescriptions[i] = {firstLocation + (uint32_t)i, binding, attributes[i].format, attributes[i].offset};
+        }
+        return vertexInputAttributeDescriptions;
+    }
+};
+
+// Checks that no attribute reads past the stride, e.g. after a member type
+// changed without the struct being updated.
+template <size_t N>
+constexpr bool isVertexLayoutValid(const VertexLayout<N> &layout)
+{
+    for (const VertexAttribute &attribute : layout.attributes)
+    {
+        if (attribute.offset + attribute.size > layout.stride)
+            return false;
+    }
+    return true;
+}
+
+template <typename Vertex, typename... Attributes>
+constexpr VertexLayout<sizeof...(Attributes)> makeVertexLayout(VkVertexInputRate inputRate, Attributes... attributes)
+{
+    return {(uint32_t)sizeof(Vertex), inputRate, {attributes...}};
+}
+
+// Concatenates the attribute descriptions of several bindings, for the
+// pipeline's vertex input state.
+template <size_t N, size_t M>
+constexpr std::array<VkVertexInputAttributeDescription, N + M> joinAttributeDescriptions(const std::array<VkVertexInputAttributeDescription, N> &first,
+                                                                                         const std::array<VkVertexInputAttributeDescription, M> &second)
+{
+    std::array<VkVertexInputAttributeDescription, N + M> vertexInputAttributeDescriptions = {};
+    for (size_t i = 0; i < N; i++)
+    {
+        vertexInputAttributeDescriptions[i] = first[i];
+    }
+    for (size_t i = 0; i < M; i++)
+    {
+        vertexInputAttributeDescriptions[N + i] = second[i];
+    }
+    return vertexInputAttributeDescriptions;
+}
@@ -0,0 +1,376 @@
+// Benchmarks the engine on a synthetic stress scene and writes the results as
+// one JSON object per line, to compare runs over time. Links the engine
+// objects and runs from the repository root like main.
+//
+// usage: bench [--meshes N] [--instances N] [--materials N] [--min-vertices N] [--max-vertices N]
+//              [--frames N] [--warmup-frames N] [--output results.jsonl]
+//
+// Covers buffer creation, staging uploads through createAndUploadBuffer,
+// device to device copies through copyBuffer, full frames of the stress
+// scene with the frame stats counters, and recording the stress scene's
+// render graph alone, without submitting or presenting. The
+// window is only needed for the swapchain, a software driver such as lavapipe
+// works under Xvfb:
+//
+//   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json xvfb-run ./bench
+
+#include "../src/engine.h"
+#include "../src/deletionQueue.h"
+#include "../src/descriptorAllocator.h"
+#include "../src/dynamicResolution.h"
+#include "../src/frameStats.h"
+#include "../src/memoryBudget.h"
+#include "../src/renderGraph.h"
+#include "../src/simulation.h"
+#include "../src/stressScene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+// Owned by engine.cpp, only the recording benchmark reaches into it.
+extern RenderGraph renderGraph;
+
+static std::ofstream resultsFile;
+
+// Collects the fields of one result line.
+class BenchResult
+{
+  public:
+    explicit BenchResult(const std::string &benchmark)
+    {
+        line << "{\"benchmark\": \"" << benchmark << "\"";
+        summary << benchmark;
+    }
+
+    BenchResult &add(const std::string &name, double value)
+    {
+        line << ", \"" << name << "\": " << value;
+        summary << " " << name << "=" << value;
+        return *this;
+    }
+
+    BenchResult &add(const std::string &name, const std::string &value)
+    {
+        line << ", \"" << name << "\": \"";
+        for (char c : value)
+        {
+            if (c == '"' || c == '\\')
+                line << '\\';
+            line << c;
+        }
+        line << "\"";
+        summary << " " << name << "=" << value;
+        return *this;
+    }
+
+    void write()
+    {
+        resultsFile << line.str() << "}\n";
+        resultsFile.flush();
+        std::cout << summary.str() << std::endl;
+    }
+
+  private:
+    std::ostringstream line;
+    std::ostringstream summary;
+};
+
+static double getMilliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// One time commands are batched until the next frame, so the timings include
+// submitting them and waiting for the GPU.
+static void waitForOneTimeCommands()
+{
+    graphicsTimeline.waitForValue(graphicsTimeline.flush());
+    deletionQueue.collect();
+}
+
+static const VkDeviceSize KiB = 1024;
+static const VkDeviceSize MiB = 1024 * 1024;
+
+static void benchBufferCreation()
+{
+    for (VkDeviceSize size : {4 * KiB, 256 * KiB, 4 * MiB, 64 * MiB})
+    {
+        const uint32_t iterations = size >= 64 * MiB ? 20 : 200;
+        double milliseconds = 0.0;
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            VkBuffer buffer;
+            VkDeviceMemory bufferMemory;
+            createBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, bufferMemory);
+            vkDestroyBuffer(device, buffer, nullptr);
+            freeDeviceMemory(bufferMemory);
+            milliseconds += getMilliseconds(start);
+        }
+
+        BenchResult("bufferCreation").add("bytes", size).add("iterations", iterations).add("microsecondsPerBuffer", milliseconds * 1000.0 / iterations).write();
+    }
+}
+
+static void benchUpload()
+{
+    for (VkDeviceSize size : {64 * KiB, 1 * MiB, 16 * MiB, 64 * MiB})
+    {
+        std::vector<uint8_t> data(size);
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            data[i] = (uint8_t)(i * 31);
+        }
+
+        // Roughly 256 MiB per size, so small uploads are timed over enough
+        // iterations.
+        const uint32_t iterations = (uint32_t)std::min(std::max(256 * MiB / size, (VkDeviceSize)4), (VkDeviceSize)200);
+        double milliseconds = 0.0;
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            VkBuffer buffer;
+            VkDeviceMemory bufferMemory;
+            createAndUploadBuffer(data.data(), size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, buffer, bufferMemory);
+            waitForOneTimeCommands();
+            milliseconds += getMilliseconds(start);
+
+            vkDestroyBuffer(device, buffer, nullptr);
+            freeDeviceMemory(bufferMemory);
+        }
+
+        BenchResult("upload")
+            .add("bytes", size)
+            .add("iterations", iterations)
+            .add("millisecondsPerUpload", milliseconds / iterations)
+            .add("mibPerSecond", size * iterations / (double)MiB / (milliseconds / 1000.0))
+            .write();
+    }
+}
+
+static void benchCopy()
+{
+    for (VkDeviceSize size : {1 * MiB, 16 * MiB, 64 * MiB})
+    {
+        VkBuffer source;
+        VkDeviceMemory sourceMemory;
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, source, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sourceMemory);
+        VkBuffer destination;
+        VkDeviceMemory destinationMemory;
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, destination, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, destinationMemory);
+
+        const uint32_t iterations = 20;
+        copyBuffer(source, destination, size);
+        waitForOneTimeCommands();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            copyBuffer(source, destination, size);
+            waitForOneTimeCommands();
+        }
+        double milliseconds = getMilliseconds(start);
+
+        BenchResult("copy")
+            .add("bytes", size)
+            .add("iterations", iterations)
+            .add("millisecondsPerCopy", milliseconds / iterations)
+            .add("mibPerSecond", size * iterations / (double)MiB / (milliseconds / 1000.0))
+            .write();
+
+        vkDestroyBuffer(device, destination, nullptr);
+        freeDeviceMemory(destinationMemory);
+        vkDestroyBuffer(device, source, nullptr);
+        freeDeviceMemory(sourceMemory);
+    }
+}
+
+// The frame stats average over the last FRAME_STATS_HISTORY frames, so the
+// counters only cover the measured frames when frames is at most that.
+static void benchFrames(uint32_t warmupFrames, uint32_t frames)
+{
+    startSimulation();
+    // Pipelines are compiled and meshes uploaded by the first frames.
+    for (uint32_t i = 0; i < warmupFrames; i++)
+    {
+        glfwPollEvents();
+        renderFrame();
+    }
+
+    std::vector<double> frameMilliseconds;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        glfwPollEvents();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        renderFrame();
+        frameMilliseconds.push_back(getMilliseconds(start));
+    }
+    stopSimulation();
+
+    double sum = 0.0;
+    for (double milliseconds : frameMilliseconds)
+    {
+        sum += milliseconds;
+    }
+    std::sort(frameMilliseconds.begin(), frameMilliseconds.end());
+
+    BenchResult result("frames");
+    result.add("frames", frames)
+        .add("meshes", stressSceneSettings.meshCount)
+        .add("instances", stressSceneSettings.instanceCount)
+        .add("materials", stressSceneSettings.materialCount)
+        .add("frameMs", sum / frames)
+        .add("p50FrameMs", frameMilliseconds[frames / 2])
+        .add("p95FrameMs", frameMilliseconds[std::min(frames * 95 / 100, frames - 1)])
+        .add("maxFrameMs", frameMilliseconds.back());
+
+    FrameStatsAverage average;
+    if (getFrameStatsAverage(average) > 0)
+    {
+        for (size_t i = 0; i < (size_t)FrameCounter::Count; i++)
+        {
+            result.add(getFrameCounterName((FrameCounter)i), average.counters[i]);
+        }
+        for (size_t i = 0; i < (size_t)FrameTimer::Count; i++)
+        {
+            result.add(std::string(getFrameTimerName((FrameTimer)i)) + "Ms", average.timerMilliseconds[i]);
+        }
+    }
+    result.write();
+}
+
+// Records the last drawn frame again into the next frame's command buffers
+// without submitting them. The passes leave the frame state alone, draws only
+// mark resources as used in the residency frame they already were, and the
+// frame stats counters are put back so the recording isn't counted.
+static void recordFrame()
+{
+#if ENGINE_STATS
+    uint64_t counters[(size_t)FrameCounter::Count];
+    memcpy(counters, frameCounters, sizeof(counters));
+#endif
+
+    frameDescriptorAllocators[currentFrame].reset();
+    renderGraph.record(currentFrame);
+
+#if ENGINE_STATS
+    memcpy(frameCounters, counters, sizeof(counters));
+#endif
+}
+
+// Runs after benchFrames, so pipelines are compiled and meshes resident. The
+// command buffers and descriptor sets recorded into belong to the next frame,
+// which must not be in flight.
+static void benchRecording(uint32_t iterations)
+{
+    vkDeviceWaitIdle(device);
+    recordFrame();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        recordFrame();
+    }
+    double milliseconds = getMilliseconds(start);
+
+    BenchResult("recording")
+        .add("iterations", iterations)
+        .add("meshes", stressSceneSettings.meshCount)
+        .add("instances", stressSceneSettings.instanceCount)
+        .add("materials", stressSceneSettings.materialCount)
+        .add("millisecondsPerRecording", milliseconds / iterations)
+        .write();
+}
+
+int main(int argc, char const *argv[])
+{
+    stressSceneSettings.meshCount = 256;
+    stressSceneSettings.instanceCount = 16;
+    stressSceneSettings.materialCount = 8;
+    stressSceneSettings.maxVertices = 16384;
+    uint32_t warmupFrames = 60;
+    uint32_t frames = FRAME_STATS_HISTORY;
+    std::string outputFileName = "bench.jsonl";
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--meshes" && i + 1 < argc)
+        {
+            stressSceneSettings.meshCount = std::max((uint32_t)std::stoul(argv[++i]), 1u);
+        }
+        else if (argument == "--instances" && i + 1 < argc)
+        {
+            stressSceneSettings.instanceCount = std::stoul(argv[++i]);
+        }
+        else if (argument == "--materials" && i + 1 < argc)
+        {
+            stressSceneSettings.materialCount = std::stoul(argv[++i]);
+        }
+        else if (argument == "--min-vertices" && i + 1 < argc)
+        {
+            stressSceneSettings.minVertices = std::stoul(argv[++i]);
+        }
+        else if (argument == "--max-vertices" && i + 1 < argc)
+        {
+            stressSceneSettings.maxVertices = std::stoul(argv[++i]);
+        }
+        else if (argument == "--frames" && i + 1 < argc)
+        {
+            frames = std::max((uint32_t)std::stoul(argv[++i]), 1u);
+        }
+        else if (argument == "--warmup-frames" && i + 1 < argc)
+        {
+            warmupFrames = std::stoul(argv[++i]);
+        }
+        else if (argument == "--output" && i + 1 < argc)
+        {
+            outputFileName = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Unknown argument " << argument << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    resultsFile.open(outputFileName);
+    if (!resultsFile)
+    {
+        std::cerr << "Failed to open " << outputFileName << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Frames are measured as fast as they render, at a fixed resolution and
+    // with a fixed simulation.
+    vsync = false;
+    dynamicResolutionSettings.enabled = false;
+    simulationSettings.tickSeconds = 1.0f / 60.0f;
+    simulationSettings.lockstep = true;
+
+    initWindow();
+    initVulkan();
+
+    VkPhysicalDeviceProperties deviceProps;
+    vkGetPhysicalDeviceProperties(physicalDevices[0], &deviceProps);
+    BenchResult("device")
+        .add("name", deviceProps.deviceName)
+        .add("vendorID", deviceProps.vendorID)
+        .add("driverVersion", deviceProps.driverVersion)
+        .add("apiVersion", std::to_string(VK_VERSION_MAJOR(deviceProps.apiVersion)) + "." + std::to_string(VK_VERSION_MINOR(deviceProps.apiVersion)))
+        .write();
+
+    benchBufferCreation();
+    benchUpload();
+    benchCopy();
+    benchFrames(warmupFrames, frames);
+    benchRecording(frames);
+
+    shutDownVulkan();
+    shutDownWindow();
+
+    std::cout << "Results written to " << outputFileName << std::endl;
+    return 0;
+}
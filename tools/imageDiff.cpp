@@ -0,0 +1,127 @@
+// Compares two binary PPM images, as written by the engine's frame capture.
+//
+// usage: imageDiff <expected.ppm> <actual.ppm> [--tolerance N] [--max-different F] [--output diff.ppm]
+//
+// A pixel differs when any channel is off by more than the tolerance (0-255,
+// default 2). The images match when at most the given fraction of pixels
+// differ (default 0.001). The diff image shows differing pixels in red over a
+// darkened copy of the expected image. Exits with 0 on a match, 1 on a
+// mismatch and 2 on errors.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct Image
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+static bool readPpm(const std::string &fileName, Image &image)
+{
+    std::ifstream file(fileName, std::ios::binary);
+    std::string magic;
+    uint32_t maxValue = 0;
+    file >> magic >> image.width >> image.height >> maxValue;
+    if (!file || magic != "P6" || maxValue != 255)
+    {
+        std::cerr << fileName << ": not an 8 bit binary PPM" << std::endl;
+        return false;
+    }
+    file.get();
+
+    image.pixels.resize((size_t)image.width * image.height * 3);
+    file.read((char *)image.pixels.data(), image.pixels.size());
+    if (!file)
+    {
+        std::cerr << fileName << ": truncated" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool writePpm(const std::string &fileName, const Image &image)
+{
+    std::ofstream file(fileName, std::ios::binary);
+    file << "P6\n"
+         << image.width << " " << image.height << "\n255\n";
+    file.write((const char *)image.pixels.data(), image.pixels.size());
+    return (bool)file;
+}
+
+int main(int argc, char const *argv[])
+{
+    std::vector<std::string> files;
+    int tolerance = 2;
+    double maxDifferent = 0.001;
+    std::string outputFileName;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--tolerance" && i + 1 < argc)
+            tolerance = std::atoi(argv[++i]);
+        else if (argument == "--max-different" && i + 1 < argc)
+            maxDifferent = std::atof(argv[++i]);
+        else if (argument == "--output" && i + 1 < argc)
+            outputFileName = argv[++i];
+        else
+            files.push_back(argument);
+    }
+
+    if (files.size() != 2)
+    {
+        std::cerr << "usage: imageDiff <expected.ppm> <actual.ppm> [--tolerance N] [--max-different F] [--output diff.ppm]" << std::endl;
+        return 2;
+    }
+
+    Image expected;
+    Image actual;
+    if (!readPpm(files[0], expected) || !readPpm(files[1], actual))
+        return 2;
+
+    if (expected.width != actual.width || expected.height != actual.height)
+    {
+        std::cerr << "Size mismatch: " << expected.width << "x" << expected.height << " vs " << actual.width << "x" << actual.height << std::endl;
+        return 1;
+    }
+
+    Image diff = expected;
+    size_t pixelCount = (size_t)expected.width * expected.height;
+    size_t differentPixels = 0;
+    int maxError = 0;
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        int pixelError = 0;
+        for (size_t c = 0; c < 3; c++)
+        {
+            pixelError = std::max(pixelError, std::abs(expected.pixels[i * 3 + c] - actual.pixels[i * 3 + c]));
+        }
+        maxError = std::max(maxError, pixelError);
+
+        bool different = pixelError > tolerance;
+        if (different)
+            differentPixels++;
+
+        for (size_t c = 0; c < 3; c++)
+        {
+            diff.pixels[i * 3 + c] = different ? (c == 0 ? 255 : 0) : expected.pixels[i * 3 + c] / 4;
+        }
+    }
+
+    if (!outputFileName.empty() && !writePpm(outputFileName, diff))
+        std::cerr << "Failed to write " << outputFileName << std::endl;
+
+    double differentFraction = pixelCount > 0 ? (double)differentPixels / pixelCount : 0.0;
+    bool match = differentFraction <= maxDifferent;
+    std::cout << (match ? "match" : "MISMATCH") << ": " << differentPixels << " of " << pixelCount << " pixels differ by more than " << tolerance
+              << ", max error " << maxError << std::endl;
+
+    return match ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+// Writes a test .scene file: a grid of tiles, each its own mesh made of
+// subdivided quads, for exercising incremental scene loading.
+//
+// usage: sceneBuilder <output.scene> [--tiles N] [--subdivisions N] [--extent F]
+//
+// The grid covers [-extent, extent] in x and y (default 2) with N x N tiles
+// (default 16), each split into N x N quads (default 32).
+
+#include "../src/sceneFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct Mesh
+{
+    std::vector<SceneVertex> vertices;
+    std::vector<uint32_t> indices;
+    SceneMeshEntry entry;
+};
+
+static uint64_t alignPayload(uint64_t offset)
+{
+    return (offset + SCENE_PAYLOAD_ALIGNMENT - 1) & ~(uint64_t)(SCENE_PAYLOAD_ALIGNMENT - 1);
+}
+
+static int16_t quantize(float value, float scale)
+{
+    return (int16_t)std::lround(std::max(-1.0f, std::min(1.0f, value / scale)) * 32767.0f);
+}
+
+static Mesh buildTile(uint32_t tileX, uint32_t tileY, uint32_t tiles, uint32_t subdivisions, float extent)
+{
+    float tileSize = 2.0f * extent / tiles;
+    float x0 = -extent + tileX * tileSize;
+    float y0 = -extent + tileY * tileSize;
+
+    // A checkerboard of two tints, so tile borders stay visible.
+    bool odd = ((tileX + tileY) & 1) != 0;
+    float tint[3] = {odd ? 1.0f : 0.6f, 0.8f, odd ? 0.6f : 1.0f};
+
+    Mesh mesh;
+    for (uint32_t y = 0; y <= subdivisions; y++)
+    {
+        for (uint32_t x = 0; x <= subdivisions; x++)
+        {
+            float u = x / (float)subdivisions;
+            float v = y / (float)subdivisions;
+
+            SceneVertex vertex;
+            vertex.pos[0] = quantize(x0 + u * tileSize, extent);
+            vertex.pos[1] = quantize(y0 + v * tileSize, extent);
+            vertex.color[0] = tint[0];
+            vertex.color[1] = tint[1];
+            vertex.color[2] = tint[2];
+            vertex.texCoord[0] = u;
+            vertex.texCoord[1] = v;
+            mesh.vertices.push_back(vertex);
+        }
+    }
+
+    uint32_t rowLength = subdivisions + 1;
+    for (uint32_t y = 0; y < subdivisions; y++)
+    {
+        for (uint32_t x = 0; x < subdivisions; x++)
+        {
+            uint32_t i = y * rowLength + x;
+            uint32_t quad[6] = {i, i + rowLength + 1, i + rowLength, i, i + 1, i + rowLength + 1};
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+
+    mesh.entry.vertexCount = mesh.vertices.size();
+    mesh.entry.indexCount = mesh.indices.size();
+    mesh.entry.center[0] = x0 + tileSize * 0.5f;
+    mesh.entry.center[1] = y0 + tileSize * 0.5f;
+    mesh.entry.radius = tileSize * 0.70710678f;
+    mesh.entry.reserved = 0;
+    return mesh;
+}
+
+int main(int argc, char const *argv[])
+{
+    std::string output;
+    uint32_t tiles = 16;
+    uint32_t subdivisions = 32;
+    float extent = 2.0f;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--tiles" && i + 1 < argc)
+            tiles = std::max(1, std::atoi(argv[++i]));
+        else if (argument == "--subdivisions" && i + 1 < argc)
+            subdivisions = std::max(1, std::atoi(argv[++i]));
+        else if (argument == "--extent" && i + 1 < argc)
+            extent = std::atof(argv[++i]);
+        else
+            output = argument;
+    }
+
+    if (output.empty() || extent <= 0.0f)
+    {
+        std::cerr << "usage: sceneBuilder <output.scene> [--tiles N] [--subdivisions N] [--extent F]" << std::endl;
+        return 2;
+    }
+
+    std::vector<Mesh> meshes;
+    for (uint32_t y = 0; y < tiles; y++)
+    {
+        for (uint32_t x = 0; x < tiles; x++)
+        {
+            meshes.push_back(buildTile(x, y, tiles, subdivisions, extent));
+        }
+    }
+
+    SceneFileHeader header;
+    header.magic = SCENE_FILE_MAGIC;
+    header.version = SCENE_FILE_VERSION;
+    header.meshCount = meshes.size();
+    header.positionScale = extent;
+    header.tableOffset = sizeof(SceneFileHeader);
+
+    uint64_t offset = alignPayload(header.tableOffset + meshes.size() * sizeof(SceneMeshEntry));
+    for (Mesh &mesh : meshes)
+    {
+        mesh.entry.vertexOffset = offset;
+        offset = alignPayload(offset + mesh.vertices.size() * sizeof(SceneVertex));
+        mesh.entry.indexOffset = offset;
+        offset = alignPayload(offset + mesh.indices.size() * sizeof(uint32_t));
+    }
+
+    std::vector<char> data(offset, 0);
+    memcpy(data.data(), &header, sizeof(header));
+    for (uint32_t i = 0; i < meshes.size(); i++)
+    {
+        const Mesh &mesh = meshes[i];
+        memcpy(data.data() + header.tableOffset + i * sizeof(SceneMeshEntry), &mesh.entry, sizeof(SceneMeshEntry));
+        memcpy(data.data() + mesh.entry.vertexOffset, mesh.vertices.data(), mesh.vertices.size() * sizeof(SceneVertex));
+        memcpy(data.data() + mesh.entry.indexOffset, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+    }
+
+    std::ofstream file(output, std::ios::binary);
+    file.write(data.data(), data.size());
+    if (!file)
+    {
+        std::cerr << "Failed to write " << output << std::endl;
+        return 2;
+    }
+
+    std::cout << "Wrote " << meshes.size() << " meshes, " << data.size() / 1024 << " KiB to " << output << std::endl;
+    return 0;
+}